@@ -1,12 +1,28 @@
 // Copyright 1998-2017 Epic Games, Inc. All Rights Reserved.
 
 #include "WebSocket.h"
+#include "WebSocketSettings.h"
+#include "WebSocketBlueprintLibrary.h"
+#include "Misc/CoreDelegates.h"
 
 #define LOCTEXT_NAMESPACE "FWebSocketModule"
 
 void FWebSocketModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+	FCoreDelegates::OnPostEngineInit.AddLambda([]()
+	{
+		if (GetDefault<UWebSocketSettings>()->bWarmUpOnStartup)
+		{
+			UWebSocketBlueprintLibrary::WarmUp();
+		}
+	});
+
+	// UObjects are still alive here, ShutdownModule runs too late to close the sockets
+	FCoreDelegates::OnPreExit.AddLambda([]()
+	{
+		UWebSocketBlueprintLibrary::ShutdownContext(GetDefault<UWebSocketSettings>()->ShutdownTimeout);
+	});
 }
 
 void FWebSocketModule::ShutdownModule()
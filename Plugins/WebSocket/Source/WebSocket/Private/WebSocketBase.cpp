@@ -22,6 +22,23 @@
 #include "WebSocket.h"
 #include <iostream>
 #include "WebSocketBase.h"
+#include "WebSocketBlueprintLibrary.h"
+#include "WebSocketChannel.h"
+#include "WebSocketClock.h"
+#include "WebSocketCodec.h"
+#include "WebSocketConnection.h"
+#include "WebSocketContext.h"
+#include "WebSocketEndpointSet.h"
+#include "WebSocketJournal.h"
+#include "WebSocketRequestTracker.h"
+#include "WebSocketRouter.h"
+#include "WebSocketServer.h"
+#include "WebSocketSettings.h"
+#include "WebSocketTransfer.h"
+#include "WebSocketUtf8.h"
+#include "Containers/Ticker.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
 
 #if PLATFORM_UWP
 #elif PLATFORM_HTML5
@@ -91,6 +108,8 @@ void FHtml5SocketHelper::Tick(float DeltaTime)
 		return;
 	}
 
+	mHostWebSocket->DeliverInbox();
+
 	if (mHostWebSocket->mIsError)
 	{
 		return;
@@ -121,6 +140,7 @@ void FHtml5SocketHelper::Tick(float DeltaTime)
 		}
 		else
 		{
+			mHostWebSocket->FailRequests();
 			mHostWebSocket->OnClosed.Broadcast();
 		}
 
@@ -156,6 +176,12 @@ TStatId FHtml5SocketHelper::GetStatId() const
 
 UWebSocketBase::UWebSocketBase()
 {
+	mInbox = MakeShareable(new FWebSocketInbox());
+	mDeliverFrame = 0;
+	mDeliveredBytes = 0;
+	mbClosing = false;
+	mbClockSync = false;
+
 #if PLATFORM_UWP
 	messageWebSocket = nullptr;
 	uwpSocketHelper = ref new FUWPSocketHelper();
@@ -166,14 +192,17 @@ UWebSocketBase::UWebSocketBase()
 	mIsError = false;
 	
 #else
-	mlwsContext = nullptr;
-	mlws = nullptr;
+	mContext = nullptr;
+	mNextTransferId = 0;
 #endif
 }
 
 
 void UWebSocketBase::BeginDestroy()
 {
+	// the promises' continuations may still look at this object, it has to be whole for them
+	FailRequests();
+	mRequests = nullptr;
 	Super::BeginDestroy();
 
 #if PLATFORM_UWP
@@ -188,11 +217,19 @@ void UWebSocketBase::BeginDestroy()
 #elif PLATFORM_HTML5
 	mHtml5SocketHelper.UnBind();
 #else
-	if (mlws != nullptr)
+	if (mEndpointSet.IsValid())
+	{
+		mEndpointSet->Stop();
+		mEndpointSet = nullptr;
+	}
+
+	// the connection outlives us until lws closed the wsi, its events are dropped from now on
+	if (mConnection.IsValid())
 	{
-		lws_set_wsi_user(mlws, NULL);
-		mlws = nullptr;
+		mConnection->Close(1001, TEXT(""), 0.0f);
+		mConnection = nullptr;
 	}
+	mJournal = nullptr;
 #endif
 }
 
@@ -209,8 +246,9 @@ void UWebSocketBase::MessageReceived(Windows::Networking::Sockets::MessageWebSoc
 		try
 		{
 			String^ read = reader->ReadString(reader->UnconsumedBufferLength);
-			FString strData(read->Data(), read->Length());
-			OnReceiveData.Broadcast(strData);
+			FWebSocketInMessage msg;
+			msg.Data = FString(read->Data(), read->Length());
+			DeliverMessage(msg);
 		}
 		catch (Exception^ ex)
 		{
@@ -225,11 +263,12 @@ void UWebSocketBase::OnUWPClosed(Windows::Networking::Sockets::IWebSocket^ sende
 		Windows::UI::Core::CoreDispatcherPriority::Normal,
 		ref new Windows::UI::Core::DispatchedHandler([this]()
 	{
+		FailRequests();
 		OnClosed.Broadcast();
 	}));
 }
 
-Concurrency::task<void> UWebSocketBase::ConnectAsync(Platform::String^ uriString)
+Concurrency::task<void> UWebSocketBase::ConnectAsync(Platform::String^ uriString, Platform::String^ protocol)
 {
 	Uri^ server = nullptr;
 	try
@@ -247,6 +286,10 @@ Concurrency::task<void> UWebSocketBase::ConnectAsync(Platform::String^ uriString
 
 	messageWebSocket = ref new MessageWebSocket();
 	messageWebSocket->Control->MessageType = SocketMessageType::Utf8;
+	if (!protocol->IsEmpty())
+	{
+		messageWebSocket->Control->SupportedProtocols->Append(protocol);
+	}
 	messageWebSocket->MessageReceived +=
 		ref new TypedEventHandler<
 		MessageWebSocket^,
@@ -268,6 +311,10 @@ Concurrency::task<void> UWebSocketBase::ConnectAsync(Platform::String^ uriString
 		}
 
 		messageWriter = ref new DataWriter(messageWebSocket->OutputStream);
+		if (messageWebSocket->Information->Protocol != nullptr)
+		{
+			mProtocol = FString(messageWebSocket->Information->Protocol->Data());
+		}
 	});
 }
 
@@ -297,15 +344,16 @@ Concurrency::task<void> UWebSocketBase::SendAsync(Platform::String^ message)
 
 #endif
 
-bool UWebSocketBase::Connect(const FString& uri, const TMap<FString, FString>& header)
+bool UWebSocketBase::Connect(const FString& uri, const TMap<FString, FString>& header, const FString& protocol)
 {
 	if (uri.IsEmpty())
 	{
 		return false;
 	}
+	mEndpoint = uri;
 
 #if PLATFORM_UWP
-	ConnectAsync(ref new String(*uri) ).then([this]()
+	ConnectAsync(ref new String(*uri), ref new String(*protocol) ).then([this]()
 	{
 		Windows::ApplicationModel::Core::CoreApplication::MainView->Dispatcher->RunAsync(
 			Windows::UI::Core::CoreDispatcherPriority::Normal,
@@ -324,97 +372,299 @@ bool UWebSocketBase::Connect(const FString& uri, const TMap<FString, FString>& h
 
 	return true;
 #elif PLATFORM_HTML5
+	if (!protocol.IsEmpty())
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: subprotocol '%s' is not offered on html5"), *protocol);
+	}
+
 	mHtml5SocketHelper.Bind(this);
 	std::string strUrl = TCHAR_TO_UTF8(*uri);
 	mWebSocketRef = SocketCreate(strUrl.c_str() );
 	
 	return true;
 #else
-	if (mlwsContext == nullptr)
+	if (mContext == nullptr || mContext->GetLwsContext() == nullptr)
 	{
 		return false;
 	}
 
-	int iUseSSL = 0;
-	int iPos = uri.Find(TEXT(":"));
-	if (iPos == INDEX_NONE)
+	int32 iProtocol = mContext->FindProtocol(protocol);
+	if (iProtocol == INDEX_NONE)
 	{
-		//UE_LOG(WebSocket, Error, TEXT("Invalid Websocket address:%s"), *uri);
+		UE_LOG(WebSocket, Error, TEXT("websocket: protocol '%s' is not registered in the websocket settings"), *protocol);
 		return false;
 	}
 
-	FString strProtocol = uri.Left(iPos);
-	if (strProtocol.ToUpper() != TEXT("WS") && strProtocol.ToUpper() != TEXT("WSS"))
+	return OpenConnection(uri, header, iProtocol, false).IsValid();
+#endif
+}
+
+bool UWebSocketBase::ConnectEndpoints(const TArray<FString>& uris, const TMap<FString, FString>& header, const FString& protocol)
+{
+	if (uris.Num() == 0)
 	{
-		//UE_LOG(WebSocket, Error, TEXT("Invalid Protol:%s"), *strProtocol);
 		return false;
 	}
 
-	if (strProtocol.ToUpper() == TEXT("WSS"))
+#if PLATFORM_UWP
+	return Connect(uris[0], header, protocol);
+#elif PLATFORM_HTML5
+	return Connect(uris[0], header, protocol);
+#else
+	if (mContext == nullptr || mContext->GetLwsContext() == nullptr)
 	{
-		iUseSSL = 2;
+		return false;
 	}
 
-	FString strHost;
-	FString strPath = TEXT("/");
-	FString strNextParse = uri.Mid(iPos + 3);
-	iPos = strNextParse.Find("/");
-	if (iPos != INDEX_NONE)
+	int32 iProtocol = mContext->FindProtocol(protocol);
+	if (iProtocol == INDEX_NONE)
 	{
-		strHost = strNextParse.Left(iPos);
-		strPath = strNextParse.Mid(iPos);
+		UE_LOG(WebSocket, Error, TEXT("websocket: protocol '%s' is not registered in the websocket settings"), *protocol);
+		return false;
 	}
-	else
+
+	mEndpointSet = MakeShareable(new FWebSocketEndpointSet(this, uris, header, iProtocol));
+	return mEndpointSet->Start(false);
+#endif
+}
+
+bool UWebSocketBase::ProbeEndpoints(const TArray<FString>& uris, const TMap<FString, FString>& header, const FString& protocol)
+{
+#if PLATFORM_UWP
+	UE_LOG(WebSocket, Error, TEXT("websocket: ProbeEndpoints is not supported on uwp"));
+	return false;
+#elif PLATFORM_HTML5
+	UE_LOG(WebSocket, Error, TEXT("websocket: ProbeEndpoints is not supported on html5"));
+	return false;
+#else
+	if (uris.Num() == 0 || mContext == nullptr || mContext->GetLwsContext() == nullptr)
 	{
-		strHost = strNextParse;
+		return false;
 	}
 
-	FString strAddress = strHost;
-	int iPort = 80;
-	iPos = strAddress.Find(":");
-	if (iPos != INDEX_NONE)
+	int32 iProtocol = mContext->FindProtocol(protocol);
+	if (iProtocol == INDEX_NONE)
 	{
-		strAddress = strHost.Left(iPos);
-		iPort = FCString::Atoi(*strHost.Mid(iPos + 1));
+		UE_LOG(WebSocket, Error, TEXT("websocket: protocol '%s' is not registered in the websocket settings"), *protocol);
+		return false;
 	}
-	else
+
+	mEndpointSet = MakeShareable(new FWebSocketEndpointSet(this, uris, header, iProtocol));
+	return mEndpointSet->Start(true);
+#endif
+}
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe> UWebSocketBase::OpenConnection(const FString& uri, const TMap<FString, FString>& header, int32 protocolIndex, bool bStandby)
+{
+	FWebSocketUri target;
+	if (!FWebSocketUri::Parse(uri, target))
 	{
-		if (iUseSSL)
-		{
-			iPort = 443;
-		}
+		return nullptr;
 	}
 
-	struct lws_client_connect_info connectInfo;
-	memset(&connectInfo, 0, sizeof(connectInfo));
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> connection = CreateConnection(protocolIndex, bStandby);
+	if (!connection->OpenUri(target, header, protocolIndex))
+	{
+		return nullptr;
+	}
+	return connection;
+}
 
-	std::string stdAddress = TCHAR_TO_UTF8(*strAddress);
-	std::string stdPath = TCHAR_TO_UTF8(*strPath);
-	std::string stdHost = TCHAR_TO_UTF8(*strHost);;
+TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> UWebSocketBase::CreateConnection(int32 protocolIndex, bool bStandby)
+{
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> connection = MakeShareable(new FWebSocketConnection(mContext, this, mInbox.ToSharedRef()));
+	connection->SetStandby(bStandby);
+	connection->SetDurable(mJournal.IsValid());
+	connection->SetTextAsUtf8(mNativeReceive.IsBound());
+	connection->SetDecoder(mConnectionDecoder);
+	if (!mTransferDirectory.IsEmpty())
+	{
+		connection->SetTransferDirectory(mTransferDirectory);
+	}
+	if (mbClockSync && !bStandby)
+	{
+		connection->SetClock(mClock);
+	}
 
-	connectInfo.context = mlwsContext;
-	connectInfo.address = stdAddress.c_str();
-	connectInfo.port = iPort;
-	connectInfo.ssl_connection = iUseSSL;
-	connectInfo.path = stdPath.c_str();
-	connectInfo.host = stdHost.c_str();
-	connectInfo.origin = stdHost.c_str();
-	connectInfo.ietf_version_or_minus_one = -1;
-	connectInfo.userdata = this;
+	// the dictionary codec compresses text, binary protocols keep their frames as they are
+	TSharedPtr<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe> codec = mContext->GetDictionaryCodec();
+	if (codec.IsValid() && mContext->GetProtocolConfig(protocolIndex).Codec == EWebSocketPayloadCodec::Text)
+	{
+		connection->SetCodec(codec.ToSharedRef());
+	}
 
-	mlws = lws_client_connect_via_info(&connectInfo);
-	//mlws = lws_client_connect_extended(mlwsContext, TCHAR_TO_UTF8(*strAddress), iPort, iUseSSL, TCHAR_TO_UTF8(*strPath), TCHAR_TO_UTF8(*strHost), TCHAR_TO_UTF8(*strHost), NULL, -1, (void*)this);
-	if (mlws == nullptr)
+	// channel queues belong to mConnection alone, a standby gets them when it is promoted
+	if (bStandby)
 	{
-		UE_LOG(WebSocket, Error, TEXT("create client connect fail"));
-		return false;
+		return connection;
 	}
 
-	mHeaderMap = header;
+	// assigned before opening, lws may report a failed connect before Open returned
+	mConnection = connection;
+	for (auto& it : mChannels)
+	{
+		connection->AddChannel(it.Value->GetState().ToSharedRef());
+	}
+	ReplayDurable();
+	return connection;
+}
 
-	return true;
-#endif
+void UWebSocketBase::PromoteConnection(const TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe>& connection, const FString& endpoint, const FString& protocol)
+{
+	mConnection = connection;
+	mEndpoint = endpoint;
+	mProtocol = protocol;
+	connection->SetStandby(false);
+	connection->SetDurable(mJournal.IsValid());
+	connection->SetTextAsUtf8(mNativeReceive.IsBound());
+	connection->SetDecoder(mConnectionDecoder);
+	if (!mTransferDirectory.IsEmpty())
+	{
+		connection->SetTransferDirectory(mTransferDirectory);
+	}
+	if (mbClockSync)
+	{
+		connection->SetClock(mClock);
+	}
+	for (auto& it : mChannels)
+	{
+		connection->AddChannel(it.Value->GetState().ToSharedRef());
+	}
+	ReplayDurable();
+}
+
+void UWebSocketBase::AdoptConnection(UWebSocketContext* context, UWebSocketServer* server, const TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe>& connection, const FString& endpoint, const FString& protocol)
+{
+	mContext = context;
+	mServer = server;
+	mInbox = connection->GetInbox();
+	mConnection = connection;
+	mEndpoint = endpoint;
+	mProtocol = protocol;
+
+	// messages that arrived before this object existed are delivered from now on
+	connection->SetOwner(this);
+}
+
+void UWebSocketBase::HandleEstablished(FWebSocketConnection* connection, const FString& protocol)
+{
+	if (mEndpointSet.IsValid() && mEndpointSet->OnEstablished(connection, protocol))
+	{
+		return;
+	}
+
+	if (connection != mConnection.Get())
+	{
+		return;
+	}
+
+	mProtocol = protocol;
+	OnConnectComplete.Broadcast();
+}
+
+void UWebSocketBase::HandleConnectError(FWebSocketConnection* connection, const FString& error)
+{
+	if (mEndpointSet.IsValid() && mEndpointSet->OnConnectionLost(connection))
+	{
+		return;
+	}
+
+	if (connection != mConnection.Get())
+	{
+		return;
+	}
+
+	// Close aborted the connect, that is a close and not an error
+	if (mbClosing)
+	{
+		NotifyClosed();
+		return;
+	}
+
+	FailRequests();
+	OnConnectError.Broadcast(error);
+}
+
+void UWebSocketBase::HandleClosed(FWebSocketConnection* connection)
+{
+	if (mEndpointSet.IsValid() && mEndpointSet->OnConnectionLost(connection))
+	{
+		return;
+	}
+
+	if (connection != mConnection.Get())
+	{
+		return;
+	}
+
+	NotifyClosed();
+}
+
+void UWebSocketBase::NotifyClosed()
+{
+	// responses that made it into the inbox still complete their requests
+	DeliverInbox(true);
+	FailRequests();
+	OnClosed.Broadcast();
+
+	if (UWebSocketServer* pServer = mServer.Get())
+	{
+		pServer->HandleClientClosed(this);
+	}
+}
+
+void UWebSocketBase::HandlePong(FWebSocketConnection* connection, float rttMs)
+{
+	if (mEndpointSet.IsValid() && mEndpointSet->OnPong(connection, rttMs))
+	{
+		return;
+	}
+
+	if (connection != mConnection.Get())
+	{
+		return;
+	}
+
+	OnPong.Broadcast(rttMs);
+}
+
+void UWebSocketBase::HandleDurableAck(uint64 sequence)
+{
+	if (mJournal.IsValid())
+	{
+		mJournal->Acknowledge(sequence);
+	}
+}
+
+void UWebSocketBase::HandleTransfer(const FWebSocketTransfer& transfer, bool bComplete, bool bSuccess)
+{
+	if (bComplete)
+	{
+		OnTransferComplete.Broadcast(transfer, bSuccess);
+		return;
+	}
+
+	OnTransferProgress.Broadcast(transfer);
+}
+
+void UWebSocketBase::ReplayDurable()
+{
+	if (!mJournal.IsValid() || !mConnection.IsValid())
+	{
+		return;
+	}
+
+	// queued ahead of everything sent from now on, lws writes them once the connection is established
+	TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe> connection = mConnection;
+	mJournal->ForEachPending([&connection](uint64 sequence, const uint8* data, int32 len, bool bBinary)
+	{
+		connection->SendDurable(sequence, data, len, bBinary);
+	});
 }
+#endif
 
 void UWebSocketBase::SendText(const FString& data)
 {
@@ -424,8 +674,9 @@ void UWebSocketBase::SendText(const FString& data)
 	});
 
 #elif PLATFORM_HTML5
-	std::string strData = TCHAR_TO_UTF8(*data);
-	SocketSend(mWebSocketRef, strData.c_str(), (int)strData.size() );
+	TArray<uint8> utf8;
+	WebSocketAppendUtf8(data, utf8);
+	SocketSend(mWebSocketRef, (const char*)utf8.GetData(), utf8.Num());
 #else
 	if (data.Len() > MAX_ECHO_PAYLOAD)
 	{
@@ -433,9 +684,15 @@ void UWebSocketBase::SendText(const FString& data)
 		return;
 	}
 
-	if (mlws != nullptr)
+	if (mbClosing)
+	{
+		UE_LOG(WebSocket, Error, TEXT("the socket is closing, SendText fail"));
+		return;
+	}
+
+	if (mConnection.IsValid() && mConnection->IsAlive())
 	{
-		mSendQueue.Add(data);
+		mConnection->SendText(data);
 	}
 	else
 	{
@@ -444,93 +701,858 @@ void UWebSocketBase::SendText(const FString& data)
 #endif
 }
 
-void UWebSocketBase::ProcessWriteable()
+void UWebSocketBase::SendBinary(const TArray<uint8>& data)
 {
 #if PLATFORM_UWP
+	UE_LOG(WebSocket, Error, TEXT("websocket: SendBinary is not supported on uwp"));
 #elif PLATFORM_HTML5
+	UE_LOG(WebSocket, Error, TEXT("websocket: SendBinary is not supported on html5"));
 #else
-	while (mSendQueue.Num() > 0)
+	if (mbClosing)
 	{
-		std::string strData = TCHAR_TO_UTF8(*mSendQueue[0]);
-
-		unsigned char buf[LWS_PRE + MAX_ECHO_PAYLOAD];
-		memcpy(&buf[LWS_PRE], strData.c_str(), strData.size() );
-		lws_write(mlws, &buf[LWS_PRE], strData.size(), LWS_WRITE_TEXT);
+		UE_LOG(WebSocket, Error, TEXT("the socket is closing, SendBinary fail"));
+		return;
+	}
 
-		mSendQueue.RemoveAt(0);
+	if (mConnection.IsValid() && mConnection->IsAlive())
+	{
+		mConnection->SendBinary(data);
+	}
+	else
+	{
+		UE_LOG(WebSocket, Error, TEXT("the socket is closed, SendBinary fail"));
 	}
 #endif
 }
 
-void UWebSocketBase::ProcessRead(const char* in, int len)
-{
-	FString strData = UTF8_TO_TCHAR(in);
-	OnReceiveData.Broadcast(strData);
-}
-
-
-bool UWebSocketBase::ProcessHeader(unsigned char** p, unsigned char* end)
+bool UWebSocketBase::SendFrame(FWebSocketFrameHandle Handle)
 {
 #if PLATFORM_UWP
+	UE_LOG(WebSocket, Error, TEXT("websocket: SendFrame is not supported on uwp"));
+	return false;
 #elif PLATFORM_HTML5
+	UE_LOG(WebSocket, Error, TEXT("websocket: SendFrame is not supported on html5"));
+	return false;
 #else
-	if (mHeaderMap.Num() == 0)
+	if (mbClosing)
 	{
-		return true;
+		UE_LOG(WebSocket, Error, TEXT("the socket is closing, SendFrame fail"));
+		return false;
 	}
-	
-	for (auto& it : mHeaderMap)
+
+	const FWebSocketCachedFrame* pFrame = (mContext != nullptr) ? mContext->FindFrame(Handle) : nullptr;
+	if (pFrame == nullptr)
 	{
-		std::string strKey = TCHAR_TO_UTF8(*(it.Key) );
-		std::string strValue = TCHAR_TO_UTF8(*(it.Value));
+		UE_LOG(WebSocket, Error, TEXT("websocket: frame %d is not registered on the socket's context"), Handle.Id);
+		return false;
+	}
 
-		strKey += ":";
-		if (lws_add_http_header_by_name(mlws, (const unsigned char*)strKey.c_str(), (const unsigned char*)strValue.c_str(), (int)strValue.size(), p, end))
-		{
-			return false;
-		}
+	if (!mConnection.IsValid() || !mConnection->IsAlive())
+	{
+		UE_LOG(WebSocket, Error, TEXT("the socket is closed, SendFrame fail"));
+		return false;
 	}
-#endif
 
+	mConnection->SendFrame(*pFrame);
+	mContext->CountFrameSend();
 	return true;
+#endif
 }
 
-void UWebSocketBase::Close()
+void UWebSocketBase::ProcessRead(const char* in, int len, bool bBinary, bool bFinal)
 {
-#if PLATFORM_UWP
-	if (messageWriter != nullptr)
+	if (!bFinal)
 	{
-		messageWriter->DetachStream();
-		delete messageWriter;
-		messageWriter = nullptr;
+		mRecvBuffer.Append((const uint8*)in, len);
+		return;
+	}
+
+	if (mRecvBuffer.Num() > 0)
+	{
+		mRecvBuffer.Append((const uint8*)in, len);
+		TArray<uint8> message = MoveTemp(mRecvBuffer);
+		ProcessMessage(message.GetData(), message.Num(), bBinary);
+		return;
+	}
+
+	ProcessMessage((const uint8*)in, len, bBinary);
+}
+
+void UWebSocketBase::ProcessMessage(const uint8* data, int32 len, bool bBinary)
+{
+	// no service thread here, the decoder runs on the game thread
+	FWebSocketInMessage msg;
+	if (mConnectionDecoder.IsValid() && WebSocketValidateUtf8(data, len) && mConnectionDecoder->Decode(FWebSocketMessageView(TArrayView<const uint8>(data, len), false), msg.Decoded))
+	{
+		msg.bDecoded = true;
+	}
+	else if (!WebSocketDecodeUtf8(data, len, msg.Data))
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: invalid utf-8 in a text message, dropped"));
+		return;
 	}
+	msg.WireBytes = len;
+	mInbox->Messages.Enqueue(MoveTemp(msg));
+	mInbox->PendingMessages.Increment();
+	mInbox->PendingBytes.Add(len);
+
+	DeliverInbox();
+}
+
+void UWebSocketBase::ReleaseRxBytes(int32 len)
+{
+#if PLATFORM_UWP
 #elif PLATFORM_HTML5
-	SocketClose(mWebSocketRef);
-	mWebSocketRef = -1;
-	OnClosed.Broadcast();
 #else
-	if (mlws != nullptr)
+	if (mConnection.IsValid())
 	{
-		lws_set_wsi_user(mlws, NULL);
-		mlws = nullptr;
+		mConnection->ReleaseRxBytes(len);
+		return;
 	}
-
-	OnClosed.Broadcast();
 #endif
+
+	mInbox->PendingBytes.Subtract(len);
 }
 
-void UWebSocketBase::Cleanlws()
+const UWebSocketSettings* UWebSocketBase::GetSettings() const
 {
 #if PLATFORM_UWP
 #elif PLATFORM_HTML5
 #else
-	if (mlws != nullptr)
+	if (mContext != nullptr)
 	{
-		lws_set_wsi_user(mlws, NULL);
+		return mContext->GetSettings();
 	}
 #endif
+	return GetDefault<UWebSocketSettings>();
+}
+
+void UWebSocketBase::DeliverInbox(bool bIgnoreBudget)
+{
+	mInbox->bDeliverScheduled = false;
+
+	// MaxDeliverBytesPerFrame spreads a burst over several frames instead of one long hitch
+	int32 iBudget = bIgnoreBudget ? 0 : GetSettings()->MaxDeliverBytesPerFrame;
+	if (mDeliverFrame != GFrameCounter)
+	{
+		mDeliverFrame = GFrameCounter;
+		mDeliveredBytes = 0;
+	}
+
+	FWebSocketInMessage msg;
+	while ((iBudget <= 0 || mDeliveredBytes < iBudget) && mInbox->Messages.Dequeue(msg))
+	{
+		mInbox->PendingMessages.Decrement();
+		mDeliveredBytes += msg.WireBytes;
+		if (msg.Channel != INDEX_NONE)
+		{
+			DeliverChannel(msg);
+		}
+		else
+		{
+			DeliverMessage(msg);
+		}
+		ReleaseRxBytes(msg.WireBytes);
+	}
+
+	if (mInbox->Messages.IsEmpty() || mInbox->bDeliverScheduled.AtomicSet(true))
+	{
+		return;
+	}
+
+	// the rest goes out next frame
+	TWeakObjectPtr<UWebSocketBase> weakThis(this);
+	FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([weakThis](float DeltaTime)
+	{
+		if (UWebSocketBase* pSocketBase = weakThis.Get())
+		{
+			pSocketBase->DeliverInbox();
+		}
+		return false;
+	}));
 }
 
+void UWebSocketBase::DeliverMessage(FWebSocketInMessage& msg)
+{
+	if (mRequests.IsValid() && mRequests->HasPending() && CompleteRequest(msg))
+	{
+		return;
+	}
+
+	if (msg.bDecoded)
+	{
+		if (msg.Decoded.Json.IsValid() && DeliverCommand(msg.Decoded))
+		{
+			return;
+		}
+		mNativeDecoded.Broadcast(this, msg.Decoded);
+		OnReceiveDecoded.Broadcast(msg.Decoded);
+		return;
+	}
+
+	if (msg.bBinary)
+	{
+		mNativeReceive.Broadcast(this, FWebSocketMessageView(msg.Binary, true));
+		OnReceiveBinary.Broadcast(msg.Binary);
+		return;
+	}
 
+	// text queued before the first handler was added is still an FString
+	if (mNativeReceive.IsBound())
+	{
+		if (!msg.bUtf8)
+		{
+			WebSocketAppendUtf8(msg.Data, msg.Binary);
+		}
+		mNativeReceive.Broadcast(this, FWebSocketMessageView(msg.Binary, false));
+	}
 
+	if (OnReceiveData.IsBound())
+	{
+		if (msg.bUtf8)
+		{
+			WebSocketDecodeUtf8(msg.Binary.GetData(), msg.Binary.Num(), msg.Data);
+		}
+		OnReceiveData.Broadcast(msg.Data);
+	}
+}
 
+FDelegateHandle UWebSocketBase::AddReceiveHandler(TFunction<void(UWebSocketBase*, const FWebSocketMessageView&)>&& handler)
+{
+	FDelegateHandle handle = mNativeReceive.Add(FWebSocketNativeReceive::FDelegate::CreateLambda(MoveTemp(handler)));
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	if (mConnection.IsValid())
+	{
+		mConnection->SetTextAsUtf8(true);
+	}
+#endif
+	return handle;
+}
+
+void UWebSocketBase::RemoveReceiveHandler(FDelegateHandle handle)
+{
+	mNativeReceive.Remove(handle);
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	if (mConnection.IsValid())
+	{
+		mConnection->SetTextAsUtf8(mNativeReceive.IsBound());
+	}
+#endif
+}
+
+void UWebSocketBase::SetDecoder(const TSharedPtr<IWebSocketMessageDecoder, ESPMode::ThreadSafe>& decoder)
+{
+	mDecoder = decoder;
+	UpdateDecoder();
+}
+
+void UWebSocketBase::UpdateDecoder()
+{
+	// a decoded response has lost its text, the router scans the request id before that
+	mConnectionDecoder = mDecoder;
+	if (mCommands.Num() > 0 || (mDecoder.IsValid() && mRequests.IsValid()))
+	{
+		TSet<int32> commands;
+		for (auto& it : mCommands)
+		{
+			commands.Add(it.Key);
+		}
+		mConnectionDecoder = MakeShareable(new FWebSocketCommandRouter(commands, mRequests.IsValid() ? mRequests->GetIdFieldName() : FString(), mDecoder));
+	}
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	if (mConnection.IsValid())
+	{
+		mConnection->SetDecoder(mConnectionDecoder);
+	}
+#endif
+}
+
+bool UWebSocketBase::SetJsonDecoder(const TMap<int32, UScriptStruct*>& Structs, const FString& TypeField, const FString& BodyField)
+{
+	TSharedRef<FWebSocketJsonDecoder, ESPMode::ThreadSafe> decoder = MakeShareable(new FWebSocketJsonDecoder(TypeField, BodyField));
+	for (auto& it : Structs)
+	{
+		if (!decoder->Map(it.Key, it.Value))
+		{
+			return false;
+		}
+	}
+
+	SetDecoder(decoder);
+	return true;
+}
+
+FDelegateHandle UWebSocketBase::AddDecodedHandler(TFunction<void(UWebSocketBase*, const FWebSocketDecodedMessage&)>&& handler)
+{
+	return mNativeDecoded.Add(FWebSocketNativeDecoded::FDelegate::CreateLambda(MoveTemp(handler)));
+}
+
+void UWebSocketBase::RemoveDecodedHandler(FDelegateHandle handle)
+{
+	mNativeDecoded.Remove(handle);
+}
+
+bool UWebSocketBase::RouteCommand(int32 Cmd, FWebSocketCommandHandler Handler, UClass* Class)
+{
+	FWebSocketCommandRoute route;
+	route.Class = Class != nullptr ? Class : UWebSocketBlueprintLibrary::GetCommandClass(Cmd);
+	route.Handler = Handler;
+	if (route.Class == nullptr)
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: no class registered for cmd %d, not routed"), Cmd);
+		return false;
+	}
+
+	mCommands.Add(Cmd, route);
+	UpdateDecoder();
+	return true;
+}
+
+void UWebSocketBase::UnrouteCommand(int32 Cmd)
+{
+	if (mCommands.Remove(Cmd) > 0)
+	{
+		UpdateDecoder();
+	}
+}
+
+bool UWebSocketBase::AddCommandHandler(int32 cmd, UClass* messageClass, TFunction<void(UWebSocketBase*, UObject*)>&& handler)
+{
+	FWebSocketCommandRoute route;
+	route.Class = messageClass != nullptr ? messageClass : UWebSocketBlueprintLibrary::GetCommandClass(cmd);
+	route.Native = MoveTemp(handler);
+	if (route.Class == nullptr)
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: no class registered for cmd %d, not routed"), cmd);
+		return false;
+	}
+
+	mCommands.Add(cmd, route);
+	UpdateDecoder();
+	return true;
+}
+
+bool UWebSocketBase::DeliverCommand(const FWebSocketDecodedMessage& message)
+{
+	// unrouted after the message was decoded, it goes to OnReceiveDecoded
+	FWebSocketCommandRoute* pRoute = mCommands.Find(message.Type);
+	if (pRoute == nullptr)
+	{
+		return false;
+	}
+
+	UObject* pMessage = NewObject<UObject>((UObject*)GetTransientPackage(), pRoute->Class);
+	if (!UWebSocketBlueprintLibrary::JsonObjectToUStruct(message.Json.ToSharedRef(), pRoute->Class, pMessage, 0, 0))
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: cmd %d does not fit %s, dropped"), message.Type, *pRoute->Class->GetName());
+		return true;
+	}
+
+	// the handler may unroute, the route is not touched after the call
+	if (pRoute->Native)
+	{
+		TFunction<void(UWebSocketBase*, UObject*)> native = pRoute->Native;
+		native(this, pMessage);
+		return true;
+	}
+	FWebSocketCommandHandler handler = pRoute->Handler;
+	handler.ExecuteIfBound(message.Type, pMessage);
+	return true;
+}
+
+static TFuture<FWebSocketResponse> WebSocketCompletedRequest(int32 type, EWebSocketRequestResult result)
+{
+	TPromise<FWebSocketResponse> promise;
+	TFuture<FWebSocketResponse> future = promise.GetFuture();
+	FWebSocketResponse response;
+	response.Result = result;
+	response.Type = type;
+	promise.SetValue(MoveTemp(response));
+	return future;
+}
+
+TFuture<FWebSocketResponse> UWebSocketBase::Request(const FString& data, float timeout)
+{
+	if (!IsOpen() || mbClosing)
+	{
+		return WebSocketCompletedRequest(0, EWebSocketRequestResult::Closed);
+	}
+
+	if (!mRequests.IsValid())
+	{
+		mRequests = MakeShareable(new FWebSocketRequestTracker(GetSettings()->RequestIdField));
+		UpdateDecoder();
+	}
+
+	int32 iType = 0;
+	WebSocketScanJsonInt(*data, data.Len(), WEBSOCKET_COMMAND_FIELD, iType);
+
+	int32 iId = mRequests->NextId();
+	FString strStamped;
+	if (!WebSocketStampJsonInt(data, mRequests->GetIdField(), iId, strStamped))
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: request of cmd %d is not a json object, not sent"), iType);
+		return WebSocketCompletedRequest(iType, EWebSocketRequestResult::Failed);
+	}
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	// SendText drops it, the request would only end with its timeout
+	if (strStamped.Len() > MAX_ECHO_PAYLOAD)
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: request of cmd %d is larger than MAX_ECHO_PAYLOAD, not sent"), iType);
+		return WebSocketCompletedRequest(iType, EWebSocketRequestResult::Failed);
+	}
+#endif
+
+	TFuture<FWebSocketResponse> future = mRequests->Start(iId, iType, timeout > 0.0f ? timeout : GetSettings()->RequestTimeout);
+	SendText(strStamped);
+	return future;
+}
+
+bool UWebSocketBase::CompleteRequest(FWebSocketInMessage& msg)
+{
+	// one partial scan per message while requests are pending, nothing otherwise
+	int32 iId = 0;
+	if (msg.bDecoded)
+	{
+		iId = msg.Decoded.RequestId;
+	}
+	else if (msg.bBinary)
+	{
+		return false;
+	}
+	else if (msg.bUtf8)
+	{
+		WebSocketScanJsonInt(msg.Binary.GetData(), msg.Binary.Num(), mRequests->GetIdField(), iId);
+	}
+	else
+	{
+		WebSocketScanJsonInt(*msg.Data, msg.Data.Len(), mRequests->GetIdField(), iId);
+	}
+
+	if (iId == 0 || !mRequests->IsPending(iId))
+	{
+		return false;
+	}
+
+	FWebSocketResponse response;
+	if (msg.bDecoded)
+	{
+		response.Decoded = MoveTemp(msg.Decoded);
+	}
+	else if (msg.bUtf8)
+	{
+		WebSocketDecodeUtf8(msg.Binary.GetData(), msg.Binary.Num(), response.Data);
+	}
+	else
+	{
+		response.Data = MoveTemp(msg.Data);
+	}
+	return mRequests->Complete(iId, MoveTemp(response));
+}
+
+void UWebSocketBase::FailRequests()
+{
+	if (mRequests.IsValid())
+	{
+		mRequests->FailAll(EWebSocketRequestResult::Closed);
+	}
+}
+
+TArray<FWebSocketRequestStats> UWebSocketBase::GetRequestStats() const
+{
+	return mRequests.IsValid() ? mRequests->GetStats() : TArray<FWebSocketRequestStats>();
+}
+
+FString FWebSocketMessageView::ToString() const
+{
+	FString strText;
+	WebSocketDecodeUtf8(Data.GetData(), Data.Num(), strText);
+	return strText;
+}
+
+void UWebSocketBase::DeliverChannel(const FWebSocketInMessage& msg)
+{
+	UWebSocketChannel* pChannel = mChannels.FindRef(msg.Channel);
+	if (pChannel == nullptr)
+	{
+		return;
+	}
+
+	pChannel->Deliver(msg);
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe> state = pChannel->GetState().ToSharedRef();
+	if (mConnection.IsValid())
+	{
+		mConnection->ReleaseChannelBytes(state, msg.WireBytes);
+	}
+	else
+	{
+		state->PendingBytes.Subtract(msg.WireBytes);
+	}
+#endif
+}
+
+UWebSocketChannel* UWebSocketBase::OpenChannel(int32 Channel, int32 Priority, int32 MaxQueuedBytes, int32 MaxPendingBytes)
+{
+	if (Channel < 0 || Channel > 0xffff)
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: channel id %d out of range"), Channel);
+		return nullptr;
+	}
+
+	if (UWebSocketChannel* pOpen = mChannels.FindRef(Channel))
+	{
+		return pOpen;
+	}
+
+#if PLATFORM_UWP
+	UE_LOG(WebSocket, Error, TEXT("websocket: channels are not supported on uwp"));
+	return nullptr;
+#elif PLATFORM_HTML5
+	UE_LOG(WebSocket, Error, TEXT("websocket: channels are not supported on html5"));
+	return nullptr;
+#else
+	TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe> state = MakeShareable(new FWebSocketChannelState((uint16)Channel, Priority, FMath::Max(MaxQueuedBytes, 0), FMath::Max(MaxPendingBytes, 0)));
+
+	UWebSocketChannel* pChannel = NewObject<UWebSocketChannel>(this);
+	pChannel->Init(this, state);
+	mChannels.Add(Channel, pChannel);
+
+	// a socket still waiting for the context gets its channels when it connects
+	if (mConnection.IsValid())
+	{
+		mConnection->AddChannel(state);
+	}
+
+	return pChannel;
+#endif
+}
+
+UWebSocketChannel* UWebSocketBase::GetChannel(int32 Channel) const
+{
+	return mChannels.FindRef(Channel);
+}
+
+TArray<FWebSocketChannelStats> UWebSocketBase::GetChannelStats() const
+{
+	TArray<FWebSocketChannelStats> stats;
+	for (auto& it : mChannels)
+	{
+		stats.Add(it.Value->GetStats());
+	}
+
+	return stats;
+}
+
+void UWebSocketBase::RequestWrite()
+{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	if (mConnection.IsValid() && mConnection->IsAlive())
+	{
+		mConnection->RequestWrite();
+	}
+#endif
+}
+
+bool UWebSocketBase::OpenDurableLane(const FString& Name)
+{
+#if PLATFORM_UWP
+	UE_LOG(WebSocket, Error, TEXT("websocket: durable lanes are not supported on uwp"));
+	return false;
+#elif PLATFORM_HTML5
+	UE_LOG(WebSocket, Error, TEXT("websocket: durable lanes are not supported on html5"));
+	return false;
+#else
+	// the lane this socket had is given up first, it may be the one opened again
+	mJournal = nullptr;
+	mJournal = FWebSocketJournal::OpenLane(Name);
+	if (!mJournal.IsValid())
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: can not open the durable lane %s"), *Name);
+		return false;
+	}
+
+	// opened on a live connection, what earlier launches left behind goes out now
+	if (IsOpen() && !mbClosing)
+	{
+		mConnection->SetDurable(true);
+		ReplayDurable();
+	}
+	return true;
+#endif
+}
+
+bool UWebSocketBase::SendDurableText(const FString& data)
+{
+	TArray<uint8> utf8;
+	WebSocketAppendUtf8(data, utf8);
+	return SendDurable(utf8.GetData(), utf8.Num(), false) != 0;
+}
+
+bool UWebSocketBase::SendDurableBinary(const TArray<uint8>& data)
+{
+	return SendDurable(data.GetData(), data.Num(), true) != 0;
+}
+
+uint64 UWebSocketBase::SendDurable(const uint8* data, int32 len, bool bBinary)
+{
+#if PLATFORM_UWP
+	UE_LOG(WebSocket, Error, TEXT("websocket: durable lanes are not supported on uwp"));
+	return 0;
+#elif PLATFORM_HTML5
+	UE_LOG(WebSocket, Error, TEXT("websocket: durable lanes are not supported on html5"));
+	return 0;
+#else
+	if (!mJournal.IsValid())
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: no durable lane is open, SendDurable fail"));
+		return 0;
+	}
+
+	uint64 sequence = mJournal->Append(data, len, bBinary);
+	if (sequence == 0)
+	{
+		return 0;
+	}
+
+	// while disconnected the journal keeps it, ReplayDurable sends it with the next connection
+	if (!mbClosing && IsOpen())
+	{
+		mConnection->SendDurable(sequence, data, len, bBinary);
+	}
+	return sequence;
+#endif
+}
+
+FWebSocketDurableStats UWebSocketBase::GetDurableStats() const
+{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	if (mJournal.IsValid())
+	{
+		return mJournal->GetStats();
+	}
+#endif
+	return FWebSocketDurableStats();
+}
+
+int32 UWebSocketBase::SendFile(const FString& Path, const FString& Name)
+{
+	TUniquePtr<FArchive> reader(IFileManager::Get().CreateFileReader(*Path));
+	if (!reader.IsValid())
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: can not read %s, SendFile fail"), *Path);
+		return -1;
+	}
+
+	return SendStream(MoveTemp(reader), Name.IsEmpty() ? FPaths::GetCleanFilename(Path) : Name);
+}
+
+int32 UWebSocketBase::SendStream(TUniquePtr<FArchive>&& reader, const FString& name)
+{
+#if PLATFORM_UWP
+	UE_LOG(WebSocket, Error, TEXT("websocket: transfers are not supported on uwp"));
+	return -1;
+#elif PLATFORM_HTML5
+	UE_LOG(WebSocket, Error, TEXT("websocket: transfers are not supported on html5"));
+	return -1;
+#else
+	if (mbClosing || !IsOpen())
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: not connected, transfer of %s fail"), *name);
+		return -1;
+	}
+
+	uint16 id = ++mNextTransferId;
+	mConnection->SendTransfer(MakeShareable(new FWebSocketOutTransfer(id, name, MoveTemp(reader))));
+	return id;
+#endif
+}
+
+void UWebSocketBase::AcceptTransfers(const FString& Directory)
+{
+#if PLATFORM_UWP
+	UE_LOG(WebSocket, Error, TEXT("websocket: transfers are not supported on uwp"));
+#elif PLATFORM_HTML5
+	UE_LOG(WebSocket, Error, TEXT("websocket: transfers are not supported on html5"));
+#else
+	mTransferDirectory = Directory.IsEmpty() ? FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("WebSocket"), TEXT("Transfers")) : Directory;
+	if (mConnection.IsValid())
+	{
+		mConnection->SetTransferDirectory(mTransferDirectory);
+	}
+#endif
+}
+
+bool UWebSocketBase::StartClockSync()
+{
+#if PLATFORM_UWP
+	return false;
+#elif PLATFORM_HTML5
+	return false;
+#else
+	if (!mClock.IsValid())
+	{
+		mClock = MakeShareable(new FWebSocketClock());
+	}
+	mbClockSync = true;
+	if (mConnection.IsValid())
+	{
+		mConnection->SetClock(mClock);
+	}
+	return true;
+#endif
+}
+
+void UWebSocketBase::StopClockSync()
+{
+	mbClockSync = false;
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	if (mConnection.IsValid())
+	{
+		mConnection->SetClock(nullptr);
+	}
+#endif
+}
+
+bool UWebSocketBase::GetServerTimeUs(int64& serverUs, double& errorUs) const
+{
+	return mClock.IsValid() && mClock->GetServerTime(WebSocketLocalClockUs(), serverUs, errorUs);
+}
+
+FDateTime UWebSocketBase::GetServerTime(float& ErrorMs) const
+{
+	int64 iServerUs = 0;
+	double dErrorUs = 0.0;
+	if (!GetServerTimeUs(iServerUs, dErrorUs))
+	{
+		ErrorMs = -1.0f;
+		return FDateTime::UtcNow();
+	}
+
+	ErrorMs = (float)(dErrorUs / 1000.0);
+	return FDateTime(1970, 1, 1) + FTimespan(iServerUs * ETimespan::TicksPerMicrosecond);
+}
+
+FWebSocketClockStats UWebSocketBase::GetClockStats() const
+{
+	return mClock.IsValid() ? mClock->GetStats() : FWebSocketClockStats();
+}
+
+void UWebSocketBase::Ping()
+{
+#if PLATFORM_UWP
+	UE_LOG(WebSocket, Error, TEXT("websocket: Ping is not supported on uwp"));
+#elif PLATFORM_HTML5
+	UE_LOG(WebSocket, Error, TEXT("websocket: Ping is not supported on html5"));
+#else
+	if (mConnection.IsValid() && mConnection->IsAlive())
+	{
+		mConnection->SendPing();
+	}
+#endif
+}
+
+FWebSocketRxStats UWebSocketBase::GetRxStats() const
+{
+	FWebSocketRxStats stats;
+	stats.PendingBytes = mInbox->PendingBytes.GetValue();
+	stats.PendingMessages = mInbox->PendingMessages.GetValue();
+	stats.bPaused = mInbox->bPaused;
+	stats.PauseCount = mInbox->PauseCount.GetValue();
+	stats.ResumeCount = mInbox->ResumeCount.GetValue();
+	return stats;
+}
+
+FWebSocketPacingStats UWebSocketBase::GetPacingStats() const
+{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	if (mConnection.IsValid())
+	{
+		return mConnection->GetPacingStats();
+	}
+#endif
+	return FWebSocketPacingStats();
+}
+
+bool UWebSocketBase::IsOpen() const
+{
+#if PLATFORM_UWP
+	return messageWebSocket != nullptr;
+#elif PLATFORM_HTML5
+	return mWebSocketRef >= 0;
+#else
+	return mConnection.IsValid() && mConnection->IsAlive();
+#endif
+}
+
+void UWebSocketBase::Close(int32 Code, const FString& Reason, float DrainTimeout)
+{
+	if (mbClosing)
+	{
+		return;
+	}
+
+#if PLATFORM_UWP
+	if (messageWriter != nullptr)
+	{
+		messageWriter->DetachStream();
+		delete messageWriter;
+		messageWriter = nullptr;
+	}
+
+	if (messageWebSocket != nullptr)
+	{
+		mbClosing = true;
+		messageWebSocket->Close((unsigned short)Code, ref new String(*Reason));
+	}
+#elif PLATFORM_HTML5
+	SocketClose(mWebSocketRef);
+	mWebSocketRef = -1;
+	FailRequests();
+	OnClosed.Broadcast();
+#else
+	// probes and the standby go first, nothing may fail over while closing
+	if (mEndpointSet.IsValid())
+	{
+		mEndpointSet->Stop();
+	}
+
+	// a socket that is not open gets its OnClosed right away, like it always did. one the context still
+	// holds back until it is created never connects
+	if (!IsOpen())
+	{
+		if (UWebSocketContext* pContext = mPendingContext.Get())
+		{
+			pContext->CancelPendingConnect(this);
+			mPendingContext = nullptr;
+		}
+		FailRequests();
+		OnClosed.Broadcast();
+		return;
+	}
+
+	mbClosing = true;
+	mConnection->Close(Code, Reason, DrainTimeout);
+#endif
+}
@@ -0,0 +1,515 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#include "WebSocket.h"
+#include "WebSocketBench.h"
+#include "WebSocketBase.h"
+#include "WebSocketBlueprintLibrary.h"
+#include "WebSocketClock.h"
+#include "WebSocketDecoder.h"
+#include "WebSocketRequestTracker.h"
+#include "WebSocketRouter.h"
+#include "WebSocketUtf8.h"
+#include "Async/ParallelFor.h"
+#include "Containers/Ticker.h"
+#include "HAL/IConsoleManager.h"
+
+UWebSocketBenchReceiver::UWebSocketBenchReceiver()
+{
+	mBytes = 0;
+}
+
+void UWebSocketBenchReceiver::ReceiveJson(const FString& data)
+{
+	UWebSocketBenchMessage* pMessage = Cast<UWebSocketBenchMessage>(UWebSocketBlueprintLibrary::JsonToObject(data, UWebSocketBenchMessage::StaticClass(), false));
+	if (pMessage != nullptr && pMessage->body.ready)
+	{
+		mBytes += data.Len();
+	}
+}
+
+#if !UE_BUILD_SHIPPING
+/**
+ * wss handshakes of the plugin itself, with the TlsOptions of the websocket settings applied to its SSL_CTX:
+ * connects to url one after the other and closes each socket once it is open. run it against
+ * TestServer/tlsserver.js, with bEnableTlsSessionCache off every connect is a full handshake.
+ */
+static void WebSocketTlsBench(const TArray<FString>& Args)
+{
+	if (Args.Num() < 1)
+	{
+		UE_LOG(WebSocket, Display, TEXT("websocket: usage websocket.TlsBench wss://host:port [connects]"));
+		return;
+	}
+
+	struct FTlsBenchState
+	{
+		FString Url;
+		int32 Remaining;
+		int32 Failed;
+		UWebSocketBase* Socket;
+		double ConnectStart;
+		double Start;
+		FWebSocketTlsStats Before;
+	};
+
+	TSharedRef<FTlsBenchState> state = MakeShareable(new FTlsBenchState());
+	state->Url = Args[0];
+	state->Remaining = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 50;
+	state->Failed = 0;
+	state->Socket = nullptr;
+	state->ConnectStart = 0.0;
+	state->Start = FPlatformTime::Seconds();
+	state->Before = UWebSocketBlueprintLibrary::GetTlsStats();
+
+	FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([state](float DeltaTime)
+	{
+		double dNow = FPlatformTime::Seconds();
+		if (state->Socket != nullptr)
+		{
+			bool bOpen = state->Socket->IsOpen();
+			if (!bOpen && dNow - state->ConnectStart < 10.0)
+			{
+				return true;
+			}
+
+			state->Failed += bOpen ? 0 : 1;
+			state->Socket->Close();
+			state->Socket->RemoveFromRoot();
+			state->Socket = nullptr;
+			state->Remaining--;
+		}
+
+		if (state->Remaining > 0)
+		{
+			bool bConnectFail = false;
+			state->Socket = UWebSocketBlueprintLibrary::Connect(state->Url, bConnectFail);
+			if (bConnectFail || state->Socket == nullptr)
+			{
+				UE_LOG(WebSocket, Display, TEXT("websocket: fail to connect '%s'"), *state->Url);
+				return false;
+			}
+			state->Socket->AddToRoot();
+			state->ConnectStart = dNow;
+			return true;
+		}
+
+		FWebSocketTlsStats after = UWebSocketBlueprintLibrary::GetTlsStats();
+		int32 iFull = after.FullHandshakes - state->Before.FullHandshakes;
+		int32 iResumed = after.ResumedHandshakes - state->Before.ResumedHandshakes;
+		double dFullMs = (double)after.AverageFullHandshakeMs * after.FullHandshakes - (double)state->Before.AverageFullHandshakeMs * state->Before.FullHandshakes;
+		double dResumedMs = (double)after.AverageResumedHandshakeMs * after.ResumedHandshakes - (double)state->Before.AverageResumedHandshakeMs * state->Before.ResumedHandshakes;
+		UE_LOG(WebSocket, Display, TEXT("websocket: %d full handshakes %.2f ms, %d resumed %.2f ms, %d failed, %.1f s"),
+			iFull, dFullMs / FMath::Max(1, iFull), iResumed, dResumedMs / FMath::Max(1, iResumed), state->Failed, dNow - state->Start);
+		return false;
+	}));
+}
+
+static FAutoConsoleCommand WebSocketTlsBenchCommand(
+	TEXT("websocket.TlsBench"),
+	TEXT("average tls handshake ms of the plugin's connects with the configured TlsOptions, arguments: wss url, optional connects"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&WebSocketTlsBench));
+
+static double WebSocketUtf8Seconds(TFunctionRef<void()> fn, int32 rounds)
+{
+	double dStart = FPlatformTime::Seconds();
+	for (int32 i = 0; i < rounds; i++)
+	{
+		fn();
+	}
+	return FPlatformTime::Seconds() - dStart;
+}
+
+static void WebSocketUtf8Bench(const TCHAR* name, const FString& text, int32 rounds)
+{
+	TArray<uint8> utf8;
+	WebSocketAppendUtf8(text, utf8);
+	double dBytes = (double)utf8.Num() * rounds;
+
+	TArray<uint8> encoded;
+	FString decoded;
+	double dEncode = WebSocketUtf8Seconds([&]()
+	{
+		encoded.Reset();
+		WebSocketAppendUtf8(text, encoded);
+	}, rounds);
+	double dDecode = WebSocketUtf8Seconds([&]()
+	{
+		WebSocketDecodeUtf8(utf8.GetData(), utf8.Num(), decoded);
+	}, rounds);
+
+	// the engine converters, the decode one without the validation lws did in a pass of its own
+	double dEngineEncode = WebSocketUtf8Seconds([&]()
+	{
+		FTCHARToUTF8 Convert(*text, text.Len());
+		encoded.Reset();
+		encoded.Append((const uint8*)Convert.Get(), Convert.Length());
+	}, rounds);
+	double dEngineDecode = WebSocketUtf8Seconds([&]()
+	{
+		FUTF8ToTCHAR Convert((const ANSICHAR*)utf8.GetData(), utf8.Num());
+		decoded = FString(Convert.Length(), Convert.Get());
+	}, rounds);
+
+	UE_LOG(WebSocket, Display, TEXT("websocket: utf8 %s, %d bytes, encode %.2f GB/s (engine %.2f), decode and validate %.2f GB/s (engine %.2f)"),
+		name, utf8.Num(), dBytes / dEncode / 1e9, dBytes / dEngineEncode / 1e9, dBytes / dDecode / 1e9, dBytes / dEngineDecode / 1e9);
+}
+
+static FAutoConsoleCommand WebSocketUtf8BenchCommand(
+	TEXT("websocket.Utf8Bench"),
+	TEXT("measure the utf-8 transcoders on ascii and chinese chat json, optional argument: rounds"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		int32 iRounds = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 200;
+
+		// about 1 MB of the messages the sample game sends, once with english and once with chinese chat
+		FString strAscii;
+		FString strCjk;
+		for (int32 i = 0; strAscii.Len() < 1024 * 1024; i++)
+		{
+			strAscii += FString::Printf(TEXT("{\n\t\"cmd\": 12,\n\t\"body\": {\n\t\t\"channel\": \"world\",\n\t\t\"from\": \"player_%d\",\n\t\t\"text\": \"anyone up for a ranked match tonight, need one more\"\n\t}\n}"), i);
+			strCjk += FString::Printf(TEXT("{\n\t\"cmd\": 12,\n\t\"body\": {\n\t\t\"channel\": \"world\",\n\t\t\"from\": \"player_%d\",\n\t\t\"text\": \"%s\"\n\t}\n}"), i,
+				TEXT("\u4eca\u665a\u6709\u4eba\u4e00\u8d77\u6253\u6392\u4f4d\u5417\uff1f\u8fd8\u5dee\u4e00\u4e2a\u4eba\uff0c\u6765\u4e2a\u4f1a\u6253\u8f85\u52a9\u7684"));
+		}
+
+		WebSocketUtf8Bench(TEXT("ascii json"), strAscii, iRounds);
+		WebSocketUtf8Bench(TEXT("chinese json"), strCjk, iRounds);
+	}));
+
+/**
+ * what one received message costs on the game thread: OnReceiveData converts to an FString and goes
+ * through ProcessEvent, a native handler validates the utf-8 and gets a view of it.
+ */
+static void WebSocketReceiveBench(const TArray<FString>& Args)
+{
+	int32 iMessages = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000000;
+	TArray<uint8> message;
+	WebSocketAppendUtf8(TEXT("{\n\t\"cmd\": 5,\n\t\"body\": {\n\t\t\"x\": 1024.5,\n\t\t\"y\": -33.25,\n\t\t\"yaw\": 90\n\t}\n}"), message);
+
+	UWebSocketBase* pSocket = NewObject<UWebSocketBase>();
+	UWebSocketBenchReceiver* pReceiver = NewObject<UWebSocketBenchReceiver>();
+	pSocket->OnReceiveData.AddDynamic(pReceiver, &UWebSocketBenchReceiver::Receive);
+
+	double dStart = FPlatformTime::Seconds();
+	for (int32 i = 0; i < iMessages; i++)
+	{
+		FWebSocketInMessage msg;
+		WebSocketDecodeUtf8(message.GetData(), message.Num(), msg.Data);
+		pSocket->DeliverMessage(msg);
+	}
+	double dDynamic = FPlatformTime::Seconds() - dStart;
+
+	pSocket->OnReceiveData.Clear();
+	int64 iNativeBytes = 0;
+	pSocket->AddReceiveHandler([&iNativeBytes](UWebSocketBase* Socket, const FWebSocketMessageView& Message)
+	{
+		iNativeBytes += Message.Num();
+	});
+
+	dStart = FPlatformTime::Seconds();
+	for (int32 i = 0; i < iMessages; i++)
+	{
+		FWebSocketInMessage msg;
+		WebSocketValidateUtf8(message.GetData(), message.Num());
+		msg.Binary.Append(message);
+		msg.bUtf8 = true;
+		pSocket->DeliverMessage(msg);
+	}
+	double dNative = FPlatformTime::Seconds() - dStart;
+
+	UE_LOG(WebSocket, Display, TEXT("websocket: %d messages of %d bytes, OnReceiveData %.1f ns per message, native handler %.1f ns per message"),
+		iMessages, message.Num(), dDynamic * 1e9 / iMessages, dNative * 1e9 / iMessages);
+	pSocket->MarkPendingKill();
+	pReceiver->MarkPendingKill();
+}
+
+static FAutoConsoleCommand WebSocketReceiveBenchCommand(
+	TEXT("websocket.ReceiveBench"),
+	TEXT("per message dispatch cost of OnReceiveData against a native receive handler, optional argument: messages"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&WebSocketReceiveBench));
+
+/** the ready message of the sample game as it arrives, cmd 7 */
+static void WebSocketBenchReadyMessage(TArray<uint8>& message)
+{
+	WebSocketAppendUtf8(TEXT("{\n\t\"cmd\": 7,\n\t\"body\": {\n\t\t\"roomId\": 10086,\n\t\t\"ready\": true,\n\t\t\"name\": \"ranked 5v5\",\n\t\t\"seats\": [1, 2, 3, 5, 8]\n\t}\n}"), message);
+}
+
+/**
+ * game thread cost of parsing received messages: a Blueprint calling JsonToObject in OnReceiveData against
+ * an FWebSocketJsonDecoder that built the struct on the task graph, so delivery only hands it over.
+ */
+static void WebSocketDecodeBench(const TArray<FString>& Args)
+{
+	int32 iMessages = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100000;
+	TArray<uint8> message;
+	WebSocketBenchReadyMessage(message);
+
+	UWebSocketBase* pSocket = NewObject<UWebSocketBase>();
+	UWebSocketBenchReceiver* pReceiver = NewObject<UWebSocketBenchReceiver>();
+	pSocket->OnReceiveData.AddDynamic(pReceiver, &UWebSocketBenchReceiver::ReceiveJson);
+
+	double dStart = FPlatformTime::Seconds();
+	for (int32 i = 0; i < iMessages; i++)
+	{
+		FWebSocketInMessage msg;
+		WebSocketDecodeUtf8(message.GetData(), message.Num(), msg.Data);
+		pSocket->DeliverMessage(msg);
+	}
+	double dJsonToObject = FPlatformTime::Seconds() - dStart;
+	pSocket->OnReceiveData.Clear();
+
+	// a connection decodes one message after the other, ParallelFor stands in for many connections
+	FWebSocketJsonDecoder decoder;
+	decoder.Map(7, FWebSocketBenchRoom::StaticStruct());
+	TArray<FWebSocketInMessage> decoded;
+	decoded.SetNum(iMessages);
+	dStart = FPlatformTime::Seconds();
+	ParallelFor(iMessages, [&decoder, &decoded, &message](int32 i)
+	{
+		decoded[i].bDecoded = decoder.Decode(FWebSocketMessageView(message, false), decoded[i].Decoded);
+	});
+	double dWorkers = FPlatformTime::Seconds() - dStart;
+
+	int64 iReady = 0;
+	pSocket->AddDecodedHandler([&iReady](UWebSocketBase* Socket, const FWebSocketDecodedMessage& Message)
+	{
+		if (const FWebSocketBenchRoom* pRoom = Message.Get<FWebSocketBenchRoom>())
+		{
+			iReady += pRoom->ready ? 1 : 0;
+		}
+	});
+
+	// DeliverInbox releases each message before it dequeues the next one, that is game thread time too
+	dStart = FPlatformTime::Seconds();
+	for (FWebSocketInMessage& msg : decoded)
+	{
+		pSocket->DeliverMessage(msg);
+		msg.Decoded = FWebSocketDecodedMessage();
+	}
+	double dDecoded = FPlatformTime::Seconds() - dStart;
+
+	UE_LOG(WebSocket, Display, TEXT("websocket: %d messages of %d bytes, game thread ms per 1k: JsonToObject in OnReceiveData %.3f, decoded on workers %.3f. worker wall time per 1k %.3f ms, %d of %d decoded"),
+		iMessages, message.Num(), dJsonToObject * 1e6 / iMessages, dDecoded * 1e6 / iMessages, dWorkers * 1e6 / iMessages, (int32)iReady, iMessages);
+	pSocket->MarkPendingKill();
+	pReceiver->MarkPendingKill();
+}
+
+static FAutoConsoleCommand WebSocketDecodeBenchCommand(
+	TEXT("websocket.DecodeBench"),
+	TEXT("game thread ms per 1k messages with JsonToObject in OnReceiveData against decoding on task graph workers, optional argument: messages"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&WebSocketDecodeBench));
+
+/**
+ * a routed message against what the Blueprints do today: GetJsonIntField parses the message for its cmd,
+ * JsonToObject parses it again. a route scans for the cmd, parses on a worker and only fills the object here.
+ */
+static void WebSocketCommandBench(const TArray<FString>& Args)
+{
+	int32 iMessages = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100000;
+	TArray<uint8> message;
+	WebSocketBenchReadyMessage(message);
+	FString strMessage;
+	WebSocketDecodeUtf8(message.GetData(), message.Num(), strMessage);
+
+	int64 iReady = 0;
+	double dStart = FPlatformTime::Seconds();
+	for (int32 i = 0; i < iMessages; i++)
+	{
+		int iCmd = 0;
+		if (UWebSocketBlueprintLibrary::GetJsonIntField(strMessage, TEXT("cmd"), iCmd) && iCmd == 7)
+		{
+			UWebSocketBenchMessage* pMessage = Cast<UWebSocketBenchMessage>(UWebSocketBlueprintLibrary::JsonToObject(strMessage, UWebSocketBenchMessage::StaticClass(), false));
+			iReady += pMessage != nullptr && pMessage->body.ready ? 1 : 0;
+		}
+	}
+	double dTwice = FPlatformTime::Seconds() - dStart;
+
+	UWebSocketBase* pSocket = NewObject<UWebSocketBase>();
+	pSocket->AddCommandHandler<UWebSocketBenchMessage>(7, [&iReady](UWebSocketBase* Socket, UWebSocketBenchMessage* Message)
+	{
+		iReady += Message->body.ready ? 1 : 0;
+	});
+
+	TSet<int32> commands;
+	commands.Add(7);
+	FWebSocketCommandRouter router(commands, FString(), nullptr);
+	TArray<FWebSocketInMessage> routed;
+	routed.SetNum(iMessages);
+	dStart = FPlatformTime::Seconds();
+	ParallelFor(iMessages, [&router, &routed, &message](int32 i)
+	{
+		routed[i].bDecoded = router.Decode(FWebSocketMessageView(message, false), routed[i].Decoded);
+	});
+	double dWorkers = FPlatformTime::Seconds() - dStart;
+
+	dStart = FPlatformTime::Seconds();
+	for (FWebSocketInMessage& msg : routed)
+	{
+		pSocket->DeliverMessage(msg);
+		msg.Decoded = FWebSocketDecodedMessage();
+	}
+	double dRouted = FPlatformTime::Seconds() - dStart;
+
+	UE_LOG(WebSocket, Display, TEXT("websocket: %d messages, game thread ms per 1k: GetJsonIntField and JsonToObject %.3f, routed %.3f. worker wall time per 1k %.3f ms, %d handled"),
+		iMessages, dTwice * 1e6 / iMessages, dRouted * 1e6 / iMessages, dWorkers * 1e6 / iMessages, (int32)iReady);
+	pSocket->MarkPendingKill();
+}
+
+static FAutoConsoleCommand WebSocketCommandBenchCommand(
+	TEXT("websocket.CommandBench"),
+	TEXT("game thread ms per 1k messages parsed twice for the cmd switch against a command route, optional argument: messages"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&WebSocketCommandBench));
+
+/**
+ * cost per request of the tracker with few and with many outstanding: start, answer half of them in random
+ * order, let the rest time out. a scan of every pending deadline per frame is what a list of requests costs instead.
+ */
+static void WebSocketRequestBenchRun(int32 requests)
+{
+	FWebSocketRequestTracker tracker(TEXT("seq"));
+	TArray<int32> ids;
+	ids.Reserve(requests);
+
+	double dStart = FPlatformTime::Seconds();
+	for (int32 i = 0; i < requests; i++)
+	{
+		int32 iId = tracker.NextId();
+		tracker.Start(iId, i % 8, 5.0f);
+		ids.Add(iId);
+	}
+	double dStarted = FPlatformTime::Seconds() - dStart;
+
+	FRandomStream random(requests);
+	for (int32 i = ids.Num() - 1; i > 0; i--)
+	{
+		ids.Swap(i, random.RandRange(0, i));
+	}
+
+	int32 iAnswered = requests / 2;
+	dStart = FPlatformTime::Seconds();
+	for (int32 i = 0; i < iAnswered; i++)
+	{
+		tracker.Complete(ids[i], FWebSocketResponse());
+	}
+	double dCompleted = FPlatformTime::Seconds() - dStart;
+
+	// what checking every pending deadline once per frame costs
+	TArray<double> deadlines;
+	deadlines.Init(FPlatformTime::Seconds() + 5.0, requests - iAnswered);
+	int32 iExpired = 0;
+	dStart = FPlatformTime::Seconds();
+	double dNow = FPlatformTime::Seconds();
+	for (double deadline : deadlines)
+	{
+		iExpired += deadline <= dNow ? 1 : 0;
+	}
+	double dScan = FPlatformTime::Seconds() - dStart;
+
+	dStart = FPlatformTime::Seconds();
+	tracker.Advance(FPlatformTime::Seconds() + 6.0);
+	double dExpired = FPlatformTime::Seconds() - dStart;
+
+	TArray<FWebSocketRequestStats> stats = tracker.GetStats();
+	int32 iTimeouts = 0;
+	for (const FWebSocketRequestStats& typeStats : stats)
+	{
+		iTimeouts += typeStats.Timeouts;
+	}
+
+	UE_LOG(WebSocket, Display, TEXT("websocket: %d outstanding, ns per request: start %.1f, response %.1f, timeout %.1f (%d timed out). a per frame scan of the deadlines %.3f ms, %d due"),
+		requests, dStarted * 1e9 / requests, dCompleted * 1e9 / FMath::Max(1, iAnswered), dExpired * 1e9 / FMath::Max(1, iTimeouts), iTimeouts, dScan * 1e3, iExpired);
+}
+
+static void WebSocketRequestBench(const TArray<FString>& Args)
+{
+	int32 iRequests = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100000;
+	WebSocketRequestBenchRun(FMath::Max(1, iRequests / 100));
+	WebSocketRequestBenchRun(iRequests);
+}
+
+static FAutoConsoleCommand WebSocketRequestBenchCommand(
+	TEXT("websocket.RequestBench"),
+	TEXT("ns per request to start, answer and time out requests with 1% and with all of them outstanding, optional argument: requests"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&WebSocketRequestBench));
+
+/** one way delay of the simulated link: 2 ms plus exponential jitter, one in twenty ten times as long */
+static double WebSocketClockBenchDelay(FRandomStream& random, double jitterUs)
+{
+	double dJitter = -jitterUs * FMath::Loge(FMath::Max(1e-9f, 1.0f - random.GetFraction()));
+	if (random.GetFraction() < 0.05f)
+	{
+		dJitter *= 10.0;
+	}
+	return 2000.0 + dJitter;
+}
+
+/**
+ * offline run of the clock estimate against a simulated server whose clock is offset and drifts, with the
+ * schedule of StartClockSync: a burst of 8 exchanges 50 ms apart, then one every 2 s. logs the real error
+ * against the reported bound as exchanges come in.
+ */
+static void WebSocketClockBench(const TArray<FString>& Args)
+{
+	double dJitterUs = (Args.Num() > 0 ? FCString::Atod(*Args[0]) : 5.0) * 1000.0;
+	double dOffsetUs = (Args.Num() > 1 ? FCString::Atod(*Args[1]) : 1234.5) * 1000.0;
+	double dDrift = (Args.Num() > 2 ? FCString::Atod(*Args[2]) : 50.0) * 1e-6;
+
+	FRandomStream random(0x54);
+	FWebSocketClock clock;
+	double dLocal = 1e6;
+	double dWorst = 0.0;
+	int32 iWithin = 0;
+	const int32 iSamples = 130;
+	for (int32 i = 1; i <= iSamples; i++)
+	{
+		double dSend = dLocal;
+		double dArrive = dSend + WebSocketClockBenchDelay(random, dJitterUs);
+		double dReply = dArrive + 50.0;
+		double dReceive = dReply + WebSocketClockBenchDelay(random, dJitterUs);
+		clock.AddSample((int64)dSend, (int64)(dArrive * (1.0 + dDrift) + dOffsetUs), (int64)(dReply * (1.0 + dDrift) + dOffsetUs), (int64)dReceive);
+
+		int64 iServer = 0;
+		double dErrorUs = 0.0;
+		clock.GetServerTime((int64)dReceive, iServer, dErrorUs);
+		double dActual = FMath::Abs((double)iServer - (dReceive * (1.0 + dDrift) + dOffsetUs));
+		dWorst = FMath::Max(dWorst, dActual);
+		iWithin += dActual <= dErrorUs ? 1 : 0;
+
+		if (FMath::IsPowerOfTwo(i) || i == iSamples)
+		{
+			FWebSocketClockStats stats = clock.GetStats();
+			UE_LOG(WebSocket, Display, TEXT("websocket: %d exchanges, error %.3f ms, bound %.3f ms, drift %.1f ppm, %d of %d used"),
+				i, dActual / 1000.0, dErrorUs / 1000.0, stats.DriftPpm, stats.UsedSamples, stats.Samples);
+		}
+
+		dLocal = dReceive + (i < 8 ? 50000.0 : 2000000.0);
+	}
+
+	UE_LOG(WebSocket, Display, TEXT("websocket: %d of %d within the bound, worst error %.3f ms"), iWithin, iSamples, dWorst / 1000.0);
+}
+
+static FAutoConsoleCommand WebSocketClockBenchCommand(
+	TEXT("websocket.ClockBench"),
+	TEXT("error of the server clock estimate against its bound on a simulated link, optional arguments: jitter ms, offset ms, drift ppm"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&WebSocketClockBench));
+#endif
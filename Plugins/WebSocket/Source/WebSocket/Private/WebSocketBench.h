@@ -0,0 +1,81 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#pragma once
+
+#include "UObject/NoExportTypes.h"
+#include "WebSocketBench.generated.h"
+
+/** body of the ready message of the sample game, what websocket.DecodeBench decodes */
+USTRUCT()
+struct FWebSocketBenchRoom
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY()
+	int32 roomId;
+
+	UPROPERTY()
+	bool ready;
+
+	UPROPERTY()
+	FString name;
+
+	UPROPERTY()
+	TArray<int32> seats;
+
+	FWebSocketBenchRoom() :roomId(0), ready(false) {}
+};
+
+/** the whole envelope as the class Blueprints hand to JsonToObject */
+UCLASS(Transient)
+class UWebSocketBenchMessage : public UObject
+{
+	GENERATED_BODY()
+public:
+
+	UPROPERTY()
+	int32 cmd;
+
+	UPROPERTY()
+	FWebSocketBenchRoom body;
+};
+
+/** target of OnReceiveData for websocket.ReceiveBench, counts what reflection hands it */
+UCLASS(Transient)
+class UWebSocketBenchReceiver : public UObject
+{
+	GENERATED_BODY()
+public:
+
+	UWebSocketBenchReceiver();
+
+	UFUNCTION()
+	void Receive(const FString& data) { mBytes += data.Len(); }
+
+	/** what a Blueprint OnReceiveData does with a message, JsonToObject and read a field */
+	UFUNCTION()
+	void ReceiveJson(const FString& data);
+
+	int64 mBytes;
+};
@@ -21,13 +21,84 @@
 
 #include "WebSocket.h"
 #include "WebSocketContext.h"
+#include "WebSocketSettings.h"
+#include "WebSocketUtf8.h"
 #include "WebSocketBlueprintLibrary.h"
 #include "Runtime/Launch/Resources/Version.h"
+#include "Engine/Engine.h"
+#include "LatentActions.h"
 
 
 
 UWebSocketContext* s_websocketCtx;
 
+/** game thread */
+static TMap<int32, TWeakObjectPtr<UClass>> s_commandClasses;
+
+/** waits for the future of a request, complete runs on the game thread once it is ready */
+class FWebSocketRequestAction : public FPendingLatentAction
+{
+public:
+
+	FWebSocketRequestAction(TFuture<FWebSocketResponse>&& future, TFunction<void(const FWebSocketResponse&)>&& complete, const FLatentActionInfo& info)
+		:mFuture(MoveTemp(future)), mComplete(MoveTemp(complete)), mExecutionFunction(info.ExecutionFunction), mOutputLink(info.Linkage), mCallbackTarget(info.CallbackTarget)
+	{
+	}
+
+	virtual void UpdateOperation(FLatentResponse& Response) override
+	{
+		if (!mFuture.IsReady())
+		{
+			return;
+		}
+
+		mComplete(mFuture.Get());
+		Response.FinishAndTriggerIf(true, mExecutionFunction, mOutputLink, mCallbackTarget);
+	}
+
+private:
+
+	TFuture<FWebSocketResponse> mFuture;
+	TFunction<void(const FWebSocketResponse&)> mComplete;
+	FName mExecutionFunction;
+	int32 mOutputLink;
+	FWeakObjectPtr mCallbackTarget;
+};
+
+/** the request on socket, or one that already failed with Closed */
+static TFuture<FWebSocketResponse> WebSocketStartRequest(UWebSocketBase* socket, const FString& data, float timeout)
+{
+	if (socket != nullptr)
+	{
+		return socket->Request(data, timeout);
+	}
+
+	TPromise<FWebSocketResponse> closed;
+	TFuture<FWebSocketResponse> future = closed.GetFuture();
+	FWebSocketResponse response;
+	response.Result = EWebSocketRequestResult::Closed;
+	closed.SetValue(MoveTemp(response));
+	return future;
+}
+
+static bool WebSocketAddRequestAction(UObject* worldContextObject, const FLatentActionInfo& info, TFunction<TFuture<FWebSocketResponse>()>&& start, TFunction<void(const FWebSocketResponse&)>&& complete)
+{
+	UWorld* pWorld = GEngine != nullptr ? GEngine->GetWorldFromContextObject(worldContextObject, EGetWorldErrorMode::LogAndReturnNull) : nullptr;
+	if (pWorld == nullptr)
+	{
+		return false;
+	}
+
+	FLatentActionManager& latentManager = pWorld->GetLatentActionManager();
+	if (latentManager.FindExistingAction<FWebSocketRequestAction>(info.CallbackTarget, info.UUID) != nullptr)
+	{
+		return false;
+	}
+
+	latentManager.AddNewAction(info.CallbackTarget, info.UUID, new FWebSocketRequestAction(start(), MoveTemp(complete), info));
+	return true;
+}
+
 static bool GetTextFromObject(const TSharedRef<FJsonObject>& Obj, FText& TextOut)
 {
 	// get the prioritized culture name list
@@ -51,34 +122,235 @@ static bool GetTextFromObject(const TSharedRef<FJsonObject>& Obj, FText& TextOut
 
 
 
-UWebSocketBase* UWebSocketBlueprintLibrary::Connect(const FString& url, bool& connectFail)
+UWebSocketContext* UWebSocketBlueprintLibrary::GetOrCreateContext()
 {
 	if (s_websocketCtx == nullptr)
 	{
-		s_websocketCtx =  NewObject<UWebSocketContext>();
-		s_websocketCtx->CreateCtx();
+		s_websocketCtx = NewObject<UWebSocketContext>();
 		s_websocketCtx->AddToRoot();
+
+		if (GetDefault<UWebSocketSettings>()->bCreateContextAsync)
+		{
+			s_websocketCtx->CreateCtxAsync();
+		}
+		else
+		{
+			s_websocketCtx->CreateCtx();
+			s_websocketCtx->StartService();
+		}
 	}
 
-	return s_websocketCtx->Connect(url, TMap<FString, FString>(), connectFail);
+	return s_websocketCtx;
 }
 
-UWebSocketBase* UWebSocketBlueprintLibrary::ConnectWithHeader(const FString& url, const TArray<FWebSocketHeaderPair>& header, bool& connectFail)
+void UWebSocketBlueprintLibrary::WarmUp()
+{
+	GetOrCreateContext();
+}
+
+void UWebSocketBlueprintLibrary::ShutdownContext(float Timeout)
 {
 	if (s_websocketCtx == nullptr)
 	{
-		s_websocketCtx = NewObject<UWebSocketContext>();
-		s_websocketCtx->CreateCtx();
-		s_websocketCtx->AddToRoot();
+		return;
 	}
 
+	if (s_websocketCtx->Shutdown(Timeout))
+	{
+		s_websocketCtx->RemoveFromRoot();
+		s_websocketCtx = nullptr;
+	}
+}
+
+UWebSocketBase* UWebSocketBlueprintLibrary::Connect(const FString& url, bool& connectFail)
+{
+	return GetOrCreateContext()->Connect(url, TMap<FString, FString>(), connectFail);
+}
+
+UWebSocketBase* UWebSocketBlueprintLibrary::ConnectWithHeader(const FString& url, const TArray<FWebSocketHeaderPair>& header, bool& connectFail)
+{
 	TMap<FString, FString> headerMap;
 	for (int i = 0; i < header.Num(); i++)
 	{
 		headerMap.Add(header[i].key, header[i].value);
 	}
 
-	return s_websocketCtx->Connect(url, headerMap, connectFail);
+	return GetOrCreateContext()->Connect(url, headerMap, connectFail);
+}
+
+UWebSocketBase* UWebSocketBlueprintLibrary::ConnectWithProtocol(const FString& url, const FString& protocol, const TArray<FWebSocketHeaderPair>& header, bool& connectFail)
+{
+	TMap<FString, FString> headerMap;
+	for (int i = 0; i < header.Num(); i++)
+	{
+		headerMap.Add(header[i].key, header[i].value);
+	}
+
+	return GetOrCreateContext()->Connect(url, headerMap, protocol, connectFail);
+}
+
+UWebSocketBase* UWebSocketBlueprintLibrary::ConnectEndpoints(const TArray<FString>& urls, const FString& protocol, const TArray<FWebSocketHeaderPair>& header, bool& connectFail)
+{
+	TMap<FString, FString> headerMap;
+	for (int i = 0; i < header.Num(); i++)
+	{
+		headerMap.Add(header[i].key, header[i].value);
+	}
+
+	return GetOrCreateContext()->ConnectEndpoints(urls, headerMap, protocol, false, connectFail);
+}
+
+UWebSocketBase* UWebSocketBlueprintLibrary::ProbeEndpoints(const TArray<FString>& urls, bool& probeFail)
+{
+	return GetOrCreateContext()->ConnectEndpoints(urls, TMap<FString, FString>(), FString(), true, probeFail);
+}
+
+UWebSocketServer* UWebSocketBlueprintLibrary::Listen(int32 port, bool& listenFail)
+{
+	return GetOrCreateContext()->Listen(port, listenFail);
+}
+
+TSharedRef<FWebSocketPool, ESPMode::ThreadSafe> UWebSocketBlueprintLibrary::CreatePool(IWebSocketPoolListener* listener)
+{
+	return GetOrCreateContext()->CreatePool(listener);
+}
+
+TArray<FWebSocketEndpointStatus> UWebSocketBlueprintLibrary::GetEndpointLatencies()
+{
+	if (s_websocketCtx == nullptr)
+	{
+		return TArray<FWebSocketEndpointStatus>();
+	}
+
+	return s_websocketCtx->GetEndpointStatuses();
+}
+
+FWebSocketTlsStats UWebSocketBlueprintLibrary::GetTlsStats()
+{
+	if (s_websocketCtx == nullptr)
+	{
+		return FWebSocketTlsStats();
+	}
+
+	return s_websocketCtx->GetTlsStats();
+}
+
+FWebSocketContextStats UWebSocketBlueprintLibrary::GetContextStats()
+{
+	if (s_websocketCtx == nullptr)
+	{
+		return FWebSocketContextStats();
+	}
+
+	return s_websocketCtx->GetContextStats();
+}
+
+FWebSocketFrameHandle UWebSocketBlueprintLibrary::RegisterFrameText(const FString& data)
+{
+	TArray<uint8> utf8;
+	WebSocketAppendUtf8(data, utf8);
+	return GetOrCreateContext()->RegisterFrame(utf8.GetData(), utf8.Num(), false);
+}
+
+FWebSocketFrameHandle UWebSocketBlueprintLibrary::RegisterFrameBinary(const TArray<uint8>& data)
+{
+	return GetOrCreateContext()->RegisterFrame(data.GetData(), data.Num(), true);
+}
+
+FWebSocketFrameHandle UWebSocketBlueprintLibrary::RegisterFrameObject(UObject* Object)
+{
+	FString data;
+	if (Object == nullptr || !ObjectToJson(Object, data))
+	{
+		return FWebSocketFrameHandle();
+	}
+
+	return RegisterFrameText(data);
+}
+
+void UWebSocketBlueprintLibrary::UnregisterFrame(FWebSocketFrameHandle handle)
+{
+	if (s_websocketCtx != nullptr)
+	{
+		s_websocketCtx->UnregisterFrame(handle);
+	}
+}
+
+void UWebSocketBlueprintLibrary::RegisterCommand(int32 Cmd, UClass* Class)
+{
+	s_commandClasses.Add(Cmd, Class);
+}
+
+UClass* UWebSocketBlueprintLibrary::GetCommandClass(int32 Cmd)
+{
+	return s_commandClasses.FindRef(Cmd).Get();
+}
+
+void UWebSocketBlueprintLibrary::Request(UObject* WorldContextObject, UWebSocketBase* Socket, const FString& Data, float Timeout, FLatentActionInfo LatentInfo, FWebSocketResponse& Response)
+{
+	// Response lives in the blueprint's frame, it is still there when the action completes
+	FWebSocketResponse* pResponse = &Response;
+	WebSocketAddRequestAction(WorldContextObject, LatentInfo, [Socket, &Data, Timeout]()
+	{
+		return WebSocketStartRequest(Socket, Data, Timeout);
+	}, [pResponse](const FWebSocketResponse& response)
+	{
+		*pResponse = response;
+	});
+}
+
+void UWebSocketBlueprintLibrary::RequestObject(UObject* WorldContextObject, UWebSocketBase* Socket, UObject* Message, UClass* ResponseClass, float Timeout, FLatentActionInfo LatentInfo, EWebSocketRequestResult& Result, UObject*& Response)
+{
+	EWebSocketRequestResult* pResult = &Result;
+	UObject** pResponse = &Response;
+	TWeakObjectPtr<UClass> weakClass(ResponseClass);
+	WebSocketAddRequestAction(WorldContextObject, LatentInfo, [Socket, Message, Timeout]()
+	{
+		FString strData;
+		if (Message == nullptr || !ObjectToJson(Message, strData))
+		{
+			return WebSocketStartRequest(Socket, FString(), Timeout);
+		}
+		return WebSocketStartRequest(Socket, strData, Timeout);
+	}, [pResult, pResponse, weakClass](const FWebSocketResponse& response)
+	{
+		*pResult = response.Result;
+		*pResponse = nullptr;
+		UClass* pClass = weakClass.Get();
+		if (response.Result != EWebSocketRequestResult::Success || pClass == nullptr)
+		{
+			return;
+		}
+
+		// a command route parsed it already, the socket's own decoder leaves nothing to read from
+		if (response.Decoded.Json.IsValid())
+		{
+			UObject* pObject = NewObject<UObject>((UObject*)GetTransientPackage(), pClass);
+			*pResponse = JsonObjectToUStruct(response.Decoded.Json.ToSharedRef(), pClass, pObject, 0, 0) ? pObject : nullptr;
+		}
+		else if (!response.Data.IsEmpty())
+		{
+			*pResponse = JsonToObject(response.Data, pClass, false);
+		}
+
+		if (*pResponse == nullptr)
+		{
+			UE_LOG(WebSocket, Warning, TEXT("websocket: response of cmd %d does not fit %s"), response.Type, *pClass->GetName());
+			*pResult = EWebSocketRequestResult::Failed;
+		}
+	});
+}
+
+bool UWebSocketBlueprintLibrary::CopyDecodedStruct(const FWebSocketDecodedMessage& message, UStructProperty* property, void* out)
+{
+	const UScriptStruct* pStruct = message.GetStruct();
+	if (property == nullptr || out == nullptr || pStruct == nullptr || property->Struct != pStruct)
+	{
+		return false;
+	}
+
+	pStruct->CopyScriptStruct(out, message.Struct->GetStructMemory());
+	return true;
 }
 
 bool UWebSocketBlueprintLibrary::GetJsonIntField(const FString& data, const FString& key, int& iValue)
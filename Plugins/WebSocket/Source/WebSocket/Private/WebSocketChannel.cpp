@@ -0,0 +1,118 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+#include "WebSocket.h"
+#include "WebSocketChannel.h"
+#include "WebSocketCodec.h"
+#include "WebSocketUtf8.h"
+
+void UWebSocketChannel::Init(UWebSocketBase* socket, const TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>& state)
+{
+	mSocket = socket;
+	mState = state;
+}
+
+bool UWebSocketChannel::SendText(const FString& data)
+{
+	TArray<uint8> utf8;
+	WebSocketAppendUtf8(data, utf8);
+	return Send(utf8.GetData(), utf8.Num(), WEBSOCKET_CHANNEL_TEXT);
+}
+
+bool UWebSocketChannel::SendBinary(const TArray<uint8>& data)
+{
+	return Send(data.GetData(), data.Num(), WEBSOCKET_CHANNEL_BINARY);
+}
+
+bool UWebSocketChannel::Send(const uint8* data, int32 len, uint8 type)
+{
+#if PLATFORM_UWP
+	return false;
+#elif PLATFORM_HTML5
+	return false;
+#else
+	UWebSocketBase* pSocket = mSocket.Get();
+	if (pSocket == nullptr || !mState.IsValid() || pSocket->IsClosing())
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: channel send fail, the socket is closed"));
+		return false;
+	}
+
+	int32 iLen = len + WEBSOCKET_CHANNEL_HEADER_SIZE;
+	if (mState->MaxQueuedBytes > 0 && mState->QueuedBytes.GetValue() + iLen > mState->MaxQueuedBytes)
+	{
+		mState->DroppedSends.Increment();
+		UE_LOG(WebSocket, Warning, TEXT("websocket: channel %d send queue full, message dropped"), mState->Channel);
+		return false;
+	}
+
+	FWebSocketOutMessage msg;
+	WebSocketMakeChannelMessage(mState->Channel, type, data, len, msg);
+	mState->QueuedBytes.Add(iLen);
+	mState->SendQueue.Enqueue(MoveTemp(msg));
+
+	pSocket->RequestWrite();
+	return true;
+#endif
+}
+
+void UWebSocketChannel::Deliver(const FWebSocketInMessage& msg)
+{
+	int32 iPayloadLen = msg.WireBytes - WEBSOCKET_CHANNEL_HEADER_SIZE;
+	mState->ReceivedMessages.Increment();
+	mState->ReceivedBytes.Add(iPayloadLen);
+
+	if (msg.bBinary)
+	{
+		OnReceiveBinary.Broadcast(msg.Binary);
+	}
+	else
+	{
+		OnReceiveData.Broadcast(msg.Data);
+	}
+}
+
+int32 UWebSocketChannel::GetChannelId() const
+{
+	return mState.IsValid() ? (int32)mState->Channel : INDEX_NONE;
+}
+
+FWebSocketChannelStats UWebSocketChannel::GetStats() const
+{
+	FWebSocketChannelStats stats;
+	if (!mState.IsValid())
+	{
+		return stats;
+	}
+
+	stats.Channel = mState->Channel;
+	stats.SentMessages = mState->SentMessages.GetValue();
+	stats.SentBytes = mState->SentBytes.GetValue();
+	stats.ReceivedMessages = mState->ReceivedMessages.GetValue();
+	stats.ReceivedBytes = mState->ReceivedBytes.GetValue();
+	stats.QueuedBytes = mState->QueuedBytes.GetValue();
+	stats.PendingBytes = mState->PendingBytes.GetValue();
+	stats.DroppedSends = mState->DroppedSends.GetValue();
+	stats.bPausedByPeer = mState->bPausedByPeer;
+	stats.bPausedPeer = mState->bPausedPeer;
+	return stats;
+}
@@ -0,0 +1,190 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#include "WebSocket.h"
+#include "WebSocketClock.h"
+#include "Misc/ScopeLock.h"
+
+/** drift is only fitted over exchanges at least this far apart, a burst alone says nothing about it */
+#define WEBSOCKET_CLOCK_MIN_DRIFT_SPAN 10e6
+
+/** drift assumed for the error bound until it is fitted, and the most a fit may report */
+#define WEBSOCKET_CLOCK_UNKNOWN_DRIFT 100e-6
+#define WEBSOCKET_CLOCK_MAX_DRIFT 500e-6
+
+int64 WebSocketLocalClockUs()
+{
+	return (int64)(FPlatformTime::Seconds() * 1e6);
+}
+
+int64 WebSocketServerClockUs()
+{
+	// utc has ms resolution on some platforms and may be stepped, the cycle counter has neither problem
+	static const double s_anchorSeconds = FPlatformTime::Seconds();
+	static const int64 s_anchorUtcUs = (FDateTime::UtcNow() - FDateTime(1970, 1, 1)).GetTicks() / ETimespan::TicksPerMicrosecond;
+	return s_anchorUtcUs + (int64)((FPlatformTime::Seconds() - s_anchorSeconds) * 1e6);
+}
+
+FWebSocketClock::FWebSocketClock()
+	:mNext(0), mTotal(0), mUsed(0), mbValid(false), mRef(0.0), mOffset(0.0), mDrift(0.0), mError(0.0), mDriftError(0.0), mMinDelay(0.0), mLastServer(0)
+{
+}
+
+void FWebSocketClock::AddSample(int64 clientSend, int64 serverReceive, int64 serverSend, int64 clientReceive)
+{
+	// the differences are taken in int64, epoch microseconds lose precision in a double before that
+	FSample sample;
+	sample.Local = 0.5 * (double)(clientSend + clientReceive);
+	sample.Offset = 0.5 * (double)((serverReceive - clientSend) + (serverSend - clientReceive));
+	sample.Delay = FMath::Max(0.0, (double)((clientReceive - clientSend) - (serverSend - serverReceive)));
+
+	FScopeLock lock(&mLock);
+	if (mSamples.Num() < WEBSOCKET_CLOCK_WINDOW)
+	{
+		mSamples.Add(sample);
+	}
+	else
+	{
+		mSamples[mNext] = sample;
+		mNext = (mNext + 1) % WEBSOCKET_CLOCK_WINDOW;
+	}
+	mTotal++;
+	Fit();
+}
+
+void FWebSocketClock::Fit()
+{
+	// the faster half, the fastest exchange is always in it
+	TArray<double> delays;
+	for (const FSample& sample : mSamples)
+	{
+		delays.Add(sample.Delay);
+	}
+	delays.Sort();
+	double dMaxDelay = delays[(delays.Num() - 1) / 2];
+	mMinDelay = delays[0];
+
+	TArray<FSample> used;
+	for (const FSample& sample : mSamples)
+	{
+		if (sample.Delay <= dMaxDelay)
+		{
+			used.Add(sample);
+		}
+	}
+
+	// fitted twice, the second time without the exchanges far off the first fit
+	double dBase = used[0].Offset;
+	double dSpread = 0.0;
+	for (int32 iPass = 0; iPass < 2; iPass++)
+	{
+		double dMeanX = 0.0;
+		double dMeanY = 0.0;
+		double dFirst = used[0].Local;
+		double dLast = used[0].Local;
+		for (const FSample& sample : used)
+		{
+			dMeanX += sample.Local;
+			dMeanY += sample.Offset - dBase;
+			dFirst = FMath::Min(dFirst, sample.Local);
+			dLast = FMath::Max(dLast, sample.Local);
+		}
+		dMeanX /= used.Num();
+		dMeanY /= used.Num();
+
+		double dSxx = 0.0;
+		double dSxy = 0.0;
+		for (const FSample& sample : used)
+		{
+			dSxx += (sample.Local - dMeanX) * (sample.Local - dMeanX);
+			dSxy += (sample.Local - dMeanX) * (sample.Offset - dBase - dMeanY);
+		}
+
+		bool bDrift = used.Num() >= 4 && dLast - dFirst >= WEBSOCKET_CLOCK_MIN_DRIFT_SPAN;
+		mRef = dMeanX;
+		mDrift = bDrift ? FMath::Clamp(dSxy / dSxx, -WEBSOCKET_CLOCK_MAX_DRIFT, WEBSOCKET_CLOCK_MAX_DRIFT) : 0.0;
+		mOffset = dBase + dMeanY;
+
+		TArray<double> residuals;
+		double dSquares = 0.0;
+		for (const FSample& sample : used)
+		{
+			double dResidual = sample.Offset - Estimate(sample.Local);
+			residuals.Add(FMath::Abs(dResidual));
+			dSquares += dResidual * dResidual;
+		}
+		dSpread = used.Num() > 2 ? FMath::Sqrt(dSquares / (used.Num() - (bDrift ? 2 : 1))) : 0.0;
+		mDriftError = bDrift ? dSpread / FMath::Sqrt(dSxx) : WEBSOCKET_CLOCK_UNKNOWN_DRIFT;
+		if (iPass == 1 || used.Num() < 4)
+		{
+			break;
+		}
+
+		// a spike is 3 median deviations off, with a floor so a perfect fit drops nothing
+		residuals.Sort();
+		double dLimit = 3.0 * 1.4826 * residuals[residuals.Num() / 2] + 100.0;
+		used.RemoveAll([this, dLimit](const FSample& sample)
+		{
+			return FMath::Abs(sample.Offset - Estimate(sample.Local)) > dLimit;
+		});
+	}
+
+	mUsed = used.Num();
+	mError = 0.5 * mMinDelay + 2.0 * dSpread;
+	mbValid = true;
+}
+
+bool FWebSocketClock::GetServerTime(int64 localUs, int64& serverUs, double& errorUs)
+{
+	FScopeLock lock(&mLock);
+	if (!mbValid)
+	{
+		return false;
+	}
+
+	// a new exchange may move the estimate back a little, callers keep seeing a clock that only runs forward
+	serverUs = FMath::Max(localUs + (int64)Estimate((double)localUs), mLastServer);
+	mLastServer = serverUs;
+	errorUs = GetError((double)localUs);
+	return true;
+}
+
+FWebSocketClockStats FWebSocketClock::GetStats() const
+{
+	FWebSocketClockStats stats;
+	FScopeLock lock(&mLock);
+	stats.Samples = mTotal;
+	stats.UsedSamples = mUsed;
+	if (!mbValid)
+	{
+		return stats;
+	}
+
+	int64 iLocal = WebSocketLocalClockUs();
+	stats.bSynchronized = true;
+	stats.OffsetMs = (float)((double)(iLocal + (int64)Estimate((double)iLocal) - WebSocketServerClockUs()) / 1000.0);
+	stats.DriftPpm = (float)(mDrift * 1e6);
+	stats.ErrorMs = (float)(GetError((double)iLocal) / 1000.0);
+	stats.RttMs = (float)(mMinDelay / 1000.0);
+	return stats;
+}
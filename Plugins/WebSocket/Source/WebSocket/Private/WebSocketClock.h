@@ -0,0 +1,87 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WebSocketStats.h"
+
+#define WEBSOCKET_CLOCK_WINDOW 32
+
+/** microseconds of FPlatformTime::Seconds, what the client stamps its clock frames with */
+int64 WebSocketLocalClockUs();
+
+/** microseconds since the unix epoch, read from FPlatformTime::Seconds anchored to utc once per process */
+int64 WebSocketServerClockUs();
+
+/**
+ * offset and drift of the server's clock against WebSocketLocalClockUs, fitted to the last 32 exchanges.
+ * only the faster half of them is used, a slow exchange sat in a queue on one of the ways and its offset
+ * is off by up to half the extra delay, and of those the ones whose offset spikes away from the fit are
+ * dropped too. the error bound is half the lowest round trip plus the spread around the fit, growing with
+ * the drift's uncertainty away from the exchanges. thread safe, the service thread adds the exchanges.
+ */
+class FWebSocketClock
+{
+public:
+
+	FWebSocketClock();
+
+	/** one exchange, client times from WebSocketLocalClockUs, server times from the server's clock */
+	void AddSample(int64 clientSend, int64 serverReceive, int64 serverSend, int64 clientReceive);
+
+	/** the server's clock at localUs, false before the first exchange. never goes backwards */
+	bool GetServerTime(int64 localUs, int64& serverUs, double& errorUs);
+
+	FWebSocketClockStats GetStats() const;
+
+private:
+
+	struct FSample
+	{
+		/** middle of the exchange on the local clock */
+		double Local;
+		double Offset;
+		double Delay;
+	};
+
+	void Fit();
+	double Estimate(double local) const { return mOffset + mDrift * (local - mRef); }
+	double GetError(double local) const { return mError + mDriftError * FMath::Abs(local - mRef); }
+
+	mutable FCriticalSection mLock;
+	TArray<FSample> mSamples;
+	int32 mNext;
+	int32 mTotal;
+	int32 mUsed;
+
+	/** offset at mRef and its change per local microsecond */
+	bool mbValid;
+	double mRef;
+	double mOffset;
+	double mDrift;
+	double mError;
+	double mDriftError;
+	double mMinDelay;
+	int64 mLastServer;
+};
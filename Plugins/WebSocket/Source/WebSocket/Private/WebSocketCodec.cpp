@@ -0,0 +1,422 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+#include "WebSocket.h"
+#include "WebSocketCodec.h"
+#include "WebSocketConnection.h"
+#include "WebSocketRouter.h"
+#include "WebSocketSettings.h"
+#include "WebSocketUtf8.h"
+#include "Paths.h"
+#include "FileHelper.h"
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#elif PLATFORM_WINDOWS
+#include "PreWindowsApi.h"
+#include "libwebsockets.h"
+#include "PostWindowsApi.h"
+#else
+#include "libwebsockets.h"
+#endif
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+THIRD_PARTY_INCLUDES_START
+#include "zlib.h"
+THIRD_PARTY_INCLUDES_END
+
+#define WEBSOCKET_SEND_PADDING LWS_PRE
+
+void WebSocketMakeOutMessage(const uint8* data, int32 len, bool bBinary, FWebSocketOutMessage& out)
+{
+	out.bBinary = bBinary;
+	out.Payload.SetNumUninitialized(WEBSOCKET_SEND_PADDING + len);
+	FMemory::Memcpy(out.Payload.GetData() + WEBSOCKET_SEND_PADDING, data, len);
+}
+
+void WebSocketMakeTextMessage(const FString& data, FWebSocketOutMessage& out)
+{
+	// converted straight behind the padding, without a temporary
+	out.bBinary = false;
+	out.Payload.SetNumUninitialized(WEBSOCKET_SEND_PADDING);
+	WebSocketAppendUtf8(data, out.Payload);
+}
+
+void WebSocketMakeChannelMessage(uint16 channel, uint8 type, const uint8* data, int32 len, FWebSocketOutMessage& out)
+{
+	out.bBinary = true;
+	out.Payload.SetNumUninitialized(WEBSOCKET_SEND_PADDING + WEBSOCKET_CHANNEL_HEADER_SIZE + len);
+
+	uint8* p = out.Payload.GetData() + WEBSOCKET_SEND_PADDING;
+	p[0] = WEBSOCKET_CHANNEL_MAGIC;
+	p[1] = type;
+	p[2] = (uint8)(channel & 0xff);
+	p[3] = (uint8)(channel >> 8);
+	if (len > 0)
+	{
+		FMemory::Memcpy(p + WEBSOCKET_CHANNEL_HEADER_SIZE, data, len);
+	}
+}
+
+bool WebSocketIsChannelFrame(const uint8* in, int32 len)
+{
+	return len >= WEBSOCKET_CHANNEL_HEADER_SIZE && in[0] == WEBSOCKET_CHANNEL_MAGIC && in[1] <= WEBSOCKET_CHANNEL_RESUME;
+}
+
+void WebSocketMakeDurableMessage(uint64 sequence, uint8 type, const uint8* data, int32 len, FWebSocketOutMessage& out)
+{
+	out.bBinary = true;
+	out.Payload.SetNumUninitialized(WEBSOCKET_SEND_PADDING + WEBSOCKET_DURABLE_HEADER_SIZE + len);
+
+	uint8* p = out.Payload.GetData() + WEBSOCKET_SEND_PADDING;
+	p[0] = WEBSOCKET_DURABLE_MAGIC;
+	p[1] = type;
+	for (int32 i = 0; i < 8; i++)
+	{
+		p[2 + i] = (uint8)(sequence >> (i * 8));
+	}
+	if (len > 0)
+	{
+		FMemory::Memcpy(p + WEBSOCKET_DURABLE_HEADER_SIZE, data, len);
+	}
+}
+
+bool WebSocketIsDurableFrame(const uint8* in, int32 len)
+{
+	return len >= WEBSOCKET_DURABLE_HEADER_SIZE && in[0] == WEBSOCKET_DURABLE_MAGIC && in[1] <= WEBSOCKET_DURABLE_ACK;
+}
+
+uint64 WebSocketReadDurableSequence(const uint8* in)
+{
+	uint64 sequence = 0;
+	for (int32 i = 0; i < 8; i++)
+	{
+		sequence |= (uint64)in[2 + i] << (i * 8);
+	}
+	return sequence;
+}
+
+bool WebSocketIsTransferFrame(const uint8* in, int32 len)
+{
+	return len >= WEBSOCKET_TRANSFER_HEADER_SIZE && in[0] == WEBSOCKET_TRANSFER_MAGIC && in[1] <= WEBSOCKET_TRANSFER_ABORT;
+}
+
+static void WebSocketWriteClockTime(uint8* p, int64 time)
+{
+	for (int32 i = 0; i < 8; i++)
+	{
+		p[i] = (uint8)((uint64)time >> (i * 8));
+	}
+}
+
+void WebSocketMakeClockMessage(uint8 type, int64 clientSend, int64 serverReceive, int64 serverSend, FWebSocketOutMessage& out)
+{
+	int32 iLen = type == WEBSOCKET_CLOCK_REQUEST ? WEBSOCKET_CLOCK_REQUEST_SIZE : WEBSOCKET_CLOCK_RESPONSE_SIZE;
+	out.bBinary = true;
+	out.Payload.SetNumUninitialized(WEBSOCKET_SEND_PADDING + iLen);
+
+	uint8* p = out.Payload.GetData() + WEBSOCKET_SEND_PADDING;
+	p[0] = WEBSOCKET_CLOCK_MAGIC;
+	p[1] = type;
+	WebSocketWriteClockTime(p + 2, clientSend);
+	if (type == WEBSOCKET_CLOCK_RESPONSE)
+	{
+		WebSocketWriteClockTime(p + 10, serverReceive);
+		WebSocketWriteClockTime(p + 18, serverSend);
+	}
+}
+
+bool WebSocketIsClockFrame(const uint8* in, int32 len)
+{
+	// exact sizes, a binary protocol's own messages are unlikely to match by accident
+	if (len < WEBSOCKET_CLOCK_REQUEST_SIZE || in[0] != WEBSOCKET_CLOCK_MAGIC)
+	{
+		return false;
+	}
+	return (in[1] == WEBSOCKET_CLOCK_REQUEST && len == WEBSOCKET_CLOCK_REQUEST_SIZE) || (in[1] == WEBSOCKET_CLOCK_RESPONSE && len == WEBSOCKET_CLOCK_RESPONSE_SIZE);
+}
+
+int64 WebSocketReadClockTime(const uint8* in, int32 offset)
+{
+	uint64 time = 0;
+	for (int32 i = 0; i < 8; i++)
+	{
+		time |= (uint64)in[offset + i] << (i * 8);
+	}
+	return (int64)time;
+}
+
+static void WriteCodecHeader(uint8* p, uint16 version)
+{
+	p[0] = WEBSOCKET_CODEC_DICT_DEFLATE;
+	p[1] = (uint8)(version & 0xff);
+	p[2] = (uint8)(version >> 8);
+}
+
+FWebSocketDictionaryCodec::FWebSocketDictionaryCodec(TArray<uint8>&& dictionary, uint16 version, int32 level, int32 minCompressSize)
+	:mDictionary(MoveTemp(dictionary)), mVersion(version), mLevel(level), mMinCompressSize(minCompressSize)
+{
+}
+
+TSharedPtr<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe> FWebSocketDictionaryCodec::LoadFromSettings(const UWebSocketSettings* Settings)
+{
+	if (!Settings->bEnableDictionaryCodec)
+	{
+		return nullptr;
+	}
+
+	return Load(Settings->DictionaryFile, (uint16)Settings->DictionaryVersion, Settings->CompressionLevel, Settings->MinCompressSize);
+}
+
+TSharedPtr<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe> FWebSocketDictionaryCodec::Load(const FString& dictionaryFile, uint16 version, int32 level, int32 minCompressSize)
+{
+	FString strPath = FPaths::ProjectDir() / dictionaryFile;
+	TArray<uint8> dictionary;
+	if (!FFileHelper::LoadFileToArray(dictionary, *strPath) || dictionary.Num() == 0)
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: fail load dictionary '%s', codec disabled"), *strPath);
+		return nullptr;
+	}
+
+	UE_LOG(WebSocket, Log, TEXT("websocket: loaded dictionary '%s' version %d, %d bytes"), *strPath, version, dictionary.Num());
+	return MakeShareable(new FWebSocketDictionaryCodec(MoveTemp(dictionary), version, level, minCompressSize));
+}
+
+bool FWebSocketDictionaryCodec::IsCodecFrame(const uint8* in, int32 len)
+{
+	return len >= WEBSOCKET_CODEC_HEADER_SIZE && in[0] == WEBSOCKET_CODEC_DICT_DEFLATE;
+}
+
+uint16 FWebSocketDictionaryCodec::ReadVersion(const uint8* in)
+{
+	return (uint16)in[1] | ((uint16)in[2] << 8);
+}
+
+bool FWebSocketDictionaryCodec::Encode(const FString& data, FWebSocketOutMessage& out) const
+{
+	TArray<uint8> utf8;
+	WebSocketAppendUtf8(data, utf8);
+	return EncodeUtf8(utf8.GetData(), utf8.Num(), out);
+}
+
+bool FWebSocketDictionaryCodec::EncodeUtf8(const uint8* data, int32 len, FWebSocketOutMessage& out) const
+{
+	if (len < mMinCompressSize)
+	{
+		WebSocketMakeOutMessage(data, len, false, out);
+		return true;
+	}
+
+	z_stream stream;
+	FMemory::Memzero(stream);
+	if (deflateInit2(&stream, mLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		return false;
+	}
+
+	if (deflateSetDictionary(&stream, mDictionary.GetData(), mDictionary.Num()) != Z_OK)
+	{
+		deflateEnd(&stream);
+		return false;
+	}
+
+	const int32 iHead = WEBSOCKET_SEND_PADDING + WEBSOCKET_CODEC_HEADER_SIZE;
+	out.bBinary = true;
+	out.Payload.SetNumUninitialized(iHead + deflateBound(&stream, len));
+	WriteCodecHeader(out.Payload.GetData() + WEBSOCKET_SEND_PADDING, mVersion);
+
+	stream.next_in = (Bytef*)data;
+	stream.avail_in = len;
+	stream.next_out = out.Payload.GetData() + iHead;
+	stream.avail_out = out.Payload.Num() - iHead;
+
+	int iRet = deflate(&stream, Z_FINISH);
+	int32 iCompressed = (int32)stream.total_out;
+	deflateEnd(&stream);
+
+	if (iRet != Z_STREAM_END)
+	{
+		return false;
+	}
+
+	out.Payload.SetNum(iHead + iCompressed, false);
+	return true;
+}
+
+bool FWebSocketDictionaryCodec::Decode(const uint8* in, int32 len, TArray<uint8>& out) const
+{
+	z_stream stream;
+	FMemory::Memzero(stream);
+	if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+	{
+		return false;
+	}
+
+	if (inflateSetDictionary(&stream, mDictionary.GetData(), mDictionary.Num()) != Z_OK)
+	{
+		inflateEnd(&stream);
+		return false;
+	}
+
+	stream.next_in = (Bytef*)(in + WEBSOCKET_CODEC_HEADER_SIZE);
+	stream.avail_in = len - WEBSOCKET_CODEC_HEADER_SIZE;
+
+	out.SetNumUninitialized(FMath::Max(1024, (len - WEBSOCKET_CODEC_HEADER_SIZE) * 4));
+
+	int iRet = Z_OK;
+	while (iRet == Z_OK)
+	{
+		if (stream.total_out == (uLong)out.Num())
+		{
+			if (out.Num() >= WEBSOCKET_CODEC_MAX_DECODED)
+			{
+				break;
+			}
+			out.SetNumUninitialized(FMath::Min(out.Num() * 2, WEBSOCKET_CODEC_MAX_DECODED));
+		}
+
+		stream.next_out = out.GetData() + stream.total_out;
+		stream.avail_out = out.Num() - stream.total_out;
+		iRet = inflate(&stream, Z_NO_FLUSH);
+		if (iRet == Z_BUF_ERROR && stream.avail_in == 0)
+		{
+			break;
+		}
+	}
+
+	out.SetNum((int32)stream.total_out, false);
+	inflateEnd(&stream);
+
+	return iRet == Z_STREAM_END;
+}
+
+FWebSocketCodecPipeline::FWebSocketCodecPipeline(const TSharedRef<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe>& codec, const TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe>& owner)
+	:mCodec(codec), mOwner(owner), mNegotiated(false)
+{
+}
+
+void FWebSocketCodecPipeline::Encode(const FString& data)
+{
+	FGraphEventArray prerequisites;
+	if (mLastEncode.IsValid())
+	{
+		prerequisites.Add(mLastEncode);
+	}
+
+	mPendingEncodes.Increment();
+
+	TSharedRef<FWebSocketCodecPipeline, ESPMode::ThreadSafe> self = AsShared();
+	mLastEncode = FFunctionGraphTask::CreateAndDispatchWhenReady([self, data]()
+	{
+		FWebSocketOutMessage out;
+		if (self->mCodec->Encode(data, out))
+		{
+			self->mEncoded.Enqueue(MoveTemp(out));
+		}
+		else
+		{
+			UE_LOG(WebSocket, Error, TEXT("websocket: dictionary encode fail, message dropped"));
+		}
+		self->mPendingEncodes.Decrement();
+
+		if (TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe> owner = self->mOwner.Pin())
+		{
+			owner->RequestWrite();
+		}
+	}, TStatId(), &prerequisites, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+bool FWebSocketCodecPipeline::PopEncoded(FWebSocketOutMessage& out)
+{
+	return mEncoded.Dequeue(out);
+}
+
+bool FWebSocketCodecPipeline::HasPendingEncode() const
+{
+	return !mEncoded.IsEmpty() || mPendingEncodes.GetValue() > 0;
+}
+
+void FWebSocketCodecPipeline::Decode(const uint8* in, int32 len, bool bBinary, bool bCommandFrame)
+{
+	bool bCodecFrame = bBinary && FWebSocketDictionaryCodec::IsCodecFrame(in, len);
+	if (bCodecFrame && FWebSocketDictionaryCodec::ReadVersion(in) != mCodec->GetVersion())
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: dictionary version mismatch %d != %d, message dropped"), FWebSocketDictionaryCodec::ReadVersion(in), mCodec->GetVersion());
+		ReleaseOwnerRxBytes(len);
+		return;
+	}
+
+	// the empty codec frame is the server's answer to our handshake header
+	if (bCodecFrame && len == WEBSOCKET_CODEC_HEADER_SIZE)
+	{
+		mNegotiated = true;
+		ReleaseOwnerRxBytes(len);
+		return;
+	}
+
+	FGraphEventArray prerequisites;
+	if (mLastDecode.IsValid())
+	{
+		prerequisites.Add(mLastDecode);
+	}
+
+	TArray<uint8> frame(in, len);
+
+	TSharedRef<FWebSocketCodecPipeline, ESPMode::ThreadSafe> self = AsShared();
+	mLastDecode = FFunctionGraphTask::CreateAndDispatchWhenReady([self, bCommandFrame, bCodecFrame, frame = MoveTemp(frame)]()
+	{
+		TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe> owner = self->mOwner.Pin();
+		if (bCommandFrame && !bCodecFrame && owner.IsValid())
+		{
+			owner->EnqueueReceived(TArray<uint8>(frame));
+			return;
+		}
+
+		TArray<uint8> decoded;
+		const TArray<uint8>* pText = &frame;
+		if (bCodecFrame)
+		{
+			if (!self->mCodec->Decode(frame.GetData(), frame.Num(), decoded))
+			{
+				UE_LOG(WebSocket, Error, TEXT("websocket: dictionary decode fail, message dropped"));
+				self->ReleaseOwnerRxBytes(frame.Num());
+				return;
+			}
+			pText = &decoded;
+		}
+
+		if (owner.IsValid())
+		{
+			owner->ReceiveText(pText->GetData(), pText->Num(), frame.Num());
+		}
+	}, TStatId(), &prerequisites, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+void FWebSocketCodecPipeline::ReleaseOwnerRxBytes(int32 len)
+{
+	if (TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe> owner = mOwner.Pin())
+	{
+		owner->ReleaseRxBytes(len);
+	}
+}
+#endif
@@ -0,0 +1,214 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Containers/Queue.h"
+#include "UObject/WeakObjectPtr.h"
+#include "HAL/ThreadSafeBool.h"
+#include "WebSocketBase.h"
+
+class FWebSocketConnection;
+
+/*
+* dictionary codec wire format, carried in binary frames:
+*
+*   byte 0     WEBSOCKET_CODEC_DICT_DEFLATE
+*   byte 1..2  dictionary version, little endian
+*   byte 3..   raw deflate stream primed with the dictionary
+*
+* the client announces its dictionary version with the WEBSOCKET_CODEC_HEADER
+* handshake header. a server that has the same dictionary answers with an empty
+* codec frame (3 bytes, no deflate stream); only after that the client starts
+* to compress, so old servers keep receiving plain text frames.
+*/
+#define WEBSOCKET_CODEC_DICT_DEFLATE 0x5A
+#define WEBSOCKET_CODEC_HEADER_SIZE 3
+#define WEBSOCKET_CODEC_HEADER "X-WebSocket-Dictionary:"
+#define WEBSOCKET_CODEC_MAX_DECODED (16*1024*1024)
+
+/*
+* channel frame, carried in binary frames once a socket opened a channel:
+*
+*   byte 0     WEBSOCKET_CHANNEL_MAGIC
+*   byte 1     frame type, WEBSOCKET_CHANNEL_TEXT .. WEBSOCKET_CHANNEL_RESUME
+*   byte 2..3  channel id, little endian
+*   byte 4..   payload of TEXT and BINARY frames
+*
+* PAUSE asks the other side to hold the channel's messages until RESUME,
+* the other channels of the socket keep flowing.
+*/
+#define WEBSOCKET_CHANNEL_MAGIC 0x4D
+#define WEBSOCKET_CHANNEL_HEADER_SIZE 4
+#define WEBSOCKET_CHANNEL_TEXT 0
+#define WEBSOCKET_CHANNEL_BINARY 1
+#define WEBSOCKET_CHANNEL_PAUSE 2
+#define WEBSOCKET_CHANNEL_RESUME 3
+
+/*
+* durable frame, carried in binary frames of a socket with a durable lane:
+*
+*   byte 0     WEBSOCKET_DURABLE_MAGIC
+*   byte 1     frame type, WEBSOCKET_DURABLE_TEXT .. WEBSOCKET_DURABLE_ACK
+*   byte 2..9  sequence, little endian
+*   byte 10..  payload of TEXT and BINARY frames
+*
+* sequences of a journal start at 1 and never repeat, also across launches.
+* the server answers ACK with the highest sequence it received without a gap
+* and stored; everything up to it is removed from the journal. unacknowledged
+* messages are sent again after every connect, the server drops sequences it
+* acknowledged before.
+*/
+#define WEBSOCKET_DURABLE_MAGIC 0x4A
+#define WEBSOCKET_DURABLE_HEADER_SIZE 10
+#define WEBSOCKET_DURABLE_TEXT 0
+#define WEBSOCKET_DURABLE_BINARY 1
+#define WEBSOCKET_DURABLE_ACK 2
+
+/*
+* transfer frame, carried in binary frames of SendFile and to sockets that AcceptTransfers:
+*
+*   byte 0     WEBSOCKET_TRANSFER_MAGIC
+*   byte 1     frame type, WEBSOCKET_TRANSFER_BEGIN .. WEBSOCKET_TRANSFER_ABORT
+*   byte 2..3  transfer id, little endian
+*   BEGIN      byte 4..11 file size, little endian, byte 12.. utf-8 file name
+*   DATA       byte 4.. the next file bytes
+*   END        byte 4..7 crc32 of the file, little endian
+*
+* DATA messages are sent in fragments of TransferChunkBytes and carry up to
+* TransferMessageBytes, other messages are written between them. the receiver
+* writes every fragment to disk as it arrives. ABORT replaces END when the
+* sender could not read the file.
+*/
+#define WEBSOCKET_TRANSFER_MAGIC 0x46
+#define WEBSOCKET_TRANSFER_HEADER_SIZE 4
+#define WEBSOCKET_TRANSFER_BEGIN 0
+#define WEBSOCKET_TRANSFER_DATA 1
+#define WEBSOCKET_TRANSFER_END 2
+#define WEBSOCKET_TRANSFER_ABORT 3
+
+/*
+* clock frame, carried in binary frames of a socket that synchronizes its clock with StartClockSync:
+*
+*   byte 0     WEBSOCKET_CLOCK_MAGIC
+*   byte 1     frame type, WEBSOCKET_CLOCK_REQUEST or WEBSOCKET_CLOCK_RESPONSE
+*   byte 2..9  client send time, microseconds of the client's clock, little endian
+*   RESPONSE   byte 10..17 server receive time, byte 18..25 server send time, microseconds since the unix epoch
+*
+* the server echoes the client time back unchanged. send times are stamped on the service thread right
+* before lws_write, receive times as the frame is read, so queues in front of the socket do not count.
+*/
+#define WEBSOCKET_CLOCK_MAGIC 0x54
+#define WEBSOCKET_CLOCK_REQUEST_SIZE 10
+#define WEBSOCKET_CLOCK_RESPONSE_SIZE 26
+#define WEBSOCKET_CLOCK_REQUEST 0
+#define WEBSOCKET_CLOCK_RESPONSE 1
+
+/** requests a server holds for one peer until it can answer, older ones are dropped for newer ones */
+#define WEBSOCKET_CLOCK_MAX_REPLIES 8
+
+/** reserve the lws frame header room in front of the payload so lws_write never needs a copy */
+void WebSocketMakeOutMessage(const uint8* data, int32 len, bool bBinary, FWebSocketOutMessage& out);
+void WebSocketMakeTextMessage(const FString& data, FWebSocketOutMessage& out);
+void WebSocketMakeChannelMessage(uint16 channel, uint8 type, const uint8* data, int32 len, FWebSocketOutMessage& out);
+bool WebSocketIsChannelFrame(const uint8* in, int32 len);
+void WebSocketMakeDurableMessage(uint64 sequence, uint8 type, const uint8* data, int32 len, FWebSocketOutMessage& out);
+bool WebSocketIsDurableFrame(const uint8* in, int32 len);
+uint64 WebSocketReadDurableSequence(const uint8* in);
+bool WebSocketIsTransferFrame(const uint8* in, int32 len);
+void WebSocketMakeClockMessage(uint8 type, int64 clientSend, int64 serverReceive, int64 serverSend, FWebSocketOutMessage& out);
+bool WebSocketIsClockFrame(const uint8* in, int32 len);
+int64 WebSocketReadClockTime(const uint8* in, int32 offset);
+
+/**
+ * preset dictionary deflate, every message is compressed on its own (no context takeover)
+ * so the dictionary is what gives small json messages their ratio. thread safe, it keeps no stream state.
+ */
+class FWebSocketDictionaryCodec
+{
+public:
+
+	FWebSocketDictionaryCodec(TArray<uint8>&& dictionary, uint16 version, int32 level, int32 minCompressSize);
+
+	/** returns null when the codec is disabled or the dictionary can not be loaded */
+	static TSharedPtr<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe> LoadFromSettings(const UWebSocketSettings* Settings);
+
+	/** the dictionary file relative to the project dir, any thread. null when it can not be loaded */
+	static TSharedPtr<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe> Load(const FString& dictionaryFile, uint16 version, int32 level, int32 minCompressSize);
+
+	uint16 GetVersion() const { return mVersion; }
+
+	/** plain text frame for short messages, codec binary frame otherwise */
+	bool Encode(const FString& data, FWebSocketOutMessage& out) const;
+	bool EncodeUtf8(const uint8* data, int32 len, FWebSocketOutMessage& out) const;
+
+	bool Decode(const uint8* in, int32 len, TArray<uint8>& out) const;
+
+	static bool IsCodecFrame(const uint8* in, int32 len);
+	static uint16 ReadVersion(const uint8* in);
+
+private:
+
+	TArray<uint8> mDictionary;
+	uint16 mVersion;
+	int32 mLevel;
+	int32 mMinCompressSize;
+};
+
+/**
+ * per connection codec state. encode and decode jobs run on task graph workers, each job depends on the
+ * previous one of the same direction so messages keep their order. encoded frames are picked up by
+ * FWebSocketConnection::OnWriteable, decoded messages go straight to the owner's inbox.
+ */
+class FWebSocketCodecPipeline : public TSharedFromThis<FWebSocketCodecPipeline, ESPMode::ThreadSafe>
+{
+public:
+
+	FWebSocketCodecPipeline(const TSharedRef<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe>& codec, const TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe>& owner);
+
+	uint16 GetVersion() const { return mCodec->GetVersion(); }
+	bool IsNegotiated() const { return mNegotiated; }
+
+	void Encode(const FString& data);
+	/** bCommandFrame is the connection's call, only a protocol with plugin frames has them */
+	void Decode(const uint8* in, int32 len, bool bBinary, bool bCommandFrame);
+
+	bool PopEncoded(FWebSocketOutMessage& out);
+	bool HasPendingEncode() const;
+
+private:
+
+	void ReleaseOwnerRxBytes(int32 len);
+
+	TSharedRef<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe> mCodec;
+	TWeakPtr<FWebSocketConnection, ESPMode::ThreadSafe> mOwner;
+	TQueue<FWebSocketOutMessage, EQueueMode::Mpsc> mEncoded;
+	FThreadSafeCounter mPendingEncodes;
+
+	/** game thread */
+	FGraphEventRef mLastEncode;
+
+	/** service thread */
+	FGraphEventRef mLastDecode;
+	FThreadSafeBool mNegotiated;
+};
@@ -0,0 +1,1796 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+#include "WebSocket.h"
+#include "WebSocketConnection.h"
+#include "WebSocketClock.h"
+#include "WebSocketContext.h"
+#include "WebSocketCodec.h"
+#include "WebSocketRouter.h"
+#include "WebSocketSettings.h"
+#include "WebSocketUtf8.h"
+#include "Async/Async.h"
+#include "Misc/Paths.h"
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#elif PLATFORM_WINDOWS
+#include "PreWindowsApi.h"
+#include "libwebsockets.h"
+#include "PostWindowsApi.h"
+#else
+#include "libwebsockets.h"
+#endif
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+void WebSocketRunOnGameThread(TFunction<void()>&& fn)
+{
+	if (IsInGameThread())
+	{
+		fn();
+		return;
+	}
+
+	AsyncTask(ENamedThreads::GameThread, MoveTemp(fn));
+}
+
+FWebSocketConnection::FWebSocketConnection(UWebSocketContext* context, UWebSocketBase* owner, const TSharedRef<FWebSocketInbox, ESPMode::ThreadSafe>& inbox)
+	:mContext(context), mOwner(owner), mInbox(inbox), mDecodeChain(nullptr), mlws(nullptr), mbEstablished(false), mbBinaryPayload(false), mbPluginFrames(false), mbClosing(false), mCloseCode(1000), mCloseDeadline(0.0), mbPaceTimerArmed(false), mbPingRequested(false), mPingSentTime(0.0), mbAccepted(false)
+{
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	mbRaw = false;
+#endif
+
+	// GetPacingStats reads it from the game thread, it can not appear later. a context that turns pacing on
+	// paces the connections it creates from then on
+	if (context->GetSettings()->bEnablePacing)
+	{
+		mPacer = MakeUnique<FWebSocketPacer>();
+	}
+}
+
+FWebSocketConnection::~FWebSocketConnection()
+{
+	delete mDecodeChain.Load();
+}
+
+void FWebSocketConnection::SetPool(const TSharedRef<FWebSocketPool, ESPMode::ThreadSafe>& pool, FWebSocketHandle handle)
+{
+	mPool = pool;
+	mPoolHandle = handle;
+}
+
+void FWebSocketConnection::PostToOwner(TFunction<void(FWebSocketConnectionOwner*)>&& fn)
+{
+	TWeakObjectPtr<UWebSocketBase> owner = mOwner;
+	TWeakPtr<FWebSocketPool, ESPMode::ThreadSafe> pool = mPool;
+	WebSocketRunOnGameThread([owner, pool, fn]()
+	{
+		if (UWebSocketBase* pOwner = owner.Get())
+		{
+			fn(pOwner);
+		}
+		else if (TSharedPtr<FWebSocketPool, ESPMode::ThreadSafe> pPool = pool.Pin())
+		{
+			fn(pPool.Get());
+		}
+	});
+}
+
+void FWebSocketConnection::SetCodec(const TSharedRef<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe>& codec)
+{
+	mCodecPipeline = MakeShareable(new FWebSocketCodecPipeline(codec, AsShared()));
+}
+
+bool FWebSocketUri::Parse(const FString& uri, FWebSocketUri& out)
+{
+	// ws+unix:///run/sim.sock or ws+unix:///run/sim.sock:/path, the same host skips tcp loopback
+	if (uri.StartsWith(TEXT("ws+unix://")))
+	{
+#if WITH_WEBSOCKET_UNIX_SOCKET
+		out.bUnix = true;
+		out.Address = uri.Mid(10);
+		out.Path = TEXT("/");
+		int32 iPathPos = INDEX_NONE;
+		if (out.Address.FindChar(TEXT(':'), iPathPos))
+		{
+			out.Path = out.Address.Mid(iPathPos + 1);
+			out.Address = out.Address.Left(iPathPos);
+		}
+		return true;
+#else
+		UE_LOG(WebSocket, Error, TEXT("websocket: ws+unix is not supported on this platform"));
+		return false;
+#endif
+	}
+
+	int iPos = uri.Find(TEXT(":"));
+	if (iPos == INDEX_NONE)
+	{
+		//UE_LOG(WebSocket, Error, TEXT("Invalid Websocket address:%s"), *uri);
+		return false;
+	}
+
+	FString strProtocol = uri.Left(iPos);
+	if (strProtocol.ToUpper() != TEXT("WS") && strProtocol.ToUpper() != TEXT("WSS"))
+	{
+		//UE_LOG(WebSocket, Error, TEXT("Invalid Protol:%s"), *strProtocol);
+		return false;
+	}
+
+	out.bUnix = false;
+	out.UseSSL = strProtocol.ToUpper() == TEXT("WSS") ? 2 : 0;
+	out.Path = TEXT("/");
+	FString strNextParse = uri.Mid(iPos + 3);
+	iPos = strNextParse.Find("/");
+	if (iPos != INDEX_NONE)
+	{
+		out.Host = strNextParse.Left(iPos);
+		out.Path = strNextParse.Mid(iPos);
+	}
+	else
+	{
+		out.Host = strNextParse;
+	}
+
+	out.Address = out.Host;
+	out.Port = out.UseSSL ? 443 : 80;
+	iPos = out.Address.Find(":");
+	if (iPos != INDEX_NONE)
+	{
+		out.Address = out.Host.Left(iPos);
+		out.Port = FCString::Atoi(*out.Host.Mid(iPos + 1));
+	}
+
+	return true;
+}
+
+bool FWebSocketConnection::OpenUri(const FWebSocketUri& uri, const TMap<FString, FString>& header, int32 protocolIndex)
+{
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	if (uri.bUnix)
+	{
+		return OpenUnix(uri.Address, uri.Path, header, protocolIndex);
+	}
+#endif
+
+	return Open(uri.Address, uri.Port, uri.UseSSL, uri.Path, uri.Host, header, protocolIndex);
+}
+
+bool FWebSocketConnection::Open(const FString& address, int32 port, int32 iUseSSL, const FString& path, const FString& host, const TMap<FString, FString>& header, int32 protocolIndex)
+{
+	if (header.Num() > 0)
+	{
+		mHeaderMap = MakeUnique<TMap<FString, FString>>(header);
+	}
+	mbAlive = true;
+
+	if (mContext->IsServiceThread())
+	{
+		bool bOpened = OpenOnService(address, port, iUseSSL, path, host, protocolIndex);
+		if (!bOpened)
+		{
+			mbAlive = false;
+		}
+		return bOpened;
+	}
+
+	// lws only connects on the thread that services it, a failure then arrives through OnConnectError
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnService([self, address, port, iUseSSL, path, host, protocolIndex]()
+	{
+		if (!self->OpenOnService(address, port, iUseSSL, path, host, protocolIndex))
+		{
+			self->OnConnectError(TEXT("create client connect fail"));
+		}
+	});
+
+	return true;
+}
+
+bool FWebSocketConnection::OpenOnService(const FString& address, int32 port, int32 iUseSSL, const FString& path, const FString& host, int32 protocolIndex)
+{
+	struct lws_context* pContext = mContext->GetLwsContext();
+	if (pContext == nullptr)
+	{
+		return false;
+	}
+
+	struct lws_client_connect_info connectInfo;
+	memset(&connectInfo, 0, sizeof(connectInfo));
+
+	std::string stdAddress = TCHAR_TO_UTF8(*address);
+	std::string stdPath = TCHAR_TO_UTF8(*path);
+	std::string stdHost = TCHAR_TO_UTF8(*host);
+	std::string stdProtocol = TCHAR_TO_UTF8(*mContext->GetProtocolConfig(protocolIndex).Name);
+
+	connectInfo.context = pContext;
+	connectInfo.address = stdAddress.c_str();
+	connectInfo.port = port;
+	connectInfo.ssl_connection = iUseSSL;
+	connectInfo.path = stdPath.c_str();
+	connectInfo.host = stdHost.c_str();
+	connectInfo.origin = stdHost.c_str();
+	connectInfo.ietf_version_or_minus_one = -1;
+	connectInfo.protocol = stdProtocol.empty() ? NULL : stdProtocol.c_str();
+	connectInfo.userdata = this;
+
+	mContext->AddConnection(AsShared());
+	mlws = lws_client_connect_via_info(&connectInfo);
+	if (mlws == nullptr)
+	{
+		UE_LOG(WebSocket, Error, TEXT("create client connect fail"));
+		Release();
+		return false;
+	}
+
+	return true;
+}
+
+#if WITH_WEBSOCKET_UNIX_SOCKET
+bool FWebSocketConnection::OpenUnix(const FString& socketPath, const FString& path, const TMap<FString, FString>& header, int32 protocolIndex)
+{
+	if (header.Num() > 0)
+	{
+		mHeaderMap = MakeUnique<TMap<FString, FString>>(header);
+	}
+	mbAlive = true;
+	mbRaw = true;
+	mRaw = MakeUnique<FWebSocketRawState>();
+
+	if (mContext->IsServiceThread())
+	{
+		bool bOpened = OpenUnixOnService(socketPath, path, protocolIndex);
+		if (!bOpened)
+		{
+			mbAlive = false;
+		}
+		return bOpened;
+	}
+
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnService([self, socketPath, path, protocolIndex]()
+	{
+		if (!self->OpenUnixOnService(socketPath, path, protocolIndex))
+		{
+			self->OnConnectError(TEXT("unix socket connect fail"));
+		}
+	});
+
+	return true;
+}
+
+bool FWebSocketConnection::OpenUnixOnService(const FString& socketPath, const FString& path, int32 protocolIndex)
+{
+	struct lws_vhost* pVhost = mContext->GetLwsVhost();
+	if (pVhost == nullptr)
+	{
+		return false;
+	}
+
+	int fd = WebSocketConnectUnix(socketPath);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	// the upgrade request carries the same headers lws adds for ws and wss
+	TMap<FString, FString> header;
+	if (mHeaderMap.IsValid())
+	{
+		header = *mHeaderMap;
+	}
+	if (mCodecPipeline.IsValid())
+	{
+		header.Add(FString(WEBSOCKET_CODEC_HEADER).LeftChop(1), FString::FromInt(mCodecPipeline->GetVersion()));
+	}
+
+	const FString& strProtocol = mContext->GetProtocolConfig(protocolIndex).Name;
+	std::string strRequest = mRaw->Client.MakeHandshake(path, strProtocol, header);
+	WebSocketMakeOutMessage((const uint8*)strRequest.c_str(), (int32)strRequest.size(), false, mRaw->Handshake);
+
+	// lws closes the descriptor itself when the adoption fails
+	lws_sock_file_fd_type desc;
+	desc.sockfd = fd;
+	std::string stdProtocol = TCHAR_TO_UTF8(*strProtocol);
+
+	mContext->AddConnection(AsShared());
+	mlws = lws_adopt_descriptor_vhost(pVhost, LWS_ADOPT_SOCKET, desc, stdProtocol.c_str(), NULL);
+	if (mlws == nullptr)
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: adopting unix socket '%s' fail"), *socketPath);
+		Release();
+		return false;
+	}
+
+	mContext->AddRawConnection(mlws, this);
+	lws_callback_on_writable(mlws);
+	return true;
+}
+#endif
+
+void FWebSocketConnection::SendText(const FString& data)
+{
+	if (mCodecPipeline.IsValid() && mCodecPipeline->IsNegotiated())
+	{
+		// the encode job calls RequestWrite when the frame is ready
+		mCodecPipeline->Encode(data);
+		return;
+	}
+
+	FWebSocketOutMessage msg;
+	WebSocketMakeTextMessage(data, msg);
+	mSendQueue.Enqueue(MoveTemp(msg));
+	RequestWrite();
+}
+
+void FWebSocketConnection::SendBinary(const TArray<uint8>& data)
+{
+	FWebSocketOutMessage msg;
+	WebSocketMakeOutMessage(data.GetData(), data.Num(), true, msg);
+	mSendQueue.Enqueue(MoveTemp(msg));
+	RequestWrite();
+}
+
+void FWebSocketConnection::SendDurable(uint64 sequence, const uint8* data, int32 len, bool bBinary)
+{
+	FWebSocketOutMessage msg;
+	WebSocketMakeDurableMessage(sequence, bBinary ? WEBSOCKET_DURABLE_BINARY : WEBSOCKET_DURABLE_TEXT, data, len, msg);
+	mSendQueue.Enqueue(MoveTemp(msg));
+	RequestWrite();
+}
+
+void FWebSocketConnection::SendShared(const TSharedRef<TArray<uint8>, ESPMode::ThreadSafe>& frame, bool bBinary)
+{
+	FWebSocketOutMessage msg;
+	msg.Shared = frame;
+	msg.bBinary = bBinary;
+	mSendQueue.Enqueue(MoveTemp(msg));
+	RequestWrite();
+}
+
+void FWebSocketConnection::SendFrame(const FWebSocketCachedFrame& frame)
+{
+	// nothing is converted or compressed here, the connection only picks the variant it can send
+	bool bEncoded = frame.Encoded.Shared.IsValid() && mCodecPipeline.IsValid() && mCodecPipeline->IsNegotiated();
+	mSendQueue.Enqueue(bEncoded ? frame.Encoded : frame.Plain);
+	RequestWrite();
+}
+
+void FWebSocketConnection::SendTransfer(const TSharedRef<FWebSocketOutTransfer, ESPMode::ThreadSafe>& transfer)
+{
+	// the queue is created on the service thread, it is the only one that touches it
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnService([self, transfer]()
+	{
+		self->GetTransfers().Queue.Enqueue(transfer);
+		if (self->mlws != nullptr && self->mbEstablished)
+		{
+			self->mbWriteRequested = true;
+			lws_callback_on_writable(self->mlws);
+		}
+	});
+}
+
+FWebSocketTransferState& FWebSocketConnection::GetTransfers()
+{
+	if (!mTransfers.IsValid())
+	{
+		mTransfers = MakeUnique<FWebSocketTransferState>();
+	}
+	return *mTransfers;
+}
+
+void FWebSocketConnection::SetOwner(UWebSocketBase* owner)
+{
+	TWeakObjectPtr<UWebSocketBase> weakOwner = owner;
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnService([self, weakOwner]()
+	{
+		self->mOwner = weakOwner;
+
+		// whatever arrived before the owner existed was scheduled for nobody
+		self->mInbox->bDeliverScheduled = false;
+		if (!self->mInbox->Messages.IsEmpty())
+		{
+			self->ScheduleDelivery();
+		}
+
+		// the close was reported before there was an owner to tell
+		if (!self->mbAlive)
+		{
+			FWebSocketConnection* pSelf = &self.Get();
+			self->PostToOwner([pSelf](FWebSocketConnectionOwner* pOwner)
+			{
+				pOwner->HandleClosed(pSelf);
+			});
+		}
+	});
+}
+
+void FWebSocketConnection::SetTransferDirectory(const FString& directory)
+{
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnService([self, directory]()
+	{
+		if (self->mTransfers.IsValid() || directory.Len() > 0)
+		{
+			self->GetTransfers().Directory = directory;
+		}
+	});
+}
+
+void FWebSocketConnection::Close(int32 code, const FString& reason, float drainTimeout)
+{
+	double dDeadline = FPlatformTime::Seconds() + FMath::Max(drainTimeout, 0.0f);
+
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnService([self, code, reason, drainTimeout, dDeadline]()
+	{
+		if (self->mlws == nullptr || self->mbClosing)
+		{
+			return;
+		}
+
+		self->mbClosing = true;
+		self->mCloseCode = code;
+		self->mCloseReason = reason;
+		self->mCloseDeadline = dDeadline;
+
+		// a connect still in progress is aborted, it reports back through OnConnectError
+		bool bConnecting = !self->mbEstablished;
+#if WITH_WEBSOCKET_UNIX_SOCKET
+		bConnecting = bConnecting && !self->mbRaw;
+#endif
+		if (bConnecting)
+		{
+			lws_set_timeout(self->mlws, PENDING_TIMEOUT_AWAITING_SERVER_RESPONSE, LWS_TO_KILL_ASYNC);
+			return;
+		}
+		if (drainTimeout <= 0.0f)
+		{
+			FWebSocketOutMessage msg;
+			while (self->mSendQueue.Dequeue(msg))
+			{
+			}
+		}
+
+		lws_callback_on_writable(self->mlws);
+	});
+}
+
+void FWebSocketConnection::RequestWrite()
+{
+	// one wake up per batch, OnWriteable clears the flag before it drains the queues
+	if (mbWriteRequested.AtomicSet(true))
+	{
+		return;
+	}
+
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnService([self]()
+	{
+		if (self->mlws != nullptr && self->mbEstablished)
+		{
+			lws_callback_on_writable(self->mlws);
+		}
+		else
+		{
+			// OnEstablished asks for the first writable itself
+			self->mbWriteRequested = false;
+		}
+	});
+}
+
+void FWebSocketConnection::ReceiveText(const uint8* data, int32 len, int32 wireBytes)
+{
+	// the only utf-8 check of a text message, lws does not validate on its own
+	FWebSocketInMessage msg;
+	msg.WireBytes = wireBytes;
+	bool bDecode = IsDecoding();
+	msg.bUtf8 = mbTextAsUtf8 || bDecode;
+	bool bValid = msg.bUtf8 ? WebSocketValidateUtf8(data, len) : WebSocketDecodeUtf8(data, len, msg.Data);
+	if (!bValid)
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: invalid utf-8 in a text message, closing"));
+		ReleaseRxBytes(wireBytes);
+		Close(1007, TEXT("invalid utf-8"), 0.0f);
+		return;
+	}
+
+	if (msg.bUtf8)
+	{
+		msg.Binary.Append(data, len);
+	}
+
+	if (bDecode)
+	{
+		DecodeReceived(MoveTemp(msg));
+		return;
+	}
+	EnqueueReceived(MoveTemp(msg));
+}
+
+void FWebSocketConnection::EnqueueReceived(TArray<uint8>&& data)
+{
+	FWebSocketInMessage msg;
+	msg.WireBytes = data.Num();
+	msg.Binary = MoveTemp(data);
+	msg.bBinary = true;
+	if (IsDecoding())
+	{
+		DecodeReceived(MoveTemp(msg));
+		return;
+	}
+	EnqueueReceived(MoveTemp(msg));
+}
+
+void FWebSocketConnection::SetDecoder(const TSharedPtr<IWebSocketMessageDecoder, ESPMode::ThreadSafe>& decoder)
+{
+	FWebSocketDecodeChain* pChain = mDecodeChain.Load();
+	if (pChain == nullptr)
+	{
+		if (!decoder.IsValid())
+		{
+			return;
+		}
+
+		FWebSocketDecodeChain* pExpected = nullptr;
+		pChain = new FWebSocketDecodeChain();
+		if (!mDecodeChain.CompareExchange(pExpected, pChain))
+		{
+			delete pChain;
+			pChain = pExpected;
+		}
+	}
+
+	FScopeLock lock(&pChain->Lock);
+	pChain->Decoder = decoder;
+}
+
+bool FWebSocketConnection::IsDecoding()
+{
+	FWebSocketDecodeChain* pChain = mDecodeChain.Load();
+	if (pChain == nullptr)
+	{
+		return false;
+	}
+
+	FScopeLock lock(&pChain->Lock);
+
+	// after SetDecoder(nullptr) messages still queue up behind the jobs in flight
+	return pChain->Decoder.IsValid() || (pChain->LastDecode.IsValid() && !pChain->LastDecode->IsComplete());
+}
+
+void FWebSocketConnection::DecodeReceived(FWebSocketInMessage&& msg)
+{
+	// only called after IsDecoding found the chain
+	FWebSocketDecodeChain* pChain = mDecodeChain.Load();
+	FScopeLock lock(&pChain->Lock);
+
+	FGraphEventArray prerequisites;
+	if (pChain->LastDecode.IsValid())
+	{
+		prerequisites.Add(pChain->LastDecode);
+	}
+
+	TSharedPtr<IWebSocketMessageDecoder, ESPMode::ThreadSafe> decoder = pChain->Decoder;
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	bool bPluginFrames = mbPluginFrames;
+	pChain->LastDecode = FFunctionGraphTask::CreateAndDispatchWhenReady([self, decoder, bPluginFrames, msg = MoveTemp(msg)]() mutable
+	{
+		if (decoder.IsValid() && decoder->Decode(FWebSocketMessageView(msg.Binary, msg.bBinary, bPluginFrames), msg.Decoded))
+		{
+			msg.bDecoded = true;
+			msg.Binary.Empty();
+		}
+		else if (!msg.bBinary && !self->mbTextAsUtf8)
+		{
+			// validated before the job was queued, OnReceiveData wants it as an FString
+			WebSocketDecodeUtf8(msg.Binary.GetData(), msg.Binary.Num(), msg.Data);
+			msg.Binary.Empty();
+			msg.bUtf8 = false;
+		}
+		self->EnqueueReceived(MoveTemp(msg));
+	}, TStatId(), &prerequisites, ENamedThreads::AnyBackgroundThreadNormalTask);
+}
+
+void FWebSocketConnection::EnqueueReceived(FWebSocketInMessage&& msg)
+{
+	// a standby is not the owner's connection yet, whatever its server says is not for OnReceiveData
+	if (mbStandby)
+	{
+		ReleaseRxBytes(msg.WireBytes);
+		return;
+	}
+
+	mInbox->Messages.Enqueue(MoveTemp(msg));
+	mInbox->PendingMessages.Increment();
+
+	ScheduleDelivery();
+}
+
+void FWebSocketConnection::ScheduleDelivery()
+{
+	if (mInbox->bDeliverScheduled.AtomicSet(true))
+	{
+		return;
+	}
+
+	FWebSocketConnection* pSelf = this;
+	PostToOwner([pSelf](FWebSocketConnectionOwner* pOwner)
+	{
+		pOwner->HandleDeliver(pSelf);
+	});
+}
+
+void FWebSocketConnection::AddRxBytes(int32 len)
+{
+	int32 iPending = mInbox->PendingBytes.Add(len) + len;
+
+	int32 iPauseBytes = mContext->GetSettings()->RxPauseBytes;
+	if (mInbox->bPaused || iPauseBytes <= 0 || iPending <= iPauseBytes || mlws == nullptr)
+	{
+		return;
+	}
+
+	lws_rx_flow_control(mlws, 0);
+	mInbox->bPaused = true;
+	mInbox->PauseCount.Increment();
+	UE_LOG(WebSocket, Verbose, TEXT("websocket: rx paused, %d bytes pending"), iPending);
+}
+
+void FWebSocketConnection::ReleaseRxBytes(int32 len)
+{
+	int32 iPending = mInbox->PendingBytes.Subtract(len) - len;
+	if (!mInbox->bPaused || iPending > mContext->GetSettings()->RxResumeBytes)
+	{
+		return;
+	}
+
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnService([self]()
+	{
+		if (!self->mInbox->bPaused.AtomicSet(false))
+		{
+			return;
+		}
+
+		self->mInbox->ResumeCount.Increment();
+		if (self->mlws != nullptr)
+		{
+			lws_rx_flow_control(self->mlws, 1);
+			UE_LOG(WebSocket, Verbose, TEXT("websocket: rx resumed, %d bytes pending"), self->mInbox->PendingBytes.GetValue());
+		}
+	});
+}
+
+void FWebSocketConnection::AddChannel(const TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>& channel)
+{
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnService([self, channel]()
+	{
+		if (!self->mChannels.IsValid())
+		{
+			self->mChannels = MakeUnique<TArray<TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>>>();
+		}
+
+		// stable by priority, equal priorities keep their opening order
+		TArray<TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>>& channels = *self->mChannels;
+		int32 iIndex = 0;
+		while (iIndex < channels.Num() && channels[iIndex]->Priority >= channel->Priority)
+		{
+			iIndex++;
+		}
+
+		channels.Insert(channel, iIndex);
+	});
+
+	// messages sent before the channel reached the service thread
+	RequestWrite();
+}
+
+void FWebSocketConnection::ReleaseChannelBytes(const TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>& channel, int32 len)
+{
+	int32 iPending = channel->PendingBytes.Subtract(len) - len;
+	if (!channel->bPausedPeer || iPending > channel->MaxPendingBytes / 2)
+	{
+		return;
+	}
+
+	if (channel->bPausedPeer.AtomicSet(false))
+	{
+		SendChannelControl(channel->Channel, WEBSOCKET_CHANNEL_RESUME);
+	}
+}
+
+void FWebSocketConnection::SendChannelControl(uint16 channel, uint8 type)
+{
+	FWebSocketOutMessage msg;
+	WebSocketMakeChannelMessage(channel, type, nullptr, 0, msg);
+	mSendQueue.Enqueue(MoveTemp(msg));
+	RequestWrite();
+}
+
+bool FWebSocketConnection::OnAppendHeader(struct lws* wsi, unsigned char** p, unsigned char* end)
+{
+	if (mCodecPipeline.IsValid())
+	{
+		std::string strVersion = TCHAR_TO_UTF8(*FString::FromInt(mCodecPipeline->GetVersion()));
+		if (lws_add_http_header_by_name(wsi, (const unsigned char*)WEBSOCKET_CODEC_HEADER, (const unsigned char*)strVersion.c_str(), (int)strVersion.size(), p, end))
+		{
+			return false;
+		}
+	}
+
+	if (!mHeaderMap.IsValid())
+	{
+		return true;
+	}
+
+	for (auto& it : *mHeaderMap)
+	{
+		std::string strKey = TCHAR_TO_UTF8(*(it.Key) );
+		std::string strValue = TCHAR_TO_UTF8(*(it.Value));
+
+		strKey += ":";
+		if (lws_add_http_header_by_name(wsi, (const unsigned char*)strKey.c_str(), (const unsigned char*)strValue.c_str(), (int)strValue.size(), p, end))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FWebSocketConnection::Accept(struct lws* wsi)
+{
+	mlws = wsi;
+	mbAlive = true;
+	mbAccepted = true;
+	if (mContext->GetSettings()->bServeClockSync)
+	{
+		mClock = MakeUnique<FWebSocketClockExchange>();
+		mClock->bServe = true;
+	}
+	mContext->AddConnection(AsShared());
+	OnEstablished();
+}
+
+void FWebSocketConnection::OnEstablished(int32 protocolIndex)
+{
+	mbEstablished = true;
+
+	// lws bound the wsi to the protocol the server accepted, or to the unnamed one when it picked none
+	if (protocolIndex == INDEX_NONE)
+	{
+		const struct lws_protocols* pProtocol = lws_get_protocol(mlws);
+		protocolIndex = (pProtocol != nullptr) ? (int32)pProtocol->id : 0;
+	}
+	const FWebSocketProtocolConfig& config = mContext->GetProtocolConfig(protocolIndex);
+	mbBinaryPayload = (config.Codec == EWebSocketPayloadCodec::Binary);
+	mbPluginFrames = config.bPluginFrames;
+	if (!mbPluginFrames && (mChannels.IsValid() || mbDurable || AcceptsTransfers() || UsesClock()))
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: protocol '%s' has no plugin frames, channel, durable, transfer and clock frames of the server are delivered as binary messages"), *config.Name);
+	}
+	if (mPacer.IsValid())
+	{
+		mPacer->Init(mContext->GetSettings(), FPlatformTime::Seconds());
+	}
+	mHeaderMap.Reset();
+
+	// whatever was sent while the handshake was running
+	mbWriteRequested = true;
+	lws_callback_on_writable(mlws);
+
+	// a new connection may have a new route to the server, the burst starts over
+	if (mClock.IsValid())
+	{
+		mClock->Requests = 0;
+		mClock->bRequested = mClock->Clock.IsValid();
+	}
+
+	FWebSocketConnection* pSelf = this;
+	FString strProtocol = config.Name;
+	PostToOwner([pSelf, strProtocol](FWebSocketConnectionOwner* pOwner)
+	{
+		pOwner->HandleEstablished(pSelf, strProtocol);
+	});
+}
+
+void FWebSocketConnection::OnConnectError(const FString& error)
+{
+	Release();
+
+	// lws may report a failed connect both from the callback and through the return value
+	if (!mbAlive.AtomicSet(false))
+	{
+		return;
+	}
+
+	UE_LOG(WebSocket, Error, TEXT("libwebsocket connect error:%s"), *error);
+
+	FWebSocketConnection* pSelf = this;
+	PostToOwner([pSelf, error](FWebSocketConnectionOwner* pOwner)
+	{
+		pOwner->HandleConnectError(pSelf, error);
+	});
+}
+
+void FWebSocketConnection::OnClosed()
+{
+	Release();
+	mbAlive = false;
+	AbortTransfers();
+
+	FWebSocketConnection* pSelf = this;
+	PostToOwner([pSelf](FWebSocketConnectionOwner* pOwner)
+	{
+		pOwner->HandleClosed(pSelf);
+	});
+}
+
+void FWebSocketConnection::OnReceive(const char* in, int len, bool bBinary, bool bFinal)
+{
+	// a file never sits in memory as a whole, its DATA fragments go to disk as they arrive
+	if ((mTransfers.IsValid() && mTransfers->bRecvStreaming) || (!bFinal && bBinary && mbPluginFrames && mRecvBuffer.Num() == 0 && AcceptsTransfers()
+		&& WebSocketIsTransferFrame((const uint8*)in, len) && in[1] == WEBSOCKET_TRANSFER_DATA))
+	{
+		ReceiveTransferFragment((const uint8*)in, len, bFinal);
+		return;
+	}
+
+	if (!bFinal)
+	{
+		mRecvBuffer.Append((const uint8*)in, len);
+		return;
+	}
+
+	if (mRecvBuffer.Num() > 0)
+	{
+		mRecvBuffer.Append((const uint8*)in, len);
+		TArray<uint8> message = MoveTemp(mRecvBuffer);
+		ProcessMessage(message.GetData(), message.Num(), bBinary);
+		return;
+	}
+
+	ProcessMessage((const uint8*)in, len, bBinary);
+}
+
+void FWebSocketConnection::ProcessMessage(const uint8* data, int32 len, bool bBinary)
+{
+	AddRxBytes(len);
+
+	// the magic bytes only mean something on a protocol that negotiated them, elsewhere a binary message
+	// starting with one is a payload of the server like any other
+	bool bPluginFrame = bBinary && mbPluginFrames;
+
+	// channel frames never go through the dictionary codec, their order only matters within a channel
+	if (bPluginFrame && mChannels.IsValid() && WebSocketIsChannelFrame(data, len))
+	{
+		ProcessChannelFrame(data, len);
+		return;
+	}
+
+	if (bPluginFrame && mbDurable && WebSocketIsDurableFrame(data, len))
+	{
+		ProcessDurableFrame(data, len);
+		return;
+	}
+
+	if (bPluginFrame && AcceptsTransfers() && WebSocketIsTransferFrame(data, len))
+	{
+		ProcessTransferFrame(data, len);
+		return;
+	}
+
+	if (bPluginFrame && UsesClock() && WebSocketIsClockFrame(data, len))
+	{
+		ProcessClockFrame(data, len);
+		return;
+	}
+
+	// with a codec every message goes through the pipeline, also before the server answered the handshake,
+	// or a text message could overtake a decoding binary one. the pipeline hands the bytes back through
+	// EnqueueReceived or ReleaseRxBytes
+	bool bCommandFrame = bPluginFrame && WebSocketIsCommandFrame(data, len);
+	if (mCodecPipeline.IsValid())
+	{
+		mCodecPipeline->Decode(data, len, bBinary, bCommandFrame);
+		return;
+	}
+
+	// a command frame on a text protocol is not utf-8, the command router reads its header
+	if (bBinary && (mbBinaryPayload || (bCommandFrame && IsDecoding())))
+	{
+		EnqueueReceived(TArray<uint8>(data, len));
+		return;
+	}
+
+	ReceiveText(data, len, len);
+}
+
+void FWebSocketConnection::ProcessDurableFrame(const uint8* data, int32 len)
+{
+	ReleaseRxBytes(len);
+	if (data[1] != WEBSOCKET_DURABLE_ACK)
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: durable frame of type %d dropped, the server only sends ACK"), data[1]);
+		return;
+	}
+
+	uint64 sequence = WebSocketReadDurableSequence(data);
+	TWeakObjectPtr<UWebSocketBase> owner = mOwner;
+	WebSocketRunOnGameThread([owner, sequence]()
+	{
+		if (UWebSocketBase* pOwner = owner.Get())
+		{
+			pOwner->HandleDurableAck(sequence);
+		}
+	});
+}
+
+void FWebSocketConnection::ProcessClockFrame(const uint8* data, int32 len)
+{
+	// stamped before anything else, the time from here to the reply is subtracted on the client
+	int64 iNow = data[1] == WEBSOCKET_CLOCK_REQUEST ? WebSocketServerClockUs() : WebSocketLocalClockUs();
+	ReleaseRxBytes(len);
+	if (data[1] == WEBSOCKET_CLOCK_RESPONSE)
+	{
+		if (mClock->Clock.IsValid())
+		{
+			mClock->Clock->AddSample(WebSocketReadClockTime(data, 2), WebSocketReadClockTime(data, 10), WebSocketReadClockTime(data, 18), iNow);
+		}
+		return;
+	}
+
+	if (!mClock->bServe)
+	{
+		return;
+	}
+	// a peer that floods requests does not grow the queue, the newest requests say the most about the link
+	TArray<TPair<int64, int64>>& replies = mClock->Replies;
+	if (replies.Num() >= WEBSOCKET_CLOCK_MAX_REPLIES)
+	{
+		replies.RemoveAt(0, replies.Num() - WEBSOCKET_CLOCK_MAX_REPLIES + 1, false);
+	}
+	replies.Add(TPair<int64, int64>(WebSocketReadClockTime(data, 2), iNow));
+	mbWriteRequested = true;
+	lws_callback_on_writable(mlws);
+}
+
+void FWebSocketConnection::ProcessTransferFrame(const uint8* data, int32 len)
+{
+	ReleaseRxBytes(len);
+
+	uint8 type = data[1];
+	uint16 id = (uint16)(data[2] | (data[3] << 8));
+	const uint8* payload = data + WEBSOCKET_TRANSFER_HEADER_SIZE;
+	int32 iPayloadLen = len - WEBSOCKET_TRANSFER_HEADER_SIZE;
+	FWebSocketTransferState& transfers = *mTransfers;
+
+	if (type == WEBSOCKET_TRANSFER_BEGIN)
+	{
+		if (iPayloadLen < 8)
+		{
+			return;
+		}
+
+		int64 iSize = 0;
+		for (int32 i = 0; i < 8; i++)
+		{
+			iSize |= (int64)payload[i] << (i * 8);
+		}
+
+		// the sender only names the file, it never picks the directory
+		FUTF8ToTCHAR Convert((const ANSICHAR*)payload + 8, iPayloadLen - 8);
+		FString strName = FPaths::GetCleanFilename(FString(Convert.Length(), Convert.Get()));
+		if (strName.IsEmpty() || iSize < 0)
+		{
+			UE_LOG(WebSocket, Warning, TEXT("websocket: transfer %d dropped, bad name or size"), id);
+			return;
+		}
+
+		// a second begin for a running id makes its data ambiguous, both transfers fail
+		TUniquePtr<FWebSocketInTransfer> active;
+		if (transfers.In.RemoveAndCopyValue(id, active))
+		{
+			UE_LOG(WebSocket, Warning, TEXT("websocket: transfer %d began twice, dropped"), id);
+			if (transfers.RecvStream == active.Get())
+			{
+				transfers.RecvStream = nullptr;
+			}
+			ReportTransfer(active->GetInfo(), true, false);
+			FWebSocketTransfer info;
+			info.TransferId = id;
+			info.Name = strName;
+			info.Path = FPaths::Combine(transfers.Directory, strName);
+			info.TotalBytes = iSize;
+			ReportTransfer(info, true, false);
+			return;
+		}
+
+		TUniquePtr<FWebSocketInTransfer> transfer = MakeUnique<FWebSocketInTransfer>(id, strName, FPaths::Combine(transfers.Directory, strName), iSize);
+		if (!transfer->Open())
+		{
+			ReportTransfer(transfer->GetInfo(), true, false);
+			return;
+		}
+
+		ReportTransfer(transfer->GetInfo(), false, false);
+		transfers.In.Add(id, MoveTemp(transfer));
+		return;
+	}
+
+	TUniquePtr<FWebSocketInTransfer>* pTransfer = transfers.In.Find(id);
+	if (pTransfer == nullptr)
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: frame for unknown transfer %d dropped"), id);
+		return;
+	}
+
+	FWebSocketInTransfer& transfer = **pTransfer;
+	if (type == WEBSOCKET_TRANSFER_DATA)
+	{
+		transfer.Write(payload, iPayloadLen);
+		if (transfer.ShouldReport(FPlatformTime::Seconds()))
+		{
+			ReportTransfer(transfer.GetInfo(), false, false);
+		}
+		return;
+	}
+
+	uint32 crc = 0;
+	if (type == WEBSOCKET_TRANSFER_END && iPayloadLen >= 4)
+	{
+		crc = (uint32)payload[0] | ((uint32)payload[1] << 8) | ((uint32)payload[2] << 16) | ((uint32)payload[3] << 24);
+	}
+
+	bool bSuccess = type == WEBSOCKET_TRANSFER_END && iPayloadLen >= 4 && transfer.Finish(crc);
+	ReportTransfer(transfer.GetInfo(), true, bSuccess);
+	transfers.In.Remove(id);
+}
+
+void FWebSocketConnection::ReceiveTransferFragment(const uint8* data, int32 len, bool bFinal)
+{
+	FWebSocketTransferState& transfers = *mTransfers;
+	if (!transfers.bRecvStreaming)
+	{
+		uint16 id = (uint16)(data[2] | (data[3] << 8));
+		TUniquePtr<FWebSocketInTransfer>* pTransfer = transfers.In.Find(id);
+		transfers.RecvStream = pTransfer != nullptr ? pTransfer->Get() : nullptr;
+		transfers.bRecvStreaming = true;
+		if (transfers.RecvStream == nullptr)
+		{
+			UE_LOG(WebSocket, Warning, TEXT("websocket: data for unknown transfer %d dropped"), id);
+		}
+
+		data += WEBSOCKET_TRANSFER_HEADER_SIZE;
+		len -= WEBSOCKET_TRANSFER_HEADER_SIZE;
+	}
+
+	if (transfers.RecvStream != nullptr)
+	{
+		transfers.RecvStream->Write(data, len);
+		if (transfers.RecvStream->ShouldReport(FPlatformTime::Seconds()))
+		{
+			ReportTransfer(transfers.RecvStream->GetInfo(), false, false);
+		}
+	}
+
+	if (bFinal)
+	{
+		transfers.bRecvStreaming = false;
+		transfers.RecvStream = nullptr;
+	}
+}
+
+void FWebSocketConnection::ReportTransfer(const FWebSocketTransfer& info, bool bComplete, bool bSuccess)
+{
+	TWeakObjectPtr<UWebSocketBase> owner = mOwner;
+	WebSocketRunOnGameThread([owner, info, bComplete, bSuccess]()
+	{
+		if (UWebSocketBase* pOwner = owner.Get())
+		{
+			pOwner->HandleTransfer(info, bComplete, bSuccess);
+		}
+	});
+}
+
+void FWebSocketConnection::AbortTransfers()
+{
+	if (!mTransfers.IsValid())
+	{
+		return;
+	}
+
+	FWebSocketTransferState& transfers = *mTransfers;
+	TSharedPtr<FWebSocketOutTransfer, ESPMode::ThreadSafe> transfer = transfers.Out;
+	transfers.Out.Reset();
+	do
+	{
+		if (transfer.IsValid())
+		{
+			ReportTransfer(transfer->GetInfo(), true, false);
+		}
+	} while (transfers.Queue.Dequeue(transfer));
+
+	for (auto& it : transfers.In)
+	{
+		ReportTransfer(it.Value->GetInfo(), true, false);
+	}
+	transfers.In.Reset();
+	transfers.bRecvStreaming = false;
+	transfers.RecvStream = nullptr;
+}
+
+void FWebSocketConnection::ProcessChannelFrame(const uint8* data, int32 len)
+{
+	uint8 type = data[1];
+	uint16 channel = (uint16)(data[2] | (data[3] << 8));
+
+	const TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>* pChannel = mChannels->FindByPredicate([channel](const TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>& it)
+	{
+		return it->Channel == channel;
+	});
+
+	if (pChannel == nullptr || type == WEBSOCKET_CHANNEL_PAUSE || type == WEBSOCKET_CHANNEL_RESUME)
+	{
+		ReleaseRxBytes(len);
+		if (pChannel == nullptr)
+		{
+			UE_LOG(WebSocket, Warning, TEXT("websocket: message for channel %d dropped, the channel is not open"), channel);
+		}
+		else if (type == WEBSOCKET_CHANNEL_PAUSE)
+		{
+			(*pChannel)->bPausedByPeer = true;
+		}
+		else if ((*pChannel)->bPausedByPeer.AtomicSet(false))
+		{
+			RequestWrite();
+		}
+		return;
+	}
+
+	const TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>& state = *pChannel;
+	const uint8* payload = data + WEBSOCKET_CHANNEL_HEADER_SIZE;
+	int32 iPayloadLen = len - WEBSOCKET_CHANNEL_HEADER_SIZE;
+
+	// channel text travels in binary frames, nobody checked its utf-8 before
+	FWebSocketInMessage msg;
+	if (type != WEBSOCKET_CHANNEL_BINARY && !WebSocketDecodeUtf8(payload, iPayloadLen, msg.Data))
+	{
+		ReleaseRxBytes(len);
+		UE_LOG(WebSocket, Warning, TEXT("websocket: message for channel %d dropped, invalid utf-8"), channel);
+		return;
+	}
+
+	// only this channel is held back by the peer, the socket keeps reading the others
+	int32 iPending = state->PendingBytes.Add(len) + len;
+	if (state->MaxPendingBytes > 0 && iPending > state->MaxPendingBytes && !state->bPausedPeer.AtomicSet(true))
+	{
+		SendChannelControl(channel, WEBSOCKET_CHANNEL_PAUSE);
+	}
+
+	msg.Channel = channel;
+	msg.WireBytes = len;
+	if (type == WEBSOCKET_CHANNEL_BINARY)
+	{
+		msg.Binary.Append(payload, iPayloadLen);
+		msg.bBinary = true;
+	}
+
+	EnqueueReceived(MoveTemp(msg));
+}
+
+#if WITH_WEBSOCKET_UNIX_SOCKET
+bool FWebSocketConnection::OnRawReceive(const uint8* in, int32 len)
+{
+	FWebSocketRawClient& client = mRaw->Client;
+	client.Append(in, len);
+
+	while (true)
+	{
+		switch (client.Next())
+		{
+		case FWebSocketRawClient::EResult::NeedMore:
+			return true;
+
+		case FWebSocketRawClient::EResult::Error:
+			UE_LOG(WebSocket, Error, TEXT("websocket: ws+unix %s"), *client.Error);
+			return false;
+
+		case FWebSocketRawClient::EResult::Handshake:
+		{
+			int32 iProtocol = mContext->FindProtocol(client.Protocol);
+			if (iProtocol == INDEX_NONE)
+			{
+				UE_LOG(WebSocket, Error, TEXT("websocket: server picked the protocol '%s' that was not offered"), *client.Protocol);
+				return false;
+			}
+			OnEstablished(iProtocol);
+		}
+			break;
+
+		case FWebSocketRawClient::EResult::Frame:
+			if (!ProcessRawFrame())
+			{
+				return false;
+			}
+			break;
+		}
+	}
+}
+
+bool FWebSocketConnection::ProcessRawFrame()
+{
+	FWebSocketRawState& raw = *mRaw;
+	switch (raw.Client.Opcode)
+	{
+	case WEBSOCKET_OPCODE_TEXT:
+	case WEBSOCKET_OPCODE_BINARY:
+		raw.bMessageBinary = (raw.Client.Opcode == WEBSOCKET_OPCODE_BINARY);
+		OnReceive((const char*)raw.Client.Payload, raw.Client.PayloadLen, raw.bMessageBinary, raw.Client.bFinal);
+		return true;
+
+	case WEBSOCKET_OPCODE_CONTINUATION:
+		OnReceive((const char*)raw.Client.Payload, raw.Client.PayloadLen, raw.bMessageBinary, raw.Client.bFinal);
+		return true;
+
+	case WEBSOCKET_OPCODE_PING:
+		QueueRawControl(WEBSOCKET_OPCODE_PONG, raw.Client.Payload, raw.Client.PayloadLen);
+		return true;
+
+	case WEBSOCKET_OPCODE_PONG:
+		OnPong();
+		return true;
+
+	case WEBSOCKET_OPCODE_CLOSE:
+		if (raw.Client.PayloadLen >= 2)
+		{
+			UE_LOG(WebSocket, Log, TEXT("websocket: peer closed with code %d"), (raw.Client.Payload[0] << 8) | raw.Client.Payload[1]);
+		}
+
+		// our own close was answered, otherwise the code is echoed before the socket goes down
+		if (raw.bCloseSent)
+		{
+			return false;
+		}
+		raw.bCloseReceived = true;
+		QueueRawControl(WEBSOCKET_OPCODE_CLOSE, raw.Client.Payload, FMath::Min(raw.Client.PayloadLen, 2));
+		return true;
+
+	default:
+		UE_LOG(WebSocket, Error, TEXT("websocket: ws+unix unknown opcode %d"), raw.Client.Opcode);
+		return false;
+	}
+}
+
+void FWebSocketConnection::QueueRawControl(uint8 opcode, const uint8* data, int32 len)
+{
+	TPair<uint8, FWebSocketOutMessage> control;
+	control.Key = opcode;
+	WebSocketMakeOutMessage(data, len, true, control.Value);
+	mRaw->Control.Add(MoveTemp(control));
+
+	mbWriteRequested = true;
+	lws_callback_on_writable(mlws);
+}
+
+void FWebSocketConnection::WriteRawFrame(FWebSocketOutMessage& msg, uint8 opcode, bool bFinal)
+{
+	uint8* pPayload = msg.Payload.GetData() + LWS_PRE;
+	int32 iLen = msg.Payload.Num() - LWS_PRE;
+	int32 iHeader = mRaw->Client.WriteFrameHeader(pPayload, iLen, opcode, bFinal);
+	lws_write(mlws, pPayload - iHeader, iHeader + iLen, LWS_WRITE_HTTP);
+}
+
+void FWebSocketConnection::OnRawClosed()
+{
+	if (!mbEstablished)
+	{
+		OnConnectError(TEXT("unix socket closed during the handshake"));
+		return;
+	}
+
+	OnClosed();
+}
+#endif
+
+void FWebSocketConnection::WriteMessage(FWebSocketOutMessage& msg)
+{
+	// accepted connections write a shared frame as it is: server frames are not masked and the server vhost has
+	// no extensions, so the header lws writes into the LWS_PRE room is the same for every recipient. clients
+	// mask the payload in place, they write a copy in mWriteScratch that keeps its allocation
+	if (msg.Shared.IsValid() && !mbAccepted)
+	{
+		mWriteScratch.Reset();
+		mWriteScratch.Append(*msg.Shared);
+		FWebSocketOutMessage copy;
+		copy.bBinary = msg.bBinary;
+		Swap(copy.Payload, mWriteScratch);
+		WriteMessage(copy);
+		Swap(copy.Payload, mWriteScratch);
+		return;
+	}
+
+	TArray<uint8>& frame = msg.GetFrame();
+	if (IsPacing())
+	{
+		mPacer->OnSent(frame.Num() - LWS_PRE);
+	}
+
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	if (mbRaw)
+	{
+		WriteRawFrame(msg, msg.bBinary ? WEBSOCKET_OPCODE_BINARY : WEBSOCKET_OPCODE_TEXT);
+		return;
+	}
+#endif
+
+	lws_write(mlws, frame.GetData() + LWS_PRE, frame.Num() - LWS_PRE, msg.bBinary ? LWS_WRITE_BINARY : LWS_WRITE_TEXT);
+}
+
+void FWebSocketConnection::WriteFragment(FWebSocketOutMessage& msg, bool bFirst, bool bFinal)
+{
+	if (IsPacing())
+	{
+		mPacer->OnSent(msg.Payload.Num() - LWS_PRE);
+	}
+
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	if (mbRaw)
+	{
+		WriteRawFrame(msg, bFirst ? WEBSOCKET_OPCODE_BINARY : WEBSOCKET_OPCODE_CONTINUATION, bFinal);
+		return;
+	}
+#endif
+
+	int iProtocol = bFirst ? LWS_WRITE_BINARY : LWS_WRITE_CONTINUATION;
+	if (!bFinal)
+	{
+		iProtocol |= LWS_WRITE_NO_FIN;
+	}
+	lws_write(mlws, msg.Payload.GetData() + LWS_PRE, msg.Payload.Num() - LWS_PRE, (enum lws_write_protocol)iProtocol);
+}
+
+void FWebSocketConnection::WriteTransfer(double now, bool bStartMessage)
+{
+	if (!mTransfers.IsValid() || (!bStartMessage && !IsTransferMidMessage()))
+	{
+		return;
+	}
+
+	const UWebSocketSettings* pSettings = mContext->GetSettings();
+	TSharedPtr<FWebSocketOutTransfer, ESPMode::ThreadSafe>& out = mTransfers->Out;
+	while (CanWrite(now))
+	{
+		if (!out.IsValid() && !mTransfers->Queue.Dequeue(out))
+		{
+			return;
+		}
+
+		bool bFirst = true;
+		bool bFinal = true;
+		WriteFragment(out->NextFrame(pSettings->TransferChunkBytes, pSettings->TransferMessageBytes, bFirst, bFinal), bFirst, bFinal);
+
+		if (out->IsDone())
+		{
+			ReportTransfer(out->GetInfo(), true, !out->IsFailed());
+			out.Reset();
+		}
+		else if (out->ShouldReport(now))
+		{
+			ReportTransfer(out->GetInfo(), false, false);
+		}
+
+		// one message per call, the other queues get their turn between them
+		if (bFinal)
+		{
+			return;
+		}
+	}
+}
+
+bool FWebSocketConnection::HasPendingTransfer() const
+{
+	return mTransfers.IsValid() && (mTransfers->Out.IsValid() || !mTransfers->Queue.IsEmpty());
+}
+
+void FWebSocketConnection::SetClock(const TSharedPtr<FWebSocketClock, ESPMode::ThreadSafe>& clock)
+{
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnService([self, clock]()
+	{
+		if (!self->mClock.IsValid())
+		{
+			if (!clock.IsValid())
+			{
+				return;
+			}
+			self->mClock = MakeUnique<FWebSocketClockExchange>();
+		}
+
+		self->mClock->Clock = clock;
+		self->mClock->Requests = 0;
+		self->mClock->bRequested = clock.IsValid();
+		if (clock.IsValid() && self->mlws != nullptr && self->mbEstablished)
+		{
+			self->mbWriteRequested = true;
+			lws_callback_on_writable(self->mlws);
+		}
+	});
+}
+
+void FWebSocketConnection::ScheduleClockRequest(double time)
+{
+	if (mClock->bTimerArmed)
+	{
+		return;
+	}
+	mClock->bTimerArmed = true;
+
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnServiceAt(time, [self]()
+	{
+		self->mClock->bTimerArmed = false;
+		if (self->mClock->Clock.IsValid() && self->mlws != nullptr && self->mbEstablished)
+		{
+			self->mClock->bRequested = true;
+			self->mbWriteRequested = true;
+			lws_callback_on_writable(self->mlws);
+		}
+	});
+}
+
+void FWebSocketConnection::WriteClock()
+{
+	// the send times are taken right before lws_write, our own queues do not count as network delay
+	// no frame on top of a partly written one, what is left goes out with the next writable
+	FWebSocketClockExchange& clock = *mClock;
+	FWebSocketOutMessage msg;
+	int32 iWritten = 0;
+	while (iWritten < clock.Replies.Num() && !IsChoked())
+	{
+		const TPair<int64, int64>& reply = clock.Replies[iWritten];
+		WebSocketMakeClockMessage(WEBSOCKET_CLOCK_RESPONSE, reply.Key, reply.Value, WebSocketServerClockUs(), msg);
+		WriteMessage(msg);
+		iWritten++;
+	}
+	clock.Replies.RemoveAt(0, iWritten, false);
+
+	if (IsChoked())
+	{
+		return;
+	}
+
+	if (!clock.bRequested || !clock.Clock.IsValid())
+	{
+		clock.bRequested = false;
+		return;
+	}
+
+	clock.bRequested = false;
+	WebSocketMakeClockMessage(WEBSOCKET_CLOCK_REQUEST, WebSocketLocalClockUs(), 0, 0, msg);
+	WriteMessage(msg);
+
+	// responses carry the send time, a lost one does not hold up the next request
+	const UWebSocketSettings* pSettings = mContext->GetSettings();
+	clock.Requests++;
+	ScheduleClockRequest(FPlatformTime::Seconds() + (clock.Requests < pSettings->ClockSyncBurst ? 0.05 : pSettings->ClockSyncInterval));
+}
+
+void FWebSocketConnection::SendPing()
+{
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnService([self]()
+	{
+		self->mbPingRequested = true;
+		if (self->mlws != nullptr && self->mbEstablished)
+		{
+			self->mbWriteRequested = true;
+			lws_callback_on_writable(self->mlws);
+		}
+	});
+}
+
+void FWebSocketConnection::WritePing()
+{
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	if (mbRaw)
+	{
+		FWebSocketOutMessage msg;
+		WebSocketMakeOutMessage(nullptr, 0, true, msg);
+		WriteRawFrame(msg, WEBSOCKET_OPCODE_PING);
+		return;
+	}
+#endif
+
+	uint8 ping[LWS_PRE + 1];
+	lws_write(mlws, ping + LWS_PRE, 0, LWS_WRITE_PING);
+}
+
+void FWebSocketConnection::OnPong()
+{
+	double dNow = FPlatformTime::Seconds();
+	if (IsPacing())
+	{
+		// the acknowledged bytes may have been all that held the queue back
+		mPacer->OnPong(dNow);
+		mbWriteRequested = true;
+		lws_callback_on_writable(mlws);
+	}
+
+	if (mPingSentTime <= 0.0)
+	{
+		return;
+	}
+
+	float fRttMs = (float)((dNow - mPingSentTime) * 1000.0);
+	mPingSentTime = 0.0;
+
+	FWebSocketConnection* pSelf = this;
+	PostToOwner([pSelf, fRttMs](FWebSocketConnectionOwner* pOwner)
+	{
+		pOwner->HandlePong(pSelf, fRttMs);
+	});
+}
+
+void FWebSocketConnection::SchedulePacedWrite(double time)
+{
+	if (mbPaceTimerArmed)
+	{
+		return;
+	}
+	mbPaceTimerArmed = true;
+
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnServiceAt(time, [self]()
+	{
+		self->mbPaceTimerArmed = false;
+		if (self->mlws != nullptr && self->mbEstablished)
+		{
+			self->mbWriteRequested = true;
+			lws_callback_on_writable(self->mlws);
+		}
+	});
+}
+
+bool FWebSocketConnection::IsChoked() const
+{
+	// lws keeps the rest of a partial write and refuses new frames until the socket drained it
+	return lws_partial_buffered(mlws) != 0;
+}
+
+bool FWebSocketConnection::CanWrite(double now)
+{
+	return !IsChoked() && (!IsPacing() || mPacer->CanSend(now));
+}
+
+bool FWebSocketConnection::OnWriteable()
+{
+	mbWriteRequested = false;
+
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	if (mbRaw)
+	{
+		FWebSocketRawState& raw = *mRaw;
+
+		// the upgrade request goes first, frames wait for the server's 101
+		if (!mbEstablished)
+		{
+			if (mbClosing)
+			{
+				return false;
+			}
+
+			if (!raw.bHandshakeSent)
+			{
+				raw.bHandshakeSent = true;
+				lws_write(mlws, raw.Handshake.Payload.GetData() + LWS_PRE, raw.Handshake.Payload.Num() - LWS_PRE, LWS_WRITE_HTTP);
+				raw.Handshake.Payload.Empty();
+			}
+			return true;
+		}
+
+		// nothing follows our close frame
+		if (raw.bCloseSent)
+		{
+			return true;
+		}
+
+		// one frame on top of a partly written one is refused like on the lws path, the rest waits a writable
+		int32 iWritten = 0;
+		while (iWritten < raw.Control.Num() && !IsChoked())
+		{
+			WriteRawFrame(raw.Control[iWritten].Value, raw.Control[iWritten].Key);
+			iWritten++;
+		}
+		raw.Control.RemoveAt(0, iWritten, false);
+		if (raw.Control.Num() > 0)
+		{
+			mbWriteRequested = true;
+			lws_callback_on_writable(mlws);
+			return true;
+		}
+
+		// the echoed close is out, lws drops the socket
+		if (raw.bCloseReceived)
+		{
+			return false;
+		}
+	}
+#endif
+
+	double dNow = FPlatformTime::Seconds();
+
+	// no other data frame may go out between the fragments of a started transfer message
+	WriteTransfer(dNow, false);
+	if (!IsTransferMidMessage())
+	{
+		// clock frames first, so they are not stuck behind the queued messages in the socket buffer
+		if (mClock.IsValid() && (mClock->bRequested || mClock->Replies.Num() > 0) && !IsChoked())
+		{
+			WriteClock();
+		}
+
+		FWebSocketOutMessage msg;
+		while (CanWrite(dNow) && mSendQueue.Dequeue(msg))
+		{
+			WriteMessage(msg);
+		}
+
+		// frames encoded by the codec workers are always queued behind the plain ones
+		if (mCodecPipeline.IsValid())
+		{
+			while (CanWrite(dNow) && mCodecPipeline->PopEncoded(msg))
+			{
+				WriteMessage(msg);
+			}
+		}
+
+		// higher priority channels first, a congested socket leaves the low priority ones waiting
+		for (int32 i = 0; mChannels.IsValid() && i < mChannels->Num(); i++)
+		{
+			const TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>& it = (*mChannels)[i];
+			while (!it->bPausedByPeer && CanWrite(dNow) && it->SendQueue.Dequeue(msg))
+			{
+				int32 iLen = msg.Payload.Num() - LWS_PRE;
+				WriteMessage(msg);
+				it->QueuedBytes.Subtract(iLen);
+				it->SentMessages.Increment();
+				it->SentBytes.Add(iLen - WEBSOCKET_CHANNEL_HEADER_SIZE);
+			}
+		}
+
+		// files last, one message of them per writable
+		WriteTransfer(dNow, true);
+	}
+
+	bool bChoked = IsChoked();
+	bool bPaced = false;
+	if (bChoked)
+	{
+		mbWriteRequested = true;
+		lws_callback_on_writable(mlws);
+	}
+	else
+	{
+		// the ping goes behind what was just written, its pong acknowledges all of it
+		bool bPacerPing = IsPacing() && mPacer->ShouldPing(dNow);
+		if (bPacerPing || mbPingRequested)
+		{
+			WritePing();
+			if (bPacerPing)
+			{
+				mPacer->OnPingSent(dNow);
+			}
+			if (mbPingRequested)
+			{
+				mbPingRequested = false;
+				mPingSentTime = dNow;
+			}
+		}
+
+		bPaced = IsPacing() && !mPacer->CanSend(dNow);
+		if (bPaced)
+		{
+			SchedulePacedWrite(mPacer->OnBlocked(dNow));
+		}
+		else if (HasPendingTransfer())
+		{
+			mbWriteRequested = true;
+			lws_callback_on_writable(mlws);
+		}
+		else if (IsPacing())
+		{
+			mPacer->OnAppLimited();
+		}
+	}
+
+	if (mbClosing)
+	{
+		// a finishing encode job or the pacing timer asks for another writable, the deadline is checked then
+		// a channel the peer paused only wakes us with its resume, the deadline is checked on a timer then
+		bool bChannelsQueued = mChannels.IsValid() && mChannels->ContainsByPredicate([](const TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>& it)
+		{
+			return !it->SendQueue.IsEmpty();
+		});
+		bool bDrained = !bChoked && !bPaced && !bChannelsQueued && !HasPendingTransfer() && (!mCodecPipeline.IsValid() || !mCodecPipeline->HasPendingEncode());
+		if (!bDrained && FPlatformTime::Seconds() < mCloseDeadline)
+		{
+			if (bChannelsQueued && !bChoked)
+			{
+				SchedulePacedWrite(mCloseDeadline);
+			}
+			return true;
+		}
+
+		if (!bDrained)
+		{
+			UE_LOG(WebSocket, Warning, TEXT("websocket: close drain timeout, dropping queued messages"));
+		}
+
+#if WITH_WEBSOCKET_UNIX_SOCKET
+		if (mbRaw)
+		{
+			// the peer's close frame ends the connection, PENDING_TIMEOUT_CLOSE_ACK if it never comes
+			std::string strRawReason = TCHAR_TO_UTF8(*mCloseReason);
+			TArray<uint8> payload;
+			payload.Add((uint8)(mCloseCode >> 8));
+			payload.Add((uint8)(mCloseCode & 0xff));
+			payload.Append((const uint8*)strRawReason.c_str(), FMath::Min<int32>((int32)strRawReason.size(), 123));
+
+			FWebSocketOutMessage closeMsg;
+			WebSocketMakeOutMessage(payload.GetData(), payload.Num(), true, closeMsg);
+			WriteRawFrame(closeMsg, WEBSOCKET_OPCODE_CLOSE);
+			mRaw->bCloseSent = true;
+			lws_set_timeout(mlws, PENDING_TIMEOUT_CLOSE_ACK, 5);
+			return true;
+		}
+#endif
+
+		// the close frame goes out when the callback returns -1, lws then waits for the peer's close
+		std::string strReason = TCHAR_TO_UTF8(*mCloseReason);
+		lws_close_reason(mlws, (enum lws_close_status)mCloseCode, (unsigned char*)strReason.c_str(), FMath::Min<size_t>(strReason.size(), 123));
+		return false;
+	}
+
+	return true;
+}
+
+void FWebSocketConnection::Release()
+{
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	if (mbRaw && mlws != nullptr)
+	{
+		mContext->RemoveRawConnection(mlws);
+	}
+#endif
+	mlws = nullptr;
+	mbEstablished = false;
+	mContext->RemoveConnection(AsShared());
+}
+#endif
@@ -0,0 +1,312 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Templates/Atomic.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "UObject/WeakObjectPtr.h"
+#include "WebSocketBase.h"
+#include "WebSocketChannel.h"
+#include "WebSocketRawTransport.h"
+#include "WebSocketPacer.h"
+#include "WebSocketTransfer.h"
+#include "WebSocketPool.h"
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+struct lws;
+class UWebSocketContext;
+class FWebSocketCodecPipeline;
+class FWebSocketDictionaryCodec;
+class FWebSocketClock;
+struct FWebSocketCachedFrame;
+
+/** run on the game thread, right away when already there */
+void WebSocketRunOnGameThread(TFunction<void()>&& fn);
+
+/** ws, wss or ws+unix uri split into what FWebSocketConnection::OpenUri needs */
+struct FWebSocketUri
+{
+	FString Address;
+	FString Host;
+	FString Path;
+	int32 Port;
+	int32 UseSSL;
+	bool bUnix;
+
+	FWebSocketUri() :Port(80), UseSSL(0), bUnix(false) {}
+
+	/** false for an uri this platform can not connect to */
+	static bool Parse(const FString& uri, FWebSocketUri& out);
+};
+
+/*
+ * the state of the optional features lives outside FWebSocketConnection, a connection allocates what it uses.
+ * an idle pooled connection only pays for the pointers
+ */
+
+/** clock frames, from SetClock or an accepted connection that serves the clock. service thread */
+struct FWebSocketClockExchange
+{
+	/** client side of the exchange, and the requests a server answers with the time they arrived */
+	TSharedPtr<FWebSocketClock, ESPMode::ThreadSafe> Clock;
+	bool bRequested;
+	bool bTimerArmed;
+	int32 Requests;
+	bool bServe;
+	TArray<TPair<int64, int64>> Replies;
+
+	FWebSocketClockExchange() :bRequested(false), bTimerArmed(false), Requests(0), bServe(false) {}
+};
+
+/** files, from the first SendTransfer or SetTransferDirectory. service thread */
+struct FWebSocketTransferState
+{
+	/** one file goes out at a time, any number come in */
+	TSharedPtr<FWebSocketOutTransfer, ESPMode::ThreadSafe> Out;
+	TQueue<TSharedPtr<FWebSocketOutTransfer, ESPMode::ThreadSafe>, EQueueMode::Spsc> Queue;
+	TMap<uint16, TUniquePtr<FWebSocketInTransfer>> In;
+	FString Directory;
+	/** a DATA message whose fragments go to disk as they arrive, RecvStream is null when it is dropped */
+	bool bRecvStreaming;
+	FWebSocketInTransfer* RecvStream;
+
+	FWebSocketTransferState() :bRecvStreaming(false), RecvStream(nullptr) {}
+};
+
+/** decode jobs run one after the other, each depends on the previous one. from the first SetDecoder, any thread */
+struct FWebSocketDecodeChain
+{
+	FCriticalSection Lock;
+	TSharedPtr<IWebSocketMessageDecoder, ESPMode::ThreadSafe> Decoder;
+	FGraphEventRef LastDecode;
+};
+
+#if WITH_WEBSOCKET_UNIX_SOCKET
+/** ws+unix, the wsi is a raw socket and Client does the websocket part. from OpenUnix, service thread */
+struct FWebSocketRawState
+{
+	FWebSocketRawClient Client;
+	FWebSocketOutMessage Handshake;
+	bool bHandshakeSent;
+	bool bMessageBinary;
+	bool bCloseSent;
+	bool bCloseReceived;
+	TArray<TPair<uint8, FWebSocketOutMessage>> Control;
+
+	FWebSocketRawState() :bHandshakeSent(false), bMessageBinary(false), bCloseSent(false), bCloseReceived(false) {}
+};
+#endif
+
+/**
+ * lws side of a UWebSocketBase or of an FWebSocketPool slot. the wsi user pointer points here instead of the UObject, so the
+ * service thread never touches an object the GC may be destroying; the context keeps the connection
+ * alive until lws closed the wsi. members under "service thread" are only used by the thread that
+ * runs lws_service, everything else is safe from any thread.
+ */
+class FWebSocketConnection : public TSharedFromThis<FWebSocketConnection, ESPMode::ThreadSafe>
+{
+public:
+
+	FWebSocketConnection(UWebSocketContext* context, UWebSocketBase* owner, const TSharedRef<FWebSocketInbox, ESPMode::ThreadSafe>& inbox);
+	~FWebSocketConnection();
+
+	/** game thread, before Open. a pooled connection posts its events to the pool instead of a UWebSocketBase */
+	void SetPool(const TSharedRef<FWebSocketPool, ESPMode::ThreadSafe>& pool, FWebSocketHandle handle);
+	FWebSocketHandle GetPoolHandle() const { return mPoolHandle; }
+
+	/** game thread */
+	void SetCodec(const TSharedRef<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe>& codec);
+	bool Open(const FString& address, int32 port, int32 iUseSSL, const FString& path, const FString& host, const TMap<FString, FString>& header, int32 protocolIndex);
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	bool OpenUnix(const FString& socketPath, const FString& path, const TMap<FString, FString>& header, int32 protocolIndex);
+#endif
+	bool OpenUri(const FWebSocketUri& uri, const TMap<FString, FString>& header, int32 protocolIndex);
+	void SendText(const FString& data);
+	void SendBinary(const TArray<uint8>& data);
+	void SendDurable(uint64 sequence, const uint8* data, int32 len, bool bBinary);
+	void SendTransfer(const TSharedRef<FWebSocketOutTransfer, ESPMode::ThreadSafe>& transfer);
+
+	/** broadcast frame of UWebSocketServer, the same buffer is queued on every recipient */
+	void SendShared(const TSharedRef<TArray<uint8>, ESPMode::ThreadSafe>& frame, bool bBinary);
+
+	/** frame of UWebSocketContext::RegisterFrame, queued by reference */
+	void SendFrame(const FWebSocketCachedFrame& frame);
+
+	/** an accepted connection gets its owner once the game thread created it, events before are held back */
+	void SetOwner(UWebSocketBase* owner);
+	TSharedRef<FWebSocketInbox, ESPMode::ThreadSafe> GetInbox() const { return mInbox; }
+	void Close(int32 code, const FString& reason, float drainTimeout);
+
+	bool IsAlive() const { return mbAlive; }
+
+	/** a standby drops what it receives until it is promoted to the owner's connection */
+	void SetStandby(bool bStandby) { mbStandby = bStandby; }
+	bool IsStandby() const { return mbStandby; }
+
+	/** text messages stay validated utf-8 for native receive handlers instead of becoming an FString */
+	void SetTextAsUtf8(bool bUtf8) { mbTextAsUtf8 = bUtf8; }
+	bool IsTextAsUtf8() const { return mbTextAsUtf8; }
+
+	/** messages go through decoder on task graph workers before the inbox, null stops decoding */
+	void SetDecoder(const TSharedPtr<IWebSocketMessageDecoder, ESPMode::ThreadSafe>& decoder);
+
+	/** the owner has a durable lane, acks reach UWebSocketBase::HandleDurableAck */
+	void SetDurable(bool bDurable) { mbDurable = bDurable; }
+
+	/** received transfers are written below directory, empty drops them */
+	void SetTransferDirectory(const FString& directory);
+
+	/** exchange clock frames with the server and feed clock, after every connect a burst first. null stops */
+	void SetClock(const TSharedPtr<FWebSocketClock, ESPMode::ThreadSafe>& clock);
+
+	/** websocket ping, the pong reaches UWebSocketBase::HandlePong with the rtt */
+	void SendPing();
+	FWebSocketPacingStats GetPacingStats() const { return mPacer.IsValid() ? mPacer->GetStats() : FWebSocketPacingStats(); }
+
+	/** any thread */
+	void RequestWrite();
+	void EnqueueReceived(TArray<uint8>&& data);
+
+	/** validate a text message and queue it as FString or utf-8, invalid text closes with 1007 */
+	void ReceiveText(const uint8* data, int32 len, int32 wireBytes);
+	void ReleaseRxBytes(int32 len);
+
+	/** channels are written in priority order after the plain messages */
+	void AddChannel(const TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>& channel);
+	void ReleaseChannelBytes(const TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>& channel, int32 len);
+
+	/** service thread, a server vhost accepted wsi. the connection is established right away */
+	void Accept(struct lws* wsi);
+
+	/** service thread, from UWebSocketContext::callback_echo and FWebSocketServerHost::callback_server */
+	bool OnAppendHeader(struct lws* wsi, unsigned char** p, unsigned char* end);
+	void OnEstablished(int32 protocolIndex = INDEX_NONE);
+	void OnConnectError(const FString& error);
+	void OnClosed();
+	void OnReceive(const char* in, int len, bool bBinary, bool bFinal);
+	bool OnWriteable();
+	void OnPong();
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	bool OnRawReceive(const uint8* in, int32 len);
+	void OnRawClosed();
+#endif
+
+private:
+
+	bool OpenOnService(const FString& address, int32 port, int32 iUseSSL, const FString& path, const FString& host, int32 protocolIndex);
+	void ProcessMessage(const uint8* data, int32 len, bool bBinary);
+	void ProcessChannelFrame(const uint8* data, int32 len);
+	void ProcessDurableFrame(const uint8* data, int32 len);
+	void ProcessTransferFrame(const uint8* data, int32 len);
+	void ProcessClockFrame(const uint8* data, int32 len);
+	void ReceiveTransferFragment(const uint8* data, int32 len, bool bFinal);
+	void ReportTransfer(const FWebSocketTransfer& info, bool bComplete, bool bSuccess);
+	void SendChannelControl(uint16 channel, uint8 type);
+	void EnqueueReceived(FWebSocketInMessage&& msg);
+	bool IsDecoding();
+	void DecodeReceived(FWebSocketInMessage&& msg);
+	bool IsChoked() const;
+	bool IsPacing() const { return mPacer.IsValid() && mPacer->IsEnabled(); }
+	bool CanWrite(double now);
+	void WriteMessage(FWebSocketOutMessage& msg);
+	void WriteFragment(FWebSocketOutMessage& msg, bool bFirst, bool bFinal);
+	FWebSocketTransferState& GetTransfers();
+	bool AcceptsTransfers() const { return mTransfers.IsValid() && mTransfers->Directory.Len() > 0; }
+	bool IsTransferMidMessage() const { return mTransfers.IsValid() && mTransfers->Out.IsValid() && mTransfers->Out->IsMidMessage(); }
+	void WriteTransfer(double now, bool bStartMessage);
+	bool HasPendingTransfer() const;
+	void AbortTransfers();
+	void WritePing();
+	bool UsesClock() const { return mClock.IsValid() && (mClock->Clock.IsValid() || mClock->bServe); }
+	void WriteClock();
+	void ScheduleClockRequest(double time);
+	void SchedulePacedWrite(double time);
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	bool OpenUnixOnService(const FString& socketPath, const FString& path, int32 protocolIndex);
+	bool ProcessRawFrame();
+	void QueueRawControl(uint8 opcode, const uint8* data, int32 len);
+	void WriteRawFrame(FWebSocketOutMessage& msg, uint8 opcode, bool bFinal = true);
+#endif
+	void AddRxBytes(int32 len);
+	void ScheduleDelivery();
+	void Release();
+
+	/** run fn on the game thread with the owner or the pool, dropped when both are gone */
+	void PostToOwner(TFunction<void(FWebSocketConnectionOwner*)>&& fn);
+
+	UWebSocketContext* mContext;
+	TWeakObjectPtr<UWebSocketBase> mOwner;
+	TWeakPtr<FWebSocketPool, ESPMode::ThreadSafe> mPool;
+	FWebSocketHandle mPoolHandle;
+	TSharedRef<FWebSocketInbox, ESPMode::ThreadSafe> mInbox;
+	TSharedPtr<FWebSocketCodecPipeline, ESPMode::ThreadSafe> mCodecPipeline;
+	/** extra upgrade headers, dropped once the handshake is done */
+	TUniquePtr<TMap<FString, FString>> mHeaderMap;
+
+	TQueue<FWebSocketOutMessage, EQueueMode::Mpsc> mSendQueue;
+	FThreadSafeBool mbWriteRequested;
+	FThreadSafeBool mbAlive;
+	FThreadSafeBool mbStandby;
+	FThreadSafeBool mbDurable;
+	FThreadSafeBool mbTextAsUtf8;
+
+	/** set once and kept until the connection goes, without it nothing is decoded and no lock is taken */
+	TAtomic<FWebSocketDecodeChain*> mDecodeChain;
+
+	/** created with the connection when the context paces its sends */
+	TUniquePtr<FWebSocketPacer> mPacer;
+
+	/** service thread */
+	struct lws* mlws;
+	bool mbEstablished;
+	bool mbBinaryPayload;
+	/** the negotiated protocol speaks the plugin's binary frames, without it every binary message is the owner's */
+	bool mbPluginFrames;
+	TUniquePtr<TArray<TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>>> mChannels;
+	TArray<uint8> mRecvBuffer;
+	bool mbClosing;
+	int32 mCloseCode;
+	FString mCloseReason;
+	double mCloseDeadline;
+	bool mbPaceTimerArmed;
+	bool mbPingRequested;
+	double mPingSentTime;
+
+	TUniquePtr<FWebSocketClockExchange> mClock;
+	TUniquePtr<FWebSocketTransferState> mTransfers;
+
+	/** accepted by a server vhost, its frames are not masked */
+	bool mbAccepted;
+	TArray<uint8> mWriteScratch;
+
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	bool mbRaw;
+	TUniquePtr<FWebSocketRawState> mRaw;
+#endif
+};
+#endif
@@ -24,34 +24,23 @@
 #include "WebSocketContext.h"
 #include "UObjectGlobals.h"
 #include "WebSocketBase.h"
+#include "WebSocketConnection.h"
+#include "WebSocketServer.h"
+#include "WebSocketSettings.h"
 #include "Paths.h"
 #include "FileManager.h"
 #include "FileHelper.h"
 #include "Kismet/KismetSystemLibrary.h"
 #include "Misc/Base64.h"
+#include "Async/Async.h"
 #include <fstream>
 
 #define MAX_PAYLOAD	64*1024
 
-extern TSharedPtr<UWebSocketContext> s_websocketCtx;
 
 #if PLATFORM_UWP
 #elif PLATFORM_HTML5
 #else
-static struct lws_protocols protocols[] = {
-	/* first protocol must always be HTTP handler */
-
-	{
-		"",		/* name - can be overridden with -e */
-		UWebSocketContext::callback_echo,
-		0,
-		MAX_PAYLOAD,
-	},
-	{
-		NULL, NULL, 0		/* End of list */
-	}
-};
-
 static const struct lws_extension exts[] = {
 	{
 		"permessage-deflate",
@@ -67,6 +56,30 @@ static const struct lws_extension exts[] = {
 };
 #endif
 
+extern char g_caArray[];
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+static TArray<uint8> DecodeBundledCA()
+{
+	double dStart = FPlatformTime::Seconds();
+
+	TArray<uint8> pem;
+	FBase64::Decode(FString(ANSI_TO_TCHAR(g_caArray)), pem);
+
+	UE_LOG(WebSocket, Log, TEXT("websocket: decoded ca bundle, %d bytes in %.2f ms"), pem.Num(), (FPlatformTime::Seconds() - dStart) * 1000.0);
+	return pem;
+}
+
+/** the bundle is decoded once per process, later contexts reuse it */
+static const TArray<uint8>& GetBundledCA()
+{
+	static TArray<uint8> s_bundledCA = DecodeBundledCA();
+	return s_bundledCA;
+}
+#endif
+
 void UWebSocketContext::BeginDestroy()
 {
 	Super::BeginDestroy();
@@ -82,38 +95,54 @@ UWebSocketContext::~UWebSocketContext()
 #else
 int UWebSocketContext::callback_echo(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len)
 {
-	void* pUser = lws_wsi_user(wsi);
-	UWebSocketBase* pWebSocketBase = (UWebSocketBase*)pUser;
+	FWebSocketConnection* pConnection = (FWebSocketConnection*)lws_wsi_user(wsi);
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	if (pConnection == nullptr && reason >= LWS_CALLBACK_RAW_RX && reason <= LWS_CALLBACK_RAW_ADOPT)
+	{
+		FWebSocketLwsContext* pLws = (FWebSocketLwsContext*)lws_context_user(lws_get_context(wsi));
+		UWebSocketContext* pContext = pLws != nullptr ? pLws->GetOwner() : nullptr;
+		pConnection = pContext != nullptr ? pContext->FindRawConnection(wsi) : nullptr;
+	}
+#endif
+
+	// closing drops the context's reference, keep the connection alive until the callback returned
+	TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe> keepAlive;
+	if (pConnection != nullptr)
+	{
+		keepAlive = pConnection->AsShared();
+	}
+
+	if (reason == LWS_CALLBACK_CLIENT_ESTABLISHED || reason == LWS_CALLBACK_CLIENT_RECEIVE || reason == LWS_CALLBACK_CLIENT_WRITEABLE
+		|| reason == LWS_CALLBACK_RAW_RX || reason == LWS_CALLBACK_RAW_WRITEABLE)
+	{
+		NoteServiceActivity(wsi);
+	}
 
 	switch (reason)
 	{
 	case LWS_CALLBACK_CLOSED:
-		if (!pWebSocketBase) return -1;
-		pWebSocketBase->Cleanlws();
-		pWebSocketBase->OnClosed.Broadcast();
+		if (!pConnection) return -1;
+		pConnection->OnClosed();
+		lws_set_wsi_user(wsi, NULL);
 		break;
 
 	case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
-	{
-		if (!pWebSocketBase) return -1;
-		FString strError = UTF8_TO_TCHAR(in);
-		UE_LOG(WebSocket, Error, TEXT("libwebsocket connect error:%s"), *strError);
-		pWebSocketBase->Cleanlws();
-		pWebSocketBase->OnConnectError.Broadcast(strError);
-	}
+		if (!pConnection) return -1;
+		pConnection->OnConnectError(in ? UTF8_TO_TCHAR(in) : TEXT("connect error"));
+		lws_set_wsi_user(wsi, NULL);
 		break;
 
 	case LWS_CALLBACK_CLIENT_ESTABLISHED:
-		if (!pWebSocketBase) return -1;
-		pWebSocketBase->OnConnectComplete.Broadcast();
+		if (!pConnection) return -1;
+		pConnection->OnEstablished();
 		break;
 
 	case LWS_CALLBACK_CLIENT_APPEND_HANDSHAKE_HEADER:
 	{
-		if (!pWebSocketBase) return -1;
+		if (!pConnection) return -1;
 
 		unsigned char **p = (unsigned char **)in, *end = (*p) + len;
-		if (!pWebSocketBase->ProcessHeader(p, end))
+		if (!pConnection->OnAppendHeader(wsi, p, end))
 		{
 			return -1;
 		}
@@ -121,13 +150,67 @@ int UWebSocketContext::callback_echo(struct lws *wsi, enum lws_callback_reasons
 		break;
 
 	case LWS_CALLBACK_CLIENT_RECEIVE:
-		if (!pWebSocketBase) return -1;
-		pWebSocketBase->ProcessRead((const char*)in, (int)len);
+		if (!pConnection) return -1;
+		pConnection->OnReceive((const char*)in, (int)len, lws_frame_is_binary(wsi) != 0,
+			lws_is_final_fragment(wsi) && lws_remaining_packet_payload(wsi) == 0);
 		break;
 
 	case LWS_CALLBACK_CLIENT_WRITEABLE:
-		if (!pWebSocketBase) return -1;
-		pWebSocketBase->ProcessWriteable();
+		if (!pConnection) return -1;
+		if (!pConnection->OnWriteable())
+		{
+			return -1;
+		}
+		break;
+
+	case LWS_CALLBACK_CLIENT_RECEIVE_PONG:
+		if (pConnection)
+		{
+			pConnection->OnPong();
+		}
+		break;
+
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	case LWS_CALLBACK_RAW_RX:
+		if (!pConnection) return -1;
+		if (!pConnection->OnRawReceive((const uint8*)in, (int32)len))
+		{
+			return -1;
+		}
+		break;
+
+	case LWS_CALLBACK_RAW_WRITEABLE:
+		if (!pConnection) return -1;
+		if (!pConnection->OnWriteable())
+		{
+			return -1;
+		}
+		break;
+
+	case LWS_CALLBACK_RAW_CLOSE:
+		if (pConnection)
+		{
+			pConnection->OnRawClosed();
+		}
+		break;
+#endif
+
+	case LWS_CALLBACK_WS_PEER_INITIATED_CLOSE:
+		if (len >= 2)
+		{
+			const unsigned char* pCode = (const unsigned char*)in;
+			UE_LOG(WebSocket, Log, TEXT("websocket: peer closed with code %d"), (pCode[0] << 8) | pCode[1]);
+		}
+		break;
+
+	case LWS_CALLBACK_OPENSSL_LOAD_EXTRA_CLIENT_VERIFY_CERTS:
+	{
+		FWebSocketLwsContext* pLws = (FWebSocketLwsContext*)lws_context_user(lws_get_context(wsi));
+		if (pLws != nullptr)
+		{
+			pLws->InitClientSSL(user);
+		}
+	}
 		break;
 
 	default:
@@ -136,28 +219,117 @@ int UWebSocketContext::callback_echo(struct lws *wsi, enum lws_callback_reasons
 
 	return 0;
 }
+
+void FWebSocketLwsContext::InitClientSSL(void* sslCtx)
+{
+	WebSocketApplyTlsOptions(sslCtx, mTlsOptions);
+
+#if WITH_WEBSOCKET_OPENSSL
+	// straight into the X509 store, nothing touches the disk
+	if (mbUseBundledCA)
+	{
+		double dStart = FPlatformTime::Seconds();
+		int32 iCount = WebSocketLoadCABundle(sslCtx, GetBundledCA());
+		UE_LOG(WebSocket, Log, TEXT("websocket: loaded %d bundled ca certificates in %.2f ms"), iCount, (FPlatformTime::Seconds() - dStart) * 1000.0);
+	}
+
+	if (mbUseSystemTrustStore)
+	{
+		WebSocketUseSystemTrustStore(sslCtx);
+	}
+#endif
+
+	if (mbEnableTlsSessionCache)
+	{
+		mSessionCache.Attach(sslCtx);
+		if (mbPersistTlsSessions)
+		{
+			mSessionCache.SetPersistPath(FPaths::ProjectSavedDir() / TEXT("WebSocket") / TEXT("tls-sessions.bin"));
+		}
+	}
+}
 #endif
 
 UWebSocketContext::UWebSocketContext()
 {
+	mCtxState = ECtxState::None;
+	mCreateSeconds = 0.0;
+	mSettings = nullptr;
+	mServiceMode = EWebSocketServiceMode::Default;
+
 #if PLATFORM_UWP
 #elif PLATFORM_HTML5
 #else
+	mServiceRunnable = nullptr;
+	mServiceThread = nullptr;
+	mServiceThreadId = GGameThreadId;
 	mlwsContext = nullptr;
+	mFrameSends = 0;
+	mIdleTickPoll = 0.0;
+	mLastServiceActivity = 0.0;
+	mNextIdlePoll = 0.0;
+	mbServiceActive = false;
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	mlwsVhost = nullptr;
+#endif
 #endif
 }
 
-extern char g_caArray[];
-
-void UWebSocketContext::CreateCtx()
-{
 #if PLATFORM_UWP
 #elif PLATFORM_HTML5
 #else
+FWebSocketLwsContext::FWebSocketLwsContext(const UWebSocketSettings* settings)
+	:mSettingsProtocols(settings->Protocols), mTlsOptions(settings->TlsOptions), mbUseBundledCA(settings->bUseBundledCA), mbUseSystemTrustStore(settings->bUseSystemTrustStore),
+	mbEnableTlsSessionCache(settings->bEnableTlsSessionCache), mbPersistTlsSessions(settings->bPersistTlsSessions),
+	mDictionaryFile(settings->bEnableDictionaryCodec ? settings->DictionaryFile : FString()), mDictionaryVersion((uint16)settings->DictionaryVersion),
+	mCompressionLevel(settings->CompressionLevel), mMinCompressSize(settings->MinCompressSize), mOwner(nullptr), mlwsContext(nullptr),
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	mlwsVhost(nullptr),
+#endif
+	mCreateSeconds(0.0), mCreatedEvent(FPlatformProcess::GetSynchEventFromPool(true)), mbCreated(false), mbAbandoned(false)
+{
+}
+
+FWebSocketLwsContext::~FWebSocketLwsContext()
+{
+	Destroy();
+	FPlatformProcess::ReturnSynchEventToPool(mCreatedEvent);
+}
+
+void FWebSocketLwsContext::Destroy()
+{
+	if (mlwsContext != nullptr)
+	{
+		lws_context_destroy(mlwsContext);
+		mlwsContext = nullptr;
+	}
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	mlwsVhost = nullptr;
+#endif
+}
+
+bool FWebSocketLwsContext::WaitCreated(float timeout)
+{
+	mCreatedEvent->Wait(FTimespan::FromSeconds(FMath::Max(timeout, 0.0f)));
+
+	FScopeLock lock(&mCreateLock);
+	if (!mbCreated)
+	{
+		mbAbandoned = true;
+		return false;
+	}
+	return true;
+}
+
+void FWebSocketLwsContext::Create()
+{
+	double dStart = FPlatformTime::Seconds();
+
 	struct lws_context_creation_info info;
 	memset(&info, 0, sizeof info);
 
-	info.protocols = protocols;
+	BuildProtocols();
+	info.protocols = mProtocols.GetData();
 	info.ssl_cert_filepath = NULL;
 	info.ssl_private_key_filepath = NULL;
 
@@ -165,9 +337,117 @@ void UWebSocketContext::CreateCtx()
 	info.gid = -1;
 	info.uid = -1;
 	info.extensions = exts;
-	info.options = LWS_SERVER_OPTION_VALIDATE_UTF8;
-	info.options |= LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+	// no LWS_SERVER_OPTION_VALIDATE_UTF8, text is validated while WebSocketDecodeUtf8 converts it
+	info.options = LWS_SERVER_OPTION_DO_SSL_GLOBAL_INIT;
+	info.user = this;
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	// the vhost is created by hand, ws+unix sockets are adopted into it
+	info.options |= LWS_SERVER_OPTION_EXPLICIT_VHOSTS;
+#endif
+
+#if !WITH_WEBSOCKET_OPENSSL
+	// without the openssl hooks lws can only read the bundle from disk
+	WriteCAFile();
+	info.ssl_ca_filepath = mstrCAPath.c_str();
+#endif
+	if (!mDictionaryFile.IsEmpty())
+	{
+		mDictionaryCodec = FWebSocketDictionaryCodec::Load(mDictionaryFile, mDictionaryVersion, mCompressionLevel, mMinCompressSize);
+	}
+	mlwsContext = lws_create_context(&info);
+	if (mlwsContext == nullptr)
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: create context fail"));
+	}
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	else
+	{
+		mlwsVhost = lws_create_vhost(mlwsContext, &info);
+		if (mlwsVhost == nullptr)
+		{
+			UE_LOG(WebSocket, Error, TEXT("websocket: create vhost fail"));
+			lws_context_destroy(mlwsContext);
+			mlwsContext = nullptr;
+		}
+	}
+#endif
+
+	mCreateSeconds = FPlatformTime::Seconds() - dStart;
+	UE_LOG(WebSocket, Log, TEXT("websocket: context created in %.2f ms"), mCreateSeconds * 1000.0);
+
+	// a shutdown that gave up waiting will never adopt it
+	FScopeLock lock(&mCreateLock);
+	mbCreated = true;
+	if (mbAbandoned)
+	{
+		Destroy();
+	}
+	mCreatedEvent->Trigger();
+}
+
+void FWebSocketLwsContext::BuildProtocols()
+{
+	// the unnamed protocol comes first, lws falls back to it when the server does not pick a subprotocol
+	FWebSocketProtocolConfig defaultProtocol;
+	defaultProtocol.RxBufferSize = MAX_PAYLOAD;
+
+	mProtocolConfigs.Reset();
+	mProtocolConfigs.Add(defaultProtocol);
+	for (const FWebSocketProtocolConfig& it : mSettingsProtocols)
+	{
+		bool bDuplicate = mProtocolConfigs.ContainsByPredicate([&it](const FWebSocketProtocolConfig& other)
+		{
+			return other.Name.Equals(it.Name, ESearchCase::CaseSensitive);
+		});
+		if (it.Name.IsEmpty() || bDuplicate)
+		{
+			UE_LOG(WebSocket, Warning, TEXT("websocket: skipped unnamed or duplicate protocol '%s'"), *it.Name);
+			continue;
+		}
+
+		mProtocolConfigs.Add(it);
+	}
+
+	// all names are in place before lws_protocols points into them
+	mProtocolNames.Reset(mProtocolConfigs.Num());
+	for (const FWebSocketProtocolConfig& it : mProtocolConfigs)
+	{
+		mProtocolNames.Emplace(TCHAR_TO_UTF8(*it.Name));
+	}
+
+	mProtocols.Reset(mProtocolConfigs.Num() + 1);
+	for (int32 i = 0; i < mProtocolConfigs.Num(); i++)
+	{
+		struct lws_protocols protocol;
+		memset(&protocol, 0, sizeof(protocol));
+		protocol.name = mProtocolNames[i].c_str();
+		protocol.callback = UWebSocketContext::callback_echo;
+		protocol.rx_buffer_size = FMath::Max(mProtocolConfigs[i].RxBufferSize, 128);
+		protocol.id = (unsigned int)i;
+		mProtocols.Add(protocol);
+	}
 
+	// end of list
+	struct lws_protocols terminator;
+	memset(&terminator, 0, sizeof(terminator));
+	mProtocols.Add(terminator);
+}
+
+int32 UWebSocketContext::FindProtocol(const FString& name) const
+{
+	if (!mLws.IsValid())
+	{
+		return INDEX_NONE;
+	}
+
+	return mLws->GetProtocolConfigs().IndexOfByPredicate([&name](const FWebSocketProtocolConfig& it)
+	{
+		return it.Name.Equals(name, ESearchCase::CaseSensitive);
+	});
+}
+
+void FWebSocketLwsContext::WriteCAFile()
+{
 	FString PEMFilename = FPaths::ProjectSavedDir() / TEXT("ca-bundle.pem");
 	PEMFilename = IFileManager::Get().ConvertToAbsolutePathForExternalAppForRead(*PEMFilename);
 #if PLATFORM_ANDROID
@@ -175,32 +455,165 @@ void UWebSocketContext::CreateCtx()
 	PEMFilename = GExternalFilePath / TEXT("ca-bundle.pem");
 #endif
 	mstrCAPath = TCHAR_TO_UTF8(*PEMFilename);
-	std::ofstream f(mstrCAPath.c_str() );
+
+	// only rewrite the file when its content is stale
+	const TArray<uint8>& bundledCA = GetBundledCA();
+	if (IFileManager::Get().FileSize(*PEMFilename) == bundledCA.Num())
+	{
+		TArray<uint8> current;
+		if (FFileHelper::LoadFileToArray(current, *PEMFilename, FILEREAD_Silent) && current == bundledCA)
+		{
+			UE_LOG(LogInit, Log, TEXT(" websocket: PEM file is current: '%s'"), *PEMFilename);
+			return;
+		}
+	}
+
+	std::ofstream f(mstrCAPath.c_str(), std::ios::binary);
 	if (f.is_open())
 	{
-		FString strBase64CA(ANSI_TO_TCHAR(g_caArray) );
-		FString strCAContent;
-		FBase64::Decode(strBase64CA, strCAContent);
-		std::string strOriginCA = TCHAR_TO_UTF8(*strCAContent);
-		f.write(strOriginCA.c_str(), strOriginCA.size());
+		f.write((const char*)bundledCA.GetData(), bundledCA.Num());
 		f.close();
 	}
 	else
 	{
-		UE_LOG(LogInit, Log, TEXT(" websocket: fail open file: '%s'"), *PEMFilename);
-		UKismetSystemLibrary::PrintString(this, TEXT(" websocket: fail open file:") + PEMFilename, true, true, FLinearColor(0.0, 0.66, 1.0), 1000);
+		// may run on a worker thread, so no on screen message here
+		UE_LOG(LogInit, Error, TEXT(" websocket: fail open file: '%s'"), *PEMFilename);
 	}
-	
+
 	UE_LOG(LogInit, Log, TEXT(" websocket: using generated PEM file: '%s'"), *PEMFilename);
-	//UKismetSystemLibrary::PrintString(this, TEXT("full dir:") + PEMFilename, true, true, FLinearColor(0.0, 0.66, 1.0), 1000);
+}
+#endif
 
-	info.ssl_ca_filepath = mstrCAPath.c_str();
-	mlwsContext = lws_create_context(&info);
-	if (mlwsContext == nullptr)
+void UWebSocketContext::Configure(UWebSocketSettings* settings, EWebSocketServiceMode mode)
+{
+	if (mCtxState != ECtxState::None)
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: context already created, configure ignored"));
+		return;
+	}
+
+	mSettings = settings;
+	mServiceMode = mode;
+}
+
+void UWebSocketContext::CreateCtx()
+{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	mLws = MakeShareable(new FWebSocketLwsContext(GetSettings()));
+	mLws->Create();
+	AdoptCtx();
+#endif
+}
+
+void UWebSocketContext::CreateCtxAsync()
+{
+	if (mCtxState != ECtxState::None)
+	{
+		return;
+	}
+
+	mCtxState = ECtxState::Creating;
+
+#if PLATFORM_UWP
+	OnCtxCreated();
+#elif PLATFORM_HTML5
+	OnCtxCreated();
+#else
+	// openssl init, ca loading and lws_create_context stay off the game thread. the worker only
+	// sees the FWebSocketLwsContext, and the context is not serviced until OnCtxCreated adopted it
+	TSharedRef<FWebSocketLwsContext, ESPMode::ThreadSafe> lws = MakeShareable(new FWebSocketLwsContext(GetSettings()));
+	mLws = lws;
+
+	TWeakObjectPtr<UWebSocketContext> weakThis(this);
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [weakThis, lws]()
+	{
+		lws->Create();
+
+		AsyncTask(ENamedThreads::GameThread, [weakThis, lws]()
+		{
+			UWebSocketContext* pContext = weakThis.Get();
+			if (pContext != nullptr && pContext->mLws == lws && pContext->IsCreating())
+			{
+				pContext->OnCtxCreated();
+				return;
+			}
+
+			// collected or shut down meanwhile, nobody services this one
+			lws->Destroy();
+		});
+	});
+#endif
+}
+
+void UWebSocketContext::AdoptCtx()
+{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	mLws->SetOwner(this);
+	mlwsContext = mLws->GetLwsContext();
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	mlwsVhost = mLws->GetLwsVhost();
+#endif
+	mDictionaryCodec = mLws->GetDictionaryCodec();
+	mCreateSeconds = mLws->GetCreateSeconds();
+#endif
+}
+
+void UWebSocketContext::OnCtxCreated()
+{
+#if PLATFORM_UWP
+	mCtxState = ECtxState::Ready;
+#elif PLATFORM_HTML5
+	mCtxState = ECtxState::Ready;
+#else
+	AdoptCtx();
+	mCtxState = (mlwsContext != nullptr) ? ECtxState::Ready : ECtxState::Failed;
+#endif
+
+	if (mCtxState == ECtxState::Ready)
+	{
+		StartService();
+	}
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	for (auto& it : mFrames)
 	{
-		//UE_LOG(WebSocket, Error, TEXT("libwebsocket Init fail"));
+		EncodeFrame(it.Value);
 	}
 #endif
+
+	TArray<UWebSocketServer*> pendingListens = MoveTemp(mPendingListens);
+	for (UWebSocketServer* it : pendingListens)
+	{
+		if (mCtxState != ECtxState::Ready || !it->Listen(this, it->GetPort()))
+		{
+			it->HandleListenError(TEXT("websocket context create fail"));
+		}
+	}
+
+	TArray<FWebSocketPendingConnect> pending = MoveTemp(mPendingConnects);
+	for (FWebSocketPendingConnect& it : pending)
+	{
+		bool connectFail = true;
+		if (mCtxState == ECtxState::Ready && it.Endpoints.Num() > 0)
+		{
+			StartConnectEndpoints(it.Socket, it.Endpoints, it.Header, it.Protocol, it.bProbeOnly, connectFail);
+		}
+		else if (mCtxState == ECtxState::Ready)
+		{
+			StartConnect(it.Socket, it.Uri, it.Header, it.Protocol, connectFail);
+		}
+
+		if (connectFail)
+		{
+			it.Socket->OnConnectError.Broadcast(TEXT("websocket context create fail"));
+		}
+	}
 }
 
 void UWebSocketContext::Tick(float DeltaTime)
@@ -208,17 +621,38 @@ void UWebSocketContext::Tick(float DeltaTime)
 #if PLATFORM_UWP
 #elif PLATFORM_HTML5
 #else
-	if (mlwsContext != nullptr)
+	// the worker still owns the context while it is being created, and without connections there is nothing to poll
+	if (mCtxState != ECtxState::Creating && mlwsContext != nullptr && mServiceThread == nullptr)
 	{
-		lws_callback_on_writable_all_protocol(mlwsContext, &protocols[0]);
-		lws_service(mlwsContext, 0);
+		if (mConnectionCount.GetValue() > 0 || mListenerCount.GetValue() > 0 || !mServiceCommands.IsEmpty())
+		{
+			// idle sockets are polled every IdleTickPollMs instead of every frame, queued commands and due timers poll at once
+			double dNow = FPlatformTime::Seconds();
+			bool bDue = !mServiceCommands.IsEmpty() || (mServiceTimers.Num() > 0 && mServiceTimers.HeapTop().Time <= dNow);
+			if (bDue || dNow - mLastServiceActivity < mIdleTickPoll || dNow >= mNextIdlePoll)
+			{
+				mbServiceActive = false;
+				ServiceOnce(0);
+				if (bDue || mbServiceActive)
+				{
+					mLastServiceActivity = dNow;
+				}
+				mNextIdlePoll = dNow + mIdleTickPoll;
+			}
+		}
 	}
 #endif
 }
 
 bool UWebSocketContext::IsTickable() const
 {
+#if PLATFORM_UWP
+	return true;
+#elif PLATFORM_HTML5
 	return true;
+#else
+	return mServiceThread == nullptr && mServiceMode != EWebSocketServiceMode::Manual;
+#endif
 }
 
 TStatId UWebSocketContext::GetStatId() const
@@ -228,28 +662,587 @@ TStatId UWebSocketContext::GetStatId() const
 
 UWebSocketBase* UWebSocketContext::Connect(const FString& uri, const TMap<FString, FString>& header, bool& connectFail)
 {
+	return Connect(uri, header, FString(), connectFail);
+}
+
+UWebSocketBase* UWebSocketContext::Connect(const FString& uri, const TMap<FString, FString>& header, const FString& protocol, bool& connectFail)
+{
+	if (mCtxState == ECtxState::Creating)
+	{
+		// the socket is handed out now and connects as soon as the context is ready
+		FWebSocketPendingConnect pending;
+		pending.Socket = NewObject<UWebSocketBase>();
+		pending.Uri = uri;
+		pending.Header = header;
+		pending.Protocol = protocol;
+		mPendingConnects.Add(pending);
 #if PLATFORM_UWP
 #elif PLATFORM_HTML5
 #else
-	if (mlwsContext == nullptr)
-	{
-		return nullptr;
-	}
+		pending.Socket->mPendingContext = this;
 #endif
 
-	UWebSocketBase* pNewSocketBase = NewObject<UWebSocketBase>();
+		connectFail = false;
+		return pending.Socket;
+	}
 
 #if PLATFORM_UWP
 #elif PLATFORM_HTML5
 #else
-	pNewSocketBase->mlwsContext = mlwsContext;
+	if (mlwsContext == nullptr)
+	{
+		connectFail = true;
+		return nullptr;
+	}
 #endif
 
-	connectFail = !(pNewSocketBase->Connect(uri, header) );
+	UWebSocketBase* pNewSocketBase = NewObject<UWebSocketBase>();
+	StartConnect(pNewSocketBase, uri, header, protocol, connectFail);
 
 	return pNewSocketBase;
 }
 
+bool UWebSocketContext::CancelPendingConnect(UWebSocketBase* socket)
+{
+	return mPendingConnects.RemoveAll([socket](const FWebSocketPendingConnect& it) { return it.Socket == socket; }) > 0;
+}
+
+UWebSocketBase* UWebSocketContext::ConnectEndpoints(const TArray<FString>& uris, const TMap<FString, FString>& header, const FString& protocol, bool bProbeOnly, bool& connectFail)
+{
+	if (mCtxState == ECtxState::Creating)
+	{
+		FWebSocketPendingConnect pending;
+		pending.Socket = NewObject<UWebSocketBase>();
+		pending.Endpoints = uris;
+		pending.Header = header;
+		pending.Protocol = protocol;
+		pending.bProbeOnly = bProbeOnly;
+		mPendingConnects.Add(pending);
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+		pending.Socket->mPendingContext = this;
+#endif
+
+		connectFail = false;
+		return pending.Socket;
+	}
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	if (mlwsContext == nullptr)
+	{
+		connectFail = true;
+		return nullptr;
+	}
+#endif
+
+	UWebSocketBase* pNewSocketBase = NewObject<UWebSocketBase>();
+	StartConnectEndpoints(pNewSocketBase, uris, header, protocol, bProbeOnly, connectFail);
+
+	return pNewSocketBase;
+}
+
+void UWebSocketContext::StartConnectEndpoints(UWebSocketBase* pSocketBase, const TArray<FString>& uris, const TMap<FString, FString>& header, const FString& protocol, bool bProbeOnly, bool& connectFail)
+{
+	mSockets.RemoveAll([](const TWeakObjectPtr<UWebSocketBase>& it) { return !it.IsValid(); });
+	mSockets.Add(pSocketBase);
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	pSocketBase->mContext = this;
+#endif
+
+	connectFail = !(bProbeOnly ? pSocketBase->ProbeEndpoints(uris, header, protocol) : pSocketBase->ConnectEndpoints(uris, header, protocol));
+}
+
+FWebSocketFrameHandle UWebSocketContext::RegisterFrame(const uint8* data, int32 len, bool bBinary)
+{
+	FWebSocketFrameHandle handle;
+#if PLATFORM_UWP
+	UE_LOG(WebSocket, Error, TEXT("websocket: frame handles are not supported on uwp"));
+#elif PLATFORM_HTML5
+	UE_LOG(WebSocket, Error, TEXT("websocket: frame handles are not supported on html5"));
+#else
+	// unique across contexts, a handle sent through the wrong context is not found instead of sending another frame
+	static int32 s_nextFrameId = 0;
+	handle.Id = ++s_nextFrameId;
+
+	FWebSocketCachedFrame& frame = mFrames.Add(handle.Id);
+	WebSocketMakeOutMessage(data, len, bBinary, frame.Plain);
+	frame.Plain.Shared = MakeShareable(new TArray<uint8>(MoveTemp(frame.Plain.Payload)));
+	if (mCtxState != ECtxState::Creating)
+	{
+		EncodeFrame(frame);
+	}
+#endif
+	return handle;
+}
+
+void UWebSocketContext::UnregisterFrame(FWebSocketFrameHandle handle)
+{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	// frames still queued on a connection keep their buffer until they are written
+	mFrames.Remove(handle.Id);
+#endif
+}
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+void UWebSocketContext::EncodeFrame(FWebSocketCachedFrame& frame) const
+{
+	if (frame.Plain.bBinary || frame.Encoded.Shared.IsValid() || !mDictionaryCodec.IsValid())
+	{
+		return;
+	}
+
+	const TArray<uint8>& plain = *frame.Plain.Shared;
+	FWebSocketOutMessage encoded;
+	if (mDictionaryCodec->EncodeUtf8(plain.GetData() + LWS_PRE, plain.Num() - LWS_PRE, encoded))
+	{
+		frame.Encoded.bBinary = encoded.bBinary;
+		frame.Encoded.Shared = MakeShareable(new TArray<uint8>(MoveTemp(encoded.Payload)));
+	}
+}
+#endif
+
+UWebSocketServer* UWebSocketContext::Listen(int32 port, bool& listenFail)
+{
+	UWebSocketServer* pServer = NewObject<UWebSocketServer>(this);
+	listenFail = !pServer->Listen(this, port);
+	if (listenFail)
+	{
+		return pServer;
+	}
+
+	mServers.RemoveAll([](const TWeakObjectPtr<UWebSocketServer>& it) { return !it.IsValid(); });
+	mServers.Add(pServer);
+	if (mCtxState == ECtxState::Creating)
+	{
+		mPendingListens.Add(pServer);
+	}
+
+	return pServer;
+}
+
+TSharedRef<FWebSocketPool, ESPMode::ThreadSafe> UWebSocketContext::CreatePool(IWebSocketPoolListener* listener)
+{
+	TSharedRef<FWebSocketPool, ESPMode::ThreadSafe> pool = MakeShareable(new FWebSocketPool(this, listener));
+	mPools.RemoveAll([](const TWeakPtr<FWebSocketPool, ESPMode::ThreadSafe>& it) { return !it.IsValid(); });
+	mPools.Add(pool);
+	return pool;
+}
+
+void UWebSocketContext::UpdateEndpointStatus(const FWebSocketEndpointStatus& status)
+{
+	FWebSocketEndpointCacheEntry& entry = mEndpointCache.FindOrAdd(status.Url);
+	entry.Status = status;
+	entry.Seconds = FPlatformTime::Seconds();
+}
+
+bool UWebSocketContext::FindEndpointStatus(const FString& uri, FWebSocketEndpointStatus& status) const
+{
+	const FWebSocketEndpointCacheEntry* pEntry = mEndpointCache.Find(uri);
+	if (pEntry == nullptr)
+	{
+		return false;
+	}
+
+	double dAge = FPlatformTime::Seconds() - pEntry->Seconds;
+	if (dAge > GetSettings()->EndpointCacheTtl)
+	{
+		return false;
+	}
+
+	status = pEntry->Status;
+	status.AgeSeconds = (float)dAge;
+	return true;
+}
+
+TArray<FWebSocketEndpointStatus> UWebSocketContext::GetEndpointStatuses() const
+{
+	double dNow = FPlatformTime::Seconds();
+	TArray<FWebSocketEndpointStatus> statuses;
+	for (auto& it : mEndpointCache)
+	{
+		FWebSocketEndpointStatus status = it.Value.Status;
+		status.AgeSeconds = (float)(dNow - it.Value.Seconds);
+		statuses.Add(status);
+	}
+
+	return statuses;
+}
+
+void UWebSocketContext::StartConnect(UWebSocketBase* pSocketBase, const FString& uri, const TMap<FString, FString>& header, const FString& protocol, bool& connectFail)
+{
+	mSockets.RemoveAll([](const TWeakObjectPtr<UWebSocketBase>& it) { return !it.IsValid(); });
+	mSockets.Add(pSocketBase);
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	pSocketBase->mContext = this;
+#endif
+
+	connectFail = !(pSocketBase->Connect(uri, header, protocol) );
+}
+
+int32 UWebSocketContext::GetOpenSocketCount() const
+{
+#if PLATFORM_UWP
+	return 0;
+#elif PLATFORM_HTML5
+	return 0;
+#else
+	return mConnectionCount.GetValue();
+#endif
+}
+
+void UWebSocketContext::StartService()
+{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	const UWebSocketSettings* Settings = GetSettings();
+	mServiceThreadId = FPlatformTLS::GetCurrentThreadId();
+	mIdleTickPoll = FMath::Max(Settings->IdleTickPollMs, 0) / 1000.0;
+	bool bThread = (mServiceMode == EWebSocketServiceMode::Thread) || (mServiceMode == EWebSocketServiceMode::Default && Settings->bUseServiceThread);
+	if (mlwsContext == nullptr || mServiceThread != nullptr || !bThread || !FPlatformProcess::SupportsMultithreading())
+	{
+		return;
+	}
+
+	// Init takes over mServiceThreadId before Create returns
+	mServiceRunnable = new FWebSocketServiceThread(this, Settings->IdleServiceTimeoutMs);
+	mServiceThread = FRunnableThread::Create(mServiceRunnable, TEXT("WebSocketService"), 0, TPri_AboveNormal);
+	if (mServiceThread == nullptr)
+	{
+		delete mServiceRunnable;
+		mServiceRunnable = nullptr;
+		mServiceThreadId = FPlatformTLS::GetCurrentThreadId();
+	}
+#endif
+}
+
+void UWebSocketContext::StopService()
+{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	if (mServiceThread != nullptr)
+	{
+		mServiceThread->Kill(true);
+		delete mServiceThread;
+		mServiceThread = nullptr;
+
+		delete mServiceRunnable;
+		mServiceRunnable = nullptr;
+	}
+
+	mServiceThreadId = FPlatformTLS::GetCurrentThreadId();
+#endif
+}
+
+bool UWebSocketContext::Service(int32 timeoutMs)
+{
+	if (mServiceMode != EWebSocketServiceMode::Manual)
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: Service is only for a context in manual service mode"));
+		return false;
+	}
+
+#if PLATFORM_UWP
+	return false;
+#elif PLATFORM_HTML5
+	return false;
+#else
+	if (mCtxState == ECtxState::Creating || mlwsContext == nullptr)
+	{
+		return false;
+	}
+
+	mServiceThreadId = FPlatformTLS::GetCurrentThreadId();
+	ServiceOnce(FMath::Max(timeoutMs, 0));
+	return true;
+#endif
+}
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+void UWebSocketContext::RunOnService(TFunction<void()>&& fn)
+{
+	if (IsServiceThread())
+	{
+		fn();
+		return;
+	}
+
+	// a manual service may be blocked in lws_service on another thread as well
+	mServiceCommands.Enqueue(MoveTemp(fn));
+	if ((mServiceThread != nullptr || mServiceMode == EWebSocketServiceMode::Manual) && mlwsContext != nullptr)
+	{
+		lws_cancel_service(mlwsContext);
+	}
+}
+
+void UWebSocketContext::RunOnServiceAt(double time, TFunction<void()>&& fn)
+{
+	FWebSocketServiceTimer timer;
+	timer.Time = time;
+	timer.Fn = MoveTemp(fn);
+	mServiceTimers.HeapPush(MoveTemp(timer));
+}
+
+void UWebSocketContext::ServiceOnce(int32 timeoutMs)
+{
+	TFunction<void()> command;
+	while (mServiceCommands.Dequeue(command))
+	{
+		command();
+	}
+
+	double dNow = FPlatformTime::Seconds();
+	while (mServiceTimers.Num() > 0 && mServiceTimers.HeapTop().Time <= dNow)
+	{
+		FWebSocketServiceTimer timer;
+		mServiceTimers.HeapPop(timer, false);
+		timer.Fn();
+	}
+
+	if (mServiceTimers.Num() > 0)
+	{
+		timeoutMs = FMath::Min(timeoutMs, FMath::CeilToInt((mServiceTimers.HeapTop().Time - dNow) * 1000.0));
+	}
+
+	if (mlwsContext != nullptr)
+	{
+		mServiceRounds.Increment();
+		lws_service(mlwsContext, timeoutMs);
+	}
+}
+
+void UWebSocketContext::NoteServiceActivity(struct lws* wsi)
+{
+	FWebSocketLwsContext* pLws = (FWebSocketLwsContext*)lws_context_user(lws_get_context(wsi));
+	UWebSocketContext* pContext = pLws != nullptr ? pLws->GetOwner() : nullptr;
+	if (pContext != nullptr)
+	{
+		pContext->mbServiceActive = true;
+	}
+}
+
+void UWebSocketContext::AddConnection(const TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe>& connection)
+{
+	bool bAlreadyInSet = false;
+	mConnections.Add(connection, &bAlreadyInSet);
+	if (!bAlreadyInSet)
+	{
+		mConnectionCount.Increment();
+	}
+}
+
+void UWebSocketContext::RemoveConnection(const TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe>& connection)
+{
+	if (mConnections.Remove(connection) > 0)
+	{
+		mConnectionCount.Decrement();
+	}
+}
+
+FWebSocketServiceThread::FWebSocketServiceThread(UWebSocketContext* context, int32 idleTimeoutMs)
+	:mContext(context), mIdleTimeoutMs(idleTimeoutMs)
+{
+}
+
+bool FWebSocketServiceThread::Init()
+{
+	mContext->mServiceThreadId = FPlatformTLS::GetCurrentThreadId();
+	return true;
+}
+
+uint32 FWebSocketServiceThread::Run()
+{
+	while (!mbStop)
+	{
+		mContext->ServiceOnce(mIdleTimeoutMs);
+	}
+
+	return 0;
+}
+
+void FWebSocketServiceThread::Stop()
+{
+	mbStop = true;
+	lws_cancel_service(mContext->mlwsContext);
+}
+#endif
+
+bool UWebSocketContext::Shutdown(float Timeout)
+{
+	double dStart = FPlatformTime::Seconds();
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	if (mCtxState == ECtxState::Creating)
+	{
+		// the worker is usually done within a few ms. if not it is abandoned and destroys the lws context itself
+		if (mLws->WaitCreated(Timeout))
+		{
+			AdoptCtx();
+		}
+		else
+		{
+			UE_LOG(WebSocket, Warning, TEXT("websocket: shutdown while the context is being created, abandoned it"));
+		}
+	}
+#endif
+
+	TArray<FWebSocketPendingConnect> pending = MoveTemp(mPendingConnects);
+	for (FWebSocketPendingConnect& it : pending)
+	{
+		it.Socket->OnConnectError.Broadcast(TEXT("websocket context shutdown"));
+	}
+
+	TArray<UWebSocketServer*> pendingListens = MoveTemp(mPendingListens);
+	for (UWebSocketServer* it : pendingListens)
+	{
+		it->HandleListenError(TEXT("websocket context shutdown"));
+	}
+
+	// every socket starts its close handshake at once, half the budget goes to draining the send queues
+	int32 iSocketCount = GetOpenSocketCount();
+	for (const TWeakObjectPtr<UWebSocketServer>& it : mServers)
+	{
+		if (it.IsValid())
+		{
+			it->Stop(Timeout * 0.5f);
+		}
+	}
+
+	for (const TWeakObjectPtr<UWebSocketBase>& it : mSockets)
+	{
+		if (it.IsValid())
+		{
+			it->Close(1001, TEXT("shutdown"), Timeout * 0.5f);
+		}
+	}
+
+	for (const TWeakPtr<FWebSocketPool, ESPMode::ThreadSafe>& it : mPools)
+	{
+		if (TSharedPtr<FWebSocketPool, ESPMode::ThreadSafe> pPool = it.Pin())
+		{
+			pPool->CloseAll(1001, TEXT("shutdown"), Timeout * 0.5f);
+		}
+	}
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	if (mlwsContext != nullptr)
+	{
+		// without a service thread the caller services the close handshakes, also in manual mode
+		double dDeadline = dStart + Timeout;
+		if (mServiceThread == nullptr)
+		{
+			mServiceThreadId = FPlatformTLS::GetCurrentThreadId();
+		}
+		while (GetOpenSocketCount() > 0 && FPlatformTime::Seconds() < dDeadline)
+		{
+			if (mServiceThread != nullptr)
+			{
+				FPlatformProcess::Sleep(0.001f);
+			}
+			else
+			{
+				ServiceOnce(10);
+			}
+		}
+
+		// whatever is still open is dropped here, its callbacks run on this thread now
+		StopService();
+		mLws->Destroy();
+		mlwsContext = nullptr;
+#if WITH_WEBSOCKET_UNIX_SOCKET
+		mlwsVhost = nullptr;
+		mRawConnections.Empty();
+#endif
+		mConnections.Empty();
+		mConnectionCount.Reset();
+		mListenerCount.Reset();
+		mServiceTimers.Empty();
+	}
+
+	for (const TWeakObjectPtr<UWebSocketBase>& it : mSockets)
+	{
+		if (it.IsValid())
+		{
+			it->mContext = nullptr;
+		}
+	}
+	mLws.Reset();
+	mDictionaryCodec.Reset();
+#endif
+
+	mSockets.Reset();
+	mServers.Reset();
+	mPools.Reset();
+	mCtxState = ECtxState::None;
+
+	UE_LOG(WebSocket, Log, TEXT("websocket: context shutdown, %d sockets in %.2f ms"), iSocketCount, (FPlatformTime::Seconds() - dStart) * 1000.0);
+	return true;
+}
+
+FWebSocketContextStats UWebSocketContext::GetContextStats() const
+{
+	FWebSocketContextStats stats;
+#if PLATFORM_UWP
+	stats.bReady = (mCtxState != ECtxState::Creating);
+#elif PLATFORM_HTML5
+	stats.bReady = (mCtxState != ECtxState::Creating);
+#else
+	stats.bReady = (mCtxState != ECtxState::Creating && mlwsContext != nullptr);
+#endif
+	stats.CreateMs = (float)(mCreateSeconds * 1000.0);
+	stats.PendingConnects = mPendingConnects.Num();
+	stats.OpenConnections = GetOpenSocketCount();
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	stats.bServiceThread = (mServiceThread != nullptr);
+	stats.bManualService = (mServiceMode == EWebSocketServiceMode::Manual);
+	stats.ServiceRounds = mServiceRounds.GetValue();
+	stats.CachedFrames = mFrames.Num();
+	for (const auto& it : mFrames)
+	{
+		stats.CachedFrameBytes += it.Value.Plain.Shared->Num() - LWS_PRE;
+		if (it.Value.Encoded.Shared.IsValid())
+		{
+			stats.CachedFrameBytes += it.Value.Encoded.Shared->Num() - LWS_PRE;
+		}
+	}
+	stats.CachedFrameSends = mFrameSends;
+#endif
+	return stats;
+}
+
+FWebSocketTlsStats UWebSocketContext::GetTlsStats() const
+{
+#if PLATFORM_UWP
+	return FWebSocketTlsStats();
+#elif PLATFORM_HTML5
+	return FWebSocketTlsStats();
+#else
+	return mLws.IsValid() ? mLws->GetTlsStats() : FWebSocketTlsStats();
+#endif
+}
+
 UWebSocketBase* UWebSocketContext::Connect(const FString& uri, bool& connectFail)
 {
 	return Connect(uri, TMap<FString, FString>(), connectFail);
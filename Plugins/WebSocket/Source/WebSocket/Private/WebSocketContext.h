@@ -23,6 +23,12 @@
 
 #include "UObject/NoExportTypes.h"
 #include "Tickable.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/Event.h"
+#include "Containers/Queue.h"
 
 #if PLATFORM_UWP
 #elif PLATFORM_HTML5
@@ -36,10 +42,173 @@
 
 #include <iostream>
 
+#include "WebSocketCodec.h"
+#include "WebSocketSSL.h"
+#include "WebSocketSettings.h"
+#include "WebSocketPool.h"
+#include "WebSocketRawTransport.h"
 #include "WebSocketContext.generated.h"
 
 
 class UWebSocketBase;
+class UWebSocketContext;
+class UWebSocketServer;
+class FWebSocketConnection;
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+/**
+ * blocks in lws_service until a socket is ready, a command is queued or IdleServiceTimeoutMs passed,
+ * so idle connections cost no cpu and readiness is handled without waiting for the next frame.
+ */
+class FWebSocketServiceThread : public FRunnable
+{
+public:
+
+	FWebSocketServiceThread(UWebSocketContext* context, int32 idleTimeoutMs);
+
+	virtual bool Init() override;
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+
+	UWebSocketContext* mContext;
+	int32 mIdleTimeoutMs;
+	FThreadSafeBool mbStop;
+};
+
+/** message of RegisterFrame, built once and queued by reference. Encoded is the dictionary codec variant */
+struct FWebSocketCachedFrame
+{
+	FWebSocketOutMessage Plain;
+	FWebSocketOutMessage Encoded;
+};
+
+struct FWebSocketServiceTimer
+{
+	double Time;
+	TFunction<void()> Fn;
+
+	bool operator<(const FWebSocketServiceTimer& other) const { return Time < other.Time; }
+};
+
+/**
+ * the lws context and everything lws keeps pointers into. it copies the settings it needs on the game thread,
+ * so CreateCtxAsync's worker builds it without touching a UObject. the UWebSocketContext adopts it once the
+ * worker is done; a context that is gone or shut down by then never does, and the lws context is destroyed.
+ */
+class FWebSocketLwsContext
+{
+public:
+
+	/** game thread */
+	explicit FWebSocketLwsContext(const UWebSocketSettings* settings);
+	~FWebSocketLwsContext();
+
+	/** any thread, once. the lws context user pointer is this */
+	void Create();
+
+	/** the thread that services it, or any thread before it is adopted */
+	void Destroy();
+
+	/**
+	 * game thread, wait up to timeout seconds for Create. false when it did not finish in time, the context
+	 * is abandoned then and Create destroys it as soon as it is done.
+	 */
+	bool WaitCreated(float timeout);
+
+	/** set on adopt, before the service starts. the raw connection lookup of callback_echo goes through it */
+	void SetOwner(UWebSocketContext* owner) { mOwner = owner; }
+	UWebSocketContext* GetOwner() const { return mOwner; }
+
+	struct lws_context* GetLwsContext() const { return mlwsContext; }
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	struct lws_vhost* GetLwsVhost() const { return mlwsVhost; }
+#endif
+	double GetCreateSeconds() const { return mCreateSeconds; }
+	TSharedPtr<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe> GetDictionaryCodec() const { return mDictionaryCodec; }
+	const TArray<FWebSocketProtocolConfig>& GetProtocolConfigs() const { return mProtocolConfigs; }
+	FWebSocketTlsStats GetTlsStats() const { return mSessionCache.GetStats(); }
+
+	/** LWS_CALLBACK_OPENSSL_LOAD_EXTRA_CLIENT_VERIFY_CERTS, while Create runs */
+	void InitClientSSL(void* sslCtx);
+
+private:
+
+	void BuildProtocols();
+	void WriteCAFile();
+
+	/** copied from the settings */
+	TArray<FWebSocketProtocolConfig> mSettingsProtocols;
+	FWebSocketTlsOptions mTlsOptions;
+	bool mbUseBundledCA;
+	bool mbUseSystemTrustStore;
+	bool mbEnableTlsSessionCache;
+	bool mbPersistTlsSessions;
+	FString mDictionaryFile;
+	uint16 mDictionaryVersion;
+	int32 mCompressionLevel;
+	int32 mMinCompressSize;
+
+	UWebSocketContext* mOwner;
+	struct lws_context* mlwsContext;
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	struct lws_vhost* mlwsVhost;
+#endif
+	double mCreateSeconds;
+	std::string mstrCAPath;
+	TSharedPtr<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe> mDictionaryCodec;
+	FWebSocketSessionCache mSessionCache;
+
+	/** lws keeps pointers into these until the context is destroyed */
+	TArray<FWebSocketProtocolConfig> mProtocolConfigs;
+	TArray<std::string> mProtocolNames;
+	TArray<struct lws_protocols> mProtocols;
+
+	/** Create and WaitCreated meet here */
+	FCriticalSection mCreateLock;
+	FEvent* mCreatedEvent;
+	bool mbCreated;
+	bool mbAbandoned;
+};
+#endif
+
+/** connect issued while the context is still being created */
+USTRUCT()
+struct FWebSocketPendingConnect
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY()
+	UWebSocketBase* Socket;
+
+	UPROPERTY()
+	FString Uri;
+
+	UPROPERTY()
+	TMap<FString, FString> Header;
+
+	UPROPERTY()
+	FString Protocol;
+
+	/** ConnectEndpoints or ProbeEndpoints instead of Uri */
+	UPROPERTY()
+	TArray<FString> Endpoints;
+
+	UPROPERTY()
+	bool bProbeOnly;
+
+	FWebSocketPendingConnect() :Socket(nullptr), bProbeOnly(false) {}
+};
+
+struct FWebSocketEndpointCacheEntry
+{
+	FWebSocketEndpointStatus Status;
+	double Seconds;
+};
+
 /**
  * 
  */
@@ -55,6 +224,18 @@ public:
 
 	void CreateCtx();
 
+	/**
+	 * settings and service mode of this context instead of the project settings and bUseServiceThread,
+	 * before CreateCtx. settings null keeps the project settings.
+	 */
+	void Configure(UWebSocketSettings* settings, EWebSocketServiceMode mode);
+	const UWebSocketSettings* GetSettings() const { return mSettings != nullptr ? mSettings : GetDefault<UWebSocketSettings>(); }
+	EWebSocketServiceMode GetServiceMode() const { return mServiceMode; }
+
+	/** run CreateCtx on a task graph worker, connects issued meanwhile are queued until it finishes */
+	void CreateCtxAsync();
+	bool IsCreating() const { return mCtxState == ECtxState::Creating; }
+
 	virtual void BeginDestroy() override;
 
 	virtual void Tick(float DeltaTime) override;
@@ -63,18 +244,177 @@ public:
 
 	UWebSocketBase* Connect(const FString& uri, bool& connectFail);
 	UWebSocketBase* Connect(const FString& uri, const TMap<FString, FString>& header, bool& connectFail);
+
+	/** offer the registered subprotocol named protocol, an empty name uses the unnamed default protocol */
+	UWebSocketBase* Connect(const FString& uri, const TMap<FString, FString>& header, const FString& protocol, bool& connectFail);
+
+	/** probe every endpoint and connect to the fastest healthy one, see UWebSocketBase::ConnectEndpoints */
+	UWebSocketBase* ConnectEndpoints(const TArray<FString>& uris, const TMap<FString, FString>& header, const FString& protocol, bool bProbeOnly, bool& connectFail);
+
+	/**
+	 * accept websocket connections on port, see UWebSocketServer. a context that is still being created
+	 * starts listening once it is ready.
+	 */
+	UWebSocketServer* Listen(int32 port, bool& listenFail);
+
+	/** connections without a UObject each, see FWebSocketPool. Shutdown closes them with the sockets */
+	TSharedRef<FWebSocketPool, ESPMode::ThreadSafe> CreatePool(IWebSocketPoolListener* listener);
+
+	/**
+	 * build the frame of a message once, every socket of this context sends it by handle without
+	 * converting or compressing it again. game thread, an invalid handle on uwp and html5.
+	 */
+	FWebSocketFrameHandle RegisterFrame(const uint8* data, int32 len, bool bBinary);
+	void UnregisterFrame(FWebSocketFrameHandle handle);
+
+	/** probe results, the endpoint cache is only used on the game thread */
+	void UpdateEndpointStatus(const FWebSocketEndpointStatus& status);
+	bool FindEndpointStatus(const FString& uri, FWebSocketEndpointStatus& status) const;
+	TArray<FWebSocketEndpointStatus> GetEndpointStatuses() const;
+
+	/**
+	 * close every connection in parallel and destroy the lws context, returns within Timeout seconds.
+	 * connections that did not finish their close handshake by then are dropped.
+	 */
+	bool Shutdown(float Timeout);
+	int32 GetOpenSocketCount() const;
+
+	/** drop a connect queued while the context is created, false when socket has none */
+	bool CancelPendingConnect(UWebSocketBase* socket);
+
+	/** service the context on FWebSocketServiceThread, or from Tick when the thread is disabled */
+	void StartService();
+
+	/**
+	 * EWebSocketServiceMode::Manual, one service round that blocks in lws_service for up to timeoutMs
+	 * unless a socket gets ready, a command is queued or a timer is due. the calling thread becomes the
+	 * service thread. false when the context is not usable.
+	 */
+	bool Service(int32 timeoutMs);
+
+	FWebSocketTlsStats GetTlsStats() const;
+	FWebSocketContextStats GetContextStats() const;
 #if PLATFORM_UWP
 #elif PLATFORM_HTML5
 #else
 	static int callback_echo(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len);
+
+	struct lws_context* GetLwsContext() const { return mlwsContext; }
+	TSharedPtr<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe> GetDictionaryCodec() const { return mDictionaryCodec; }
+
+	/** index into the protocols registered with lws, INDEX_NONE for unknown names. fixed once the context is created */
+	int32 FindProtocol(const FString& name) const;
+	const FWebSocketProtocolConfig& GetProtocolConfig(int32 index) const { return mLws->GetProtocolConfigs()[index]; }
+	int32 GetProtocolCount() const { return mLws.IsValid() ? mLws->GetProtocolConfigs().Num() : 0; }
+
+	/** null for handles of other contexts or unregistered ones, game thread */
+	const FWebSocketCachedFrame* FindFrame(FWebSocketFrameHandle handle) const { return mFrames.Find(handle.Id); }
+	void CountFrameSend() { mFrameSends++; }
+
+	/** listening vhosts of UWebSocketServers, Tick services them without connections too. service thread */
+	void AddListener() { mListenerCount.Increment(); }
+	void RemoveListener() { mListenerCount.Decrement(); }
+
+	/**
+	 * lws is single threaded, everything touching a wsi goes through here. runs fn right away on the
+	 * service thread, otherwise queues it and wakes the service thread up.
+	 */
+	void RunOnService(TFunction<void()>&& fn);
+	bool IsServiceThread() const { return FPlatformTLS::GetCurrentThreadId() == mServiceThreadId; }
+
+	/** run fn once FPlatformTime::Seconds() reached time, the service thread does not sleep past it. service thread */
+	void RunOnServiceAt(double time, TFunction<void()>&& fn);
+
+	/** one lws_service round, commands first. service thread */
+	void ServiceOnce(int32 timeoutMs);
+
+	/** a socket of wsi's context received or wrote, keeps the tick path polling every frame. service thread */
+	static void NoteServiceActivity(struct lws* wsi);
+
+	/** connections with a live wsi, service thread */
+	void AddConnection(const TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe>& connection);
+	void RemoveConnection(const TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe>& connection);
+
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	struct lws_vhost* GetLwsVhost() const { return mlwsVhost; }
+
+	/** adopted raw wsis have no user pointer of their own, service thread */
+	void AddRawConnection(struct lws* wsi, FWebSocketConnection* connection) { mRawConnections.Add(wsi, connection); }
+	void RemoveRawConnection(struct lws* wsi) { mRawConnections.Remove(wsi); }
+	FWebSocketConnection* FindRawConnection(struct lws* wsi) const { return mRawConnections.FindRef(wsi); }
+#endif
 #endif
 	
 private:
 
+	enum class ECtxState : uint8
+	{
+		None,
+		Creating,
+		Ready,
+		Failed,
+	};
+
+	void OnCtxCreated();
+	void AdoptCtx();
+	void StopService();
+	void StartConnect(UWebSocketBase* pSocketBase, const FString& uri, const TMap<FString, FString>& header, const FString& protocol, bool& connectFail);
+	void StartConnectEndpoints(UWebSocketBase* pSocketBase, const TArray<FString>& uris, const TMap<FString, FString>& header, const FString& protocol, bool bProbeOnly, bool& connectFail);
+
+	ECtxState mCtxState;
+	double mCreateSeconds;
+
+	UPROPERTY()
+	UWebSocketSettings* mSettings;
+	EWebSocketServiceMode mServiceMode;
+
+	UPROPERTY()
+	TArray<FWebSocketPendingConnect> mPendingConnects;
+
+	/** Listen issued while the context is still being created, port is on the server */
+	UPROPERTY()
+	TArray<UWebSocketServer*> mPendingListens;
+
+	TArray<TWeakObjectPtr<UWebSocketServer>> mServers;
+	TArray<TWeakPtr<FWebSocketPool, ESPMode::ThreadSafe>> mPools;
+
+	TArray<TWeakObjectPtr<UWebSocketBase>> mSockets;
+	TMap<FString, FWebSocketEndpointCacheEntry> mEndpointCache;
+
 #if PLATFORM_UWP
 #elif PLATFORM_HTML5
 #else
+	/** being created while mCtxState is Creating, adopted after that */
+	TSharedPtr<FWebSocketLwsContext, ESPMode::ThreadSafe> mLws;
 	struct lws_context* mlwsContext;
-	std::string mstrCAPath;
+
+#if WITH_WEBSOCKET_UNIX_SOCKET
+	struct lws_vhost* mlwsVhost;
+	TMap<struct lws*, FWebSocketConnection*> mRawConnections;
+#endif
+
+	friend class FWebSocketServiceThread;
+	FWebSocketServiceThread* mServiceRunnable;
+	FRunnableThread* mServiceThread;
+	uint32 mServiceThreadId;
+	TQueue<TFunction<void()>, EQueueMode::Mpsc> mServiceCommands;
+	TArray<FWebSocketServiceTimer> mServiceTimers;
+	TSet<TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe>> mConnections;
+	FThreadSafeCounter mConnectionCount;
+	FThreadSafeCounter mListenerCount;
+	FThreadSafeCounter mServiceRounds;
+
+	/** tick path only: IdleTickPollMs in seconds, set by NoteServiceActivity during a round */
+	double mIdleTickPoll;
+	double mLastServiceActivity;
+	double mNextIdlePoll;
+	bool mbServiceActive;
+
+	TSharedPtr<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe> mDictionaryCodec;
+
+	/** the codec variant needs mDictionaryCodec, frames registered while creating get it in OnCtxCreated */
+	void EncodeFrame(FWebSocketCachedFrame& frame) const;
+	TMap<int32, FWebSocketCachedFrame> mFrames;
+	int32 mFrameSends;
 #endif
 };
@@ -0,0 +1,129 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#include "WebSocket.h"
+#include "WebSocketDecoder.h"
+#include "WebSocketBase.h"
+#include "WebSocketBlueprintLibrary.h"
+#include "WebSocketUtf8.h"
+
+/** no property that JsonValueToUProperty would fill with NewObject, it runs on a worker here */
+static bool WebSocketIsWorkerSafe(const UStruct* structType);
+
+static bool WebSocketIsWorkerSafe(UProperty* property)
+{
+	if (property->IsA<UObjectPropertyBase>() || property->IsA<UInterfaceProperty>() || property->IsA<UDelegateProperty>() || property->IsA<UMulticastDelegateProperty>())
+	{
+		return false;
+	}
+	if (UStructProperty* pStruct = Cast<UStructProperty>(property))
+	{
+		return WebSocketIsWorkerSafe(pStruct->Struct);
+	}
+	if (UArrayProperty* pArray = Cast<UArrayProperty>(property))
+	{
+		return WebSocketIsWorkerSafe(pArray->Inner);
+	}
+	if (USetProperty* pSet = Cast<USetProperty>(property))
+	{
+		return WebSocketIsWorkerSafe(pSet->ElementProp);
+	}
+	if (UMapProperty* pMap = Cast<UMapProperty>(property))
+	{
+		return WebSocketIsWorkerSafe(pMap->KeyProp) && WebSocketIsWorkerSafe(pMap->ValueProp);
+	}
+	return true;
+}
+
+static bool WebSocketIsWorkerSafe(const UStruct* structType)
+{
+	for (TFieldIterator<UProperty> It(structType); It; ++It)
+	{
+		if (!WebSocketIsWorkerSafe(*It))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+FWebSocketJsonDecoder::FWebSocketJsonDecoder(const FString& typeField, const FString& bodyField)
+	:mTypeField(typeField), mBodyField(bodyField)
+{
+}
+
+bool FWebSocketJsonDecoder::Map(int32 type, UScriptStruct* structType)
+{
+	if (structType == nullptr || !WebSocketIsWorkerSafe(structType))
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: %s can not be decoded off the game thread, type %d is not mapped"), structType != nullptr ? *structType->GetName() : TEXT("null"), type);
+		return false;
+	}
+
+	mStructs.Add(type, structType);
+	return true;
+}
+
+bool FWebSocketJsonDecoder::Decode(const FWebSocketMessageView& message, FWebSocketDecodedMessage& out)
+{
+	if (message.bBinary)
+	{
+		return false;
+	}
+
+	FString strText;
+	if (!WebSocketDecodeUtf8(message.Data.GetData(), message.Num(), strText))
+	{
+		return false;
+	}
+
+	TSharedRef<TJsonReader<TCHAR>> Reader = FJsonStringReader::Create(MoveTemp(strText));
+	TSharedPtr<FJsonObject> JsonObject;
+	int32 iType = 0;
+	if (!FJsonSerializer::Deserialize(Reader, JsonObject) || !JsonObject.IsValid() || !JsonObject->TryGetNumberField(mTypeField, iType))
+	{
+		return false;
+	}
+
+	UScriptStruct* pStruct = mStructs.FindRef(iType);
+	if (pStruct == nullptr)
+	{
+		return false;
+	}
+
+	const TSharedPtr<FJsonObject>* pBody = &JsonObject;
+	if (!mBodyField.IsEmpty() && !JsonObject->TryGetObjectField(mBodyField, pBody))
+	{
+		return false;
+	}
+
+	TSharedPtr<FStructOnScope, ESPMode::ThreadSafe> decoded = MakeShareable(new FStructOnScope(pStruct));
+	if (!UWebSocketBlueprintLibrary::JsonObjectToUStruct((*pBody).ToSharedRef(), pStruct, decoded->GetStructMemory(), 0, 0))
+	{
+		return false;
+	}
+
+	out.Type = iType;
+	out.Struct = decoded;
+	return true;
+}
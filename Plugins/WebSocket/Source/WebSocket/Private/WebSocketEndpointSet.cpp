@@ -0,0 +1,465 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+#include "WebSocket.h"
+#include "WebSocketEndpointSet.h"
+#include "WebSocketBase.h"
+#include "WebSocketConnection.h"
+#include "WebSocketContext.h"
+#include "WebSocketSettings.h"
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+FWebSocketEndpointSet::FWebSocketEndpointSet(UWebSocketBase* owner, const TArray<FString>& endpoints, const TMap<FString, FString>& header, int32 protocolIndex)
+	:mOwner(owner), mEndpoints(endpoints), mHeader(header), mProtocolIndex(protocolIndex), mPurpose(EPurpose::None), mbUsedCache(false), mbConnected(false)
+{
+}
+
+FWebSocketEndpointSet::~FWebSocketEndpointSet()
+{
+	Stop();
+}
+
+bool FWebSocketEndpointSet::Start(bool bProbeOnly)
+{
+	if (mEndpoints.Num() == 0)
+	{
+		return false;
+	}
+
+	Probe(bProbeOnly ? EPurpose::ProbeOnly : EPurpose::Primary, true);
+	return true;
+}
+
+void FWebSocketEndpointSet::Stop()
+{
+	ClearTicker(mProbeTimeout);
+	ClearTicker(mStandbyPing);
+	mPurpose = EPurpose::None;
+
+	for (FProbe& it : mProbes)
+	{
+		if (it.Connection.IsValid())
+		{
+			it.Connection->Close(1000, TEXT(""), 0.0f);
+		}
+	}
+	mProbes.Empty();
+
+	if (mStandby.IsValid())
+	{
+		mStandby->Close(1000, TEXT(""), 0.0f);
+		mStandby = nullptr;
+	}
+	mStandbyEndpoint.Empty();
+}
+
+void FWebSocketEndpointSet::ClearTicker(FDelegateHandle& handle)
+{
+	if (handle.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(handle);
+		handle.Reset();
+	}
+}
+
+void FWebSocketEndpointSet::Probe(EPurpose purpose, bool bUseCache)
+{
+	UWebSocketBase* pOwner = mOwner.Get();
+	if (pOwner == nullptr)
+	{
+		return;
+	}
+
+	const UWebSocketSettings* Settings = pOwner->mContext->GetSettings();
+	mPurpose = purpose;
+	mbUsedCache = false;
+
+	TArray<FString> candidates;
+	for (const FString& it : mEndpoints)
+	{
+		if (purpose == EPurpose::Standby && it == mEndpoint)
+		{
+			continue;
+		}
+		candidates.Add(it);
+	}
+
+	// when every endpoint has a fresh result only the best cached ones are connected, dead and slow regions are skipped
+	TArray<FWebSocketEndpointStatus> cached;
+	for (const FString& it : candidates)
+	{
+		FWebSocketEndpointStatus status;
+		if (!bUseCache || !pOwner->mContext->FindEndpointStatus(it, status))
+		{
+			cached.Empty();
+			break;
+		}
+		cached.Add(status);
+	}
+
+	if (cached.Num() > 0 && purpose == EPurpose::ProbeOnly)
+	{
+		candidates.Empty();
+	}
+	else if (cached.Num() > 0)
+	{
+		cached.RemoveAll([](const FWebSocketEndpointStatus& it) { return !it.bHealthy; });
+		cached.Sort([](const FWebSocketEndpointStatus& a, const FWebSocketEndpointStatus& b) { return a.RttMs < b.RttMs; });
+		int32 iWanted = (purpose == EPurpose::Primary && Settings->bKeepWarmStandby) ? 2 : 1;
+		if (cached.Num() > 0)
+		{
+			candidates.Empty();
+			for (int32 i = 0; i < cached.Num() && i < iWanted; i++)
+			{
+				candidates.Add(cached[i].Url);
+			}
+			cached.Empty();
+			mbUsedCache = true;
+		}
+	}
+
+	double dNow = FPlatformTime::Seconds();
+	for (const FWebSocketEndpointStatus& it : cached)
+	{
+		FProbe& probe = mProbes[mProbes.AddDefaulted()];
+		probe.Uri = it.Url;
+		probe.Status = it;
+		probe.bDone = true;
+	}
+
+	for (const FString& it : candidates)
+	{
+		FProbe& probe = mProbes[mProbes.AddDefaulted()];
+		probe.Uri = it;
+		probe.StartSeconds = dNow;
+		probe.Status.Url = it;
+		probe.Connection = pOwner->OpenConnection(it, mHeader, mProtocolIndex, true);
+		if (!probe.Connection.IsValid())
+		{
+			FinishProbe(probe, false, 0.0f);
+		}
+	}
+
+	// settled on the next tick when nothing has to be waited for, so delegates bound after the call still fire
+	bool bPending = mProbes.ContainsByPredicate([](const FProbe& it) { return !it.bDone; });
+	float fDelay = bPending ? Settings->EndpointProbeTimeout : 0.0f;
+	ClearTicker(mProbeTimeout);
+	mProbeTimeout = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float DeltaTime)
+	{
+		mProbeTimeout.Reset();
+		CheckProbes(true);
+		return false;
+	}), fDelay);
+}
+
+FWebSocketEndpointSet::FProbe* FWebSocketEndpointSet::FindProbe(FWebSocketConnection* connection)
+{
+	return mProbes.FindByPredicate([connection](const FProbe& it) { return it.Connection.Get() == connection; });
+}
+
+void FWebSocketEndpointSet::FinishProbe(FProbe& probe, bool bHealthy, float rttMs)
+{
+	probe.bDone = true;
+	probe.Status.bHealthy = bHealthy;
+	probe.Status.RttMs = rttMs;
+	probe.Status.AgeSeconds = 0.0f;
+
+	if (UWebSocketBase* pOwner = mOwner.Get())
+	{
+		pOwner->mContext->UpdateEndpointStatus(probe.Status);
+	}
+}
+
+bool FWebSocketEndpointSet::OnEstablished(FWebSocketConnection* connection, const FString& protocol)
+{
+	if (FProbe* pProbe = FindProbe(connection))
+	{
+		pProbe->Protocol = protocol;
+		pProbe->Status.ConnectMs = (float)((FPlatformTime::Seconds() - pProbe->StartSeconds) * 1000.0);
+		connection->SendPing();
+		return true;
+	}
+
+	return mStandby.IsValid() && mStandby.Get() == connection;
+}
+
+bool FWebSocketEndpointSet::OnPong(FWebSocketConnection* connection, float rttMs)
+{
+	if (FProbe* pProbe = FindProbe(connection))
+	{
+		if (!pProbe->bDone)
+		{
+			FinishProbe(*pProbe, true, rttMs);
+			CheckProbes(false);
+		}
+		return true;
+	}
+
+	if (mStandby.IsValid() && mStandby.Get() == connection)
+	{
+		FWebSocketEndpointStatus status;
+		UWebSocketBase* pOwner = mOwner.Get();
+		if (pOwner != nullptr && pOwner->mContext->FindEndpointStatus(mStandbyEndpoint, status))
+		{
+			status.bHealthy = true;
+			status.RttMs = rttMs;
+			pOwner->mContext->UpdateEndpointStatus(status);
+		}
+		return true;
+	}
+
+	return false;
+}
+
+bool FWebSocketEndpointSet::OnConnectionLost(FWebSocketConnection* connection)
+{
+	if (FProbe* pProbe = FindProbe(connection))
+	{
+		pProbe->Connection = nullptr;
+		if (!pProbe->bDone)
+		{
+			FinishProbe(*pProbe, false, 0.0f);
+			CheckProbes(false);
+		}
+		return true;
+	}
+
+	if (mStandby.IsValid() && mStandby.Get() == connection)
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: standby connection to %s lost"), *mStandbyEndpoint);
+		FProbe lost;
+		lost.Status.Url = mStandbyEndpoint;
+		FinishProbe(lost, false, 0.0f);
+
+		mStandby = nullptr;
+		mStandbyEndpoint.Empty();
+		ClearTicker(mStandbyPing);
+		if (mPurpose == EPurpose::None)
+		{
+			Probe(EPurpose::Standby, true);
+		}
+		return true;
+	}
+
+	UWebSocketBase* pOwner = mOwner.Get();
+	if (pOwner != nullptr && mbConnected && !pOwner->IsClosing() && pOwner->mConnection.Get() == connection)
+	{
+		return Failover();
+	}
+
+	return false;
+}
+
+bool FWebSocketEndpointSet::Failover()
+{
+	UWebSocketBase* pOwner = mOwner.Get();
+	UE_LOG(WebSocket, Warning, TEXT("websocket: connection to %s lost, failing over"), *mEndpoint);
+
+	FProbe lost;
+	lost.Status.Url = mEndpoint;
+	FinishProbe(lost, false, 0.0f);
+	mEndpoint.Empty();
+
+	if (mStandby.IsValid() && mStandby->IsAlive())
+	{
+		TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe> standby = mStandby;
+		mStandby = nullptr;
+		mEndpoint = mStandbyEndpoint;
+		mStandbyEndpoint.Empty();
+		ClearTicker(mStandbyPing);
+
+		pOwner->PromoteConnection(standby, mEndpoint, mStandbyProtocol);
+		if (mPurpose == EPurpose::None && pOwner->mContext->GetSettings()->bKeepWarmStandby)
+		{
+			Probe(EPurpose::Standby, true);
+		}
+
+		// last, a handler that connects again frees this set
+		FString strEndpoint = mEndpoint;
+		pOwner->OnFailover.Broadcast(strEndpoint);
+		return true;
+	}
+
+	// a standby probe still running is promoted once it settles
+	if (mPurpose == EPurpose::Standby)
+	{
+		mPurpose = EPurpose::Primary;
+		return true;
+	}
+
+	Probe(EPurpose::Primary, true);
+	return true;
+}
+
+void FWebSocketEndpointSet::CheckProbes(bool bTimeout)
+{
+	if (mPurpose == EPurpose::None)
+	{
+		return;
+	}
+
+	if (!bTimeout && mProbes.ContainsByPredicate([](const FProbe& it) { return !it.bDone; }))
+	{
+		return;
+	}
+
+	ClearTicker(mProbeTimeout);
+
+	// endpoints that did not answer within EndpointProbeTimeout count as down
+	for (FProbe& it : mProbes)
+	{
+		if (!it.bDone)
+		{
+			FinishProbe(it, false, 0.0f);
+		}
+	}
+
+	TArray<FProbe> probes = MoveTemp(mProbes);
+	EPurpose purpose = mPurpose;
+	bool bUsedCache = mbUsedCache;
+	mPurpose = EPurpose::None;
+
+	probes.Sort([](const FProbe& a, const FProbe& b)
+	{
+		if (a.Status.bHealthy != b.Status.bHealthy)
+		{
+			return a.Status.bHealthy;
+		}
+		return a.Status.RttMs < b.Status.RttMs;
+	});
+
+	UWebSocketBase* pOwner = mOwner.Get();
+	int32 iNext = 0;
+	TArray<FWebSocketEndpointStatus> statuses;
+	bool bPromoted = false;
+	bool bFailover = false;
+	FString strPromoted;
+	if (pOwner != nullptr && purpose == EPurpose::ProbeOnly)
+	{
+		for (const FProbe& it : probes)
+		{
+			statuses.Add(it.Status);
+		}
+		iNext = probes.Num();
+	}
+	else if (pOwner != nullptr && purpose == EPurpose::Primary)
+	{
+		if (probes.Num() == 0 || !probes[0].Status.bHealthy)
+		{
+			iNext = probes.Num();
+		}
+		else
+		{
+			FProbe& best = probes[0];
+			mEndpoint = best.Uri;
+			UE_LOG(WebSocket, Log, TEXT("websocket: picked endpoint %s, rtt %.1f ms"), *mEndpoint, best.Status.RttMs);
+			pOwner->PromoteConnection(best.Connection, best.Uri, best.Protocol);
+			best.Connection = nullptr;
+			bPromoted = true;
+			bFailover = mbConnected;
+			strPromoted = best.Uri;
+			mbConnected = true;
+			iNext = 1;
+		}
+	}
+
+	// the next fastest stays connected for the failover
+	if (pOwner != nullptr && purpose != EPurpose::ProbeOnly && !mStandby.IsValid() && probes.IsValidIndex(iNext) && probes[iNext].Status.bHealthy
+		&& probes[iNext].Connection.IsValid() && pOwner->mContext->GetSettings()->bKeepWarmStandby)
+	{
+		FProbe& standby = probes[iNext];
+		mStandby = standby.Connection;
+		mStandbyEndpoint = standby.Uri;
+		mStandbyProtocol = standby.Protocol;
+		standby.Connection = nullptr;
+
+		// pinged at half the cache ttl, so the standby and its cached rtt stay fresh
+		float fInterval = FMath::Max(pOwner->mContext->GetSettings()->EndpointCacheTtl * 0.5f, 1.0f);
+		mStandbyPing = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float DeltaTime)
+		{
+			PingStandby();
+			return true;
+		}), fInterval);
+	}
+
+	for (FProbe& it : probes)
+	{
+		if (it.Connection.IsValid())
+		{
+			it.Connection->Close(1000, TEXT(""), 0.0f);
+		}
+	}
+
+	if (pOwner == nullptr)
+	{
+		return;
+	}
+
+	// the delegates go last, a handler calling ConnectEndpoints frees this set
+	if (purpose == EPurpose::ProbeOnly)
+	{
+		pOwner->OnProbeComplete.Broadcast(statuses);
+	}
+	else if (bPromoted && bFailover)
+	{
+		pOwner->OnFailover.Broadcast(strPromoted);
+	}
+	else if (bPromoted)
+	{
+		pOwner->OnConnectComplete.Broadcast();
+	}
+	else if (purpose == EPurpose::Primary && mEndpoint.IsEmpty())
+	{
+		// the cached picks were down after all, ask every endpoint
+		if (bUsedCache)
+		{
+			Probe(EPurpose::Primary, false);
+			return;
+		}
+		Fail();
+	}
+}
+
+void FWebSocketEndpointSet::Fail()
+{
+	UWebSocketBase* pOwner = mOwner.Get();
+	UE_LOG(WebSocket, Error, TEXT("websocket: none of the %d endpoints is healthy"), mEndpoints.Num());
+
+	if (mbConnected)
+	{
+		pOwner->NotifyClosed();
+		return;
+	}
+
+	pOwner->OnConnectError.Broadcast(TEXT("no healthy endpoint"));
+}
+
+void FWebSocketEndpointSet::PingStandby()
+{
+	if (mStandby.IsValid() && mStandby->IsAlive())
+	{
+		mStandby->SendPing();
+	}
+}
+#endif
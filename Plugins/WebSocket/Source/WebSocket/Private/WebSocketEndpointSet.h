@@ -0,0 +1,112 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+#include "UObject/WeakObjectPtr.h"
+#include "WebSocketStats.h"
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+class UWebSocketBase;
+class FWebSocketConnection;
+
+/**
+ * endpoints of a UWebSocketBase connected with ConnectEndpoints. every endpoint is probed with a
+ * standby connection at once, the websocket handshake plus one ping. the fastest healthy one becomes
+ * the socket's connection without connecting again, the second fastest stays connected as warm
+ * standby and takes over when the connection drops. a new standby is probed in the background.
+ *
+ * game thread only, the connections report back through UWebSocketBase::Handle*.
+ */
+class FWebSocketEndpointSet
+{
+public:
+
+	FWebSocketEndpointSet(UWebSocketBase* owner, const TArray<FString>& endpoints, const TMap<FString, FString>& header, int32 protocolIndex);
+	~FWebSocketEndpointSet();
+
+	/** pick and connect the fastest endpoint, or only probe them for OnProbeComplete */
+	bool Start(bool bProbeOnly);
+
+	/** close the standby and the probes, the owner closes its own connection */
+	void Stop();
+
+	const FString& GetEndpoint() const { return mEndpoint; }
+
+	/** return true when the connection was one of ours or the drop was taken over by a failover */
+	bool OnEstablished(FWebSocketConnection* connection, const FString& protocol);
+	bool OnPong(FWebSocketConnection* connection, float rttMs);
+	bool OnConnectionLost(FWebSocketConnection* connection);
+
+private:
+
+	enum class EPurpose : uint8
+	{
+		None,
+		Primary,
+		Standby,
+		ProbeOnly,
+	};
+
+	struct FProbe
+	{
+		FString Uri;
+		TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe> Connection;
+		double StartSeconds;
+		FWebSocketEndpointStatus Status;
+		FString Protocol;
+		bool bDone;
+
+		FProbe() :StartSeconds(0.0), bDone(false) {}
+	};
+
+	void Probe(EPurpose purpose, bool bUseCache);
+	FProbe* FindProbe(FWebSocketConnection* connection);
+	void FinishProbe(FProbe& probe, bool bHealthy, float rttMs);
+	void CheckProbes(bool bTimeout);
+	bool Failover();
+	void Fail();
+	void PingStandby();
+	void ClearTicker(FDelegateHandle& handle);
+
+	TWeakObjectPtr<UWebSocketBase> mOwner;
+	TArray<FString> mEndpoints;
+	TMap<FString, FString> mHeader;
+	int32 mProtocolIndex;
+
+	EPurpose mPurpose;
+	bool mbUsedCache;
+	bool mbConnected;
+	TArray<FProbe> mProbes;
+	FDelegateHandle mProbeTimeout;
+
+	FString mEndpoint;
+	TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe> mStandby;
+	FString mStandbyEndpoint;
+	FString mStandbyProtocol;
+	FDelegateHandle mStandbyPing;
+};
+#endif
@@ -0,0 +1,613 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#include "WebSocket.h"
+#include "WebSocketJournal.h"
+#include "WebSocketSettings.h"
+#include "HAL/FileManager.h"
+#include "Misc/Crc.h"
+#include "Misc/Paths.h"
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define WEBSOCKET_JOURNAL_MAGIC 0x314A5357
+#define WEBSOCKET_JOURNAL_VERSION 1
+#define WEBSOCKET_JOURNAL_HEADER_SIZE 64
+#define WEBSOCKET_JOURNAL_ENTRY_HEADER_SIZE 16
+#define WEBSOCKET_JOURNAL_BINARY_FLAG 0x80000000u
+
+struct FWebSocketJournalHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	uint32 Epoch;
+	uint32 Reserved;
+	uint64 AckedSequence;
+};
+
+/** followed by the payload, the next entry starts 8 byte aligned */
+struct FWebSocketJournalEntry
+{
+	/** payload length, WEBSOCKET_JOURNAL_BINARY_FLAG for binary messages */
+	uint32 Size;
+	uint32 Crc;
+	uint64 Sequence;
+};
+
+static int32 GetPayloadLen(const FWebSocketJournalEntry& entry)
+{
+	return (int32)(entry.Size & ~WEBSOCKET_JOURNAL_BINARY_FLAG);
+}
+
+static int64 GetEntrySpan(int32 len)
+{
+	return Align((int64)WEBSOCKET_JOURNAL_ENTRY_HEADER_SIZE + len, 8);
+}
+
+static uint32 GetEntryCrc(const FWebSocketJournalEntry& entry, const uint8* payload)
+{
+	uint32 crc = FCrc::MemCrc32(&entry.Sequence, sizeof(entry.Sequence), entry.Size);
+	return FCrc::MemCrc32(payload, GetPayloadLen(entry), crc);
+}
+
+FWebSocketMappedFile::FWebSocketMappedFile()
+	:mData(nullptr), mSize(0)
+#if PLATFORM_WINDOWS
+	, mFile(INVALID_HANDLE_VALUE), mMapping(nullptr)
+#else
+	, mFile(-1)
+#endif
+{
+}
+
+FWebSocketMappedFile::~FWebSocketMappedFile()
+{
+	Close();
+}
+
+#if PLATFORM_WINDOWS
+bool FWebSocketMappedFile::Open(const FString& path, int64 size)
+{
+	Close();
+
+	FString strFullPath = IFileManager::Get().ConvertToAbsolutePathForExternalAppForWrite(*path);
+	mFile = CreateFileW(*strFullPath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(mFile, &fileSize))
+	{
+		Close();
+		return false;
+	}
+
+	if (fileSize.QuadPart < size)
+	{
+		fileSize.QuadPart = size;
+		if (!SetFilePointerEx(mFile, fileSize, nullptr, FILE_BEGIN) || !SetEndOfFile(mFile))
+		{
+			Close();
+			return false;
+		}
+	}
+
+	mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READWRITE, (DWORD)(fileSize.QuadPart >> 32), (DWORD)(fileSize.QuadPart & 0xffffffff), nullptr);
+	if (mMapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mData = (uint8*)MapViewOfFile(mMapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)fileSize.QuadPart);
+	if (mData == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mSize = fileSize.QuadPart;
+	return true;
+}
+
+void FWebSocketMappedFile::Close()
+{
+	if (mData != nullptr)
+	{
+		UnmapViewOfFile(mData);
+		mData = nullptr;
+	}
+
+	if (mMapping != nullptr)
+	{
+		CloseHandle(mMapping);
+		mMapping = nullptr;
+	}
+
+	if (mFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+	mSize = 0;
+}
+
+bool FWebSocketMappedFile::Flush(int64 offset, int64 len)
+{
+	return mData != nullptr && FlushViewOfFile(mData + offset, (SIZE_T)len) && FlushFileBuffers(mFile);
+}
+#else
+bool FWebSocketMappedFile::Open(const FString& path, int64 size)
+{
+	Close();
+
+	// android keeps Saved outside of the process' working directory
+	FString strFullPath = IFileManager::Get().ConvertToAbsolutePathForExternalAppForWrite(*path);
+	mFile = open(TCHAR_TO_UTF8(*strFullPath), O_RDWR | O_CREAT, 0644);
+	if (mFile < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(mFile, &fileStat) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	int64 fileSize = fileStat.st_size;
+	if (fileSize < size)
+	{
+		fileSize = size;
+		if (ftruncate(mFile, fileSize) != 0)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	void* pData = mmap(nullptr, (size_t)fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+	if (pData == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	mData = (uint8*)pData;
+	mSize = fileSize;
+	return true;
+}
+
+void FWebSocketMappedFile::Close()
+{
+	if (mData != nullptr)
+	{
+		munmap(mData, (size_t)mSize);
+		mData = nullptr;
+	}
+
+	if (mFile >= 0)
+	{
+		close(mFile);
+		mFile = -1;
+	}
+	mSize = 0;
+}
+
+bool FWebSocketMappedFile::Flush(int64 offset, int64 len)
+{
+	if (mData == nullptr)
+	{
+		return false;
+	}
+
+	// msync wants a page aligned start, clean pages in the range cost nothing
+	int64 iPageSize = (int64)sysconf(_SC_PAGESIZE);
+	int64 iStart = offset / iPageSize * iPageSize;
+	return msync(mData + iStart, (size_t)(offset + len - iStart), MS_SYNC) == 0;
+}
+#endif
+
+FWebSocketJournal::FWebSocketJournal(const FString& path)
+	:mPath(path), mHead(WEBSOCKET_JOURNAL_HEADER_SIZE), mTail(WEBSOCKET_JOURNAL_HEADER_SIZE), mEpoch(0), mAckedSequence(0), mLastSequence(0),
+	mPendingMessages(0), mAppendedMessages(0), mUnsyncedBytes(0)
+{
+}
+
+FWebSocketJournal::~FWebSocketJournal()
+{
+	if (mSyncTicker.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(mSyncTicker);
+		mSyncTicker.Reset();
+	}
+
+	WaitForSync();
+	if (mFile.IsOpen())
+	{
+		mFile.Flush(0, mTail);
+		mFile.Close();
+	}
+}
+
+TSharedPtr<FWebSocketJournal, ESPMode::ThreadSafe> FWebSocketJournal::OpenLane(const FString& name)
+{
+	static TMap<FString, TWeakPtr<FWebSocketJournal, ESPMode::ThreadSafe>> GJournals;
+
+	if (GJournals.FindRef(name).IsValid())
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: durable lane %s is open on another socket"), *name);
+		return nullptr;
+	}
+
+	TSharedPtr<FWebSocketJournal, ESPMode::ThreadSafe> journal = MakeShareable(new FWebSocketJournal(FPaths::ProjectSavedDir() / TEXT("WebSocket") / (name + TEXT(".journal"))));
+	if (!journal->Open())
+	{
+		return nullptr;
+	}
+
+	GJournals.Add(name, journal);
+	return journal;
+}
+
+bool FWebSocketJournal::Open()
+{
+	IFileManager& fileManager = IFileManager::Get();
+	fileManager.MakeDirectory(*FPaths::GetPath(mPath), true);
+
+	// a crash during Rewrite leaves the new journal next to the old one, or alone when the old one was removed already
+	FString strTmpPath = mPath + TEXT(".tmp");
+	if (fileManager.FileExists(*strTmpPath))
+	{
+		if (fileManager.FileExists(*mPath))
+		{
+			fileManager.Delete(*strTmpPath, false, false, true);
+		}
+		else
+		{
+			fileManager.Move(*mPath, *strTmpPath, true);
+		}
+	}
+
+	const UWebSocketSettings* Settings = GetDefault<UWebSocketSettings>();
+	int64 iCapacity = FMath::Max<int64>(Settings->DurableJournalBytes, WEBSOCKET_JOURNAL_HEADER_SIZE * 2);
+	if (!mFile.Open(mPath, iCapacity))
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: can not map the journal %s"), *mPath);
+		return false;
+	}
+
+	FWebSocketJournalHeader* pHeader = (FWebSocketJournalHeader*)mFile.GetData();
+	if (pHeader->Magic != WEBSOCKET_JOURNAL_MAGIC || pHeader->Version != WEBSOCKET_JOURNAL_VERSION)
+	{
+		if (pHeader->Magic != 0)
+		{
+			UE_LOG(WebSocket, Warning, TEXT("websocket: %s is no journal of this version, starting a new one"), *mPath);
+		}
+		FMemory::Memzero(mFile.GetData(), mFile.GetSize());
+		pHeader->Magic = WEBSOCKET_JOURNAL_MAGIC;
+		pHeader->Version = WEBSOCKET_JOURNAL_VERSION;
+	}
+
+	Recover();
+
+	// the new epoch has to be on disk before its first sequence can reach the server
+	mEpoch = pHeader->Epoch + 1;
+	WriteHeader();
+	if (!mFile.Flush(0, WEBSOCKET_JOURNAL_HEADER_SIZE))
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: can not write the journal %s"), *mPath);
+		mFile.Close();
+		return false;
+	}
+
+	if (mPendingMessages > 0)
+	{
+		UE_LOG(WebSocket, Log, TEXT("websocket: journal %s has %d unacknowledged messages"), *mPath, mPendingMessages);
+	}
+	return true;
+}
+
+bool FWebSocketJournal::Recover()
+{
+	const FWebSocketJournalHeader* pHeader = (const FWebSocketJournalHeader*)mFile.GetData();
+	mAckedSequence = pHeader->AckedSequence;
+	mPendingMessages = 0;
+
+	// follow the chain of growing sequences, a torn write or a stale entry behind a rewind ends it
+	int64 iOffset = WEBSOCKET_JOURNAL_HEADER_SIZE;
+	int64 iHead = -1;
+	uint64 prevSequence = 0;
+	while (iOffset + WEBSOCKET_JOURNAL_ENTRY_HEADER_SIZE <= mFile.GetSize())
+	{
+		const FWebSocketJournalEntry* pEntry = (const FWebSocketJournalEntry*)(mFile.GetData() + iOffset);
+		int64 iSpan = GetEntrySpan(GetPayloadLen(*pEntry));
+		if (pEntry->Sequence <= prevSequence || iOffset + iSpan > mFile.GetSize()
+			|| pEntry->Crc != GetEntryCrc(*pEntry, (const uint8*)pEntry + WEBSOCKET_JOURNAL_ENTRY_HEADER_SIZE))
+		{
+			break;
+		}
+
+		if (pEntry->Sequence > mAckedSequence)
+		{
+			if (iHead < 0)
+			{
+				iHead = iOffset;
+			}
+			mPendingMessages++;
+		}
+		prevSequence = pEntry->Sequence;
+		iOffset += iSpan;
+	}
+
+	mTail = iOffset;
+	mHead = iHead < 0 ? mTail : iHead;
+	mLastSequence = FMath::Max(prevSequence, mAckedSequence);
+	return mPendingMessages > 0;
+}
+
+uint64 FWebSocketJournal::Append(const uint8* data, int32 len, bool bBinary)
+{
+	int64 iSpan = GetEntrySpan(len);
+	if (!mFile.IsOpen() || !Reserve(iSpan))
+	{
+		return 0;
+	}
+
+	uint64 sequence = FMath::Max(mLastSequence + 1, ((uint64)mEpoch << 32) | 1);
+
+	uint8* p = mFile.GetData() + mTail;
+	FWebSocketJournalEntry* pEntry = (FWebSocketJournalEntry*)p;
+	FMemory::Memcpy(p + WEBSOCKET_JOURNAL_ENTRY_HEADER_SIZE, data, len);
+	pEntry->Size = (uint32)len | (bBinary ? WEBSOCKET_JOURNAL_BINARY_FLAG : 0);
+	pEntry->Sequence = sequence;
+	pEntry->Crc = GetEntryCrc(*pEntry, p + WEBSOCKET_JOURNAL_ENTRY_HEADER_SIZE);
+
+	mTail += iSpan;
+	mLastSequence = sequence;
+	mPendingMessages++;
+	mAppendedMessages++;
+	mUnsyncedBytes += iSpan;
+	ScheduleSync();
+	return sequence;
+}
+
+bool FWebSocketJournal::Reserve(int64 len)
+{
+	if (mTail + len <= mFile.GetSize())
+	{
+		return true;
+	}
+
+	// keep half of the new file free, so the next rewrite is as far away as this one was
+	const UWebSocketSettings* Settings = GetDefault<UWebSocketSettings>();
+	int64 iNeeded = WEBSOCKET_JOURNAL_HEADER_SIZE + (mTail - mHead) + len;
+	int64 iCapacity = mFile.GetSize();
+	while (iCapacity < iNeeded * 2)
+	{
+		iCapacity *= 2;
+	}
+
+	if (iCapacity > Settings->MaxDurableJournalBytes)
+	{
+		iCapacity = FMath::Max<int64>(Settings->MaxDurableJournalBytes, mFile.GetSize());
+		if (iNeeded > iCapacity)
+		{
+			UE_LOG(WebSocket, Warning, TEXT("websocket: journal %s is full with %d unacknowledged messages"), *mPath, mPendingMessages);
+			return false;
+		}
+	}
+	return Rewrite(iCapacity);
+}
+
+bool FWebSocketJournal::Rewrite(int64 capacity)
+{
+	WaitForSync();
+
+	IFileManager& fileManager = IFileManager::Get();
+	FString strTmpPath = mPath + TEXT(".tmp");
+	fileManager.Delete(*strTmpPath, false, false, true);
+
+	int64 iLive = mTail - mHead;
+	FWebSocketMappedFile tmp;
+	if (!tmp.Open(strTmpPath, capacity))
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: can not map %s"), *strTmpPath);
+		return false;
+	}
+
+	WriteHeader();
+	FMemory::Memcpy(tmp.GetData(), mFile.GetData(), WEBSOCKET_JOURNAL_HEADER_SIZE);
+	FMemory::Memcpy(tmp.GetData() + WEBSOCKET_JOURNAL_HEADER_SIZE, mFile.GetData() + mHead, iLive);
+	bool bFlushed = tmp.Flush(0, WEBSOCKET_JOURNAL_HEADER_SIZE + iLive);
+	tmp.Close();
+
+	int64 iOldSize = mFile.GetSize();
+	mFile.Close();
+	if (!bFlushed || !fileManager.Move(*mPath, *strTmpPath, true))
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: can not rewrite the journal %s"), *mPath);
+		fileManager.Delete(*strTmpPath, false, false, true);
+		if (mFile.Open(mPath, iOldSize) && ((const FWebSocketJournalHeader*)mFile.GetData())->Magic != WEBSOCKET_JOURNAL_MAGIC)
+		{
+			mFile.Close();
+		}
+		return false;
+	}
+
+	if (!mFile.Open(mPath, capacity))
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: can not map the journal %s"), *mPath);
+		return false;
+	}
+
+	mHead = WEBSOCKET_JOURNAL_HEADER_SIZE;
+	mTail = mHead + iLive;
+	mUnsyncedBytes = 0;
+	return true;
+}
+
+void FWebSocketJournal::Acknowledge(uint64 sequence)
+{
+	sequence = FMath::Min(sequence, mLastSequence);
+	if (!mFile.IsOpen() || sequence <= mAckedSequence)
+	{
+		return;
+	}
+
+	while (mHead < mTail)
+	{
+		const FWebSocketJournalEntry* pEntry = (const FWebSocketJournalEntry*)(mFile.GetData() + mHead);
+		if (pEntry->Sequence > sequence)
+		{
+			break;
+		}
+		mHead += GetEntrySpan(GetPayloadLen(*pEntry));
+		mPendingMessages--;
+	}
+
+	// nothing left to keep, the next append starts over at the front where the pages are warm
+	if (mPendingMessages == 0)
+	{
+		mHead = WEBSOCKET_JOURNAL_HEADER_SIZE;
+		mTail = WEBSOCKET_JOURNAL_HEADER_SIZE;
+	}
+
+	mAckedSequence = sequence;
+	WriteHeader();
+}
+
+void FWebSocketJournal::ForEachPending(TFunctionRef<void(uint64 sequence, const uint8* data, int32 len, bool bBinary)> fn) const
+{
+	int64 iOffset = mHead;
+	while (iOffset < mTail)
+	{
+		const FWebSocketJournalEntry* pEntry = (const FWebSocketJournalEntry*)(mFile.GetData() + iOffset);
+		int32 iLen = GetPayloadLen(*pEntry);
+		fn(pEntry->Sequence, (const uint8*)pEntry + WEBSOCKET_JOURNAL_ENTRY_HEADER_SIZE, iLen, (pEntry->Size & WEBSOCKET_JOURNAL_BINARY_FLAG) != 0);
+		iOffset += GetEntrySpan(iLen);
+	}
+}
+
+void FWebSocketJournal::WriteHeader()
+{
+	FWebSocketJournalHeader* pHeader = (FWebSocketJournalHeader*)mFile.GetData();
+	pHeader->Epoch = mEpoch;
+	pHeader->AckedSequence = mAckedSequence;
+}
+
+void FWebSocketJournal::ScheduleSync()
+{
+	if (mUnsyncedBytes >= GetDefault<UWebSocketSettings>()->DurableSyncBytes && Sync())
+	{
+		return;
+	}
+
+	if (mSyncTicker.IsValid())
+	{
+		return;
+	}
+
+	TWeakPtr<FWebSocketJournal, ESPMode::ThreadSafe> weakJournal = AsShared();
+	mSyncTicker = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([weakJournal](float DeltaTime)
+	{
+		TSharedPtr<FWebSocketJournal, ESPMode::ThreadSafe> journal = weakJournal.Pin();
+		if (!journal.IsValid())
+		{
+			return false;
+		}
+
+		// tick again while the previous batch is still being written
+		if (!journal->Sync())
+		{
+			return true;
+		}
+		journal->mSyncTicker.Reset();
+		return false;
+	}), GetDefault<UWebSocketSettings>()->DurableSyncIntervalMs / 1000.0f);
+}
+
+bool FWebSocketJournal::Sync()
+{
+	if (!mFile.IsOpen() || mUnsyncedBytes == 0)
+	{
+		return true;
+	}
+
+	if (mSyncTask.IsValid() && !mSyncTask->IsComplete())
+	{
+		return false;
+	}
+
+	// appends keep copying into the mapping meanwhile, only Rewrite and the destructor unmap and they wait for the job
+	FWebSocketJournal* pJournal = this;
+	int64 iLen = mTail;
+	mUnsyncedBytes = 0;
+	mSyncTask = FFunctionGraphTask::CreateAndDispatchWhenReady([pJournal, iLen]()
+	{
+		if (!pJournal->mFile.Flush(0, iLen))
+		{
+			UE_LOG(WebSocket, Error, TEXT("websocket: journal %s write fail"), *pJournal->mPath);
+		}
+		pJournal->mSyncs.Increment();
+	}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+	return true;
+}
+
+void FWebSocketJournal::WaitForSync()
+{
+	if (mSyncTask.IsValid())
+	{
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(mSyncTask);
+		mSyncTask = nullptr;
+	}
+}
+
+FWebSocketDurableStats FWebSocketJournal::GetStats() const
+{
+	FWebSocketDurableStats stats;
+	stats.bOpen = mFile.IsOpen();
+	stats.PendingMessages = mPendingMessages;
+	stats.PendingBytes = (int32)(mTail - mHead);
+	stats.AppendedMessages = mAppendedMessages;
+	stats.JournalBytes = (int32)mFile.GetSize();
+	stats.Syncs = mSyncs.GetValue();
+	return stats;
+}
+#endif
@@ -0,0 +1,139 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Containers/Ticker.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "WebSocketBase.h"
+#include "WebSocketStats.h"
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+/**
+ * read write mapping of a whole file, the size is fixed until the next Open.
+ * Flush writes a range back to disk and waits for it.
+ */
+class FWebSocketMappedFile
+{
+public:
+
+	FWebSocketMappedFile();
+	~FWebSocketMappedFile();
+
+	/** create path when it does not exist, grow it to at least size bytes and map all of it */
+	bool Open(const FString& path, int64 size);
+	void Close();
+
+	bool IsOpen() const { return mData != nullptr; }
+	uint8* GetData() const { return mData; }
+	int64 GetSize() const { return mSize; }
+
+	bool Flush(int64 offset, int64 len);
+
+private:
+
+	uint8* mData;
+	int64 mSize;
+#if PLATFORM_WINDOWS
+	void* mFile;
+	void* mMapping;
+#else
+	int mFile;
+#endif
+};
+
+/**
+ * append only journal of the messages a durable lane sent, in Saved/WebSocket/<name>.journal.
+ * appends are copied into the mapping and written to disk in batches by a task graph worker, so a
+ * crash loses at most DurableSyncIntervalMs of messages. once everything is acknowledged the next
+ * append starts over at the front of the file, when the file runs full the unacknowledged entries
+ * are rewritten into a new file of the right size.
+ *
+ * a sequence is the launch's epoch in the high 32 bits and a counter in the low ones, the epoch is
+ * on disk before the first append, so sequences keep growing even when a crash lost the tail of
+ * the journal. entries form a chain of growing sequences from the front of the file, stale entries
+ * behind a rewind end the chain.
+ *
+ * game thread only, except for the sync job.
+ */
+class FWebSocketJournal : public TSharedFromThis<FWebSocketJournal, ESPMode::ThreadSafe>
+{
+public:
+
+	FWebSocketJournal(const FString& path);
+	~FWebSocketJournal();
+
+	/**
+	 * the journal of lane name. one socket owns a lane at a time, a second one would replay the same entries
+	 * and acknowledge what the first did not deliver. null when it can not be opened or is owned already
+	 */
+	static TSharedPtr<FWebSocketJournal, ESPMode::ThreadSafe> OpenLane(const FString& name);
+
+	/** map the file, start a new epoch and recover the entries that were not acknowledged yet */
+	bool Open();
+
+	/** returns the sequence, 0 when the journal can not take the message */
+	uint64 Append(const uint8* data, int32 len, bool bBinary);
+
+	/** drop everything up to sequence, the acknowledgement reaches the disk with the next batch */
+	void Acknowledge(uint64 sequence);
+
+	/** entries that are not acknowledged yet, oldest first */
+	void ForEachPending(TFunctionRef<void(uint64 sequence, const uint8* data, int32 len, bool bBinary)> fn) const;
+
+	/** write everything appended so far to disk unless a write is still running, false when it has to be retried */
+	bool Sync();
+
+	FWebSocketDurableStats GetStats() const;
+
+private:
+
+	bool Recover();
+	bool Reserve(int64 len);
+	bool Rewrite(int64 capacity);
+	void WriteHeader();
+	void ScheduleSync();
+	void WaitForSync();
+
+	FString mPath;
+	FWebSocketMappedFile mFile;
+
+	/** offsets into the mapping, unacknowledged entries live in [mHead, mTail) */
+	int64 mHead;
+	int64 mTail;
+	uint32 mEpoch;
+	uint64 mAckedSequence;
+	uint64 mLastSequence;
+	int32 mPendingMessages;
+	int32 mAppendedMessages;
+
+	/** bytes appended since the last batch went to disk */
+	int64 mUnsyncedBytes;
+	FDelegateHandle mSyncTicker;
+	FGraphEventRef mSyncTask;
+	FThreadSafeCounter mSyncs;
+};
+#endif
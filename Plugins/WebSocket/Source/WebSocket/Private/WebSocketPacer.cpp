@@ -0,0 +1,257 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+#include "WebSocket.h"
+#include "WebSocketPacer.h"
+#include "WebSocketBase.h"
+#include "WebSocketSettings.h"
+
+#define WEBSOCKET_PACING_BANDWIDTH_SAMPLES 10
+#define WEBSOCKET_PACING_MIN_RTT_WINDOW 10.0
+#define WEBSOCKET_PACING_STARTUP_GAIN 2.0
+#define WEBSOCKET_PACING_INFLIGHT_GAIN 2.0
+#define WEBSOCKET_PACING_PING_TIMEOUT 2.0
+
+static const double GPacingGainCycle[] = { 1.25, 0.75, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0 };
+
+FWebSocketPacer::FWebSocketPacer()
+	:mbEnabled(false), mMinRate(0.0), mMaxRate(0.0), mBurst(0.0), mProbeInterval(0.1), mRate(0.0), mTokens(0.0), mLastRefill(0.0),
+	mBytesSent(0), mBytesAcked(0), mLastAckTime(0.0), mbPingOutstanding(false), mPingTime(0.0), mPingBytes(0), mbPingAppLimited(false), mbAppLimited(false),
+	mBandwidth(0.0), mRtt(0.0), mMinRtt(0.0), mMinRttTime(0.0), mbStartup(true), mFullBandwidth(0.0), mFullBandwidthRounds(0), mCycleIndex(0), mCycleStart(0.0), mPacedWaits(0)
+{
+}
+
+void FWebSocketPacer::Init(const UWebSocketSettings* settings, double now)
+{
+	mbEnabled = settings->bEnablePacing;
+	mMinRate = settings->MinPacingRate;
+	mMaxRate = settings->MaxPacingRate > 0 ? FMath::Max(settings->MaxPacingRate, settings->MinPacingRate) : 0.0;
+	mBurst = settings->PacingBurstBytes;
+	mProbeInterval = settings->PacingProbeIntervalMs / 1000.0;
+
+	mRate = FMath::Max<double>(settings->InitialPacingRate, mMinRate);
+	if (mMaxRate > 0.0)
+	{
+		mRate = FMath::Min(mRate, mMaxRate);
+	}
+	mTokens = mBurst;
+	mLastRefill = now;
+	mLastAckTime = now;
+	mPingTime = now;
+	mCycleStart = now;
+	UpdateStats();
+}
+
+void FWebSocketPacer::Refill(double now)
+{
+	mTokens = FMath::Min(mBurst, mTokens + mRate * (now - mLastRefill));
+	mLastRefill = now;
+}
+
+bool FWebSocketPacer::IsInflightLimited() const
+{
+	if (mBandwidth <= 0.0 || mMinRtt <= 0.0)
+	{
+		return false;
+	}
+
+	double dLimit = WEBSOCKET_PACING_INFLIGHT_GAIN * (mbStartup ? WEBSOCKET_PACING_STARTUP_GAIN : 1.0) * mBandwidth * mMinRtt + mBurst;
+	return (double)(mBytesSent - mBytesAcked) >= dLimit;
+}
+
+bool FWebSocketPacer::CanSend(double now)
+{
+	Refill(now);
+	return mTokens >= 0.0 && !IsInflightLimited();
+}
+
+void FWebSocketPacer::OnSent(int32 bytes)
+{
+	mTokens -= bytes;
+	mBytesSent += bytes;
+}
+
+double FWebSocketPacer::OnBlocked(double now)
+{
+	mPacedWaits++;
+	{
+		FScopeLock lock(&mStatsLock);
+		mStats.PacedWaits = mPacedWaits;
+	}
+
+	// waiting for a pong, look again in case it never comes
+	if (mTokens >= 0.0)
+	{
+		return now + FMath::Max(mProbeInterval, 2.0 * mRtt);
+	}
+
+	return now + (-mTokens / mRate);
+}
+
+bool FWebSocketPacer::ShouldPing(double now)
+{
+	if (mbPingOutstanding)
+	{
+		if (now - mPingTime < WEBSOCKET_PACING_PING_TIMEOUT)
+		{
+			return false;
+		}
+
+		// a server that does not answer pings leaves the token bucket at the last estimate
+		UE_LOG(WebSocket, Verbose, TEXT("websocket: pacing ping lost"));
+		mbPingOutstanding = false;
+		mBytesAcked = mPingBytes;
+		mLastAckTime = now;
+	}
+
+	if (mBytesSent == mPingBytes)
+	{
+		return false;
+	}
+
+	return now - mPingTime >= mProbeInterval || IsInflightLimited();
+}
+
+void FWebSocketPacer::OnPingSent(double now)
+{
+	mbPingOutstanding = true;
+	mPingTime = now;
+	mPingBytes = mBytesSent;
+	mbPingAppLimited = mbAppLimited;
+	mbAppLimited = false;
+}
+
+void FWebSocketPacer::OnPong(double now)
+{
+	if (!mbPingOutstanding)
+	{
+		return;
+	}
+	mbPingOutstanding = false;
+
+	mRtt = now - mPingTime;
+	if (mMinRtt <= 0.0 || mRtt <= mMinRtt || now - mMinRttTime > WEBSOCKET_PACING_MIN_RTT_WINDOW)
+	{
+		mMinRtt = mRtt;
+		mMinRttTime = now;
+	}
+
+	// the first pong after an idle period spans the idle time too, it counts as app limited
+	int64 iDelivered = mPingBytes - mBytesAcked;
+	double dInterval = now - mLastAckTime;
+	bool bAppLimited = mbPingAppLimited || dInterval > 2.0 * (mProbeInterval + mRtt);
+	mBytesAcked = mPingBytes;
+	mLastAckTime = now;
+
+	if (iDelivered > 0 && dInterval > 0.0)
+	{
+		AddBandwidthSample(iDelivered / dInterval, bAppLimited, now);
+	}
+
+	UpdateRate(now);
+	UpdateStats();
+}
+
+void FWebSocketPacer::AddBandwidthSample(double sample, bool bAppLimited, double now)
+{
+	if (bAppLimited && sample <= mBandwidth)
+	{
+		return;
+	}
+
+	mBandwidthSamples.Add(sample);
+	if (mBandwidthSamples.Num() > WEBSOCKET_PACING_BANDWIDTH_SAMPLES)
+	{
+		mBandwidthSamples.RemoveAt(0, 1, false);
+	}
+
+	mBandwidth = 0.0;
+	for (double it : mBandwidthSamples)
+	{
+		mBandwidth = FMath::Max(mBandwidth, it);
+	}
+
+	// startup ends once three samples in a row did not grow the estimate by a quarter
+	if (!mbStartup || bAppLimited)
+	{
+		return;
+	}
+
+	if (mBandwidth >= mFullBandwidth * 1.25)
+	{
+		mFullBandwidth = mBandwidth;
+		mFullBandwidthRounds = 0;
+		return;
+	}
+
+	if (++mFullBandwidthRounds >= 3)
+	{
+		UE_LOG(WebSocket, Verbose, TEXT("websocket: pacing startup done, %.0f bytes/s"), mBandwidth);
+		mbStartup = false;
+		mCycleIndex = 1;
+		mCycleStart = now;
+	}
+}
+
+void FWebSocketPacer::UpdateRate(double now)
+{
+	if (mBandwidth <= 0.0)
+	{
+		return;
+	}
+
+	double dGain = WEBSOCKET_PACING_STARTUP_GAIN;
+	if (!mbStartup)
+	{
+		if (now - mCycleStart >= FMath::Max(mMinRtt, mProbeInterval))
+		{
+			mCycleIndex = (mCycleIndex + 1) % ARRAY_COUNT(GPacingGainCycle);
+			mCycleStart = now;
+		}
+		dGain = GPacingGainCycle[mCycleIndex];
+	}
+
+	mRate = FMath::Max(dGain * mBandwidth, mMinRate);
+	if (mMaxRate > 0.0)
+	{
+		mRate = FMath::Min(mRate, mMaxRate);
+	}
+}
+
+void FWebSocketPacer::UpdateStats()
+{
+	FScopeLock lock(&mStatsLock);
+	mStats.bEnabled = mbEnabled;
+	mStats.EstimatedBandwidth = (float)mBandwidth;
+	mStats.PacingRate = (float)mRate;
+	mStats.RttMs = (float)(mRtt * 1000.0);
+	mStats.MinRttMs = (float)(mMinRtt * 1000.0);
+	mStats.BytesInFlight = (int32)(mBytesSent - mBytesAcked);
+	mStats.bStartup = mbStartup;
+	mStats.PacedWaits = mPacedWaits;
+}
+
+FWebSocketPacingStats FWebSocketPacer::GetStats() const
+{
+	FScopeLock lock(&mStatsLock);
+	return mStats;
+}
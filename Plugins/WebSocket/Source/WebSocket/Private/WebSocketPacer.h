@@ -0,0 +1,114 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/ScopeLock.h"
+#include "WebSocketStats.h"
+
+class UWebSocketSettings;
+
+/**
+ * send pacing for one connection. the server's pongs acknowledge everything written before the
+ * matching ping, the bytes acknowledged between two pongs give a delivery rate sample and the ping
+ * itself the rtt. the best recent sample is the bandwidth estimate, the token bucket refills at a
+ * gain times it: doubling while the estimate still grows, then cycling 1.25, 0.75 and six rounds of 1
+ * so the estimate follows a link that got faster and the queue built by the probe drains again.
+ * unacknowledged bytes are capped at twice the bandwidth delay product, so a wrong estimate can not
+ * fill the socket buffer either.
+ *
+ * everything but GetStats runs on the service thread.
+ */
+class FWebSocketPacer
+{
+public:
+
+	FWebSocketPacer();
+
+	void Init(const UWebSocketSettings* settings, double now);
+	bool IsEnabled() const { return mbEnabled; }
+
+	/** a frame may be written now, it may overdraw the bucket */
+	bool CanSend(double now);
+	void OnSent(int32 bytes);
+
+	/** CanSend refused, returns when to try again. acknowledgements wake the connection up by themselves */
+	double OnBlocked(double now);
+
+	/** the send queues ran empty before the bucket did, the current sample only counts if it raises the estimate */
+	void OnAppLimited() { mbAppLimited = true; }
+
+	bool ShouldPing(double now);
+	void OnPingSent(double now);
+	void OnPong(double now);
+
+	/** any thread */
+	FWebSocketPacingStats GetStats() const;
+
+private:
+
+	void Refill(double now);
+	void AddBandwidthSample(double sample, bool bAppLimited, double now);
+	void UpdateRate(double now);
+	bool IsInflightLimited() const;
+	void UpdateStats();
+
+	bool mbEnabled;
+	double mMinRate;
+	double mMaxRate;
+	double mBurst;
+	double mProbeInterval;
+
+	/** token bucket */
+	double mRate;
+	double mTokens;
+	double mLastRefill;
+
+	/** bytes written and acknowledged since Init */
+	int64 mBytesSent;
+	int64 mBytesAcked;
+	double mLastAckTime;
+
+	bool mbPingOutstanding;
+	double mPingTime;
+	int64 mPingBytes;
+	bool mbPingAppLimited;
+	bool mbAppLimited;
+
+	/** max filter over the last samples, min filter over WEBSOCKET_PACING_MIN_RTT_WINDOW seconds */
+	TArray<double> mBandwidthSamples;
+	double mBandwidth;
+	double mRtt;
+	double mMinRtt;
+	double mMinRttTime;
+
+	bool mbStartup;
+	double mFullBandwidth;
+	int32 mFullBandwidthRounds;
+	int32 mCycleIndex;
+	double mCycleStart;
+	int32 mPacedWaits;
+
+	mutable FCriticalSection mStatsLock;
+	FWebSocketPacingStats mStats;
+};
@@ -0,0 +1,460 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#include "WebSocket.h"
+#include "WebSocketPool.h"
+#include "WebSocketContext.h"
+#include "Containers/Ticker.h"
+#include "UObject/UObjectArray.h"
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+#include "WebSocketCodec.h"
+#include "WebSocketConnection.h"
+#endif
+
+FWebSocketPool::FWebSocketPool(UWebSocketContext* context, IWebSocketPoolListener* listener)
+{
+	mContext = context;
+	mListener = listener;
+	mFreeHead = INDEX_NONE;
+	mFreeCount = 0;
+	mOpenCount = 0;
+	mReusedSlots = 0;
+	mDeliverFrame = 0;
+	mDeliveredBytes = 0;
+}
+
+FWebSocketPool::~FWebSocketPool()
+{
+	// the connections outlive the pool until lws closed their wsi, their events are dropped from now on
+	CloseAll(1001, TEXT(""), 0.0f);
+}
+
+FWebSocketHandle FWebSocketPool::Connect(const FString& uri, const TMap<FString, FString>& header, const FString& protocol)
+{
+#if PLATFORM_UWP
+	UE_LOG(WebSocket, Error, TEXT("websocket: FWebSocketPool is not supported on uwp"));
+	return FWebSocketHandle();
+#elif PLATFORM_HTML5
+	UE_LOG(WebSocket, Error, TEXT("websocket: FWebSocketPool is not supported on html5"));
+	return FWebSocketHandle();
+#else
+	UWebSocketContext* pContext = mContext.Get();
+	if (pContext == nullptr || pContext->GetLwsContext() == nullptr)
+	{
+		return FWebSocketHandle();
+	}
+
+	int32 iProtocol = pContext->FindProtocol(protocol);
+	if (iProtocol == INDEX_NONE)
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: protocol '%s' is not registered in the websocket settings"), *protocol);
+		return FWebSocketHandle();
+	}
+
+	FWebSocketUri target;
+	if (!FWebSocketUri::Parse(uri, target))
+	{
+		return FWebSocketHandle();
+	}
+
+	FWebSocketHandle handle = AllocSlot();
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> connection = MakeShareable(new FWebSocketConnection(pContext, nullptr, MakeShareable(new FWebSocketInbox())));
+	connection->SetPool(AsShared(), handle);
+	connection->SetTextAsUtf8(true);
+
+	TSharedPtr<const FWebSocketDictionaryCodec, ESPMode::ThreadSafe> codec = pContext->GetDictionaryCodec();
+	if (codec.IsValid() && pContext->GetProtocolConfig(iProtocol).Codec == EWebSocketPayloadCodec::Text)
+	{
+		connection->SetCodec(codec.ToSharedRef());
+	}
+
+	// assigned before opening, lws may report a failed connect before OpenUri returned
+	mSlots[handle.Index].Connection = connection;
+	mSlots[handle.Index].RxBufferSize = pContext->GetProtocolConfig(iProtocol).RxBufferSize;
+	if (!connection->OpenUri(target, header, iProtocol))
+	{
+		FreeSlot(handle);
+		return FWebSocketHandle();
+	}
+
+	return handle;
+#endif
+}
+
+bool FWebSocketPool::SendText(FWebSocketHandle handle, const FString& data)
+{
+#if PLATFORM_UWP
+	return false;
+#elif PLATFORM_HTML5
+	return false;
+#else
+	FSlot* pSlot = FindSlot(handle);
+	if (pSlot == nullptr || !pSlot->Connection->IsAlive())
+	{
+		return false;
+	}
+
+	pSlot->Connection->SendText(data);
+	return true;
+#endif
+}
+
+bool FWebSocketPool::SendBinary(FWebSocketHandle handle, const TArray<uint8>& data)
+{
+#if PLATFORM_UWP
+	return false;
+#elif PLATFORM_HTML5
+	return false;
+#else
+	FSlot* pSlot = FindSlot(handle);
+	if (pSlot == nullptr || !pSlot->Connection->IsAlive())
+	{
+		return false;
+	}
+
+	pSlot->Connection->SendBinary(data);
+	return true;
+#endif
+}
+
+bool FWebSocketPool::SendFrame(FWebSocketHandle handle, FWebSocketFrameHandle frame)
+{
+#if PLATFORM_UWP
+	return false;
+#elif PLATFORM_HTML5
+	return false;
+#else
+	UWebSocketContext* pContext = mContext.Get();
+	const FWebSocketCachedFrame* pFrame = (pContext != nullptr) ? pContext->FindFrame(frame) : nullptr;
+	if (pFrame == nullptr)
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: frame %d is not registered on the pool's context"), frame.Id);
+		return false;
+	}
+
+	FSlot* pSlot = FindSlot(handle);
+	if (pSlot == nullptr || !pSlot->Connection->IsAlive())
+	{
+		return false;
+	}
+
+	pSlot->Connection->SendFrame(*pFrame);
+	pContext->CountFrameSend();
+	return true;
+#endif
+}
+
+bool FWebSocketPool::Ping(FWebSocketHandle handle)
+{
+#if PLATFORM_UWP
+	return false;
+#elif PLATFORM_HTML5
+	return false;
+#else
+	FSlot* pSlot = FindSlot(handle);
+	if (pSlot == nullptr || !pSlot->Connection->IsAlive())
+	{
+		return false;
+	}
+
+	pSlot->Connection->SendPing();
+	return true;
+#endif
+}
+
+void FWebSocketPool::Close(FWebSocketHandle handle, int32 code, const FString& reason, float drainTimeout)
+{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	FSlot* pSlot = FindSlot(handle);
+	if (pSlot != nullptr && mContext.IsValid())
+	{
+		pSlot->Connection->Close(code, reason, drainTimeout);
+	}
+#endif
+}
+
+void FWebSocketPool::CloseAll(int32 code, const FString& reason, float drainTimeout)
+{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	if (!mContext.IsValid())
+	{
+		return;
+	}
+
+	for (FSlot& it : mSlots)
+	{
+		if (it.bTaken)
+		{
+			it.Connection->Close(code, reason, drainTimeout);
+		}
+	}
+#endif
+}
+
+bool FWebSocketPool::IsOpen(FWebSocketHandle handle) const
+{
+#if PLATFORM_UWP
+	return false;
+#elif PLATFORM_HTML5
+	return false;
+#else
+	const FSlot* pSlot = FindSlot(handle);
+	return pSlot != nullptr && pSlot->bOpen && pSlot->Connection->IsAlive();
+#endif
+}
+
+FWebSocketPoolStats FWebSocketPool::GetStats() const
+{
+	FWebSocketPoolStats stats;
+	stats.OpenConnections = mOpenCount;
+	stats.Slots = mSlots.Num();
+	stats.FreeSlots = mFreeCount;
+	stats.ReusedSlots = mReusedSlots;
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	// the structs plus the heap a connection holds: its rx buffer and the received bytes waiting in the inbox
+	int64 iHeapBytes = 0;
+	int32 iTaken = 0;
+	for (const FSlot& it : mSlots)
+	{
+		if (it.bTaken && it.Connection.IsValid())
+		{
+			iHeapBytes += it.RxBufferSize + it.Connection->GetInbox()->PendingBytes.GetValue();
+			iTaken++;
+		}
+	}
+	int32 iConnectionBytes = (int32)(sizeof(FWebSocketConnection) + sizeof(FWebSocketInbox)) + (iTaken > 0 ? (int32)(iHeapBytes / iTaken) : 0);
+	stats.BytesPerConnection = (int32)sizeof(FSlot) + iConnectionBytes;
+	stats.BytesPerObjectConnection = (int32)(sizeof(UWebSocketBase) + sizeof(FUObjectItem)) + iConnectionBytes;
+#endif
+	return stats;
+}
+
+void FWebSocketPool::HandleEstablished(FWebSocketConnection* connection, const FString& protocol)
+{
+	FWebSocketHandle handle = FindHandle(connection);
+	FSlot* pSlot = FindSlot(handle);
+	if (pSlot == nullptr)
+	{
+		return;
+	}
+
+	pSlot->bOpen = true;
+	mOpenCount++;
+	if (mListener != nullptr)
+	{
+		mListener->OnConnected(handle, protocol);
+	}
+}
+
+void FWebSocketPool::HandleConnectError(FWebSocketConnection* connection, const FString& error)
+{
+	FWebSocketHandle handle = FindHandle(connection);
+	if (!handle.IsValid())
+	{
+		return;
+	}
+
+	FreeSlot(handle);
+	if (mListener != nullptr)
+	{
+		mListener->OnConnectError(handle, error);
+	}
+}
+
+void FWebSocketPool::HandleClosed(FWebSocketConnection* connection)
+{
+	FWebSocketHandle handle = FindHandle(connection);
+	if (!handle.IsValid())
+	{
+		return;
+	}
+
+	// what arrived before the close still reaches the listener, then the slot is free for the next Connect
+	DeliverInbox(handle, true);
+	FreeSlot(handle);
+	if (mListener != nullptr)
+	{
+		mListener->OnClosed(handle);
+	}
+}
+
+void FWebSocketPool::HandlePong(FWebSocketConnection* connection, float rttMs)
+{
+	FWebSocketHandle handle = FindHandle(connection);
+	if (handle.IsValid() && mListener != nullptr)
+	{
+		mListener->OnPong(handle, rttMs);
+	}
+}
+
+void FWebSocketPool::HandleDeliver(FWebSocketConnection* connection)
+{
+	FWebSocketHandle handle = FindHandle(connection);
+	if (handle.IsValid())
+	{
+		DeliverInbox(handle);
+	}
+}
+
+void FWebSocketPool::DeliverInbox(FWebSocketHandle handle, bool bIgnoreBudget)
+{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	FSlot* pSlot = FindSlot(handle);
+	UWebSocketContext* pContext = mContext.Get();
+	if (pSlot == nullptr || pContext == nullptr)
+	{
+		return;
+	}
+
+	// the listener may connect and grow mSlots, the slot is not touched again after the first callback
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> connection = pSlot->Connection.ToSharedRef();
+	TSharedRef<FWebSocketInbox, ESPMode::ThreadSafe> inbox = connection->GetInbox();
+	inbox->bDeliverScheduled = false;
+
+	// MaxDeliverBytesPerFrame is shared by all connections of the pool
+	int32 iBudget = bIgnoreBudget ? 0 : pContext->GetSettings()->MaxDeliverBytesPerFrame;
+	if (mDeliverFrame != GFrameCounter)
+	{
+		mDeliverFrame = GFrameCounter;
+		mDeliveredBytes = 0;
+	}
+
+	FWebSocketInMessage msg;
+	while ((iBudget <= 0 || mDeliveredBytes < iBudget) && inbox->Messages.Dequeue(msg))
+	{
+		inbox->PendingMessages.Decrement();
+		mDeliveredBytes += msg.WireBytes;
+
+		// pooled connections open no channels, stray channel frames are dropped
+		if (mListener != nullptr && msg.Channel == INDEX_NONE)
+		{
+			mListener->OnMessage(handle, FWebSocketMessageView(msg.Binary, msg.bBinary));
+		}
+		connection->ReleaseRxBytes(msg.WireBytes);
+	}
+
+	if (inbox->Messages.IsEmpty() || inbox->bDeliverScheduled.AtomicSet(true))
+	{
+		return;
+	}
+
+	// the rest goes out next frame
+	TWeakPtr<FWebSocketPool, ESPMode::ThreadSafe> weakThis = AsShared();
+	FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([weakThis, handle](float DeltaTime)
+	{
+		if (TSharedPtr<FWebSocketPool, ESPMode::ThreadSafe> pPool = weakThis.Pin())
+		{
+			pPool->DeliverInbox(handle);
+		}
+		return false;
+	}));
+#endif
+}
+
+FWebSocketPool::FSlot* FWebSocketPool::FindSlot(FWebSocketHandle handle)
+{
+	if (!mSlots.IsValidIndex(handle.Index))
+	{
+		return nullptr;
+	}
+
+	FSlot& slot = mSlots[handle.Index];
+	return (slot.bTaken && slot.Generation == handle.Generation) ? &slot : nullptr;
+}
+
+const FWebSocketPool::FSlot* FWebSocketPool::FindSlot(FWebSocketHandle handle) const
+{
+	return const_cast<FWebSocketPool*>(this)->FindSlot(handle);
+}
+
+FWebSocketHandle FWebSocketPool::FindHandle(FWebSocketConnection* connection) const
+{
+#if PLATFORM_UWP
+	return FWebSocketHandle();
+#elif PLATFORM_HTML5
+	return FWebSocketHandle();
+#else
+	FWebSocketHandle handle = connection->GetPoolHandle();
+	const FSlot* pSlot = FindSlot(handle);
+	return (pSlot != nullptr && pSlot->Connection.Get() == connection) ? handle : FWebSocketHandle();
+#endif
+}
+
+FWebSocketHandle FWebSocketPool::AllocSlot()
+{
+	int32 iIndex = mFreeHead;
+	if (iIndex != INDEX_NONE)
+	{
+		mFreeHead = mSlots[iIndex].NextFree;
+		mFreeCount--;
+		mReusedSlots++;
+	}
+	else
+	{
+		iIndex = mSlots.AddDefaulted();
+	}
+
+	FSlot& slot = mSlots[iIndex];
+	slot.NextFree = INDEX_NONE;
+	slot.bTaken = true;
+	slot.bOpen = false;
+	return FWebSocketHandle(iIndex, slot.Generation);
+}
+
+void FWebSocketPool::FreeSlot(FWebSocketHandle handle)
+{
+	FSlot* pSlot = FindSlot(handle);
+	if (pSlot == nullptr)
+	{
+		return;
+	}
+
+	if (pSlot->bOpen)
+	{
+		mOpenCount--;
+	}
+
+	// a new generation makes every handle of the old connection stale
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	pSlot->Connection = nullptr;
+#endif
+	pSlot->Generation++;
+	pSlot->bTaken = false;
+	pSlot->bOpen = false;
+	pSlot->NextFree = mFreeHead;
+	mFreeHead = handle.Index;
+	mFreeCount++;
+}
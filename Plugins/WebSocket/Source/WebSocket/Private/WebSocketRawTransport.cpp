@@ -0,0 +1,324 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+#include "WebSocket.h"
+#include "WebSocketRawTransport.h"
+#include "Misc/Base64.h"
+#include "Misc/Guid.h"
+#include "Misc/SecureHash.h"
+
+#if WITH_WEBSOCKET_UNIX_SOCKET
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#define WEBSOCKET_RAW_MAX_FRAME (16*1024*1024)
+#define WEBSOCKET_RAW_MAX_HANDSHAKE (16*1024)
+#define WEBSOCKET_ACCEPT_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+int WebSocketConnectUnix(const FString& socketPath)
+{
+	std::string strPath = TCHAR_TO_UTF8(*socketPath);
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strPath.empty() || strPath.size() >= sizeof(addr.sun_path))
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: invalid unix socket path '%s'"), *socketPath);
+		return -1;
+	}
+	memcpy(addr.sun_path, strPath.c_str(), strPath.size());
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+#if PLATFORM_MAC
+	int iNoSigPipe = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &iNoSigPipe, sizeof(iNoSigPipe));
+#endif
+
+	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: connect to unix socket '%s' failed, errno %d"), *socketPath, errno);
+		::close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+FWebSocketRawClient::FWebSocketRawClient()
+	:Opcode(0), bFinal(false), Payload(nullptr), PayloadLen(0), mMaskIndex(WEBSOCKET_RAW_MASK_BATCH), mbUpgraded(false), mOffset(0)
+{
+}
+
+uint32 FWebSocketRawClient::NextMask()
+{
+	if (mMaskIndex < WEBSOCKET_RAW_MASK_BATCH)
+	{
+		return mMasks[mMaskIndex++];
+	}
+
+	ssize_t iRead = -1;
+	int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+	if (fd >= 0)
+	{
+		iRead = read(fd, mMasks, sizeof(mMasks));
+		close(fd);
+	}
+
+	if (iRead != (ssize_t)sizeof(mMasks))
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: /dev/urandom read fail, errno %d, masks from guids"), errno);
+		for (int32 i = 0; i < WEBSOCKET_RAW_MASK_BATCH; i += 4)
+		{
+			FGuid guid;
+			FPlatformMisc::CreateGuid(guid);
+			FMemory::Memcpy(&mMasks[i], &guid, sizeof(guid));
+		}
+	}
+
+	mMaskIndex = 1;
+	return mMasks[0];
+}
+
+std::string FWebSocketRawClient::MakeHandshake(const FString& path, const FString& protocol, const TMap<FString, FString>& header)
+{
+	FGuid guid = FGuid::NewGuid();
+	TArray<uint8> key((const uint8*)&guid, sizeof(guid));
+	mKey = FBase64::Encode(key);
+
+	FString strRequest = FString::Printf(TEXT("GET %s HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n"), *path, *mKey);
+	if (!protocol.IsEmpty())
+	{
+		strRequest += FString::Printf(TEXT("Sec-WebSocket-Protocol: %s\r\n"), *protocol);
+	}
+
+	for (auto& it : header)
+	{
+		strRequest += FString::Printf(TEXT("%s: %s\r\n"), *it.Key, *it.Value);
+	}
+	strRequest += TEXT("\r\n");
+
+	return std::string(TCHAR_TO_UTF8(*strRequest));
+}
+
+int32 FWebSocketRawClient::WriteFrameHeader(uint8* payload, int32 len, uint8 opcode, bool bFinal)
+{
+	uint32 uMask = NextMask();
+	const uint8* mask = (const uint8*)&uMask;
+
+	int32 iHeader = (len < 126 ? 2 : (len <= 0xffff ? 4 : 10)) + 4;
+	uint8* p = payload - iHeader;
+	p[0] = (bFinal ? 0x80 : 0) | opcode;
+	if (len < 126)
+	{
+		p[1] = 0x80 | (uint8)len;
+	}
+	else if (len <= 0xffff)
+	{
+		p[1] = 0x80 | 126;
+		p[2] = (uint8)(len >> 8);
+		p[3] = (uint8)(len & 0xff);
+	}
+	else
+	{
+		p[1] = 0x80 | 127;
+		for (int32 i = 0; i < 8; i++)
+		{
+			p[2 + i] = (uint8)((uint64)len >> (56 - 8 * i));
+		}
+	}
+
+	FMemory::Memcpy(p + iHeader - 4, mask, 4);
+	for (int32 i = 0; i < len; i++)
+	{
+		payload[i] ^= mask[i & 3];
+	}
+
+	return iHeader;
+}
+
+void FWebSocketRawClient::Append(const uint8* data, int32 len)
+{
+	// everything before mOffset was handed out by Next already
+	if (mOffset > 0)
+	{
+		mBuffer.RemoveAt(0, mOffset, false);
+		mOffset = 0;
+	}
+
+	mBuffer.Append(data, len);
+}
+
+FWebSocketRawClient::EResult FWebSocketRawClient::Next()
+{
+	if (!mbUpgraded)
+	{
+		return ParseHandshake();
+	}
+
+	int32 iAvail = mBuffer.Num() - mOffset;
+	if (iAvail < 2)
+	{
+		return EResult::NeedMore;
+	}
+
+	const uint8* p = mBuffer.GetData() + mOffset;
+	bool bMasked = (p[1] & 0x80) != 0;
+	uint64 uLen = p[1] & 0x7f;
+	int32 iHeader = 2;
+	if (uLen == 126)
+	{
+		if (iAvail < 4)
+		{
+			return EResult::NeedMore;
+		}
+		uLen = ((uint64)p[2] << 8) | p[3];
+		iHeader = 4;
+	}
+	else if (uLen == 127)
+	{
+		if (iAvail < 10)
+		{
+			return EResult::NeedMore;
+		}
+		uLen = 0;
+		for (int32 i = 0; i < 8; i++)
+		{
+			uLen = (uLen << 8) | p[2 + i];
+		}
+		iHeader = 10;
+	}
+
+	if (uLen > WEBSOCKET_RAW_MAX_FRAME)
+	{
+		Error = FString::Printf(TEXT("frame of %llu bytes is too large"), uLen);
+		return EResult::Error;
+	}
+
+	// servers must not mask, it is undone anyway
+	int32 iMask = iHeader;
+	if (bMasked)
+	{
+		iHeader += 4;
+	}
+
+	if (iAvail < iHeader + (int32)uLen)
+	{
+		return EResult::NeedMore;
+	}
+
+	Opcode = p[0] & 0x0f;
+	bFinal = (p[0] & 0x80) != 0;
+	PayloadLen = (int32)uLen;
+
+	uint8* pPayload = mBuffer.GetData() + mOffset + iHeader;
+	if (bMasked)
+	{
+		for (int32 i = 0; i < PayloadLen; i++)
+		{
+			pPayload[i] ^= p[iMask + (i & 3)];
+		}
+	}
+
+	Payload = pPayload;
+	mOffset += iHeader + PayloadLen;
+	return EResult::Frame;
+}
+
+FWebSocketRawClient::EResult FWebSocketRawClient::ParseHandshake()
+{
+	int32 iEnd = INDEX_NONE;
+	for (int32 i = mOffset; i + 3 < mBuffer.Num(); i++)
+	{
+		if (mBuffer[i] == '\r' && mBuffer[i + 1] == '\n' && mBuffer[i + 2] == '\r' && mBuffer[i + 3] == '\n')
+		{
+			iEnd = i;
+			break;
+		}
+	}
+
+	if (iEnd == INDEX_NONE)
+	{
+		if (mBuffer.Num() > WEBSOCKET_RAW_MAX_HANDSHAKE)
+		{
+			Error = TEXT("handshake response too long");
+			return EResult::Error;
+		}
+		return EResult::NeedMore;
+	}
+
+	FUTF8ToTCHAR Convert((const ANSICHAR*)mBuffer.GetData() + mOffset, iEnd - mOffset);
+	FString strResponse(Convert.Length(), Convert.Get());
+
+	TArray<FString> lines;
+	strResponse.ParseIntoArray(lines, TEXT("\r\n"), true);
+	if (lines.Num() == 0 || !lines[0].Contains(TEXT(" 101")))
+	{
+		Error = FString::Printf(TEXT("upgrade refused: %s"), lines.Num() > 0 ? *lines[0] : TEXT(""));
+		return EResult::Error;
+	}
+
+	FString strAccept;
+	for (int32 i = 1; i < lines.Num(); i++)
+	{
+		FString strKey;
+		FString strValue;
+		if (!lines[i].Split(TEXT(":"), &strKey, &strValue))
+		{
+			continue;
+		}
+
+		strKey.TrimStartAndEndInline();
+		strValue.TrimStartAndEndInline();
+		if (strKey.Equals(TEXT("Sec-WebSocket-Accept"), ESearchCase::IgnoreCase))
+		{
+			strAccept = strValue;
+		}
+		else if (strKey.Equals(TEXT("Sec-WebSocket-Protocol"), ESearchCase::IgnoreCase))
+		{
+			Protocol = strValue;
+		}
+	}
+
+	std::string strExpected = TCHAR_TO_UTF8(*(mKey + TEXT(WEBSOCKET_ACCEPT_GUID)));
+	uint8 hash[20];
+	FSHA1::HashBuffer(strExpected.c_str(), strExpected.size(), hash);
+	// base64 is case sensitive, a key differing only in case is a different key
+	if (!strAccept.Equals(FBase64::Encode(TArray<uint8>(hash, 20)), ESearchCase::CaseSensitive))
+	{
+		Error = TEXT("invalid Sec-WebSocket-Accept");
+		return EResult::Error;
+	}
+
+	mbUpgraded = true;
+	mOffset = iEnd + 4;
+	return EResult::Handshake;
+}
+#endif
@@ -0,0 +1,113 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <string>
+
+#ifndef WITH_WEBSOCKET_UNIX_SOCKET
+#define WITH_WEBSOCKET_UNIX_SOCKET 0
+#endif
+
+/*
+* rfc 6455 client framing for ws+unix. lws 2.3 can not connect a client over
+* AF_UNIX, so the connected socket is adopted as a raw lws connection and the
+* handshake and frames are done here; the service thread, flow control and
+* writable handling stay the same as for ws and wss.
+*
+*   ws+unix:///run/sim.sock            path "/"
+*   ws+unix:///run/sim.sock:/match     path "/match"
+*/
+#if WITH_WEBSOCKET_UNIX_SOCKET
+
+#define WEBSOCKET_OPCODE_CONTINUATION 0x0
+#define WEBSOCKET_OPCODE_TEXT 0x1
+#define WEBSOCKET_OPCODE_BINARY 0x2
+#define WEBSOCKET_OPCODE_CLOSE 0x8
+#define WEBSOCKET_OPCODE_PING 0x9
+#define WEBSOCKET_OPCODE_PONG 0xA
+
+/** largest client frame header, 2 + 8 byte length + 4 byte mask. fits into LWS_PRE */
+#define WEBSOCKET_RAW_MAX_HEADER 14
+
+/** frame masks read from the random source at once */
+#define WEBSOCKET_RAW_MASK_BATCH 64
+
+/** connected, blocking socket or -1. a unix socket connects or fails right away */
+int WebSocketConnectUnix(const FString& socketPath);
+
+class FWebSocketRawClient
+{
+public:
+
+	FWebSocketRawClient();
+
+	/** upgrade request, the key is remembered to check the server's answer */
+	std::string MakeHandshake(const FString& path, const FString& protocol, const TMap<FString, FString>& header);
+
+	/**
+	 * writes the masked frame header in front of payload, which needs WEBSOCKET_RAW_MAX_HEADER bytes of room
+	 * before it, and masks the payload in place. returns the header size. bFinal false leaves FIN clear for
+	 * all but the last fragment of a message.
+	 */
+	int32 WriteFrameHeader(uint8* payload, int32 len, uint8 opcode, bool bFinal = true);
+
+	enum class EResult : uint8
+	{
+		NeedMore,
+		Handshake,
+		Frame,
+		Error,
+	};
+
+	/** feed received bytes, then call Next until it returns NeedMore */
+	void Append(const uint8* data, int32 len);
+
+	/**
+	 * Handshake: the upgrade succeeded, Protocol is what the server accepted.
+	 * Frame: Opcode, bFinal and the payload are valid until the next call.
+	 */
+	EResult Next();
+
+	FString Protocol;
+	uint8 Opcode;
+	bool bFinal;
+	const uint8* Payload;
+	int32 PayloadLen;
+	FString Error;
+
+private:
+
+	EResult ParseHandshake();
+
+	/** frame masks must not be predictable to the peer, they come from /dev/urandom in batches */
+	uint32 NextMask();
+
+	FString mKey;
+	uint32 mMasks[WEBSOCKET_RAW_MASK_BATCH];
+	int32 mMaskIndex;
+	bool mbUpgraded;
+	TArray<uint8> mBuffer;
+	int32 mOffset;
+};
+#endif
@@ -0,0 +1,208 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#include "WebSocket.h"
+#include "WebSocketRequestTracker.h"
+#include "Containers/Ticker.h"
+
+/** 10% per bucket from 0.1 ms */
+#define WEBSOCKET_LATENCY_MIN_MS 0.1
+#define WEBSOCKET_LATENCY_GROWTH 1.1
+
+/** timeouts are this precise */
+#define WEBSOCKET_REQUEST_TICK_SECONDS 0.01
+
+static double WebSocketLatencyBucketLimit(int32 bucket)
+{
+	return WEBSOCKET_LATENCY_MIN_MS * FMath::Pow((float)WEBSOCKET_LATENCY_GROWTH, (float)bucket);
+}
+
+FWebSocketLatencyHistogram::FWebSocketLatencyHistogram()
+	:mTotal(0), mMax(0.0)
+{
+	FMemory::Memzero(mCounts, sizeof(mCounts));
+}
+
+void FWebSocketLatencyHistogram::Add(double ms)
+{
+	int32 iBucket = 0;
+	if (ms > WEBSOCKET_LATENCY_MIN_MS)
+	{
+		iBucket = FMath::Min(FMath::CeilToInt(FMath::Loge((float)(ms / WEBSOCKET_LATENCY_MIN_MS)) / FMath::Loge((float)WEBSOCKET_LATENCY_GROWTH)), WEBSOCKET_LATENCY_BUCKETS - 1);
+	}
+	mCounts[iBucket]++;
+	mTotal++;
+	mMax = FMath::Max(mMax, ms);
+}
+
+double FWebSocketLatencyHistogram::GetPercentile(double percentile) const
+{
+	if (mTotal == 0)
+	{
+		return 0.0;
+	}
+
+	int64 iRank = FMath::Max<int64>(1, (int64)FMath::CeilToDouble(percentile / 100.0 * mTotal));
+	int64 iSeen = 0;
+	for (int32 i = 0; i < WEBSOCKET_LATENCY_BUCKETS; i++)
+	{
+		iSeen += mCounts[i];
+		if (iSeen >= iRank)
+		{
+			return FMath::Min(WebSocketLatencyBucketLimit(i), mMax);
+		}
+	}
+	return mMax;
+}
+
+FWebSocketRequestTracker::FWebSocketRequestTracker(const FString& idField)
+	:mIdFieldName(idField), mNextId(0), mWheel(WEBSOCKET_REQUEST_TICK_SECONDS, FPlatformTime::Seconds())
+{
+	FTCHARToUTF8 utf8(*idField);
+	mIdField.Append(utf8.Get(), utf8.Length());
+	mIdField.Add(0);
+
+	mTicker = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float DeltaTime)
+	{
+		if (HasPending())
+		{
+			Advance(FPlatformTime::Seconds());
+		}
+		return true;
+	}));
+}
+
+FWebSocketRequestTracker::~FWebSocketRequestTracker()
+{
+	FTicker::GetCoreTicker().RemoveTicker(mTicker);
+	FailAll(EWebSocketRequestResult::Closed);
+}
+
+int32 FWebSocketRequestTracker::NextId()
+{
+	// skips 0 and ids still pending after a wrap
+	do
+	{
+		mNextId = mNextId == MAX_int32 ? 1 : mNextId + 1;
+	} while (mPending.Contains(mNextId));
+	return mNextId;
+}
+
+TFuture<FWebSocketResponse> FWebSocketRequestTracker::Start(int32 id, int32 type, float timeout)
+{
+	double dNow = FPlatformTime::Seconds();
+	FPending& pending = mPending.Add(id);
+	pending.Type = type;
+	pending.Start = dNow;
+	pending.Timer = mWheel.Add(dNow + timeout, (uint64)(uint32)id);
+
+	FTypeStats& stats = mStats.FindOrAdd(type);
+	stats.Requests++;
+	stats.Pending++;
+	return pending.Promise.GetFuture();
+}
+
+void FWebSocketRequestTracker::Finish(FPending& pending, EWebSocketRequestResult result, FWebSocketResponse&& response)
+{
+	double dLatencyMs = (FPlatformTime::Seconds() - pending.Start) * 1000.0;
+	FTypeStats& stats = mStats.FindOrAdd(pending.Type);
+	stats.Pending--;
+	switch (result)
+	{
+	case EWebSocketRequestResult::Success:
+		stats.Responses++;
+		stats.Latency.Add(dLatencyMs);
+		break;
+	case EWebSocketRequestResult::Timeout:
+		stats.Timeouts++;
+		break;
+	default:
+		stats.Failed++;
+		break;
+	}
+
+	response.Result = result;
+	response.Type = pending.Type;
+	response.LatencyMs = (float)dLatencyMs;
+	pending.Promise.SetValue(MoveTemp(response));
+}
+
+bool FWebSocketRequestTracker::Complete(int32 id, FWebSocketResponse&& response)
+{
+	FPending pending;
+	if (!mPending.RemoveAndCopyValue(id, pending))
+	{
+		return false;
+	}
+
+	mWheel.Cancel(pending.Timer);
+	Finish(pending, EWebSocketRequestResult::Success, MoveTemp(response));
+	return true;
+}
+
+void FWebSocketRequestTracker::FailAll(EWebSocketRequestResult result)
+{
+	// continuations may start new requests, they see an empty table
+	TMap<int32, FPending> pending = MoveTemp(mPending);
+	mPending.Reset();
+	for (auto& it : pending)
+	{
+		mWheel.Cancel(it.Value.Timer);
+		Finish(it.Value, result, FWebSocketResponse());
+	}
+}
+
+void FWebSocketRequestTracker::Advance(double now)
+{
+	mExpired.Reset();
+	mWheel.Advance(now, mExpired);
+	for (uint64 id : mExpired)
+	{
+		FPending pending;
+		if (mPending.RemoveAndCopyValue((int32)(uint32)id, pending))
+		{
+			UE_LOG(WebSocket, Verbose, TEXT("websocket: request %d of cmd %d timed out"), (int32)(uint32)id, pending.Type);
+			Finish(pending, EWebSocketRequestResult::Timeout, FWebSocketResponse());
+		}
+	}
+}
+
+TArray<FWebSocketRequestStats> FWebSocketRequestTracker::GetStats() const
+{
+	TArray<FWebSocketRequestStats> result;
+	for (auto& it : mStats)
+	{
+		FWebSocketRequestStats& stats = result[result.AddDefaulted()];
+		stats.Type = it.Key;
+		stats.Requests = it.Value.Requests;
+		stats.Responses = it.Value.Responses;
+		stats.Timeouts = it.Value.Timeouts;
+		stats.Failed = it.Value.Failed;
+		stats.Pending = it.Value.Pending;
+		stats.P50Ms = (float)it.Value.Latency.GetPercentile(50.0);
+		stats.P90Ms = (float)it.Value.Latency.GetPercentile(90.0);
+		stats.P99Ms = (float)it.Value.Latency.GetPercentile(99.0);
+		stats.MaxMs = (float)it.Value.Latency.GetMax();
+	}
+	return result;
+}
@@ -0,0 +1,121 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "WebSocketRequest.h"
+#include "WebSocketStats.h"
+#include "WebSocketTimerWheel.h"
+
+#define WEBSOCKET_LATENCY_BUCKETS 128
+
+/**
+ * log bucketed latencies, every bucket is 10% wider than the one before starting at 0.1 ms, the last one
+ * holds everything above 18 s. Add is O(1) and a percentile is the upper bound of its bucket.
+ */
+class FWebSocketLatencyHistogram
+{
+public:
+
+	FWebSocketLatencyHistogram();
+
+	void Add(double ms);
+	double GetPercentile(double percentile) const;
+	double GetMax() const { return mMax; }
+
+private:
+
+	int32 mCounts[WEBSOCKET_LATENCY_BUCKETS];
+	int64 mTotal;
+	double mMax;
+};
+
+/**
+ * outstanding requests of a socket and the latency of the answered ones per type. timeouts sit in a timer
+ * wheel, so starting, answering and expiring a request costs the same with ten or ten thousand pending.
+ * game thread.
+ */
+class FWebSocketRequestTracker
+{
+public:
+
+	FWebSocketRequestTracker(const FString& idField);
+	~FWebSocketRequestTracker();
+
+	/** the id field as utf-8 for the json scans */
+	const ANSICHAR* GetIdField() const { return mIdField.GetData(); }
+	const FString& GetIdFieldName() const { return mIdFieldName; }
+
+	/** never 0, which no response carries */
+	int32 NextId();
+
+	TFuture<FWebSocketResponse> Start(int32 id, int32 type, float timeout);
+	bool HasPending() const { return mPending.Num() > 0; }
+	bool IsPending(int32 id) const { return mPending.Contains(id); }
+
+	/** false when id is not pending anymore, eg it timed out */
+	bool Complete(int32 id, FWebSocketResponse&& response);
+
+	/** complete every pending request with result, the socket closed */
+	void FailAll(EWebSocketRequestResult result);
+
+	/** fire the timeouts up to now */
+	void Advance(double now);
+
+	TArray<FWebSocketRequestStats> GetStats() const;
+
+private:
+
+	struct FPending
+	{
+		TPromise<FWebSocketResponse> Promise;
+		int32 Type;
+		double Start;
+		int32 Timer;
+	};
+
+	struct FTypeStats
+	{
+		FWebSocketLatencyHistogram Latency;
+		int32 Requests;
+		int32 Responses;
+		int32 Timeouts;
+		int32 Failed;
+		int32 Pending;
+
+		FTypeStats() :Requests(0), Responses(0), Timeouts(0), Failed(0), Pending(0) {}
+	};
+
+	void Finish(FPending& pending, EWebSocketRequestResult result, FWebSocketResponse&& response);
+
+	FString mIdFieldName;
+	TArray<ANSICHAR> mIdField;
+	int32 mNextId;
+	TMap<int32, FPending> mPending;
+	TMap<int32, FTypeStats> mStats;
+	FWebSocketTimerWheel mWheel;
+	TArray<uint64> mExpired;
+	FDelegateHandle mTicker;
+};
@@ -0,0 +1,253 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#include "WebSocket.h"
+#include "WebSocketRouter.h"
+#include "WebSocketBase.h"
+#include "WebSocketUtf8.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+bool WebSocketIsCommandFrame(const uint8* in, int32 len)
+{
+	return len >= WEBSOCKET_COMMAND_HEADER_SIZE && in[0] == WEBSOCKET_COMMAND_MAGIC;
+}
+
+int32 WebSocketReadCommand(const uint8* in)
+{
+	uint32 cmd = 0;
+	for (int32 i = 0; i < 4; i++)
+	{
+		cmd |= (uint32)in[1 + i] << (i * 8);
+	}
+	return (int32)cmd;
+}
+
+template<typename CharType>
+static int32 WebSocketSkipSpace(const CharType* data, int32 len, int32 i)
+{
+	while (i < len && (data[i] == ' ' || data[i] == '\t' || data[i] == '\n' || data[i] == '\r'))
+	{
+		i++;
+	}
+	return i;
+}
+
+template<typename CharType>
+static bool WebSocketIsKey(const CharType* data, int32 len, const ANSICHAR* key, int32 keyLen)
+{
+	if (len != keyLen)
+	{
+		return false;
+	}
+	for (int32 i = 0; i < len; i++)
+	{
+		if (data[i] != (CharType)(uint8)key[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+template<typename CharType>
+static bool WebSocketScanJsonIntImpl(const CharType* data, int32 len, const ANSICHAR* key, int32& out)
+{
+	int32 iKeyLen = FCStringAnsi::Strlen(key);
+	int32 iDepth = 0;
+	for (int32 i = 0; i < len; i++)
+	{
+		CharType c = data[i];
+		if (c == '{' || c == '[')
+		{
+			iDepth++;
+			continue;
+		}
+		if (c == '}' || c == ']')
+		{
+			// the top level object ended without the key
+			if (--iDepth <= 0)
+			{
+				return false;
+			}
+			continue;
+		}
+		if (c != '"')
+		{
+			continue;
+		}
+
+		int32 iStart = i + 1;
+		for (i = iStart; i < len && data[i] != '"'; i++)
+		{
+			if (data[i] == '\\')
+			{
+				i++;
+			}
+		}
+		if (i >= len)
+		{
+			return false;
+		}
+		if (iDepth != 1 || !WebSocketIsKey(data + iStart, i - iStart, key, iKeyLen))
+		{
+			continue;
+		}
+
+		// a string value that happens to read like the key is not followed by a colon
+		int32 j = WebSocketSkipSpace(data, len, i + 1);
+		if (j >= len || data[j] != ':')
+		{
+			continue;
+		}
+
+		j = WebSocketSkipSpace(data, len, j + 1);
+		bool bNegative = j < len && data[j] == '-';
+		if (bNegative)
+		{
+			j++;
+		}
+		if (j >= len || data[j] < '0' || data[j] > '9')
+		{
+			return false;
+		}
+
+		int64 iValue = 0;
+		for (; j < len && data[j] >= '0' && data[j] <= '9' && iValue <= MAX_int32; j++)
+		{
+			iValue = iValue * 10 + (data[j] - '0');
+		}
+		if (iValue > MAX_int32)
+		{
+			return false;
+		}
+		out = (int32)(bNegative ? -iValue : iValue);
+		return true;
+	}
+	return false;
+}
+
+bool WebSocketScanJsonInt(const uint8* data, int32 len, const ANSICHAR* key, int32& out)
+{
+	return WebSocketScanJsonIntImpl(data, len, key, out);
+}
+
+bool WebSocketScanJsonInt(const TCHAR* data, int32 len, const ANSICHAR* key, int32& out)
+{
+	return WebSocketScanJsonIntImpl(data, len, key, out);
+}
+
+bool WebSocketStampJsonInt(const FString& data, const ANSICHAR* key, int32 value, FString& out)
+{
+	const TCHAR* pData = *data;
+	int32 iOpen = WebSocketSkipSpace(pData, data.Len(), 0);
+	if (iOpen >= data.Len() || pData[iOpen] != '{')
+	{
+		return false;
+	}
+
+	// the field goes first, an empty object gets no comma
+	int32 iNext = WebSocketSkipSpace(pData, data.Len(), iOpen + 1);
+	bool bEmpty = iNext < data.Len() && pData[iNext] == '}';
+	out.Reset(data.Len() + FCStringAnsi::Strlen(key) + 16);
+	out.AppendChars(pData, iOpen + 1);
+	out += FString::Printf(TEXT("\"%s\":%d%s"), ANSI_TO_TCHAR(key), value, bEmpty ? TEXT("") : TEXT(","));
+	out.AppendChars(pData + iOpen + 1, data.Len() - iOpen - 1);
+	return true;
+}
+
+FWebSocketCommandRouter::FWebSocketCommandRouter(const TSet<int32>& commands, const FString& requestField, const TSharedPtr<IWebSocketMessageDecoder, ESPMode::ThreadSafe>& next)
+	:mCommands(commands), mNext(next)
+{
+	if (!requestField.IsEmpty())
+	{
+		FTCHARToUTF8 utf8(*requestField);
+		mRequestField.Append(utf8.Get(), utf8.Length());
+		mRequestField.Add(0);
+	}
+}
+
+void FWebSocketCommandRouter::ScanRequestId(const uint8* json, int32 len, FWebSocketDecodedMessage& out) const
+{
+	if (mRequestField.Num() > 0)
+	{
+		WebSocketScanJsonInt(json, len, mRequestField.GetData(), out.RequestId);
+	}
+}
+
+bool FWebSocketCommandRouter::Decode(const FWebSocketMessageView& message, FWebSocketDecodedMessage& out)
+{
+	const uint8* pJson = message.Data.GetData();
+	int32 iLen = message.Num();
+	int32 iCmd = 0;
+	bool bFound = false;
+	if (message.bBinary)
+	{
+		if (message.bPluginFrames && WebSocketIsCommandFrame(pJson, iLen))
+		{
+			iCmd = WebSocketReadCommand(pJson);
+			pJson += WEBSOCKET_COMMAND_HEADER_SIZE;
+			iLen -= WEBSOCKET_COMMAND_HEADER_SIZE;
+			bFound = true;
+		}
+	}
+	else
+	{
+		bFound = WebSocketScanJsonInt(pJson, iLen, WEBSOCKET_COMMAND_FIELD, iCmd);
+	}
+
+	if (!bFound || !mCommands.Contains(iCmd))
+	{
+		if (!mNext.IsValid() || !mNext->Decode(message, out))
+		{
+			return false;
+		}
+		if (!message.bBinary)
+		{
+			ScanRequestId(pJson, iLen, out);
+		}
+		return true;
+	}
+
+	// the one parse of the message, the game thread only copies the values into the route's object
+	FString strText;
+	if (!WebSocketDecodeUtf8(pJson, iLen, strText))
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: cmd %d is not utf-8 json, not routed"), iCmd);
+		return false;
+	}
+
+	TSharedRef<TJsonReader<TCHAR>> Reader = FJsonStringReader::Create(MoveTemp(strText));
+	TSharedPtr<FJsonObject> JsonObject;
+	if (!FJsonSerializer::Deserialize(Reader, JsonObject) || !JsonObject.IsValid())
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: cmd %d is not a json object, not routed"), iCmd);
+		return false;
+	}
+
+	out.Type = iCmd;
+	out.Json = JsonObject;
+	ScanRequestId(pJson, iLen, out);
+	return true;
+}
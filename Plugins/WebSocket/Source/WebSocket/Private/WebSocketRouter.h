@@ -0,0 +1,78 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WebSocketDecoder.h"
+
+/*
+* command frame, a binary frame the server may send instead of a json text
+* frame to a socket with command routes:
+*
+*   byte 0     WEBSOCKET_COMMAND_MAGIC
+*   byte 1..4  cmd, little endian
+*   byte 5..   the utf-8 json message
+*
+* the cmd comes from the header instead of a scan of the json.
+*/
+#define WEBSOCKET_COMMAND_MAGIC 0x43
+#define WEBSOCKET_COMMAND_HEADER_SIZE 5
+#define WEBSOCKET_COMMAND_FIELD "cmd"
+
+bool WebSocketIsCommandFrame(const uint8* in, int32 len);
+int32 WebSocketReadCommand(const uint8* in);
+
+/**
+ * int value of key in the top level object of the utf-8 json, without parsing it. stops at the key,
+ * nested objects and strings are skipped. false when the key is missing or not an integer.
+ */
+bool WebSocketScanJsonInt(const uint8* data, int32 len, const ANSICHAR* key, int32& out);
+bool WebSocketScanJsonInt(const TCHAR* data, int32 len, const ANSICHAR* key, int32& out);
+
+/** data with "key":value as the first field of its top level object, false when data is not an object */
+bool WebSocketStampJsonInt(const FString& data, const ANSICHAR* key, int32 value, FString& out);
+
+/**
+ * decoder of a socket with command routes. the cmd of a message is scanned for or read from the command
+ * header, messages of routed commands are parsed once into Json for the game thread to read into the
+ * route's class. everything else goes to next, or stays a plain message without it. the requestField of
+ * what was decoded is scanned into RequestId. immutable, the socket builds a new router whenever its
+ * routes change.
+ */
+class FWebSocketCommandRouter : public IWebSocketMessageDecoder
+{
+public:
+
+	FWebSocketCommandRouter(const TSet<int32>& commands, const FString& requestField, const TSharedPtr<IWebSocketMessageDecoder, ESPMode::ThreadSafe>& next);
+
+	virtual bool Decode(const FWebSocketMessageView& message, FWebSocketDecodedMessage& out) override;
+
+private:
+
+	void ScanRequestId(const uint8* json, int32 len, FWebSocketDecodedMessage& out) const;
+
+	TSet<int32> mCommands;
+	TArray<ANSICHAR> mRequestField;
+	TSharedPtr<IWebSocketMessageDecoder, ESPMode::ThreadSafe> mNext;
+};
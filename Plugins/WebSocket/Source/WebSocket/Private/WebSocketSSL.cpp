@@ -0,0 +1,542 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+#include "WebSocket.h"
+#include "WebSocketSSL.h"
+#include "WebSocketBase.h"
+#include "FileHelper.h"
+#include "HAL/FileManager.h"
+#include "Async/Async.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/MemoryReader.h"
+
+#if WITH_WEBSOCKET_OPENSSL
+
+#if PLATFORM_WINDOWS
+#include "PreWindowsApi.h"
+#endif
+#define UI UI_ST
+THIRD_PARTY_INCLUDES_START
+#include "openssl/ssl.h"
+#include "openssl/pem.h"
+#include "openssl/err.h"
+#if PLATFORM_WINDOWS
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+THIRD_PARTY_INCLUDES_END
+#undef UI
+#if PLATFORM_WINDOWS
+#include "PostWindowsApi.h"
+#endif
+
+static int GetCacheExIndex()
+{
+	static int s_iIndex = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+	return s_iIndex;
+}
+
+static void FreeHandshakeStart(void* parent, void* ptr, CRYPTO_EX_DATA* ad, int idx, long argl, void* argp)
+{
+	delete (double*)ptr;
+}
+
+/** the handshake start time lives on the SSL object, it goes away with it also when the handshake never finishes */
+static int GetHandshakeExIndex()
+{
+	static int s_iIndex = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, &FreeHandshakeStart);
+	return s_iIndex;
+}
+
+static bool ApplyTlsString(int iRet, const TCHAR* szWhat, const FString& value)
+{
+	if (iRet != 1)
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: openssl rejected %s '%s', using the default"), szWhat, *value);
+		return false;
+	}
+
+	return true;
+}
+
+#endif
+
+bool WebSocketApplyTlsOptions(void* sslCtx, const FWebSocketTlsOptions& options)
+{
+#if WITH_WEBSOCKET_OPENSSL
+	SSL_CTX* ctx = (SSL_CTX*)sslCtx;
+	if (ctx == nullptr)
+	{
+		return false;
+	}
+
+	bool bOk = true;
+	if (!options.CipherList.IsEmpty())
+	{
+		bOk &= ApplyTlsString(SSL_CTX_set_cipher_list(ctx, TCHAR_TO_UTF8(*options.CipherList)), TEXT("cipher list"), options.CipherList);
+	}
+
+#ifdef TLS1_3_VERSION
+	if (!options.CipherSuites.IsEmpty())
+	{
+		bOk &= ApplyTlsString(SSL_CTX_set_ciphersuites(ctx, TCHAR_TO_UTF8(*options.CipherSuites)), TEXT("cipher suites"), options.CipherSuites);
+	}
+#endif
+
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+	if (!options.Curves.IsEmpty())
+	{
+		bOk &= ApplyTlsString((int)SSL_CTX_set1_curves_list(ctx, TCHAR_TO_UTF8(*options.Curves)), TEXT("curves"), options.Curves);
+	}
+
+	if (!options.SignatureAlgorithms.IsEmpty())
+	{
+		bOk &= ApplyTlsString((int)SSL_CTX_set1_sigalgs_list(ctx, TCHAR_TO_UTF8(*options.SignatureAlgorithms)), TEXT("signature algorithms"), options.SignatureAlgorithms);
+	}
+#endif
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	int iMinVersion = 0;
+	switch (options.MinVersion)
+	{
+	case EWebSocketTlsVersion::TLS1_0: iMinVersion = TLS1_VERSION; break;
+	case EWebSocketTlsVersion::TLS1_1: iMinVersion = TLS1_1_VERSION; break;
+	case EWebSocketTlsVersion::TLS1_2: iMinVersion = TLS1_2_VERSION; break;
+#ifdef TLS1_3_VERSION
+	case EWebSocketTlsVersion::TLS1_3: iMinVersion = TLS1_3_VERSION; break;
+#endif
+	default: break;
+	}
+
+	if (iMinVersion != 0 && SSL_CTX_set_min_proto_version(ctx, iMinVersion) != 1)
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: openssl rejected minimum tls version %d"), (int)options.MinVersion);
+		bOk = false;
+	}
+#else
+	long lNoVersions = SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3;
+	if (options.MinVersion >= EWebSocketTlsVersion::TLS1_1)
+	{
+		lNoVersions |= SSL_OP_NO_TLSv1;
+	}
+	if (options.MinVersion >= EWebSocketTlsVersion::TLS1_2)
+	{
+		lNoVersions |= SSL_OP_NO_TLSv1_1;
+	}
+	SSL_CTX_set_options(ctx, lNoVersions);
+#endif
+
+	return bOk;
+#else
+	return false;
+#endif
+}
+
+int32 WebSocketLoadCABundle(void* sslCtx, const TArray<uint8>& pem)
+{
+#if WITH_WEBSOCKET_OPENSSL
+	SSL_CTX* ctx = (SSL_CTX*)sslCtx;
+	if (ctx == nullptr || pem.Num() == 0)
+	{
+		return 0;
+	}
+
+	X509_STORE* store = SSL_CTX_get_cert_store(ctx);
+	BIO* bio = BIO_new_mem_buf((void*)pem.GetData(), pem.Num());
+	if (store == nullptr || bio == nullptr)
+	{
+		return 0;
+	}
+
+	int32 iCount = 0;
+	while (X509* cert = PEM_read_bio_X509(bio, nullptr, nullptr, nullptr))
+	{
+		if (X509_STORE_add_cert(store, cert) == 1)
+		{
+			iCount++;
+		}
+		X509_free(cert);
+	}
+
+	// reading stops with a "no start line" error at the end of the bundle
+	ERR_clear_error();
+	BIO_free(bio);
+
+	return iCount;
+#else
+	return 0;
+#endif
+}
+
+bool WebSocketUseSystemTrustStore(void* sslCtx)
+{
+#if WITH_WEBSOCKET_OPENSSL
+	SSL_CTX* ctx = (SSL_CTX*)sslCtx;
+	if (ctx == nullptr)
+	{
+		return false;
+	}
+
+	if (SSL_CTX_set_default_verify_paths(ctx) != 1)
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: fail to load the system trust store"));
+		ERR_clear_error();
+		return false;
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+FWebSocketSessionCache::FWebSocketSessionCache()
+	:mPendingSave(MakeShareable(new FPendingSave())), mFullHandshakes(0), mResumedHandshakes(0), mFullHandshakeSeconds(0.0), mResumedHandshakeSeconds(0.0)
+{
+}
+
+FWebSocketSessionCache::~FWebSocketSessionCache()
+{
+	Clear();
+}
+
+void FWebSocketSessionCache::Attach(void* sslCtx)
+{
+#if WITH_WEBSOCKET_OPENSSL
+	SSL_CTX* ctx = (SSL_CTX*)sslCtx;
+	if (ctx == nullptr)
+	{
+		return;
+	}
+
+	SSL_CTX_set_ex_data(ctx, GetCacheExIndex(), this);
+
+	// openssl's internal store is keyed by session id for servers, the client side lookup is ours
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(ctx, &FWebSocketSessionCache::OnNewSession);
+	SSL_CTX_set_info_callback(ctx, &FWebSocketSessionCache::OnInfo);
+#endif
+}
+
+void FWebSocketSessionCache::SetPersistPath(const FString& path)
+{
+	FScopeLock lock(&mLock);
+	mPersistPath = path;
+	Load();
+}
+
+void FWebSocketSessionCache::Clear()
+{
+	FScopeLock lock(&mLock);
+#if WITH_WEBSOCKET_OPENSSL
+	for (auto& it : mSessions)
+	{
+		SSL_SESSION_free(it.Value);
+	}
+#endif
+	mSessions.Empty();
+}
+
+FWebSocketTlsStats FWebSocketSessionCache::GetStats() const
+{
+	FScopeLock lock(&mLock);
+	FWebSocketTlsStats stats;
+	stats.FullHandshakes = mFullHandshakes;
+	stats.ResumedHandshakes = mResumedHandshakes;
+	stats.CachedSessions = mSessions.Num();
+
+	int32 iTotal = mFullHandshakes + mResumedHandshakes;
+	if (iTotal > 0)
+	{
+		stats.ResumeRate = (float)mResumedHandshakes / (float)iTotal;
+	}
+	if (mFullHandshakes > 0)
+	{
+		stats.AverageFullHandshakeMs = (float)(mFullHandshakeSeconds * 1000.0 / mFullHandshakes);
+	}
+	if (mResumedHandshakes > 0)
+	{
+		stats.AverageResumedHandshakeMs = (float)(mResumedHandshakeSeconds * 1000.0 / mResumedHandshakes);
+	}
+
+	return stats;
+}
+
+#if WITH_WEBSOCKET_OPENSSL
+FWebSocketSessionCache* FWebSocketSessionCache::FromSSL(const ssl_st* ssl)
+{
+	return (FWebSocketSessionCache*)SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), GetCacheExIndex());
+}
+
+bool FWebSocketSessionCache::GetSessionKey(const ssl_st* ssl, FString& key)
+{
+	const char* szHost = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+	int iFd = SSL_get_fd(ssl);
+	if (szHost == nullptr || iFd < 0)
+	{
+		return false;
+	}
+
+	// the same host may run differently configured servers on other ports, they must not share a ticket
+	struct sockaddr_storage addr;
+	socklen_t iAddrLen = sizeof(addr);
+	if (getpeername(iFd, (struct sockaddr*)&addr, &iAddrLen) != 0)
+	{
+		return false;
+	}
+
+	int32 iPort = 0;
+	if (addr.ss_family == AF_INET)
+	{
+		iPort = ntohs(((struct sockaddr_in*)&addr)->sin_port);
+	}
+	else if (addr.ss_family == AF_INET6)
+	{
+		iPort = ntohs(((struct sockaddr_in6*)&addr)->sin6_port);
+	}
+	else
+	{
+		return false;
+	}
+
+	key = FString::Printf(TEXT("%s:%d"), UTF8_TO_TCHAR(szHost), iPort);
+	return true;
+}
+
+int FWebSocketSessionCache::OnNewSession(ssl_st* ssl, ssl_session_st* session)
+{
+	FWebSocketSessionCache* pCache = FromSSL(ssl);
+	FString strKey;
+	if (pCache == nullptr || !GetSessionKey(ssl, strKey))
+	{
+		return 0;
+	}
+
+	FScopeLock lock(&pCache->mLock);
+	if (ssl_session_st** pOld = pCache->mSessions.Find(strKey))
+	{
+		SSL_SESSION_free(*pOld);
+	}
+
+	// returning 1 keeps the reference openssl handed us
+	pCache->mSessions.Add(strKey, session);
+	pCache->Save();
+
+	return 1;
+}
+
+void FWebSocketSessionCache::OnInfo(const ssl_st* ssl, int where, int ret)
+{
+	FWebSocketSessionCache* pCache = FromSSL(ssl);
+	if (pCache == nullptr)
+	{
+		return;
+	}
+
+	FScopeLock lock(&pCache->mLock);
+	SSL* pSSL = const_cast<SSL*>(ssl);
+	if (where & SSL_CB_HANDSHAKE_START)
+	{
+		// ClientHello is not built yet, the cached session can still be offered
+		FString strKey;
+		if (SSL_get_session(pSSL) == nullptr && GetSessionKey(ssl, strKey))
+		{
+			if (ssl_session_st** pSession = pCache->mSessions.Find(strKey))
+			{
+				SSL_set_session(pSSL, *pSession);
+			}
+		}
+
+		double* pStart = (double*)SSL_get_ex_data(pSSL, GetHandshakeExIndex());
+		if (pStart == nullptr)
+		{
+			pStart = new double();
+			SSL_set_ex_data(pSSL, GetHandshakeExIndex(), pStart);
+		}
+		*pStart = FPlatformTime::Seconds();
+	}
+	else if (where & SSL_CB_HANDSHAKE_DONE)
+	{
+		double* pStart = (double*)SSL_get_ex_data(pSSL, GetHandshakeExIndex());
+		if (pStart == nullptr || *pStart == 0.0)
+		{
+			return;
+		}
+
+		double dElapsed = FPlatformTime::Seconds() - *pStart;
+		*pStart = 0.0;
+		bool bResumed = SSL_session_reused(pSSL) != 0;
+		if (bResumed)
+		{
+			pCache->mResumedHandshakes++;
+			pCache->mResumedHandshakeSeconds += dElapsed;
+		}
+		else
+		{
+			pCache->mFullHandshakes++;
+			pCache->mFullHandshakeSeconds += dElapsed;
+		}
+
+		UE_LOG(WebSocket, Verbose, TEXT("websocket: tls handshake %s in %.2f ms"), bResumed ? TEXT("resumed") : TEXT("full"), dElapsed * 1000.0);
+	}
+}
+
+void FWebSocketSessionCache::Load()
+{
+	if (mPersistPath.IsEmpty())
+	{
+		return;
+	}
+
+	TArray<uint8> data;
+	if (!FFileHelper::LoadFileToArray(data, *mPersistPath, FILEREAD_Silent))
+	{
+		return;
+	}
+
+	FMemoryReader reader(data);
+	int32 iCount = 0;
+	reader << iCount;
+
+	int64 iNow = (int64)time(nullptr);
+	for (int32 i = 0; i < iCount && !reader.IsError(); i++)
+	{
+		FString strHost;
+		TArray<uint8> der;
+		reader << strHost << der;
+
+		const unsigned char* p = der.GetData();
+		SSL_SESSION* session = d2i_SSL_SESSION(nullptr, &p, der.Num());
+		if (session == nullptr)
+		{
+			continue;
+		}
+
+		if ((int64)SSL_SESSION_get_time(session) + (int64)SSL_SESSION_get_timeout(session) <= iNow)
+		{
+			SSL_SESSION_free(session);
+			continue;
+		}
+
+		if (ssl_session_st** pOld = mSessions.Find(strHost))
+		{
+			SSL_SESSION_free(*pOld);
+		}
+		mSessions.Add(strHost, session);
+	}
+
+	UE_LOG(WebSocket, Log, TEXT("websocket: loaded %d tls sessions from '%s'"), mSessions.Num(), *mPersistPath);
+}
+
+void FWebSocketSessionCache::Save()
+{
+	if (mPersistPath.IsEmpty())
+	{
+		return;
+	}
+
+	TArray<uint8> data;
+	FMemoryWriter writer(data);
+	int32 iCount = mSessions.Num();
+	writer << iCount;
+
+	for (auto& it : mSessions)
+	{
+		FString strHost = it.Key;
+		TArray<uint8> der;
+		der.SetNumUninitialized(i2d_SSL_SESSION(it.Value, nullptr));
+		unsigned char* p = der.GetData();
+		i2d_SSL_SESSION(it.Value, &p);
+		writer << strHost << der;
+	}
+
+	// new sessions arrive while servicing, keep the file write off that thread. a single writer
+	// picks up the latest snapshot, and the rename means a crash never leaves half a file behind
+	TSharedRef<FPendingSave, ESPMode::ThreadSafe> pending = mPendingSave;
+	{
+		FScopeLock saveLock(&pending->Lock);
+		pending->Path = mPersistPath;
+		pending->Data = MoveTemp(data);
+		pending->bPending = true;
+		if (pending->bWriting)
+		{
+			return;
+		}
+		pending->bWriting = true;
+	}
+
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [pending]()
+	{
+		for (;;)
+		{
+			FString strPath;
+			TArray<uint8> data;
+			{
+				FScopeLock saveLock(&pending->Lock);
+				if (!pending->bPending)
+				{
+					pending->bWriting = false;
+					return;
+				}
+				strPath = pending->Path;
+				data = MoveTemp(pending->Data);
+				pending->bPending = false;
+			}
+
+			FString strTemp = strPath + TEXT(".tmp");
+			if (!FFileHelper::SaveArrayToFile(data, *strTemp) || !IFileManager::Get().Move(*strPath, *strTemp, true, true))
+			{
+				UE_LOG(WebSocket, Warning, TEXT("websocket: fail to save tls sessions to '%s'"), *strPath);
+			}
+		}
+	});
+}
+#else
+int FWebSocketSessionCache::OnNewSession(ssl_st* ssl, ssl_session_st* session)
+{
+	return 0;
+}
+
+void FWebSocketSessionCache::OnInfo(const ssl_st* ssl, int where, int ret)
+{
+}
+
+FWebSocketSessionCache* FWebSocketSessionCache::FromSSL(const ssl_st* ssl)
+{
+	return nullptr;
+}
+
+bool FWebSocketSessionCache::GetSessionKey(const ssl_st* ssl, FString& key)
+{
+	return false;
+}
+
+void FWebSocketSessionCache::Load()
+{
+}
+
+void FWebSocketSessionCache::Save()
+{
+}
+#endif
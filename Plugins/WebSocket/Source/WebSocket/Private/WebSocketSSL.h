@@ -0,0 +1,107 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/ScopeLock.h"
+#include "WebSocketStats.h"
+#include "WebSocketSettings.h"
+
+#ifndef WITH_WEBSOCKET_OPENSSL
+#define WITH_WEBSOCKET_OPENSSL 0
+#endif
+
+/*
+* libwebsockets.h declares its own dummy SSL and SSL_CTX types, so the openssl
+* headers can not be included next to it. everything that talks to openssl lives
+* in WebSocketSSL.cpp and takes the SSL_CTX as an opaque pointer.
+*/
+struct ssl_st;
+struct ssl_session_st;
+
+/** apply cipher, curve, signature and protocol version settings to the client SSL_CTX */
+bool WebSocketApplyTlsOptions(void* sslCtx, const FWebSocketTlsOptions& options);
+
+/** add every certificate of a PEM bundle held in memory to the SSL_CTX trust store, returns the count */
+int32 WebSocketLoadCABundle(void* sslCtx, const TArray<uint8>& pem);
+
+/** trust the platform certificate store as well (/etc/ssl/certs and friends on linux) */
+bool WebSocketUseSystemTrustStore(void* sslCtx);
+
+/**
+ * client tls session cache keyed by the SNI host name and the server port. sessions handed
+ * out by the server (ids or tickets) are kept per host and port and offered again on the
+ * next connect, so reconnects only pay for an abbreviated handshake.
+ */
+class FWebSocketSessionCache
+{
+public:
+
+	FWebSocketSessionCache();
+	~FWebSocketSessionCache();
+
+	/** hook the client SSL_CTX, called from LWS_CALLBACK_OPENSSL_LOAD_EXTRA_CLIENT_VERIFY_CERTS */
+	void Attach(void* sslCtx);
+
+	/** keep sessions across runs in this file, empty path disables persistence */
+	void SetPersistPath(const FString& path);
+
+	void Clear();
+
+	FWebSocketTlsStats GetStats() const;
+
+private:
+
+	static int OnNewSession(ssl_st* ssl, ssl_session_st* session);
+	static void OnInfo(const ssl_st* ssl, int where, int ret);
+	static FWebSocketSessionCache* FromSSL(const ssl_st* ssl);
+	static bool GetSessionKey(const ssl_st* ssl, FString& key);
+
+	void Load();
+	void Save();
+
+	/** the callbacks run on the service thread, GetStats on the game thread */
+	mutable FCriticalSection mLock;
+	TMap<FString, ssl_session_st*> mSessions;
+	FString mPersistPath;
+
+	/** one background write at a time, a newer snapshot replaces the one still waiting */
+	struct FPendingSave
+	{
+		FCriticalSection Lock;
+		FString Path;
+		TArray<uint8> Data;
+		bool bPending;
+		bool bWriting;
+
+		FPendingSave()
+			:bPending(false), bWriting(false)
+		{
+		}
+	};
+	TSharedRef<FPendingSave, ESPMode::ThreadSafe> mPendingSave;
+
+	int32 mFullHandshakes;
+	int32 mResumedHandshakes;
+	double mFullHandshakeSeconds;
+	double mResumedHandshakeSeconds;
+};
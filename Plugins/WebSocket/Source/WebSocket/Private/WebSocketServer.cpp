@@ -0,0 +1,303 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#include "WebSocket.h"
+#include "WebSocketServer.h"
+#include "WebSocketContext.h"
+#include "WebSocketUtf8.h"
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+#include "WebSocketCodec.h"
+#include "WebSocketConnection.h"
+#include "WebSocketServerHost.h"
+#endif
+
+UWebSocketServer::UWebSocketServer()
+{
+	mContext = nullptr;
+	mPort = 0;
+	mbListening = false;
+}
+
+void UWebSocketServer::BeginDestroy()
+{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	// the clients are collected with us and send their close in their own BeginDestroy, the vhost waits for them
+	if (mHost.IsValid())
+	{
+		mHost->Stop(0.0f);
+		mHost = nullptr;
+	}
+#endif
+
+	Super::BeginDestroy();
+}
+
+bool UWebSocketServer::Listen(UWebSocketContext* context, int32 port)
+{
+#if PLATFORM_UWP
+	UE_LOG(WebSocket, Error, TEXT("websocket: server mode is not supported on uwp"));
+	return false;
+#elif PLATFORM_HTML5
+	UE_LOG(WebSocket, Error, TEXT("websocket: server mode is not supported on html5"));
+	return false;
+#else
+	if (mHost.IsValid() || context == nullptr)
+	{
+		return false;
+	}
+
+	mContext = context;
+	mPort = port;
+	if (context->IsCreating())
+	{
+		return true;
+	}
+
+	if (context->GetLwsContext() == nullptr)
+	{
+		return false;
+	}
+
+	mbListening = true;
+	mHost = MakeShareable(new FWebSocketServerHost(context, this));
+	mHost->Listen(port);
+	return true;
+#endif
+}
+
+void UWebSocketServer::Stop(float DrainTimeout)
+{
+	mbListening = false;
+
+	// Close is a no-op for clients that are already closing. their closes reach the service thread before the
+	// host stops, destroying the vhost first would drop them without a close frame
+	TArray<UWebSocketBase*> clients = mClients;
+	for (UWebSocketBase* pClient : clients)
+	{
+		pClient->Close(1001, TEXT("server stopped"), DrainTimeout);
+	}
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	if (mHost.IsValid())
+	{
+		mHost->Stop(DrainTimeout);
+		mHost = nullptr;
+	}
+#endif
+}
+
+void UWebSocketServer::JoinGroup(UWebSocketBase* Client, FName Group)
+{
+	if (Client == nullptr || Group.IsNone() || !mClients.Contains(Client))
+	{
+		return;
+	}
+
+	mGroups.FindOrAdd(Group).AddUnique(Client);
+}
+
+void UWebSocketServer::LeaveGroup(UWebSocketBase* Client, FName Group)
+{
+	TArray<TWeakObjectPtr<UWebSocketBase>>* pMembers = mGroups.Find(Group);
+	if (pMembers == nullptr)
+	{
+		return;
+	}
+
+	pMembers->Remove(Client);
+	if (pMembers->Num() == 0)
+	{
+		mGroups.Remove(Group);
+	}
+}
+
+int32 UWebSocketServer::BroadcastText(const FString& Data, FName Group)
+{
+	TArray<uint8> utf8;
+	WebSocketAppendUtf8(Data, utf8);
+	return Broadcast(utf8.GetData(), utf8.Num(), false, Group);
+}
+
+int32 UWebSocketServer::BroadcastBinary(const TArray<uint8>& Data, FName Group)
+{
+	return Broadcast(Data.GetData(), Data.Num(), true, Group);
+}
+
+int32 UWebSocketServer::BroadcastFrame(FWebSocketFrameHandle Handle, FName Group)
+{
+#if PLATFORM_UWP
+	return 0;
+#elif PLATFORM_HTML5
+	return 0;
+#else
+	const FWebSocketCachedFrame* pFrame = (mContext != nullptr) ? mContext->FindFrame(Handle) : nullptr;
+	if (pFrame == nullptr)
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: frame %d is not registered on the server's context"), Handle.Id);
+		return 0;
+	}
+
+	// accepted connections have no codec, they all get the plain frame
+	int32 iCount = 0;
+	for (UWebSocketBase* pClient : GetRecipients(Group))
+	{
+		if (pClient->IsOpen() && !pClient->IsClosing())
+		{
+			pClient->mConnection->SendFrame(*pFrame);
+			iCount++;
+		}
+	}
+
+	int32 iLen = pFrame->Plain.Shared->Num() - LWS_PRE;
+	mStats.Broadcasts++;
+	mStats.BroadcastRecipients += iCount;
+	mStats.BroadcastBytesQueued += (int64)iLen * iCount;
+	return iCount;
+#endif
+}
+
+TArray<UWebSocketBase*> UWebSocketServer::GetRecipients(FName group) const
+{
+	if (group.IsNone())
+	{
+		return mClients;
+	}
+
+	TArray<UWebSocketBase*> recipients;
+	if (const TArray<TWeakObjectPtr<UWebSocketBase>>* pMembers = mGroups.Find(group))
+	{
+		for (const TWeakObjectPtr<UWebSocketBase>& it : *pMembers)
+		{
+			if (it.IsValid())
+			{
+				recipients.Add(it.Get());
+			}
+		}
+	}
+
+	return recipients;
+}
+
+int32 UWebSocketServer::Broadcast(const uint8* data, int32 len, bool bBinary, FName group)
+{
+#if PLATFORM_UWP
+	return 0;
+#elif PLATFORM_HTML5
+	return 0;
+#else
+	TArray<UWebSocketBase*> recipients = GetRecipients(group);
+	if (recipients.Num() == 0)
+	{
+		return 0;
+	}
+
+	// one frame for everybody, the last connection that wrote it frees it
+	FWebSocketOutMessage msg;
+	WebSocketMakeOutMessage(data, len, bBinary, msg);
+	TSharedRef<TArray<uint8>, ESPMode::ThreadSafe> frame = MakeShareable(new TArray<uint8>(MoveTemp(msg.Payload)));
+
+	int32 iCount = 0;
+	for (UWebSocketBase* pClient : recipients)
+	{
+		if (pClient->IsOpen() && !pClient->IsClosing())
+		{
+			pClient->mConnection->SendShared(frame, bBinary);
+			iCount++;
+		}
+	}
+
+	mStats.Broadcasts++;
+	mStats.BroadcastRecipients += iCount;
+	mStats.BroadcastBytesBuilt += len;
+	mStats.BroadcastBytesQueued += (int64)len * iCount;
+	return iCount;
+#endif
+}
+
+FWebSocketServerStats UWebSocketServer::GetServerStats() const
+{
+	FWebSocketServerStats stats = mStats;
+	stats.bListening = mbListening;
+	stats.Port = mPort;
+	stats.Clients = mClients.Num();
+	return stats;
+}
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+void UWebSocketServer::HandleAccepted(const TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe>& connection, const FString& peer, const FString& protocol)
+{
+	// accepted after Stop, the listen socket was still open on the service thread
+	if (!mHost.IsValid())
+	{
+		connection->Close(1001, TEXT("server stopped"), 0.0f);
+		return;
+	}
+
+	UWebSocketBase* pClient = NewObject<UWebSocketBase>(this);
+	pClient->AdoptConnection(mContext, this, connection, peer, protocol);
+	mClients.Add(pClient);
+	mStats.AcceptedConnections++;
+
+	OnClientConnected.Broadcast(pClient);
+}
+
+#endif
+
+void UWebSocketServer::HandleListenError(const FString& error)
+{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	mHost = nullptr;
+#endif
+	mbListening = false;
+	OnListenError.Broadcast(error);
+}
+
+void UWebSocketServer::HandleClientClosed(UWebSocketBase* client)
+{
+	if (mClients.Remove(client) == 0)
+	{
+		return;
+	}
+
+	for (auto it = mGroups.CreateIterator(); it; ++it)
+	{
+		it.Value().Remove(client);
+		if (it.Value().Num() == 0)
+		{
+			it.RemoveCurrent();
+		}
+	}
+
+	OnClientClosed.Broadcast(client);
+}
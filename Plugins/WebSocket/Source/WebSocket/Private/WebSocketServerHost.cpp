@@ -0,0 +1,293 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#include "WebSocket.h"
+#include "WebSocketServerHost.h"
+#include "WebSocketServer.h"
+#include "WebSocketConnection.h"
+#include "WebSocketContext.h"
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+// seconds a stopping server waits for the close replies after the drain
+#define WEBSOCKET_SERVER_CLOSE_GRACE 1.0
+
+FWebSocketServerHost::FWebSocketServerHost(UWebSocketContext* context, UWebSocketServer* owner)
+	:mContext(context), mOwner(owner), mVhost(nullptr), mConnectionCount(0), mbStopping(false)
+{
+}
+
+FWebSocketServerHost* FWebSocketServerHost::GetHost(struct lws* wsi)
+{
+	const struct lws_protocols* pProtocol = lws_get_protocol(wsi);
+	return (pProtocol != nullptr) ? (FWebSocketServerHost*)pProtocol->user : nullptr;
+}
+
+void FWebSocketServerHost::Listen(int32 port)
+{
+	TSharedRef<FWebSocketServerHost, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnService([self, port]()
+	{
+		self->ListenOnService(port);
+	});
+}
+
+void FWebSocketServerHost::ListenOnService(int32 port)
+{
+	struct lws_context* pContext = mContext->GetLwsContext();
+	if (pContext == nullptr)
+	{
+		ReportListenError(TEXT("websocket context is not ready"));
+		return;
+	}
+
+	// the client protocols under the same ids, so an accepted connection finds its FWebSocketProtocolConfig
+	int32 iCount = mContext->GetProtocolCount();
+	mProtocolNames.Reset(iCount);
+	for (int32 i = 0; i < iCount; i++)
+	{
+		mProtocolNames.Emplace(TCHAR_TO_UTF8(*mContext->GetProtocolConfig(i).Name));
+	}
+
+	mProtocols.Reset(iCount + 1);
+	for (int32 i = 0; i < iCount; i++)
+	{
+		struct lws_protocols protocol;
+		memset(&protocol, 0, sizeof(protocol));
+		protocol.name = mProtocolNames[i].c_str();
+		protocol.callback = FWebSocketServerHost::callback_server;
+		protocol.per_session_data_size = sizeof(FWebSocketConnection*);
+		protocol.rx_buffer_size = FMath::Max(mContext->GetProtocolConfig(i).RxBufferSize, 128);
+		protocol.id = (unsigned int)i;
+		protocol.user = this;
+		mProtocols.Add(protocol);
+	}
+
+	struct lws_protocols terminator;
+	memset(&terminator, 0, sizeof(terminator));
+	mProtocols.Add(terminator);
+
+	// no extensions: a broadcast frame is written as built, permessage-deflate would compress it per connection
+	struct lws_context_creation_info info;
+	memset(&info, 0, sizeof info);
+	info.port = port;
+	info.protocols = mProtocols.GetData();
+	info.vhost_name = "uewebsocket-server";
+	info.gid = -1;
+	info.uid = -1;
+
+	mVhost = lws_create_vhost(pContext, &info);
+	if (mVhost == nullptr)
+	{
+		ReportListenError(FString::Printf(TEXT("listen on port %d fail"), port));
+		return;
+	}
+
+	mContext->AddListener();
+	UE_LOG(WebSocket, Log, TEXT("websocket: server listening on port %d"), port);
+}
+
+void FWebSocketServerHost::Stop(float drainTimeout)
+{
+	TSharedRef<FWebSocketServerHost, ESPMode::ThreadSafe> self = AsShared();
+	mContext->RunOnService([self, drainTimeout]()
+	{
+		self->mbStopping = true;
+		if (self->mConnectionCount == 0)
+		{
+			self->DestroyVhost();
+			return;
+		}
+
+		// the connections got their close before this command, OnConnectionClosed destroys the vhost after the last one
+		self->mContext->RunOnServiceAt(FPlatformTime::Seconds() + FMath::Max(drainTimeout, 0.0f) + WEBSOCKET_SERVER_CLOSE_GRACE, [self]()
+		{
+			self->DestroyVhost();
+		});
+	});
+}
+
+void FWebSocketServerHost::DestroyVhost()
+{
+	// a context shutdown already destroyed the vhost with the lws context
+	if (mVhost == nullptr || mContext->GetLwsContext() == nullptr)
+	{
+		mVhost = nullptr;
+		return;
+	}
+
+	if (mConnectionCount > 0)
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: server stopped with %d connections still closing"), mConnectionCount);
+	}
+
+	struct lws_vhost* pVhost = mVhost;
+	mVhost = nullptr;
+	lws_vhost_destroy(pVhost);
+	mContext->RemoveListener();
+}
+
+void FWebSocketServerHost::OnConnectionClosed()
+{
+	mConnectionCount--;
+	if (mbStopping && mConnectionCount == 0 && mVhost != nullptr)
+	{
+		// not from inside the callback of a wsi on the vhost
+		TSharedRef<FWebSocketServerHost, ESPMode::ThreadSafe> self = AsShared();
+		mContext->RunOnServiceAt(0.0, [self]()
+		{
+			self->DestroyVhost();
+		});
+	}
+}
+
+void FWebSocketServerHost::ReportListenError(const FString& error)
+{
+	UE_LOG(WebSocket, Error, TEXT("websocket: %s"), *error);
+
+	TWeakObjectPtr<UWebSocketServer> owner = mOwner;
+	WebSocketRunOnGameThread([owner, error]()
+	{
+		if (UWebSocketServer* pOwner = owner.Get())
+		{
+			pOwner->HandleListenError(error);
+		}
+	});
+}
+
+void FWebSocketServerHost::OnAccepted(struct lws* wsi, void* user)
+{
+	TSharedRef<FWebSocketInbox, ESPMode::ThreadSafe> inbox = MakeShareable(new FWebSocketInbox());
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> connection = MakeShareable(new FWebSocketConnection(mContext, nullptr, inbox));
+	*(FWebSocketConnection**)user = &connection.Get();
+	connection->Accept(wsi);
+	mConnectionCount++;
+
+	char peer[128];
+	peer[0] = 0;
+	lws_get_peer_simple(wsi, peer, sizeof(peer));
+	FString strPeer = UTF8_TO_TCHAR(peer);
+
+	const struct lws_protocols* pProtocol = lws_get_protocol(wsi);
+	FString strProtocol = mContext->GetProtocolConfig(pProtocol != nullptr ? (int32)pProtocol->id : 0).Name;
+
+	// the UWebSocketBase is created on the game thread, received messages wait in the inbox until then
+	TWeakObjectPtr<UWebSocketServer> owner = mOwner;
+	WebSocketRunOnGameThread([owner, connection, strPeer, strProtocol]()
+	{
+		UWebSocketServer* pOwner = owner.Get();
+		if (pOwner == nullptr)
+		{
+			connection->Close(1001, TEXT(""), 0.0f);
+			return;
+		}
+
+		pOwner->HandleAccepted(connection, strPeer, strProtocol);
+	});
+}
+
+int FWebSocketServerHost::callback_server(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len)
+{
+	FWebSocketConnection* pConnection = (user != nullptr) ? *(FWebSocketConnection**)user : nullptr;
+
+	// closing drops the context's reference, keep the connection alive until the callback returned
+	TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe> keepAlive;
+	if (pConnection != nullptr)
+	{
+		keepAlive = pConnection->AsShared();
+	}
+
+	if (reason == LWS_CALLBACK_ESTABLISHED || reason == LWS_CALLBACK_RECEIVE || reason == LWS_CALLBACK_SERVER_WRITEABLE)
+	{
+		UWebSocketContext::NoteServiceActivity(wsi);
+	}
+
+	switch (reason)
+	{
+	// lws 2.3 can not close only the listen socket, a stopping server refuses the upgrade instead
+	case LWS_CALLBACK_FILTER_PROTOCOL_CONNECTION:
+	{
+		FWebSocketServerHost* pHost = GetHost(wsi);
+		if (pHost == nullptr || pHost->mbStopping) return -1;
+	}
+		break;
+
+	case LWS_CALLBACK_ESTABLISHED:
+	{
+		FWebSocketServerHost* pHost = GetHost(wsi);
+		if (pHost == nullptr || user == nullptr) return -1;
+		pHost->OnAccepted(wsi, user);
+	}
+		break;
+
+	case LWS_CALLBACK_CLOSED:
+		if (!pConnection) return -1;
+		pConnection->OnClosed();
+		*(FWebSocketConnection**)user = nullptr;
+		if (FWebSocketServerHost* pHost = GetHost(wsi))
+		{
+			pHost->OnConnectionClosed();
+		}
+		break;
+
+	case LWS_CALLBACK_RECEIVE:
+		if (!pConnection) return -1;
+		pConnection->OnReceive((const char*)in, (int)len, lws_frame_is_binary(wsi) != 0,
+			lws_is_final_fragment(wsi) && lws_remaining_packet_payload(wsi) == 0);
+		break;
+
+	case LWS_CALLBACK_SERVER_WRITEABLE:
+		if (!pConnection) return -1;
+		if (!pConnection->OnWriteable())
+		{
+			return -1;
+		}
+		break;
+
+	case LWS_CALLBACK_RECEIVE_PONG:
+		if (pConnection)
+		{
+			pConnection->OnPong();
+		}
+		break;
+
+	case LWS_CALLBACK_WS_PEER_INITIATED_CLOSE:
+		if (len >= 2)
+		{
+			const unsigned char* pCode = (const unsigned char*)in;
+			UE_LOG(WebSocket, Log, TEXT("websocket: client closed with code %d"), (pCode[0] << 8) | pCode[1]);
+		}
+		break;
+
+	// websocket upgrades only, plain http requests are refused
+	case LWS_CALLBACK_HTTP:
+		return -1;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+#endif
@@ -0,0 +1,94 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtr.h"
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#elif PLATFORM_WINDOWS
+#include "PreWindowsApi.h"
+#include "libwebsockets.h"
+#include "PostWindowsApi.h"
+#else
+#include "libwebsockets.h"
+#endif
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+#include <string>
+
+class UWebSocketContext;
+class UWebSocketServer;
+
+/**
+ * lws side of a UWebSocketServer, a listening vhost on the server's context. accepted wsis get an
+ * FWebSocketConnection like the client ones, the game thread wraps each in a UWebSocketBase.
+ * the vhost offers the context's protocols without extensions, so a frame goes out as it was built.
+ * service thread, except Listen and Stop.
+ */
+class FWebSocketServerHost : public TSharedFromThis<FWebSocketServerHost, ESPMode::ThreadSafe>
+{
+public:
+
+	FWebSocketServerHost(UWebSocketContext* context, UWebSocketServer* owner);
+
+	/** game thread, a failure reaches UWebSocketServer::HandleListenError */
+	void Listen(int32 port);
+
+	/**
+	 * game thread, after the owner closed the accepted connections. new upgrades are refused from now on, the vhost
+	 * and its listen socket go once the last connection closed or drainTimeout plus the close handshake passed
+	 */
+	void Stop(float drainTimeout);
+
+	static int callback_server(struct lws *wsi, enum lws_callback_reasons reason, void *user, void *in, size_t len);
+
+private:
+
+	static FWebSocketServerHost* GetHost(struct lws* wsi);
+
+	void ListenOnService(int32 port);
+	void OnAccepted(struct lws* wsi, void* user);
+	void OnConnectionClosed();
+
+	/** lws_vhost_destroy drops every connection still on it without a close frame */
+	void DestroyVhost();
+	void ReportListenError(const FString& error);
+
+	UWebSocketContext* mContext;
+	TWeakObjectPtr<UWebSocketServer> mOwner;
+
+	/** service thread */
+	struct lws_vhost* mVhost;
+	int32 mConnectionCount;
+	bool mbStopping;
+
+	/** lws keeps pointers into these until the vhost is destroyed */
+	TArray<std::string> mProtocolNames;
+	TArray<struct lws_protocols> mProtocols;
+};
+#endif
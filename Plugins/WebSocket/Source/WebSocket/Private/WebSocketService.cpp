@@ -0,0 +1,172 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#include "WebSocket.h"
+#include "WebSocketService.h"
+#include "WebSocketContext.h"
+#include "WebSocketUtf8.h"
+
+UWebSocketService::UWebSocketService()
+{
+	mContext = nullptr;
+}
+
+UWebSocketService* UWebSocketService::CreateService(UObject* Outer, UWebSocketSettings* Settings, EWebSocketServiceMode Mode)
+{
+	UWebSocketService* pService = NewObject<UWebSocketService>(Outer != nullptr ? Outer : GetTransientPackage());
+	UWebSocketContext* pContext = NewObject<UWebSocketContext>(pService);
+	pContext->Configure(Settings, Mode);
+	pService->mContext = pContext;
+
+	// a manual service is created right away, its owner's loop services it from the first call on
+	if (Mode != EWebSocketServiceMode::Manual && pContext->GetSettings()->bCreateContextAsync)
+	{
+		pContext->CreateCtxAsync();
+	}
+	else
+	{
+		pContext->CreateCtx();
+		pContext->StartService();
+	}
+
+	return pService;
+}
+
+void UWebSocketService::BeginDestroy()
+{
+	// the lws context is not a UObject, it has to go before the service does. one still being created is
+	// abandoned by Shutdown and destroyed by its worker
+	if (mContext != nullptr)
+	{
+		Shutdown(0.0f);
+	}
+
+	Super::BeginDestroy();
+}
+
+UWebSocketBase* UWebSocketService::Connect(const FString& Url, const TMap<FString, FString>& Header, const FString& Protocol, bool& ConnectFail)
+{
+	if (mContext == nullptr)
+	{
+		ConnectFail = true;
+		return nullptr;
+	}
+
+	return mContext->Connect(Url, Header, Protocol, ConnectFail);
+}
+
+UWebSocketBase* UWebSocketService::ConnectEndpoints(const TArray<FString>& Urls, const TMap<FString, FString>& Header, const FString& Protocol, bool& ConnectFail)
+{
+	if (mContext == nullptr)
+	{
+		ConnectFail = true;
+		return nullptr;
+	}
+
+	return mContext->ConnectEndpoints(Urls, Header, Protocol, false, ConnectFail);
+}
+
+FWebSocketFrameHandle UWebSocketService::RegisterFrameText(const FString& Data)
+{
+	if (mContext == nullptr)
+	{
+		return FWebSocketFrameHandle();
+	}
+
+	TArray<uint8> utf8;
+	WebSocketAppendUtf8(Data, utf8);
+	return mContext->RegisterFrame(utf8.GetData(), utf8.Num(), false);
+}
+
+FWebSocketFrameHandle UWebSocketService::RegisterFrameBinary(const TArray<uint8>& Data)
+{
+	return (mContext != nullptr) ? mContext->RegisterFrame(Data.GetData(), Data.Num(), true) : FWebSocketFrameHandle();
+}
+
+void UWebSocketService::UnregisterFrame(FWebSocketFrameHandle Handle)
+{
+	if (mContext != nullptr)
+	{
+		mContext->UnregisterFrame(Handle);
+	}
+}
+
+UWebSocketServer* UWebSocketService::Listen(int32 Port, bool& ListenFail)
+{
+	if (mContext == nullptr)
+	{
+		ListenFail = true;
+		return nullptr;
+	}
+
+	return mContext->Listen(Port, ListenFail);
+}
+
+TSharedPtr<FWebSocketPool, ESPMode::ThreadSafe> UWebSocketService::CreatePool(IWebSocketPoolListener* Listener)
+{
+	if (mContext == nullptr)
+	{
+		return nullptr;
+	}
+
+	return mContext->CreatePool(Listener);
+}
+
+UWebSocketBase* UWebSocketService::ProbeEndpoints(const TArray<FString>& Urls, bool& ProbeFail)
+{
+	if (mContext == nullptr)
+	{
+		ProbeFail = true;
+		return nullptr;
+	}
+
+	return mContext->ConnectEndpoints(Urls, TMap<FString, FString>(), FString(), true, ProbeFail);
+}
+
+bool UWebSocketService::Service(int32 TimeoutMs)
+{
+	return mContext != nullptr && mContext->Service(TimeoutMs);
+}
+
+void UWebSocketService::Shutdown(float Timeout)
+{
+	if (mContext != nullptr && mContext->Shutdown(Timeout))
+	{
+		mContext = nullptr;
+	}
+}
+
+FWebSocketContextStats UWebSocketService::GetContextStats() const
+{
+	return mContext != nullptr ? mContext->GetContextStats() : FWebSocketContextStats();
+}
+
+FWebSocketTlsStats UWebSocketService::GetTlsStats() const
+{
+	return mContext != nullptr ? mContext->GetTlsStats() : FWebSocketTlsStats();
+}
+
+TArray<FWebSocketEndpointStatus> UWebSocketService::GetEndpointLatencies() const
+{
+	return mContext != nullptr ? mContext->GetEndpointStatuses() : TArray<FWebSocketEndpointStatus>();
+}
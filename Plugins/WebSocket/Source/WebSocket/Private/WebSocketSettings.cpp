@@ -0,0 +1,65 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+#include "WebSocket.h"
+#include "WebSocketSettings.h"
+
+UWebSocketSettings::UWebSocketSettings()
+{
+	bCreateContextAsync = true;
+	bWarmUpOnStartup = false;
+	bUseServiceThread = false;
+	IdleServiceTimeoutMs = 1000;
+	IdleTickPollMs = 50;
+	ShutdownTimeout = 2.0f;
+	RxPauseBytes = 4 * 1024 * 1024;
+	RxResumeBytes = 1024 * 1024;
+	MaxDeliverBytesPerFrame = 0;
+	bEnablePacing = false;
+	InitialPacingRate = 256 * 1024;
+	MinPacingRate = 8 * 1024;
+	MaxPacingRate = 0;
+	PacingBurstBytes = 16 * 1024;
+	PacingProbeIntervalMs = 100;
+	EndpointProbeTimeout = 2.0f;
+	EndpointCacheTtl = 30.0f;
+	bKeepWarmStandby = true;
+	DurableJournalBytes = 1024 * 1024;
+	MaxDurableJournalBytes = 64 * 1024 * 1024;
+	DurableSyncBytes = 64 * 1024;
+	DurableSyncIntervalMs = 50;
+	TransferChunkBytes = 64 * 1024;
+	TransferMessageBytes = 1024 * 1024;
+	RequestIdField = TEXT("seq");
+	RequestTimeout = 10.0f;
+	ClockSyncBurst = 8;
+	ClockSyncInterval = 2.0f;
+	bServeClockSync = true;
+	bEnableDictionaryCodec = false;
+	DictionaryFile = TEXT("Content/WebSocket/message.dict");
+	DictionaryVersion = 1;
+	CompressionLevel = 6;
+	MinCompressSize = 64;
+	bEnableTlsSessionCache = true;
+	bPersistTlsSessions = false;
+	bUseBundledCA = true;
+	bUseSystemTrustStore = false;
+}
@@ -0,0 +1,76 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#include "WebSocket.h"
+#include "WebSocketSubsystem.h"
+#include "Engine/Engine.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+
+UWebSocketSubsystem::UWebSocketSubsystem()
+{
+	mService = nullptr;
+	mSettings = nullptr;
+	mMode = EWebSocketServiceMode::Default;
+}
+
+void UWebSocketSubsystem::Deinitialize()
+{
+	if (mService != nullptr)
+	{
+		const UWebSocketSettings* pSettings = mSettings != nullptr ? mSettings : GetDefault<UWebSocketSettings>();
+		mService->Shutdown(pSettings->ShutdownTimeout);
+		mService = nullptr;
+	}
+
+	Super::Deinitialize();
+}
+
+UWebSocketService* UWebSocketSubsystem::GetService()
+{
+	if (mService == nullptr)
+	{
+		mService = UWebSocketService::CreateService(this, mSettings, mMode);
+	}
+
+	return mService;
+}
+
+void UWebSocketSubsystem::Configure(UWebSocketSettings* Settings, EWebSocketServiceMode Mode)
+{
+	if (mService != nullptr)
+	{
+		UE_LOG(WebSocket, Warning, TEXT("websocket: the game instance's service already exists, configure ignored"));
+		return;
+	}
+
+	mSettings = Settings;
+	mMode = Mode;
+}
+
+UWebSocketSubsystem* UWebSocketSubsystem::Get(const UObject* WorldContextObject)
+{
+	UWorld* pWorld = GEngine != nullptr ? GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull) : nullptr;
+	UGameInstance* pGameInstance = pWorld != nullptr ? pWorld->GetGameInstance() : nullptr;
+	return pGameInstance != nullptr ? pGameInstance->GetSubsystem<UWebSocketSubsystem>() : nullptr;
+}
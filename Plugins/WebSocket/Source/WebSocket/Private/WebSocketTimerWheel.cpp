@@ -0,0 +1,171 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#include "WebSocket.h"
+#include "WebSocketTimerWheel.h"
+
+FWebSocketTimerWheel::FWebSocketTimerWheel(double tickSeconds, double now)
+	:mTickSeconds(tickSeconds), mNow(0), mFree(INDEX_NONE), mCount(0)
+{
+	mNow = ToTick(now);
+	for (int32 i = 0; i < WEBSOCKET_WHEEL_LEVELS * WEBSOCKET_WHEEL_SLOTS; i++)
+	{
+		mSlots[i] = INDEX_NONE;
+	}
+}
+
+int32 FWebSocketTimerWheel::Add(double deadline, uint64 id)
+{
+	int32 handle = mFree;
+	if (handle != INDEX_NONE)
+	{
+		mFree = mTimers[handle].Next;
+	}
+	else
+	{
+		handle = mTimers.AddUninitialized();
+	}
+
+	// rounded up so it never fires early, a deadline that already passed fires with the next tick
+	FTimer& timer = mTimers[handle];
+	timer.Id = id;
+	timer.Tick = FMath::Max((uint64)FMath::Max(0.0, FMath::CeilToDouble(deadline / mTickSeconds)), mNow + 1);
+	Link(handle);
+	mCount++;
+	return handle;
+}
+
+void FWebSocketTimerWheel::Cancel(int32 handle)
+{
+	Unlink(handle);
+	mTimers[handle].Next = mFree;
+	mFree = handle;
+	mCount--;
+}
+
+void FWebSocketTimerWheel::Link(int32 handle)
+{
+	FTimer& timer = mTimers[handle];
+	uint64 delta = timer.Tick - mNow;
+
+	// the level whose 64 slots span the delta, the slot is picked by the deadline itself
+	int32 iLevel = 0;
+	while (iLevel < WEBSOCKET_WHEEL_LEVELS - 1 && delta >= ((uint64)1 << (WEBSOCKET_WHEEL_BITS * (iLevel + 1))))
+	{
+		iLevel++;
+	}
+
+	uint64 tick = timer.Tick;
+	if (delta >= ((uint64)1 << (WEBSOCKET_WHEEL_BITS * WEBSOCKET_WHEEL_LEVELS)))
+	{
+		// beyond the top level, parked in its last slot and placed again when that cascades
+		tick = mNow + ((uint64)1 << (WEBSOCKET_WHEEL_BITS * WEBSOCKET_WHEEL_LEVELS)) - 1;
+	}
+
+	timer.Slot = iLevel * WEBSOCKET_WHEEL_SLOTS + (int32)((tick >> (WEBSOCKET_WHEEL_BITS * iLevel)) & WEBSOCKET_WHEEL_MASK);
+	timer.Prev = INDEX_NONE;
+	timer.Next = mSlots[timer.Slot];
+	if (timer.Next != INDEX_NONE)
+	{
+		mTimers[timer.Next].Prev = handle;
+	}
+	mSlots[timer.Slot] = handle;
+}
+
+void FWebSocketTimerWheel::Unlink(int32 handle)
+{
+	FTimer& timer = mTimers[handle];
+	if (timer.Prev != INDEX_NONE)
+	{
+		mTimers[timer.Prev].Next = timer.Next;
+	}
+	else
+	{
+		mSlots[timer.Slot] = timer.Next;
+	}
+	if (timer.Next != INDEX_NONE)
+	{
+		mTimers[timer.Next].Prev = timer.Prev;
+	}
+}
+
+void FWebSocketTimerWheel::Cascade(int32 level)
+{
+	int32 iSlot = level * WEBSOCKET_WHEEL_SLOTS + (int32)((mNow >> (WEBSOCKET_WHEEL_BITS * level)) & WEBSOCKET_WHEEL_MASK);
+	int32 handle = mSlots[iSlot];
+	mSlots[iSlot] = INDEX_NONE;
+	while (handle != INDEX_NONE)
+	{
+		int32 next = mTimers[handle].Next;
+		Link(handle);
+		handle = next;
+	}
+}
+
+void FWebSocketTimerWheel::Advance(double now, TArray<uint64>& expired)
+{
+	uint64 target = ToTick(now);
+	while (mNow < target)
+	{
+		if (mCount == 0)
+		{
+			mNow = target;
+			return;
+		}
+
+		mNow++;
+
+		// the levels below wrapped, their timers move closer. top down, a timer may drop two levels
+		int32 iWrapped = 0;
+		while (iWrapped < WEBSOCKET_WHEEL_LEVELS - 1 && (mNow & (((uint64)1 << (WEBSOCKET_WHEEL_BITS * (iWrapped + 1))) - 1)) == 0)
+		{
+			iWrapped++;
+		}
+		for (int32 iLevel = iWrapped; iLevel > 0; iLevel--)
+		{
+			Cascade(iLevel);
+		}
+
+		int32 iSlot = (int32)(mNow & WEBSOCKET_WHEEL_MASK);
+		int32 handle = mSlots[iSlot];
+		mSlots[iSlot] = INDEX_NONE;
+		while (handle != INDEX_NONE)
+		{
+			FTimer& timer = mTimers[handle];
+			int32 next = timer.Next;
+			if (timer.Tick > mNow)
+			{
+				// parked beyond the top level
+				Link(handle);
+			}
+			else
+			{
+				expired.Add(timer.Id);
+				timer.Next = mFree;
+				mFree = handle;
+				mCount--;
+			}
+			handle = next;
+		}
+	}
+}
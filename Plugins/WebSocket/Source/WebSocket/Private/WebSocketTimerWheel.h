@@ -0,0 +1,76 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#define WEBSOCKET_WHEEL_BITS 6
+#define WEBSOCKET_WHEEL_SLOTS (1 << WEBSOCKET_WHEEL_BITS)
+#define WEBSOCKET_WHEEL_MASK (WEBSOCKET_WHEEL_SLOTS - 1)
+#define WEBSOCKET_WHEEL_LEVELS 4
+
+/**
+ * hierarchical timer wheel, 4 levels of 64 slots. a timer goes into the level whose range holds its
+ * deadline and moves one level down each time the level below wrapped, so Add and Cancel are O(1) and
+ * Advance costs one step per elapsed tick plus the timers it fires. with 10 ms ticks the top level
+ * reaches 46 hours, later deadlines wait there and are placed again. not thread safe.
+ */
+class FWebSocketTimerWheel
+{
+public:
+
+	FWebSocketTimerWheel(double tickSeconds, double now);
+
+	/** timer that hands id to Advance once deadline passed, the returned handle cancels it */
+	int32 Add(double deadline, uint64 id);
+	void Cancel(int32 handle);
+
+	/** move to now and append the ids of the timers that expired on the way */
+	void Advance(double now, TArray<uint64>& expired);
+
+	int32 Num() const { return mCount; }
+
+private:
+
+	struct FTimer
+	{
+		uint64 Id;
+		uint64 Tick;
+		int32 Slot;
+		int32 Prev;
+		int32 Next;
+	};
+
+	uint64 ToTick(double time) const { return (uint64)FMath::Max(0.0, time / mTickSeconds); }
+	void Link(int32 handle);
+	void Unlink(int32 handle);
+	void Cascade(int32 level);
+
+	double mTickSeconds;
+	uint64 mNow;
+	TArray<FTimer> mTimers;
+	int32 mFree;
+	int32 mCount;
+	int32 mSlots[WEBSOCKET_WHEEL_LEVELS * WEBSOCKET_WHEEL_SLOTS];
+};
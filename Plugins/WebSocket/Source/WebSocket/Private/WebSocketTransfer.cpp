@@ -0,0 +1,258 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+#include "WebSocket.h"
+#include "WebSocketTransfer.h"
+#include "WebSocketCodec.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Crc.h"
+#include "Misc/Paths.h"
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#elif PLATFORM_WINDOWS
+#include "PreWindowsApi.h"
+#include "libwebsockets.h"
+#include "PostWindowsApi.h"
+#else
+#include "libwebsockets.h"
+#endif
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+
+#define WEBSOCKET_TRANSFER_REPORT_INTERVAL 0.1
+
+FWebSocketOutTransfer::FWebSocketOutTransfer(uint16 id, const FString& name, TUniquePtr<FArchive>&& reader)
+	:mId(id), mName(name), mReader(MoveTemp(reader)), mSize(0), mSent(0), mMessageLeft(0), mCrc(0), mbFailed(false), mState(EState::Begin), mLastReport(0.0)
+{
+	mSize = mReader->TotalSize() - mReader->Tell();
+}
+
+uint8* FWebSocketOutTransfer::StartFrame(uint8 type, int32 len, bool bHeader)
+{
+	// SetNum keeps the allocation, every frame of the transfer reuses it
+	int32 iHeader = bHeader ? WEBSOCKET_TRANSFER_HEADER_SIZE : 0;
+	mFrame.bBinary = true;
+	mFrame.Payload.SetNumUninitialized(LWS_PRE + iHeader + len, false);
+
+	uint8* p = mFrame.Payload.GetData() + LWS_PRE;
+	if (bHeader)
+	{
+		p[0] = WEBSOCKET_TRANSFER_MAGIC;
+		p[1] = type;
+		p[2] = (uint8)(mId & 0xff);
+		p[3] = (uint8)(mId >> 8);
+	}
+	return p + iHeader;
+}
+
+FWebSocketOutMessage& FWebSocketOutTransfer::NextFrame(int32 chunkBytes, int32 messageBytes, bool& bFirst, bool& bFinal)
+{
+	bFirst = true;
+	bFinal = true;
+
+	if (mState == EState::Begin)
+	{
+		FTCHARToUTF8 Convert(*mName, mName.Len());
+		uint8* p = StartFrame(WEBSOCKET_TRANSFER_BEGIN, 8 + Convert.Length(), true);
+		for (int32 i = 0; i < 8; i++)
+		{
+			p[i] = (uint8)((uint64)mSize >> (i * 8));
+		}
+		FMemory::Memcpy(p + 8, Convert.Get(), Convert.Length());
+		mState = mSize > 0 ? EState::Data : EState::End;
+		return mFrame;
+	}
+
+	if (mState == EState::Data)
+	{
+		bFirst = mMessageLeft == 0;
+		if (bFirst)
+		{
+			mMessageLeft = FMath::Min<int64>(messageBytes, mSize - mSent);
+		}
+
+		int32 iLen = (int32)FMath::Min<int64>(chunkBytes, mMessageLeft);
+		uint8* p = StartFrame(WEBSOCKET_TRANSFER_DATA, iLen, bFirst);
+		if (!mbFailed)
+		{
+			mReader->Serialize(p, iLen);
+			mbFailed = mReader->IsError();
+		}
+
+		// the message length is not announced, but a started message has to be finished, so a failed read is padded
+		if (mbFailed)
+		{
+			FMemory::Memzero(p, iLen);
+		}
+		else
+		{
+			mCrc = FCrc::MemCrc32(p, iLen, mCrc);
+		}
+
+		mSent += iLen;
+		mMessageLeft -= iLen;
+		bFinal = mMessageLeft == 0;
+		if (bFinal && (mbFailed || mSent == mSize))
+		{
+			mState = EState::End;
+		}
+		return mFrame;
+	}
+
+	if (mbFailed)
+	{
+		StartFrame(WEBSOCKET_TRANSFER_ABORT, 0, true);
+	}
+	else
+	{
+		uint8* p = StartFrame(WEBSOCKET_TRANSFER_END, 4, true);
+		for (int32 i = 0; i < 4; i++)
+		{
+			p[i] = (uint8)(mCrc >> (i * 8));
+		}
+	}
+	mState = EState::Done;
+	mReader.Reset();
+	return mFrame;
+}
+
+bool FWebSocketOutTransfer::ShouldReport(double now)
+{
+	if (now - mLastReport < WEBSOCKET_TRANSFER_REPORT_INTERVAL)
+	{
+		return false;
+	}
+	mLastReport = now;
+	return true;
+}
+
+FWebSocketTransfer FWebSocketOutTransfer::GetInfo() const
+{
+	FWebSocketTransfer info;
+	info.TransferId = mId;
+	info.Name = mName;
+	info.bUpload = true;
+	info.TransferredBytes = mSent;
+	info.TotalBytes = mSize;
+	return info;
+}
+
+// transfers to the same name, on this or another connection, each write their own part file
+static FThreadSafeCounter GInTransferSerial;
+
+FWebSocketInTransfer::FWebSocketInTransfer(uint16 id, const FString& name, const FString& path, int64 size)
+	:mId(id), mName(name), mPath(path), mPartPath(FString::Printf(TEXT("%s.%d-%d.part"), *path, id, GInTransferSerial.Increment())), mSize(size), mReceived(0), mCrc(0), mbFailed(false), mbFinished(false), mLastReport(0.0)
+{
+}
+
+FWebSocketInTransfer::~FWebSocketInTransfer()
+{
+	mFile.Reset();
+	if (!mbFinished)
+	{
+		IFileManager::Get().Delete(*mPartPath, false, false, true);
+	}
+}
+
+bool FWebSocketInTransfer::Open()
+{
+	IPlatformFile& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+	platformFile.CreateDirectoryTree(*FPaths::GetPath(mPartPath));
+	mFile.Reset(platformFile.OpenWrite(*mPartPath));
+	if (!mFile.IsValid())
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: can not write %s, transfer %d dropped"), *mPartPath, mId);
+		mbFailed = true;
+		return false;
+	}
+	return true;
+}
+
+void FWebSocketInTransfer::Write(const uint8* data, int32 len)
+{
+	if (mbFailed)
+	{
+		return;
+	}
+
+	if (mReceived + len > mSize || !mFile->Write(data, len))
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: transfer %d to %s failed after %lld bytes"), mId, *mPath, mReceived);
+		mbFailed = true;
+		mFile.Reset();
+		return;
+	}
+
+	mCrc = FCrc::MemCrc32(data, len, mCrc);
+	mReceived += len;
+}
+
+bool FWebSocketInTransfer::Finish(uint32 crc)
+{
+	if (mbFailed)
+	{
+		return false;
+	}
+
+	mFile.Reset();
+	if (mReceived != mSize || mCrc != crc)
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: transfer %d to %s is corrupt, %lld of %lld bytes, crc %08x != %08x"), mId, *mPath, mReceived, mSize, mCrc, crc);
+		return false;
+	}
+
+	if (!IFileManager::Get().Move(*mPath, *mPartPath, true))
+	{
+		UE_LOG(WebSocket, Error, TEXT("websocket: can not move %s to %s"), *mPartPath, *mPath);
+		return false;
+	}
+
+	mbFinished = true;
+	return true;
+}
+
+bool FWebSocketInTransfer::ShouldReport(double now)
+{
+	if (now - mLastReport < WEBSOCKET_TRANSFER_REPORT_INTERVAL)
+	{
+		return false;
+	}
+	mLastReport = now;
+	return true;
+}
+
+FWebSocketTransfer FWebSocketInTransfer::GetInfo() const
+{
+	FWebSocketTransfer info;
+	info.TransferId = mId;
+	info.Name = mName;
+	info.Path = mPath;
+	info.bUpload = false;
+	info.TransferredBytes = mReceived;
+	info.TotalBytes = mSize;
+	return info;
+}
+#endif
@@ -0,0 +1,119 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Serialization/Archive.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "WebSocketBase.h"
+#include "WebSocketStats.h"
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+/**
+ * file or memory region on its way out, see WEBSOCKET_TRANSFER_MAGIC for the framing. the reader is
+ * pulled one fragment at a time into a buffer that is reused for every frame, so memory does not grow
+ * with the size of the file. created on the game thread, then only used by the service thread.
+ */
+class FWebSocketOutTransfer
+{
+public:
+
+	FWebSocketOutTransfer(uint16 id, const FString& name, TUniquePtr<FArchive>&& reader);
+
+	/** the next frame, bFirst and bFinal tell where it sits in its message */
+	FWebSocketOutMessage& NextFrame(int32 chunkBytes, int32 messageBytes, bool& bFirst, bool& bFinal);
+
+	/** a fragmented DATA message was started, nothing else may be written before its final frame */
+	bool IsMidMessage() const { return mMessageLeft > 0; }
+	bool IsDone() const { return mState == EState::Done; }
+	bool IsFailed() const { return mbFailed; }
+
+	/** at most every WEBSOCKET_TRANSFER_REPORT_INTERVAL seconds */
+	bool ShouldReport(double now);
+	FWebSocketTransfer GetInfo() const;
+
+private:
+
+	enum class EState : uint8
+	{
+		Begin,
+		Data,
+		End,
+		Done,
+	};
+
+	uint8* StartFrame(uint8 type, int32 len, bool bHeader);
+
+	uint16 mId;
+	FString mName;
+	TUniquePtr<FArchive> mReader;
+	int64 mSize;
+	int64 mSent;
+	int64 mMessageLeft;
+	uint32 mCrc;
+	bool mbFailed;
+	EState mState;
+	double mLastReport;
+	FWebSocketOutMessage mFrame;
+};
+
+/**
+ * file being received, written to a part file of its own next to path as the fragments arrive and renamed
+ * to path once the crc matched. service thread.
+ */
+class FWebSocketInTransfer
+{
+public:
+
+	FWebSocketInTransfer(uint16 id, const FString& name, const FString& path, int64 size);
+
+	/** an unfinished transfer deletes its part file */
+	~FWebSocketInTransfer();
+
+	bool Open();
+
+	/** bytes beyond the announced size or a failed write fail the transfer, the rest of it is dropped */
+	void Write(const uint8* data, int32 len);
+
+	bool Finish(uint32 crc);
+
+	bool ShouldReport(double now);
+	FWebSocketTransfer GetInfo() const;
+
+private:
+
+	uint16 mId;
+	FString mName;
+	FString mPath;
+	FString mPartPath;
+	TUniquePtr<IFileHandle> mFile;
+	int64 mSize;
+	int64 mReceived;
+	uint32 mCrc;
+	bool mbFailed;
+	bool mbFinished;
+	double mLastReport;
+};
+#endif
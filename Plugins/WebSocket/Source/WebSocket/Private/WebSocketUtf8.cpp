@@ -0,0 +1,578 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#include "WebSocket.h"
+#include "WebSocketUtf8.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+#include <arm_neon.h>
+#define WEBSOCKET_UTF8_SSE 0
+#define WEBSOCKET_UTF8_NEON 1
+#elif PLATFORM_ENABLE_VECTORINTRINSICS && (defined(__x86_64__) || defined(_M_X64))
+#include <emmintrin.h>
+#define WEBSOCKET_UTF8_SSE 1
+#define WEBSOCKET_UTF8_NEON 0
+#else
+#define WEBSOCKET_UTF8_SSE 0
+#define WEBSOCKET_UTF8_NEON 0
+#endif
+
+// a 4 byte TCHAR has no surrogates and no utf-16 vector path
+#define WEBSOCKET_UTF16 (sizeof(TCHAR) == 2)
+
+// the frame or string keeps its allocation while it is queued, worst case room above this is given back
+#define WEBSOCKET_UTF8_MAX_SLACK 1024
+
+static FORCEINLINE uint8* WebSocketPutUtf8(uint32 cp, uint8* out)
+{
+	if (cp < 0x80)
+	{
+		out[0] = (uint8)cp;
+		return out + 1;
+	}
+
+	if (cp < 0x800)
+	{
+		out[0] = (uint8)(0xC0 | (cp >> 6));
+		out[1] = (uint8)(0x80 | (cp & 0x3F));
+		return out + 2;
+	}
+
+	if (cp < 0x10000)
+	{
+		out[0] = (uint8)(0xE0 | (cp >> 12));
+		out[1] = (uint8)(0x80 | ((cp >> 6) & 0x3F));
+		out[2] = (uint8)(0x80 | (cp & 0x3F));
+		return out + 3;
+	}
+
+	out[0] = (uint8)(0xF0 | (cp >> 18));
+	out[1] = (uint8)(0x80 | ((cp >> 12) & 0x3F));
+	out[2] = (uint8)(0x80 | ((cp >> 6) & 0x3F));
+	out[3] = (uint8)(0x80 | (cp & 0x3F));
+	return out + 4;
+}
+
+#if WEBSOCKET_UTF8_SSE
+/** 4 code points of U+0800 to U+FFFF in 32 bit lanes as 12 bytes at p. writes 2 zero bytes past them */
+static FORCEINLINE void WebSocketPutUtf8Triples(__m128i cp, uint8* p)
+{
+	__m128i b0 = _mm_or_si128(_mm_srli_epi32(cp, 12), _mm_set1_epi32(0xE0));
+	__m128i b1 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(cp, 6), _mm_set1_epi32(0x3F)), _mm_set1_epi32(0x80));
+	__m128i b2 = _mm_or_si128(_mm_and_si128(cp, _mm_set1_epi32(0x3F)), _mm_set1_epi32(0x80));
+	__m128i t = _mm_or_si128(b0, _mm_or_si128(_mm_slli_epi32(b1, 8), _mm_slli_epi32(b2, 16)));
+
+	// no byte shuffle in sse2: the two sequences of a 64 bit half are joined by a shift, the halves stored 6 bytes apart
+	__m128i c = _mm_or_si128(_mm_and_si128(t, _mm_set_epi32(0, 0xFFFFFF, 0, 0xFFFFFF)),
+		_mm_and_si128(_mm_srli_epi64(t, 8), _mm_set_epi32(0xFFFF, (int)0xFF000000, 0xFFFF, (int)0xFF000000)));
+	_mm_storel_epi64((__m128i*)p, c);
+	_mm_storel_epi64((__m128i*)(p + 6), _mm_unpackhi_epi64(c, c));
+}
+#endif
+
+int32 WebSocketEncodeUtf8(const TCHAR* data, int32 len, uint8* out)
+{
+	uint8* p = out;
+	int32 i = 0;
+	while (i < len)
+	{
+		// blocks of 8 units that are all ascii, all 2 byte or all 3 byte. a mixed block goes below
+#if WEBSOCKET_UTF8_SSE
+		if (WEBSOCKET_UTF16)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			while (i + 8 <= len)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+				int32 iAscii = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16((short)0xFF80)), zero));
+				if (iAscii == 0xFFFF)
+				{
+					_mm_storel_epi64((__m128i*)p, _mm_packus_epi16(v, v));
+					i += 8;
+					p += 8;
+					continue;
+				}
+
+				__m128i high = _mm_and_si128(v, _mm_set1_epi16((short)0xF800));
+				int32 iShort = _mm_movemask_epi8(_mm_cmpeq_epi16(high, zero));
+				if (iShort == 0xFFFF && iAscii == 0)
+				{
+					// 110xxxxx in the low byte of a lane, 10xxxxxx in the high one, 16 bytes for 8 units
+					__m128i b0 = _mm_or_si128(_mm_srli_epi16(v, 6), _mm_set1_epi16(0xC0));
+					__m128i b1 = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi16(0x3F)), _mm_set1_epi16(0x80));
+					_mm_storeu_si128((__m128i*)p, _mm_or_si128(b0, _mm_slli_epi16(b1, 8)));
+					i += 8;
+					p += 16;
+					continue;
+				}
+
+				// a unit behind the block leaves at least 3 bytes of out for what the triples write past the 24
+				int32 iSurrogate = _mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_set1_epi16((short)0xD800)));
+				if (iShort == 0 && iSurrogate == 0 && i + 8 < len)
+				{
+					WebSocketPutUtf8Triples(_mm_unpacklo_epi16(v, zero), p);
+					WebSocketPutUtf8Triples(_mm_unpackhi_epi16(v, zero), p + 12);
+					i += 8;
+					p += 24;
+					continue;
+				}
+				break;
+			}
+		}
+#elif WEBSOCKET_UTF8_NEON
+		if (WEBSOCKET_UTF16)
+		{
+			while (i + 8 <= len)
+			{
+				uint16x8_t v = vld1q_u16((const uint16*)(data + i));
+				uint16 iMax = vmaxvq_u16(v);
+				if (iMax < 0x80)
+				{
+					vst1_u8(p, vmovn_u16(v));
+					i += 8;
+					p += 8;
+					continue;
+				}
+
+				uint16 iMin = vminvq_u16(v);
+				if (iMin >= 0x80 && iMax < 0x800)
+				{
+					uint8x8x2_t bytes;
+					bytes.val[0] = vmovn_u16(vorrq_u16(vshrq_n_u16(v, 6), vdupq_n_u16(0xC0)));
+					bytes.val[1] = vmovn_u16(vorrq_u16(vandq_u16(v, vdupq_n_u16(0x3F)), vdupq_n_u16(0x80)));
+					vst2_u8(p, bytes);
+					i += 8;
+					p += 16;
+					continue;
+				}
+
+				bool bSurrogate = vmaxvq_u16(vceqq_u16(vandq_u16(v, vdupq_n_u16(0xF800)), vdupq_n_u16(0xD800))) != 0;
+				if (iMin >= 0x800 && !bSurrogate)
+				{
+					uint8x8x3_t bytes;
+					bytes.val[0] = vmovn_u16(vorrq_u16(vshrq_n_u16(v, 12), vdupq_n_u16(0xE0)));
+					bytes.val[1] = vmovn_u16(vorrq_u16(vandq_u16(vshrq_n_u16(v, 6), vdupq_n_u16(0x3F)), vdupq_n_u16(0x80)));
+					bytes.val[2] = vmovn_u16(vorrq_u16(vandq_u16(v, vdupq_n_u16(0x3F)), vdupq_n_u16(0x80)));
+					vst3_u8(p, bytes);
+					i += 8;
+					p += 24;
+					continue;
+				}
+				break;
+			}
+		}
+#endif
+
+		// the block that stopped the vector loop, or the tail, one code point at a time
+		int32 iEnd = FMath::Min(i + 8, len);
+		while (i < iEnd)
+		{
+			uint32 cp = (uint32)data[i++];
+			if (cp >= 0xD800 && cp < 0xE000)
+			{
+				if (WEBSOCKET_UTF16 && cp < 0xDC00 && i < len && (uint32)data[i] >= 0xDC00 && (uint32)data[i] < 0xE000)
+				{
+					cp = 0x10000 + ((cp - 0xD800) << 10) + ((uint32)data[i++] - 0xDC00);
+				}
+				else
+				{
+					cp = 0xFFFD;
+				}
+			}
+			else if (cp > 0x10FFFF)
+			{
+				cp = 0xFFFD;
+			}
+			p = WebSocketPutUtf8(cp, p);
+		}
+	}
+
+	return (int32)(p - out);
+}
+
+/** the multi byte sequence at data[i], false when it is malformed. i moves past it */
+static FORCEINLINE bool WebSocketReadSequence(const uint8* data, int32 len, int32& i, uint32& cp)
+{
+	uint32 c = data[i];
+	if (c < 0xC2)
+	{
+		// a continuation byte or an overlong 2 byte form
+		return false;
+	}
+
+	if (c < 0xE0)
+	{
+		if (i + 1 >= len || (data[i + 1] & 0xC0) != 0x80)
+		{
+			return false;
+		}
+		cp = ((c & 0x1F) << 6) | (data[i + 1] & 0x3F);
+		i += 2;
+		return true;
+	}
+
+	if (c < 0xF0)
+	{
+		if (i + 2 >= len)
+		{
+			return false;
+		}
+
+		// E0 below A0 is overlong, ED above 9F a surrogate
+		uint32 c1 = data[i + 1];
+		uint32 c2 = data[i + 2];
+		uint32 iLow = (c == 0xE0) ? 0xA0 : 0x80;
+		uint32 iHigh = (c == 0xED) ? 0x9F : 0xBF;
+		if (c1 < iLow || c1 > iHigh || (c2 & 0xC0) != 0x80)
+		{
+			return false;
+		}
+		cp = ((c & 0x0F) << 12) | ((c1 & 0x3F) << 6) | (c2 & 0x3F);
+		i += 3;
+		return true;
+	}
+
+	if (c < 0xF5)
+	{
+		if (i + 3 >= len)
+		{
+			return false;
+		}
+
+		// F0 below 90 is overlong, F4 above 8F beyond U+10FFFF
+		uint32 c1 = data[i + 1];
+		uint32 c2 = data[i + 2];
+		uint32 c3 = data[i + 3];
+		uint32 iLow = (c == 0xF0) ? 0x90 : 0x80;
+		uint32 iHigh = (c == 0xF4) ? 0x8F : 0xBF;
+		if (c1 < iLow || c1 > iHigh || (c2 & 0xC0) != 0x80 || (c3 & 0xC0) != 0x80)
+		{
+			return false;
+		}
+		cp = ((c & 0x07) << 18) | ((c1 & 0x3F) << 12) | ((c2 & 0x3F) << 6) | (c3 & 0x3F);
+		i += 4;
+		return true;
+	}
+
+	return false;
+}
+
+#if WEBSOCKET_UTF8_SSE || WEBSOCKET_UTF8_NEON
+// sequences per vector block of 2 and 3 byte utf-8, and the input bytes a block reads
+#define WEBSOCKET_UTF8_PAIRS 8
+#define WEBSOCKET_UTF8_PAIRS_READ 16
+#if WEBSOCKET_UTF8_SSE
+#define WEBSOCKET_UTF8_TRIPLES 4
+#define WEBSOCKET_UTF8_TRIPLES_READ 16
+#else
+#define WEBSOCKET_UTF8_TRIPLES 8
+#define WEBSOCKET_UTF8_TRIPLES_READ 24
+#endif
+
+/**
+ * WEBSOCKET_UTF8_PAIRS 2 byte sequences at data, false when any of them is something else or overlong.
+ * out, when not null, gets a utf-16 unit per sequence
+ */
+static FORCEINLINE bool WebSocketReadPairs(const uint8* data, TCHAR* out)
+{
+#if WEBSOCKET_UTF8_SSE
+	// the lead byte 110xxxxx in the low byte of a 16 bit lane, 10xxxxxx in the high one. C0 and C1 are overlong
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v = _mm_loadu_si128((const __m128i*)data);
+	__m128i ok = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16((short)0xC0E0)), _mm_set1_epi16((short)0x80C0));
+	__m128i overlong = _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16(0x1E)), zero);
+	if (_mm_movemask_epi8(_mm_andnot_si128(overlong, ok)) != 0xFFFF)
+	{
+		return false;
+	}
+
+	if (out != nullptr)
+	{
+		__m128i cp = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0x1F)), 6), _mm_and_si128(_mm_srli_epi16(v, 8), _mm_set1_epi16(0x3F)));
+		_mm_storeu_si128((__m128i*)out, cp);
+	}
+	return true;
+#else
+	uint8x8x2_t v = vld2_u8(data);
+	uint8x8_t ok = vand_u8(vceq_u8(vand_u8(v.val[0], vdup_n_u8(0xE0)), vdup_n_u8(0xC0)), vceq_u8(vand_u8(v.val[1], vdup_n_u8(0xC0)), vdup_n_u8(0x80)));
+	if (vminv_u8(ok) == 0 || vminv_u8(v.val[0]) < 0xC2)
+	{
+		return false;
+	}
+
+	if (out != nullptr)
+	{
+		uint16x8_t cp = vorrq_u16(vshlq_n_u16(vmovl_u8(vand_u8(v.val[0], vdup_n_u8(0x1F))), 6), vmovl_u8(vand_u8(v.val[1], vdup_n_u8(0x3F))));
+		vst1q_u16((uint16*)out, cp);
+	}
+	return true;
+#endif
+}
+
+/** the same for WEBSOCKET_UTF8_TRIPLES 3 byte sequences, overlong forms and surrogates fail */
+static FORCEINLINE bool WebSocketReadTriples(const uint8* data, TCHAR* out)
+{
+#if WEBSOCKET_UTF8_SSE
+	// bytes 0-11 into one sequence per 32 bit lane: the 64 bit halves start at byte 0 and 6, each holds two
+	__m128i v = _mm_loadu_si128((const __m128i*)data);
+	__m128i halves = _mm_unpacklo_epi64(v, _mm_srli_si128(v, 6));
+	__m128i low = _mm_set_epi32(0, 0xFFFFFF, 0, 0xFFFFFF);
+	__m128i w = _mm_or_si128(_mm_and_si128(halves, low), _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(halves, 24), low), 32));
+
+	// 1110xxxx 10xxxxxx 10xxxxxx, below U+0800 is overlong
+	__m128i ok = _mm_cmpeq_epi32(_mm_and_si128(w, _mm_set1_epi32(0xC0C0F0)), _mm_set1_epi32(0x8080E0));
+	__m128i cp = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(w, _mm_set1_epi32(0x0F)), 12),
+		_mm_or_si128(_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(w, 8), _mm_set1_epi32(0x3F)), 6), _mm_and_si128(_mm_srli_epi32(w, 16), _mm_set1_epi32(0x3F))));
+	__m128i bad = _mm_or_si128(_mm_cmplt_epi32(cp, _mm_set1_epi32(0x800)), _mm_cmpeq_epi32(_mm_and_si128(cp, _mm_set1_epi32(0xF800)), _mm_set1_epi32(0xD800)));
+	if (_mm_movemask_epi8(_mm_andnot_si128(bad, ok)) != 0xFFFF)
+	{
+		return false;
+	}
+
+	if (out != nullptr)
+	{
+		// sse2 only packs 32 bit lanes signed, the code points are moved into that range and back
+		__m128i packed = _mm_packs_epi32(_mm_sub_epi32(cp, _mm_set1_epi32(0x8000)), _mm_setzero_si128());
+		_mm_storel_epi64((__m128i*)out, _mm_add_epi16(packed, _mm_set1_epi16((short)0x8000)));
+	}
+	return true;
+#else
+	uint8x8x3_t v = vld3_u8(data);
+	uint8x8_t ok = vand_u8(vceq_u8(vand_u8(v.val[0], vdup_n_u8(0xF0)), vdup_n_u8(0xE0)),
+		vand_u8(vceq_u8(vand_u8(v.val[1], vdup_n_u8(0xC0)), vdup_n_u8(0x80)), vceq_u8(vand_u8(v.val[2], vdup_n_u8(0xC0)), vdup_n_u8(0x80))));
+	if (vminv_u8(ok) == 0)
+	{
+		return false;
+	}
+
+	uint16x8_t cp = vorrq_u16(vshlq_n_u16(vmovl_u8(vand_u8(v.val[0], vdup_n_u8(0x0F))), 12),
+		vorrq_u16(vshlq_n_u16(vmovl_u8(vand_u8(v.val[1], vdup_n_u8(0x3F))), 6), vmovl_u8(vand_u8(v.val[2], vdup_n_u8(0x3F)))));
+	if (vminvq_u16(cp) < 0x800 || vmaxvq_u16(vceqq_u16(vandq_u16(cp, vdupq_n_u16(0xF800)), vdupq_n_u16(0xD800))) != 0)
+	{
+		return false;
+	}
+
+	if (out != nullptr)
+	{
+		vst1q_u16((uint16*)out, cp);
+	}
+	return true;
+#endif
+}
+#endif
+
+int32 WebSocketDecodeUtf8(const uint8* data, int32 len, TCHAR* out)
+{
+	TCHAR* p = out;
+	int32 i = 0;
+	while (i < len)
+	{
+		// out never runs ahead of data, so a whole vector of TCHARs always fits behind p
+#if WEBSOCKET_UTF8_SSE
+		if (WEBSOCKET_UTF16)
+		{
+			const __m128i zero = _mm_setzero_si128();
+			while (i + 16 <= len)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+				_mm_storeu_si128((__m128i*)p, _mm_unpacklo_epi8(v, zero));
+				_mm_storeu_si128((__m128i*)(p + 8), _mm_unpackhi_epi8(v, zero));
+
+				// only the ascii bytes in front of the first lead byte are kept
+				uint32 iMask = (uint32)_mm_movemask_epi8(v);
+				int32 iAscii = iMask != 0 ? (int32)FMath::CountTrailingZeros(iMask) : 16;
+				i += iAscii;
+				p += iAscii;
+				if (iAscii < 16)
+				{
+					break;
+				}
+			}
+		}
+#elif WEBSOCKET_UTF8_NEON
+		if (WEBSOCKET_UTF16)
+		{
+			while (i + 16 <= len)
+			{
+				uint8x16_t v = vld1q_u8(data + i);
+				if (vmaxvq_u8(v) >= 0x80)
+				{
+					break;
+				}
+
+				vst1q_u16((uint16*)p, vmovl_u8(vget_low_u8(v)));
+				vst1q_u16((uint16*)(p + 8), vmovl_high_u8(v));
+				i += 16;
+				p += 16;
+			}
+		}
+#endif
+
+		// a run of multi byte sequences, e.g. chinese text, stays here until the next ascii byte
+		while (i < len)
+		{
+			uint32 c = data[i];
+			if (c < 0x80)
+			{
+#if WEBSOCKET_UTF8_SSE || WEBSOCKET_UTF8_NEON
+				if (WEBSOCKET_UTF16 && i + 16 <= len)
+				{
+					break;
+				}
+#endif
+				*p++ = (TCHAR)c;
+				i++;
+				continue;
+			}
+
+			// whole blocks of 2 or 3 byte sequences in one vector step, a block with anything else one by one.
+			// a pair or triple block writes no more TCHARs than it reads bytes
+#if WEBSOCKET_UTF8_SSE || WEBSOCKET_UTF8_NEON
+			if (WEBSOCKET_UTF16 && c < 0xE0 && i + WEBSOCKET_UTF8_PAIRS_READ <= len && WebSocketReadPairs(data + i, p))
+			{
+				i += WEBSOCKET_UTF8_PAIRS * 2;
+				p += WEBSOCKET_UTF8_PAIRS;
+				continue;
+			}
+			if (WEBSOCKET_UTF16 && c >= 0xE0 && c < 0xF0 && i + WEBSOCKET_UTF8_TRIPLES_READ <= len && WebSocketReadTriples(data + i, p))
+			{
+				i += WEBSOCKET_UTF8_TRIPLES * 3;
+				p += WEBSOCKET_UTF8_TRIPLES;
+				continue;
+			}
+#endif
+
+			uint32 cp;
+			if (!WebSocketReadSequence(data, len, i, cp))
+			{
+				return INDEX_NONE;
+			}
+
+			if (WEBSOCKET_UTF16 && cp >= 0x10000)
+			{
+				cp -= 0x10000;
+				*p++ = (TCHAR)(0xD800 + (cp >> 10));
+				*p++ = (TCHAR)(0xDC00 + (cp & 0x3FF));
+				continue;
+			}
+
+			*p++ = (TCHAR)cp;
+		}
+	}
+
+	return (int32)(p - out);
+}
+
+bool WebSocketValidateUtf8(const uint8* data, int32 len)
+{
+	int32 i = 0;
+	while (i < len)
+	{
+#if WEBSOCKET_UTF8_SSE
+		while (i + 16 <= len)
+		{
+			uint32 iMask = (uint32)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(data + i)));
+			if (iMask != 0)
+			{
+				i += (int32)FMath::CountTrailingZeros(iMask);
+				break;
+			}
+			i += 16;
+		}
+#elif WEBSOCKET_UTF8_NEON
+		while (i + 16 <= len && vmaxvq_u8(vld1q_u8(data + i)) < 0x80)
+		{
+			i += 16;
+		}
+#endif
+
+		while (i < len)
+		{
+			uint32 c = data[i];
+			if (c < 0x80)
+			{
+#if WEBSOCKET_UTF8_SSE || WEBSOCKET_UTF8_NEON
+				if (i + 16 <= len)
+				{
+					break;
+				}
+#endif
+				i++;
+				continue;
+			}
+
+#if WEBSOCKET_UTF8_SSE || WEBSOCKET_UTF8_NEON
+			if (c < 0xE0 && i + WEBSOCKET_UTF8_PAIRS_READ <= len && WebSocketReadPairs(data + i, nullptr))
+			{
+				i += WEBSOCKET_UTF8_PAIRS * 2;
+				continue;
+			}
+			if (c >= 0xE0 && c < 0xF0 && i + WEBSOCKET_UTF8_TRIPLES_READ <= len && WebSocketReadTriples(data + i, nullptr))
+			{
+				i += WEBSOCKET_UTF8_TRIPLES * 3;
+				continue;
+			}
+#endif
+
+			uint32 cp;
+			if (!WebSocketReadSequence(data, len, i, cp))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void WebSocketAppendUtf8(const FString& data, TArray<uint8>& out)
+{
+	int32 iStart = out.Num();
+	out.SetNumUninitialized(iStart + WEBSOCKET_UTF8_MAX_BYTES(data.Len()), false);
+	int32 iLen = WebSocketEncodeUtf8(*data, data.Len(), out.GetData() + iStart);
+	out.SetNum(iStart + iLen, false);
+	if (out.GetSlack() > WEBSOCKET_UTF8_MAX_SLACK)
+	{
+		out.Shrink();
+	}
+}
+
+bool WebSocketDecodeUtf8(const uint8* data, int32 len, FString& out)
+{
+	TArray<TCHAR>& chars = out.GetCharArray();
+	chars.SetNumUninitialized(len + 1, false);
+	int32 iLen = WebSocketDecodeUtf8(data, len, chars.GetData());
+	if (iLen <= 0)
+	{
+		out.Empty();
+		return iLen == 0;
+	}
+
+	chars[iLen] = 0;
+	chars.SetNum(iLen + 1, false);
+	if (chars.GetSlack() > WEBSOCKET_UTF8_MAX_SLACK)
+	{
+		chars.Shrink();
+	}
+	return true;
+}
@@ -0,0 +1,53 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** worst case utf-8 bytes for len TCHARs, 3 per utf-16 unit and 4 per utf-32 one */
+#define WEBSOCKET_UTF8_MAX_BYTES(len) ((len) * (sizeof(TCHAR) == 2 ? 3 : 4))
+
+/**
+ * TCHAR to utf-8 into out, which has room for WEBSOCKET_UTF8_MAX_BYTES(len). blocks of 8 units that all
+ * encode to 1, 2 or 3 bytes take one vector step (sse2 or neon), a mixed block or surrogates go one code
+ * point at a time. unpaired surrogates become U+FFFD. returns the bytes written.
+ */
+int32 WebSocketEncodeUtf8(const TCHAR* data, int32 len, uint8* out);
+
+/**
+ * utf-8 to TCHAR into out, which has room for len TCHARs. validates while it converts: overlong forms,
+ * surrogates, code points above U+10FFFF and cut sequences fail with INDEX_NONE. ascii runs take 16
+ * bytes per vector step, runs of 2 or 3 byte sequences 8 or 4 (sse2) / 8 (neon) sequences with a utf-16
+ * TCHAR. 4 byte sequences and mixed blocks go one at a time. returns the TCHARs written.
+ */
+int32 WebSocketDecodeUtf8(const uint8* data, int32 len, TCHAR* out);
+
+/** the checks of WebSocketDecodeUtf8 without converting, for text that stays utf-8 */
+bool WebSocketValidateUtf8(const uint8* data, int32 len);
+
+/** append data as utf-8 to out */
+void WebSocketAppendUtf8(const FString& data, TArray<uint8>& out);
+
+/** false and an empty out for malformed utf-8 */
+bool WebSocketDecodeUtf8(const uint8* data, int32 len, FString& out);
@@ -24,6 +24,13 @@
 #include "Components/ActorComponent.h"
 #include "UObject/NoExportTypes.h"
 #include "Delegates/DelegateCombinations.h"
+#include "Containers/Queue.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Async/Future.h"
+#include "WebSocketStats.h"
+#include "WebSocketDecoder.h"
+#include "WebSocketRequest.h"
 #include "WebSocketBase.generated.h"
 
 
@@ -33,6 +40,14 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWebSocketConnectError, const FStrin
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FWebSocketClosed);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FWebSocketConnected);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWebSocketRecieve, const FString&, data);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWebSocketRecieveBinary, const TArray<uint8>&, data);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWebSocketReceiveDecoded, const FWebSocketDecodedMessage&, Message);
+DECLARE_DYNAMIC_DELEGATE_TwoParams(FWebSocketCommandHandler, int32, Cmd, UObject*, Message);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWebSocketPong, float, RttMs);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWebSocketFailover, const FString&, Endpoint);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWebSocketProbeComplete, const TArray<FWebSocketEndpointStatus>&, Endpoints);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWebSocketTransferProgress, const FWebSocketTransfer&, Transfer);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FWebSocketTransferComplete, const FWebSocketTransfer&, Transfer, bool, bSuccess);
 
 
 #if PLATFORM_UWP
@@ -106,15 +121,131 @@ private:
 };
 
 #else
-struct lws_context;
-struct lws;
+class UWebSocketContext;
+class FWebSocketEndpointSet;
+class FWebSocketJournal;
 #endif
 
+class UWebSocketBase;
+class UWebSocketChannel;
+class UWebSocketServer;
+class UWebSocketSettings;
+class FWebSocketConnection;
+class FWebSocketRequestTracker;
+class FWebSocketClock;
+
+/**
+ * game thread side of an FWebSocketConnection, a UWebSocketBase or an FWebSocketPool. the connection
+ * posts its events here, connection is the one that raised them.
+ */
+class WEBSOCKET_API FWebSocketConnectionOwner
+{
+public:
+
+	virtual ~FWebSocketConnectionOwner() {}
+
+	virtual void HandleEstablished(FWebSocketConnection* connection, const FString& protocol) {}
+	virtual void HandleConnectError(FWebSocketConnection* connection, const FString& error) {}
+	virtual void HandleClosed(FWebSocketConnection* connection) {}
+	virtual void HandlePong(FWebSocketConnection* connection, float rttMs) {}
+
+	/** the connection's inbox has messages */
+	virtual void HandleDeliver(FWebSocketConnection* connection) {}
+};
+
+/** utf-8 frame waiting for the socket, Payload starts with the lws header room */
+struct FWebSocketOutMessage
+{
+	TArray<uint8> Payload;
+
+	/** broadcast frame built once and queued on every recipient, written instead of Payload when set */
+	TSharedPtr<TArray<uint8>, ESPMode::ThreadSafe> Shared;
+	bool bBinary;
+
+	FWebSocketOutMessage() :bBinary(false) {}
+
+	TArray<uint8>& GetFrame() { return Shared.IsValid() ? *Shared : Payload; }
+};
+
+/** received message waiting for OnReceiveData or OnReceiveBinary, WireBytes is what it cost in the receive budget */
+struct FWebSocketInMessage
+{
+	FString Data;
+	TArray<uint8> Binary;
+	bool bBinary;
+	int32 WireBytes;
+
+	/** text kept as validated utf-8 in Binary for native receive handlers, Data is empty */
+	bool bUtf8;
+
+	/** logical channel, INDEX_NONE for messages sent on the socket itself */
+	int32 Channel;
+
+	/** built by the socket's decoder, Data and Binary are empty then */
+	FWebSocketDecodedMessage Decoded;
+	bool bDecoded;
+
+	FWebSocketInMessage() :bBinary(false), WireBytes(0), bUtf8(false), Channel(INDEX_NONE), bDecoded(false) {}
+};
+
+/** received message of a native receive handler, the bytes are only valid during the call */
+struct WEBSOCKET_API FWebSocketMessageView
+{
+	/** utf-8 text, not null terminated, or the binary payload */
+	TArrayView<const uint8> Data;
+	bool bBinary;
+	/** the protocol negotiated the plugin's binary frames, only then a binary message may be a command frame */
+	bool bPluginFrames;
+
+	FWebSocketMessageView(TArrayView<const uint8> data, bool bBinaryMessage, bool bPluginFrameProtocol = false) :Data(data), bBinary(bBinaryMessage), bPluginFrames(bPluginFrameProtocol) {}
+
+	const ANSICHAR* GetUtf8() const { return (const ANSICHAR*)Data.GetData(); }
+	int32 Num() const { return Data.Num(); }
+
+	/** the conversion OnReceiveData pays for every message */
+	FString ToString() const;
+};
+
+DECLARE_MULTICAST_DELEGATE_TwoParams(FWebSocketNativeReceive, UWebSocketBase*, const FWebSocketMessageView&);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FWebSocketNativeDecoded, UWebSocketBase*, const FWebSocketDecodedMessage&);
+
+/** handler of one cmd and the class its messages are read into */
+USTRUCT()
+struct FWebSocketCommandRoute
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY()
+	UClass* Class;
+
+	UPROPERTY()
+	FWebSocketCommandHandler Handler;
+
+	TFunction<void(UWebSocketBase*, UObject*)> Native;
+
+	FWebSocketCommandRoute() :Class(nullptr) {}
+};
+
+/**
+ * messages on their way to OnReceiveData. filled by the lws service thread and the codec workers,
+ * drained on the game thread, so everything in here is thread safe.
+ */
+struct FWebSocketInbox
+{
+	TQueue<FWebSocketInMessage, EQueueMode::Mpsc> Messages;
+	FThreadSafeCounter PendingBytes;
+	FThreadSafeCounter PendingMessages;
+	FThreadSafeCounter PauseCount;
+	FThreadSafeCounter ResumeCount;
+	FThreadSafeBool bPaused;
+	FThreadSafeBool bDeliverScheduled;
+};
+
 /**
  * 
  */
 UCLASS(Blueprintable, BlueprintType)
-class WEBSOCKET_API UWebSocketBase:public UObject
+class WEBSOCKET_API UWebSocketBase:public UObject, public FWebSocketConnectionOwner
 {
 	GENERATED_BODY()
 public:
@@ -127,12 +258,134 @@ public:
 	void SendText(const FString& data);
 
 	UFUNCTION(BlueprintCallable, Category = WebSocket)
-	void Close();
+	void SendBinary(const TArray<uint8>& data);
+
+	/** send a message registered with RegisterFrameText or RegisterFrameBinary on this socket's context, as it was encoded then */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	bool SendFrame(FWebSocketFrameHandle Handle);
+
+	/**
+	 * flush the queued messages for up to DrainTimeout seconds, then send a close frame with Code and Reason.
+	 * OnClosed fires once the peer acknowledged the close or the connection dropped.
+	 */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	void Close(int32 Code = 1000, const FString& Reason = TEXT(""), float DrainTimeout = 1.0f);
+
+	/** undelivered receive bytes and how often reading was paused for them */
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	FWebSocketRxStats GetRxStats() const;
+
+	/** bandwidth estimate and token bucket state, bEnablePacing has to be set for the estimate */
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	FWebSocketPacingStats GetPacingStats() const;
+
+	/** delivered bytes per second the pacer measured, 0 before the first estimate. lower update rates when it drops */
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	float GetEstimatedBandwidth() const { return GetPacingStats().EstimatedBandwidth; }
+
+	/**
+	 * logical channel multiplexed over this socket, the server has to speak the channel framing.
+	 * higher Priority channels are written first when the socket is congested. MaxQueuedBytes limits
+	 * the channel's send queue, above MaxPendingBytes of undelivered messages the server is asked to
+	 * pause the channel. 0 disables a limit. returns the open channel when Channel is already open.
+	 */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	UWebSocketChannel* OpenChannel(int32 Channel, int32 Priority = 0, int32 MaxQueuedBytes = 0, int32 MaxPendingBytes = 0);
+
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	UWebSocketChannel* GetChannel(int32 Channel) const;
+
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	TArray<FWebSocketChannelStats> GetChannelStats() const;
+
+	/**
+	 * journal the messages of SendDurableText and SendDurableBinary in Saved/WebSocket/<Name>.journal.
+	 * they are kept until the server acknowledged them and sent again after every connect, also after a
+	 * crash or in the next launch. the server has to speak the durable framing, see WEBSOCKET_DURABLE_MAGIC,
+	 * on a protocol with bPluginFrames.
+	 */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	bool OpenDurableLane(const FString& Name);
+
+	/** false when no durable lane is open or its journal is full, the message is not sent then */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	bool SendDurableText(const FString& data);
+
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	bool SendDurableBinary(const TArray<uint8>& data);
 
-	bool Connect(const FString& uri, const TMap<FString, FString>& header);
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	FWebSocketDurableStats GetDurableStats() const;
+
+	/** journal and send, returns the message's sequence or 0 */
+	uint64 SendDurable(const uint8* data, int32 len, bool bBinary);
+
+	/**
+	 * stream the file at Path to the server under Name, one chunk at a time, see WEBSOCKET_TRANSFER_MAGIC.
+	 * returns the transfer id OnTransferProgress and OnTransferComplete report, -1 when the file can not
+	 * be read. a dropped connection fails the transfer.
+	 */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	int32 SendFile(const FString& Path, const FString& Name);
+
+	/** like SendFile from any archive, a memory reader over a mapped region as well as a file */
+	int32 SendStream(TUniquePtr<FArchive>&& reader, const FString& name);
+
+	/** write the files the server sends to Directory, Saved/WebSocket/Transfers when empty */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	void AcceptTransfers(const FString& Directory = TEXT(""));
+
+	/**
+	 * estimate the server's clock from clock frames, see WEBSOCKET_CLOCK_MAGIC: ClockSyncBurst exchanges after
+	 * every connect, then one every ClockSyncInterval. sockets of a UWebSocketServer answer them. false on uwp and html5.
+	 */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	bool StartClockSync();
+
+	/** no more exchanges, GetServerTime keeps the last estimate with a growing error */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	void StopClockSync();
+
+	/** the server's clock now, off by up to ErrorMs. utc now with ErrorMs -1 before the first exchange */
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	FDateTime GetServerTime(float& ErrorMs) const;
+
+	/** microseconds since the unix epoch on the server's clock, false before the first exchange */
+	bool GetServerTimeUs(int64& serverUs, double& errorUs) const;
+
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	FWebSocketClockStats GetClockStats() const;
+
+	/** websocket ping, OnPong fires with the round trip time */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	void Ping();
+
+	/** url of the current connection, with ConnectEndpoints the endpoint that was picked last */
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	FString GetEndpoint() const { return mEndpoint; }
+
+	/** subprotocol the server accepted, empty until connected or when it picked none */
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	FString GetProtocol() const { return mProtocol; }
+
+	bool IsClosing() const { return mbClosing; }
+	bool IsOpen() const;
+
+	bool Connect(const FString& uri, const TMap<FString, FString>& header, const FString& protocol = FString());
+
+	/**
+	 * probe every endpoint at once and connect to the one with the lowest ping rtt, the second fastest stays
+	 * connected as warm standby. when the connection drops the standby takes over and OnFailover fires,
+	 * messages still queued on the dropped connection are lost, channel queues carry over. OnClosed only
+	 * fires once no endpoint is left. uwp and html5 connect to the first endpoint.
+	 */
+	bool ConnectEndpoints(const TArray<FString>& uris, const TMap<FString, FString>& header, const FString& protocol = FString());
+
+	/** probe the endpoints without connecting, OnProbeComplete gets the results */
+	bool ProbeEndpoints(const TArray<FString>& uris, const TMap<FString, FString>& header, const FString& protocol = FString());
 
 #if PLATFORM_UWP
-	Concurrency::task<void> ConnectAsync(Platform::String^ uriString);
+	Concurrency::task<void> ConnectAsync(Platform::String^ uriString, Platform::String^ protocol);
 	void MessageReceived(Windows::Networking::Sockets::MessageWebSocket^ sender, Windows::Networking::Sockets::MessageWebSocketMessageReceivedEventArgs^ args);
 	void OnUWPClosed(Windows::Networking::Sockets::IWebSocket^ sender, Windows::Networking::Sockets::WebSocketClosedEventArgs^ args);
 	Concurrency::task<void> SendAsync(Platform::String^ message);
@@ -150,10 +403,111 @@ public:
 	UPROPERTY(BlueprintAssignable, Category = WebSocket)
 	FWebSocketRecieve OnReceiveData;
 
-	void Cleanlws();
-	void ProcessWriteable();
-	void ProcessRead(const char* in, int len);
-	bool ProcessHeader(unsigned char** p, unsigned char* end);
+	/** binary frames of a protocol with the Binary codec */
+	UPROPERTY(BlueprintAssignable, Category = WebSocket)
+	FWebSocketRecieveBinary OnReceiveBinary;
+
+	/** messages the decoder built, the rest still goes to OnReceiveData and OnReceiveBinary */
+	UPROPERTY(BlueprintAssignable, Category = WebSocket)
+	FWebSocketReceiveDecoded OnReceiveDecoded;
+
+	UPROPERTY(BlueprintAssignable, Category = WebSocket)
+	FWebSocketPong OnPong;
+
+	/** ConnectEndpoints moved to another endpoint, state the server kept per connection has to be restored */
+	UPROPERTY(BlueprintAssignable, Category = WebSocket)
+	FWebSocketFailover OnFailover;
+
+	/** ProbeEndpoints finished, healthy endpoints first, fastest first */
+	UPROPERTY(BlueprintAssignable, Category = WebSocket)
+	FWebSocketProbeComplete OnProbeComplete;
+
+	/** at most every 100 ms per transfer, in both directions */
+	UPROPERTY(BlueprintAssignable, Category = WebSocket)
+	FWebSocketTransferProgress OnTransferProgress;
+
+	/** a received file is at Transfer.Path once bSuccess, nothing is left on disk otherwise */
+	UPROPERTY(BlueprintAssignable, Category = WebSocket)
+	FWebSocketTransferComplete OnTransferComplete;
+
+	void ProcessRead(const char* in, int len, bool bBinary = false, bool bFinal = true);
+	void ProcessMessage(const uint8* data, int32 len, bool bBinary);
+
+	/**
+	 * receive flow control, every message counts against RxPauseBytes from the moment it is read until
+	 * OnReceiveData returned. above the limit the socket is not read anymore, so tcp pushes back on the server.
+	 */
+	void ReleaseRxBytes(int32 len);
+	void DeliverInbox(bool bIgnoreBudget = false);
+
+	/**
+	 * c++ receive without reflection and without the FString of OnReceiveData: the handler gets the socket
+	 * and a view of the message bytes, text frames as validated utf-8. while a handler is added text stays
+	 * utf-8 until delivery, OnReceiveData and OnReceiveBinary keep firing after the handlers. game thread.
+	 */
+	FDelegateHandle AddReceiveHandler(TFunction<void(UWebSocketBase*, const FWebSocketMessageView&)>&& handler);
+	void RemoveReceiveHandler(FDelegateHandle handle);
+
+	/**
+	 * parse messages on task graph workers instead of in OnReceiveData, the decoder picks the type per message.
+	 * what it built reaches OnReceiveDecoded and the decoded handlers in the order the messages arrived, mixed
+	 * with the messages it left alone. null turns decoding off. html5 and uwp decode on the game thread.
+	 */
+	void SetDecoder(const TSharedPtr<IWebSocketMessageDecoder, ESPMode::ThreadSafe>& decoder);
+
+	/** SetDecoder with an FWebSocketJsonDecoder, Structs maps the TypeField value to the struct BodyField is read into */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	bool SetJsonDecoder(const TMap<int32, UScriptStruct*>& Structs, const FString& TypeField = TEXT("cmd"), const FString& BodyField = TEXT("body"));
+
+	FDelegateHandle AddDecodedHandler(TFunction<void(UWebSocketBase*, const FWebSocketDecodedMessage&)>&& handler);
+	void RemoveDecodedHandler(FDelegateHandle handle);
+
+	/**
+	 * call Handler with every message of Cmd, read into a new object of Class. the cmd is scanned for without
+	 * parsing the message, or read from the command header, and the json is parsed once on a task graph worker.
+	 * a null Class takes the one RegisterCommand registered for Cmd. routed messages skip OnReceiveData.
+	 */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	bool RouteCommand(int32 Cmd, FWebSocketCommandHandler Handler, UClass* Class = nullptr);
+
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	void UnrouteCommand(int32 Cmd);
+
+	bool AddCommandHandler(int32 cmd, UClass* messageClass, TFunction<void(UWebSocketBase*, UObject*)>&& handler);
+
+	template<typename T>
+	bool AddCommandHandler(int32 cmd, TFunction<void(UWebSocketBase*, T*)>&& handler)
+	{
+		return AddCommandHandler(cmd, T::StaticClass(), [handler = MoveTemp(handler)](UWebSocketBase* socket, UObject* message)
+		{
+			handler(socket, (T*)message);
+		});
+	}
+
+	/**
+	 * send the json object data with a correlation id in RequestIdField, the future completes with the response
+	 * that carries the same id or after timeout seconds, RequestTimeout when 0. responses complete their request
+	 * instead of reaching OnReceiveData, OnReceiveDecoded or a command route. game thread.
+	 */
+	TFuture<FWebSocketResponse> Request(const FString& data, float timeout = 0.0f);
+
+	/** count, outcome and latency percentiles of the requests per cmd */
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	TArray<FWebSocketRequestStats> GetRequestStats() const;
+
+	/** settings of the context the socket was connected through */
+	const UWebSocketSettings* GetSettings() const;
+
+	/** a channel queued a message */
+	void RequestWrite();
+	void DeliverChannel(const FWebSocketInMessage& msg);
+	void DeliverMessage(FWebSocketInMessage& msg);
+	bool DeliverCommand(const FWebSocketDecodedMessage& message);
+	bool CompleteRequest(FWebSocketInMessage& msg);
+	void FailRequests();
+
+	/** the decoder connections get, a command router in front of mDecoder while commands are routed */
+	void UpdateDecoder();
 
 #if PLATFORM_UWP
 	Windows::Networking::Sockets::MessageWebSocket^ messageWebSocket;
@@ -165,10 +519,68 @@ public:
 	bool mIsError;
 	FHtml5SocketHelper mHtml5SocketHelper;
 #else
-	struct lws_context* mlwsContext;
-	struct lws* mlws;
+	TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe> CreateConnection(int32 protocolIndex, bool bStandby);
+
+	/** parse uri and open a connection, a standby one is not assigned to mConnection */
+	TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe> OpenConnection(const FString& uri, const TMap<FString, FString>& header, int32 protocolIndex, bool bStandby);
+	/** delivers what is left in the inbox, fails the open requests and broadcasts OnClosed */
+	void NotifyClosed();
+
+	/** the caller broadcasts OnConnectComplete or OnFailover after it settled its own state, a handler may connect again */
+	void PromoteConnection(const TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe>& connection, const FString& endpoint, const FString& protocol);
+
+	/** become the socket of a connection a UWebSocketServer accepted, endpoint is the client's address */
+	void AdoptConnection(UWebSocketContext* context, UWebSocketServer* server, const TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe>& connection, const FString& endpoint, const FString& protocol);
+
+	/** game thread, events of mConnection and of the endpoint set's standby connections */
+	virtual void HandleEstablished(FWebSocketConnection* connection, const FString& protocol) override;
+	virtual void HandleConnectError(FWebSocketConnection* connection, const FString& error) override;
+	virtual void HandleClosed(FWebSocketConnection* connection) override;
+	virtual void HandlePong(FWebSocketConnection* connection, float rttMs) override;
+	virtual void HandleDeliver(FWebSocketConnection* connection) override { DeliverInbox(); }
+	void HandleDurableAck(uint64 sequence);
+	void HandleTransfer(const FWebSocketTransfer& transfer, bool bComplete, bool bSuccess);
+
+	/** queue the unacknowledged journal entries on a connection that just became mConnection */
+	void ReplayDurable();
+
+	UWebSocketContext* mContext;
+	TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe> mConnection;
+	TSharedPtr<FWebSocketEndpointSet> mEndpointSet;
+	TSharedPtr<FWebSocketJournal, ESPMode::ThreadSafe> mJournal;
+	FString mTransferDirectory;
+	uint16 mNextTransferId;
+
+	/** the server that accepted the connection, null for client sockets */
+	TWeakObjectPtr<UWebSocketServer> mServer;
+
+	/** the context that queued this socket's connect until it is created */
+	TWeakObjectPtr<UWebSocketContext> mPendingContext;
 #endif
 	
-	TArray<FString> mSendQueue;
-	TMap<FString, FString> mHeaderMap;
+	TArray<uint8> mRecvBuffer;
+	FString mProtocol;
+	FString mEndpoint;
+
+	UPROPERTY()
+	TMap<int32, UWebSocketChannel*> mChannels;
+
+	TSharedPtr<FWebSocketInbox, ESPMode::ThreadSafe> mInbox;
+	FWebSocketNativeReceive mNativeReceive;
+	FWebSocketNativeDecoded mNativeDecoded;
+	TSharedPtr<IWebSocketMessageDecoder, ESPMode::ThreadSafe> mDecoder;
+	TSharedPtr<IWebSocketMessageDecoder, ESPMode::ThreadSafe> mConnectionDecoder;
+
+	UPROPERTY()
+	TMap<int32, FWebSocketCommandRoute> mCommands;
+	TSharedPtr<FWebSocketRequestTracker> mRequests;
+
+	/** kept across connects and failovers, a stopped sync keeps its estimate */
+	TSharedPtr<FWebSocketClock, ESPMode::ThreadSafe> mClock;
+	bool mbClockSync;
+
+	uint64 mDeliverFrame;
+	int32 mDeliveredBytes;
+
+	bool mbClosing;
 };
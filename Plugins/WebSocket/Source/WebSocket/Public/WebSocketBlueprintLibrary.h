@@ -23,6 +23,11 @@
 
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "WebSocketBase.h"
+#include "WebSocketServer.h"
+#include "WebSocketPool.h"
+#include "WebSocketStats.h"
+#include "WebSocketRequest.h"
+#include "Engine/LatentActionManager.h"
 #include "Runtime/Json/Public/Dom/JsonObject.h"
 #include "Runtime/JsonUtilities/Public/JsonObjectConverter.h"
 #include "Runtime/JsonUtilities/Public/JsonObjectWrapper.h"
@@ -65,6 +70,8 @@ public:
 };
 
 
+class UWebSocketContext;
+
 USTRUCT(BlueprintType)
 struct FWebSocketHeaderPair
 {
@@ -93,15 +100,109 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "WebSocket")
 	static UWebSocketBase* ConnectWithHeader(const FString& url, const TArray<FWebSocketHeaderPair>& header, bool& connectFail);
 
+	/** offer one of the subprotocols registered in the websocket settings, GetProtocol tells which one the server accepted */
+	UFUNCTION(BlueprintCallable, Category = "WebSocket")
+	static UWebSocketBase* ConnectWithProtocol(const FString& url, const FString& protocol, const TArray<FWebSocketHeaderPair>& header, bool& connectFail);
+
+	/** connect to the endpoint with the lowest ping rtt and fail over to the next one, see UWebSocketBase::ConnectEndpoints */
+	UFUNCTION(BlueprintCallable, Category = "WebSocket")
+	static UWebSocketBase* ConnectEndpoints(const TArray<FString>& urls, const FString& protocol, const TArray<FWebSocketHeaderPair>& header, bool& connectFail);
+
+	/** probe the endpoints, eg for a region list, the returned socket's OnProbeComplete gets the results */
+	UFUNCTION(BlueprintCallable, Category = "WebSocket")
+	static UWebSocketBase* ProbeEndpoints(const TArray<FString>& urls, bool& probeFail);
+
+	/** accept websocket connections on port, eg on a dedicated server. not available on uwp and html5 */
+	UFUNCTION(BlueprintCallable, Category = "WebSocket")
+	static UWebSocketServer* Listen(int32 port, bool& listenFail);
+
+	/** c++ only, connections without a UObject each on the process wide context, see FWebSocketPool */
+	static TSharedRef<FWebSocketPool, ESPMode::ThreadSafe> CreatePool(IWebSocketPoolListener* listener);
+
+	/** every probed endpoint with its last rtt, including results older than EndpointCacheTtl */
+	UFUNCTION(BlueprintPure, Category = "WebSocket")
+	static TArray<FWebSocketEndpointStatus> GetEndpointLatencies();
+
+	/** create the websocket context ahead of the first connect, eg behind a loading screen */
+	UFUNCTION(BlueprintCallable, Category = "WebSocket")
+	static void WarmUp();
+
+	/** close all connections and destroy the websocket context within Timeout seconds, the next connect creates a new one */
+	UFUNCTION(BlueprintCallable, Category = "WebSocket")
+	static void ShutdownContext(float Timeout = 2.0f);
+
+	/** context creation time and connects still waiting for it */
+	UFUNCTION(BlueprintPure, Category = "WebSocket")
+	static FWebSocketContextStats GetContextStats();
+
+	/** resumed handshake rate and handshake latency of wss connections */
+	UFUNCTION(BlueprintPure, Category = "WebSocket")
+	static FWebSocketTlsStats GetTlsStats();
+
+	/**
+	 * encode a message that is sent again and again, eg a heartbeat or a list poll, once. sockets of the
+	 * global context send it with SendFrame without json, utf-8 conversion or compression.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "WebSocket")
+	static FWebSocketFrameHandle RegisterFrameText(const FString& data);
+
+	UFUNCTION(BlueprintCallable, Category = "WebSocket")
+	static FWebSocketFrameHandle RegisterFrameBinary(const TArray<uint8>& data);
+
+	/** ObjectToJson once, the handle sends that json */
+	UFUNCTION(BlueprintCallable, Category = "WebSocket")
+	static FWebSocketFrameHandle RegisterFrameObject(UObject* Object);
+
+	UFUNCTION(BlueprintCallable, Category = "WebSocket")
+	static void UnregisterFrame(FWebSocketFrameHandle handle);
+
+	/** the class messages of Cmd are read into by UWebSocketBase::RouteCommand, ProtoTool generates the calls */
+	UFUNCTION(BlueprintCallable, Category = "WebSocket")
+	static void RegisterCommand(int32 Cmd, UClass* Class);
+
+	UFUNCTION(BlueprintPure, Category = "WebSocket")
+	static UClass* GetCommandClass(int32 Cmd);
+
+	/** UWebSocketBase::Request as a latent node, it continues once Response completed. triggers while it waits are ignored */
+	UFUNCTION(BlueprintCallable, Category = "WebSocket", meta = (Latent, LatentInfo = "LatentInfo", WorldContext = "WorldContextObject"))
+	static void Request(UObject* WorldContextObject, UWebSocketBase* Socket, const FString& Data, float Timeout, FLatentActionInfo LatentInfo, FWebSocketResponse& Response);
+
+	/** Request with Message as json, the response is read into a new ResponseClass object, null unless Result is Success */
+	UFUNCTION(BlueprintCallable, Category = "WebSocket", meta = (Latent, LatentInfo = "LatentInfo", WorldContext = "WorldContextObject"))
+	static void RequestObject(UObject* WorldContextObject, UWebSocketBase* Socket, UObject* Message, UClass* ResponseClass, float Timeout, FLatentActionInfo LatentInfo, EWebSocketRequestResult& Result, UObject*& Response);
+
 	UFUNCTION(BlueprintCallable, Category = "WebSocket")
 	static UObject* JsonToObject(const FString& data, UClass * StructDefinition, bool checkAll);
 	
+	/** copy the struct of a message from OnReceiveDecoded to Struct, false when the message holds another type */
+	UFUNCTION(BlueprintCallable, CustomThunk, Category = "WebSocket", meta = (CustomStructureParam = "Struct"))
+	static bool GetDecodedStruct(const FWebSocketDecodedMessage& Message, int32& Struct);
+
+	DECLARE_FUNCTION(execGetDecodedStruct)
+	{
+		P_GET_STRUCT_REF(FWebSocketDecodedMessage, Message);
+		Stack.MostRecentProperty = nullptr;
+		Stack.MostRecentPropertyAddress = nullptr;
+		Stack.StepCompiledIn<UStructProperty>(nullptr);
+		UStructProperty* pProperty = Cast<UStructProperty>(Stack.MostRecentProperty);
+		void* pStruct = Stack.MostRecentPropertyAddress;
+		P_FINISH;
+
+		P_NATIVE_BEGIN;
+		*(bool*)RESULT_PARAM = CopyDecodedStruct(Message, pProperty, pStruct);
+		P_NATIVE_END;
+	}
+
+	static bool CopyDecodedStruct(const FWebSocketDecodedMessage& message, UStructProperty* property, void* out);
+
 	UFUNCTION(BlueprintCallable, Category = "WebSocket")
 	static bool GetJsonIntField(const FString& data, const FString& key, int& iValue);
 
 	UFUNCTION(BlueprintCallable, Category = "WebSocket")
 	static bool ObjectToJson(UObject* Object, FString& data);
 
+	static UWebSocketContext* GetOrCreateContext();
+
 	static bool JsonValueToUProperty(TSharedPtr<FJsonValue> JsonValue, UProperty* Property, void* OutValue, int64 CheckFlags, int64 SkipFlags);
 	static bool ConvertScalarJsonValueToUProperty(TSharedPtr<FJsonValue> JsonValue, UProperty* Property, void* OutValue, int64 CheckFlags, int64 SkipFlags);
 	static bool JsonObjectToUStruct(const TSharedRef<FJsonObject>& JsonObject, const UStruct* StructDefinition, void* OutStruct, int64 CheckFlags, int64 SkipFlags);
@@ -0,0 +1,108 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+#pragma once
+
+#include "UObject/NoExportTypes.h"
+#include "Containers/Queue.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeBool.h"
+#include "WebSocketBase.h"
+#include "WebSocketStats.h"
+#include "WebSocketChannel.generated.h"
+
+/**
+ * one logical channel of a socket. the send queue is drained by the lws service thread, the counters
+ * are written from both sides, so everything in here is thread safe.
+ */
+struct FWebSocketChannelState
+{
+	uint16 Channel;
+	int32 Priority;
+	int32 MaxQueuedBytes;
+	int32 MaxPendingBytes;
+
+	TQueue<FWebSocketOutMessage, EQueueMode::Mpsc> SendQueue;
+	FThreadSafeCounter QueuedBytes;
+	FThreadSafeCounter PendingBytes;
+
+	FThreadSafeCounter SentMessages;
+	FThreadSafeCounter SentBytes;
+	FThreadSafeCounter ReceivedMessages;
+	FThreadSafeCounter ReceivedBytes;
+	FThreadSafeCounter DroppedSends;
+
+	/** the peer sent PAUSE, the send queue is held */
+	FThreadSafeBool bPausedByPeer;
+
+	/** we sent PAUSE because PendingBytes went above MaxPendingBytes */
+	FThreadSafeBool bPausedPeer;
+
+	FWebSocketChannelState(uint16 channel, int32 priority, int32 maxQueuedBytes, int32 maxPendingBytes)
+		:Channel(channel), Priority(priority), MaxQueuedBytes(maxQueuedBytes), MaxPendingBytes(maxPendingBytes)
+	{
+	}
+};
+
+/**
+ * numbered logical channel multiplexed over one UWebSocketBase, see WEBSOCKET_CHANNEL_MAGIC for the framing.
+ * the socket's protocol needs bPluginFrames, see FWebSocketProtocolConfig.
+ * channels share the socket's tls session, deflate state and rx buffer; each has its own receive events,
+ * send priority and backpressure.
+ */
+UCLASS(BlueprintType)
+class WEBSOCKET_API UWebSocketChannel : public UObject
+{
+	GENERATED_BODY()
+public:
+
+	/** false when MaxQueuedBytes would be exceeded or the socket is gone, the message is dropped then */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	bool SendText(const FString& data);
+
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	bool SendBinary(const TArray<uint8>& data);
+
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	int32 GetChannelId() const;
+
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	FWebSocketChannelStats GetStats() const;
+
+	UPROPERTY(BlueprintAssignable, Category = WebSocket)
+	FWebSocketRecieve OnReceiveData;
+
+	UPROPERTY(BlueprintAssignable, Category = WebSocket)
+	FWebSocketRecieveBinary OnReceiveBinary;
+
+	void Init(UWebSocketBase* socket, const TSharedRef<FWebSocketChannelState, ESPMode::ThreadSafe>& state);
+	void Deliver(const FWebSocketInMessage& msg);
+
+	TSharedPtr<FWebSocketChannelState, ESPMode::ThreadSafe> GetState() const { return mState; }
+
+private:
+
+	bool Send(const uint8* data, int32 len, uint8 type);
+
+	TWeakObjectPtr<UWebSocketBase> mSocket;
+	TSharedPtr<FWebSocketChannelState, ESPMode::ThreadSafe> mState;
+};
@@ -0,0 +1,110 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "UObject/StructOnScope.h"
+#include "Dom/JsonObject.h"
+#include "WebSocketDecoder.generated.h"
+
+struct FWebSocketMessageView;
+
+/** result of a native decoder, eg a message class of a generated codec or an object the decoder keeps in a pool */
+class FWebSocketDecodedPayload
+{
+public:
+	virtual ~FWebSocketDecodedPayload() {}
+};
+
+/**
+ * a message decoded on a task graph worker, it reaches OnReceiveDecoded built. Struct is an instance of
+ * the USTRUCT the decoder picked for the message, Payload what a native decoder built instead.
+ * messages of a command route are delivered to the route's handler instead.
+ */
+USTRUCT(BlueprintType)
+struct WEBSOCKET_API FWebSocketDecodedMessage
+{
+	GENERATED_USTRUCT_BODY()
+
+	/** decoder defined, the cmd of the envelope for FWebSocketJsonDecoder */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Type;
+
+	/** correlation id of a response to UWebSocketBase::Request, 0 for other messages */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 RequestId;
+
+	TSharedPtr<FStructOnScope, ESPMode::ThreadSafe> Struct;
+	TSharedPtr<FWebSocketDecodedPayload, ESPMode::ThreadSafe> Payload;
+
+	/** parsed message of a command route, read into the route's class on the game thread where objects can be created */
+	TSharedPtr<FJsonObject> Json;
+
+	FWebSocketDecodedMessage() :Type(0), RequestId(0) {}
+
+	const UScriptStruct* GetStruct() const { return Struct.IsValid() ? Cast<const UScriptStruct>(Struct->GetStruct()) : nullptr; }
+
+	/** the struct when it is a T, null otherwise */
+	template<typename T>
+	const T* Get() const
+	{
+		return GetStruct() == T::StaticStruct() ? (const T*)Struct->GetStructMemory() : nullptr;
+	}
+};
+
+/**
+ * builds the message objects of a connection off the game thread. Decode runs on task graph workers, one
+ * message of a connection after the other, but for several connections at once, so it has to be thread
+ * safe. it must not create or touch UObjects. false leaves the message to OnReceiveData and OnReceiveBinary.
+ */
+class WEBSOCKET_API IWebSocketMessageDecoder
+{
+public:
+	virtual ~IWebSocketMessageDecoder() {}
+
+	virtual bool Decode(const FWebSocketMessageView& message, FWebSocketDecodedMessage& out) = 0;
+};
+
+/**
+ * json envelope decoder, the int field TypeField picks the USTRUCT that BodyField is read into. an empty
+ * BodyField reads the whole message. map every type before the decoder is handed to a socket.
+ */
+class WEBSOCKET_API FWebSocketJsonDecoder : public IWebSocketMessageDecoder
+{
+public:
+
+	FWebSocketJsonDecoder(const FString& typeField = TEXT("cmd"), const FString& bodyField = TEXT("body"));
+
+	/** false for a struct with object properties, JsonToObject would create their objects off the game thread */
+	bool Map(int32 type, UScriptStruct* structType);
+
+	virtual bool Decode(const FWebSocketMessageView& message, FWebSocketDecodedMessage& out) override;
+
+private:
+
+	FString mTypeField;
+	FString mBodyField;
+	TMap<int32, UScriptStruct*> mStructs;
+};
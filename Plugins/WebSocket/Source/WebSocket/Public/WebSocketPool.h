@@ -0,0 +1,144 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtr.h"
+#include "WebSocketBase.h"
+#include "WebSocketStats.h"
+
+class UWebSocketContext;
+
+/** connection of an FWebSocketPool. the generation tells a reused slot from the connection that had it before */
+struct FWebSocketHandle
+{
+	int32 Index;
+	uint32 Generation;
+
+	FWebSocketHandle() :Index(INDEX_NONE), Generation(0) {}
+	FWebSocketHandle(int32 index, uint32 generation) :Index(index), Generation(generation) {}
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+	bool operator==(const FWebSocketHandle& other) const { return Index == other.Index && Generation == other.Generation; }
+	bool operator!=(const FWebSocketHandle& other) const { return !(*this == other); }
+};
+
+/** events of every connection of a pool, on the game thread */
+class IWebSocketPoolListener
+{
+public:
+	virtual ~IWebSocketPoolListener() {}
+
+	virtual void OnConnected(FWebSocketHandle handle, const FString& protocol) {}
+	virtual void OnConnectError(FWebSocketHandle handle, const FString& error) {}
+	virtual void OnClosed(FWebSocketHandle handle) {}
+
+	/** text as validated utf-8 or a binary payload, the view is only valid during the call */
+	virtual void OnMessage(FWebSocketHandle handle, const FWebSocketMessageView& message) {}
+	virtual void OnPong(FWebSocketHandle handle, float rttMs) {}
+};
+
+/**
+ * plain c++ connections without a UObject each, for load test bots or a relay that holds thousands of
+ * sockets. a connection is a slot addressed by FWebSocketHandle, a closed slot goes on a free list and
+ * the next Connect reuses it. channels, durable lanes and transfers stay with UWebSocketBase.
+ * from UWebSocketContext::CreatePool, game thread, Connect fails on uwp and html5.
+ */
+class WEBSOCKET_API FWebSocketPool : public FWebSocketConnectionOwner, public TSharedFromThis<FWebSocketPool, ESPMode::ThreadSafe>
+{
+public:
+
+	/** the listener has to outlive the pool or be detached with SetListener(nullptr) */
+	FWebSocketPool(UWebSocketContext* context, IWebSocketPoolListener* listener);
+	virtual ~FWebSocketPool();
+
+	void SetListener(IWebSocketPoolListener* listener) { mListener = listener; }
+
+	/** an invalid handle when the uri or protocol is bad or the context is not ready, otherwise the result arrives through the listener */
+	FWebSocketHandle Connect(const FString& uri, const TMap<FString, FString>& header, const FString& protocol = FString());
+
+	bool SendText(FWebSocketHandle handle, const FString& data);
+	bool SendBinary(FWebSocketHandle handle, const TArray<uint8>& data);
+
+	/** see UWebSocketContext::RegisterFrame */
+	bool SendFrame(FWebSocketHandle handle, FWebSocketFrameHandle frame);
+	bool Ping(FWebSocketHandle handle);
+
+	/** the slot stays taken until OnClosed */
+	void Close(FWebSocketHandle handle, int32 code = 1000, const FString& reason = FString(), float drainTimeout = 1.0f);
+	void CloseAll(int32 code = 1000, const FString& reason = FString(), float drainTimeout = 1.0f);
+
+	/** established and not closed yet */
+	bool IsOpen(FWebSocketHandle handle) const;
+	FWebSocketPoolStats GetStats() const;
+
+	virtual void HandleEstablished(FWebSocketConnection* connection, const FString& protocol) override;
+	virtual void HandleConnectError(FWebSocketConnection* connection, const FString& error) override;
+	virtual void HandleClosed(FWebSocketConnection* connection) override;
+	virtual void HandlePong(FWebSocketConnection* connection, float rttMs) override;
+	virtual void HandleDeliver(FWebSocketConnection* connection) override;
+
+private:
+
+	struct FSlot
+	{
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+		TSharedPtr<FWebSocketConnection, ESPMode::ThreadSafe> Connection;
+#endif
+		uint32 Generation;
+		int32 NextFree;
+		/** lws allocates this per connection, it depends on the protocol */
+		int32 RxBufferSize;
+		bool bTaken;
+		bool bOpen;
+
+		FSlot() :Generation(0), NextFree(INDEX_NONE), RxBufferSize(0), bTaken(false), bOpen(false) {}
+	};
+
+	/** null for stale handles */
+	FSlot* FindSlot(FWebSocketHandle handle);
+	const FSlot* FindSlot(FWebSocketHandle handle) const;
+
+	/** the handle of a connection that still has its slot, invalid once the slot was freed */
+	FWebSocketHandle FindHandle(FWebSocketConnection* connection) const;
+
+	FWebSocketHandle AllocSlot();
+	void FreeSlot(FWebSocketHandle handle);
+
+	/** deliver what the connection received within the per frame budget, the rest next frame */
+	void DeliverInbox(FWebSocketHandle handle, bool bIgnoreBudget = false);
+
+	TWeakObjectPtr<UWebSocketContext> mContext;
+	IWebSocketPoolListener* mListener;
+	TArray<FSlot> mSlots;
+	int32 mFreeHead;
+	int32 mFreeCount;
+	int32 mOpenCount;
+	int32 mReusedSlots;
+
+	uint64 mDeliverFrame;
+	int32 mDeliveredBytes;
+};
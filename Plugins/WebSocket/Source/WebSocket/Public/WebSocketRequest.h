@@ -0,0 +1,68 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/NoExportTypes.h"
+#include "WebSocketDecoder.h"
+#include "WebSocketRequest.generated.h"
+
+UENUM(BlueprintType)
+enum class EWebSocketRequestResult : uint8
+{
+	Success,
+	/** no response within the timeout, a late one goes to OnReceiveData again */
+	Timeout,
+	/** the socket was not open or closed before the response arrived */
+	Closed,
+	/** the request is not a json object or too large, nothing was sent */
+	Failed,
+};
+
+/** what UWebSocketBase::Request completes with */
+USTRUCT(BlueprintType)
+struct WEBSOCKET_API FWebSocketResponse
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	EWebSocketRequestResult Result;
+
+	/** cmd of the request */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Type;
+
+	/** from the send until the response was delivered on the game thread */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float LatencyMs;
+
+	/** the response, empty when the socket's decoder or a command route built Decoded instead */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	FString Data;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	FWebSocketDecodedMessage Decoded;
+
+	FWebSocketResponse() :Result(EWebSocketRequestResult::Failed), Type(0), LatencyMs(0.0f) {}
+};
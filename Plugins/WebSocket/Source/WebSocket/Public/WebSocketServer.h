@@ -0,0 +1,138 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#pragma once
+
+#include "UObject/NoExportTypes.h"
+#include "WebSocketBase.h"
+#include "WebSocketStats.h"
+#include "WebSocketServer.generated.h"
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWebSocketClientConnected, UWebSocketBase*, Client);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWebSocketClientClosed, UWebSocketBase*, Client);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FWebSocketListenError, const FString&, Error);
+
+class UWebSocketContext;
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+class FWebSocketServerHost;
+#endif
+
+/**
+ * listen socket on a websocket context, for a dedicated server that takes the player sockets itself.
+ * every accepted connection is a UWebSocketBase with the usual events, serviced like the client ones.
+ * broadcasts build the frame once and queue the same buffer on every recipient. plain ws without
+ * extensions, not available on uwp and html5.
+ */
+UCLASS(BlueprintType)
+class WEBSOCKET_API UWebSocketServer : public UObject
+{
+	GENERATED_BODY()
+public:
+
+	UWebSocketServer();
+
+	virtual void BeginDestroy() override;
+
+	/** from UWebSocketContext::Listen, a failure arrives through OnListenError. on a context that is still being created it only keeps the port */
+	bool Listen(UWebSocketContext* context, int32 port);
+
+	/**
+	 * stop accepting and close every client, the clients get DrainTimeout seconds to flush their queues.
+	 * the listen socket closes once they are gone or the drain and their close handshake timed out
+	 */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	void Stop(float DrainTimeout = 1.0f);
+
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	TArray<UWebSocketBase*> GetClients() const { return mClients; }
+
+	/** groups are just names for broadcasts, a client can be in any number of them */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	void JoinGroup(UWebSocketBase* Client, FName Group);
+
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	void LeaveGroup(UWebSocketBase* Client, FName Group);
+
+	/** send to every client in Group, to all clients when Group is none. returns the number of recipients */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	int32 BroadcastText(const FString& Data, FName Group = NAME_None);
+
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	int32 BroadcastBinary(const TArray<uint8>& Data, FName Group = NAME_None);
+
+	/** broadcast a frame registered on the server's context, nothing is built at all */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	int32 BroadcastFrame(FWebSocketFrameHandle Handle, FName Group = NAME_None);
+
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	FWebSocketServerStats GetServerStats() const;
+
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	int32 GetPort() const { return mPort; }
+
+	UPROPERTY(BlueprintAssignable, Category = WebSocket)
+	FWebSocketClientConnected OnClientConnected;
+
+	/** after the client's own OnClosed, it has left all groups */
+	UPROPERTY(BlueprintAssignable, Category = WebSocket)
+	FWebSocketClientClosed OnClientClosed;
+
+	UPROPERTY(BlueprintAssignable, Category = WebSocket)
+	FWebSocketListenError OnListenError;
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	/** game thread, from FWebSocketServerHost */
+	void HandleAccepted(const TSharedRef<FWebSocketConnection, ESPMode::ThreadSafe>& connection, const FString& peer, const FString& protocol);
+#endif
+	void HandleListenError(const FString& error);
+
+	/** a client's connection closed, from UWebSocketBase::HandleClosed */
+	void HandleClientClosed(UWebSocketBase* client);
+
+private:
+
+	int32 Broadcast(const uint8* data, int32 len, bool bBinary, FName group);
+	TArray<UWebSocketBase*> GetRecipients(FName group) const;
+
+	UPROPERTY()
+	UWebSocketContext* mContext;
+
+	UPROPERTY()
+	TArray<UWebSocketBase*> mClients;
+
+	TMap<FName, TArray<TWeakObjectPtr<UWebSocketBase>>> mGroups;
+	int32 mPort;
+	bool mbListening;
+	FWebSocketServerStats mStats;
+
+#if PLATFORM_UWP
+#elif PLATFORM_HTML5
+#else
+	TSharedPtr<FWebSocketServerHost, ESPMode::ThreadSafe> mHost;
+#endif
+};
@@ -0,0 +1,109 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#pragma once
+
+#include "UObject/NoExportTypes.h"
+#include "WebSocketBase.h"
+#include "WebSocketServer.h"
+#include "WebSocketPool.h"
+#include "WebSocketSettings.h"
+#include "WebSocketStats.h"
+#include "WebSocketService.generated.h"
+
+class UWebSocketContext;
+
+/**
+ * websocket context of its own, with its own settings, connections and stats, for several match
+ * instances or PIE clients in one process. UWebSocketSubsystem keeps one per game instance, the
+ * blueprint library keeps using the process wide context.
+ */
+UCLASS(BlueprintType)
+class WEBSOCKET_API UWebSocketService : public UObject
+{
+	GENERATED_BODY()
+public:
+
+	UWebSocketService();
+
+	/** Settings null uses the project settings. a Manual service is only serviced by Service */
+	UFUNCTION(BlueprintCallable, Category = WebSocket, meta = (DefaultToSelf = "Outer"))
+	static UWebSocketService* CreateService(UObject* Outer, UWebSocketSettings* Settings = nullptr, EWebSocketServiceMode Mode = EWebSocketServiceMode::Default);
+
+	virtual void BeginDestroy() override;
+
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	UWebSocketBase* Connect(const FString& Url, const TMap<FString, FString>& Header, const FString& Protocol, bool& ConnectFail);
+
+	/** see UWebSocketBase::ConnectEndpoints */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	UWebSocketBase* ConnectEndpoints(const TArray<FString>& Urls, const TMap<FString, FString>& Header, const FString& Protocol, bool& ConnectFail);
+
+	/** see UWebSocketBlueprintLibrary::RegisterFrameText, the handle is for sockets of this service */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	FWebSocketFrameHandle RegisterFrameText(const FString& Data);
+
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	FWebSocketFrameHandle RegisterFrameBinary(const TArray<uint8>& Data);
+
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	void UnregisterFrame(FWebSocketFrameHandle Handle);
+
+	/** accept websocket connections on Port, see UWebSocketServer */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	UWebSocketServer* Listen(int32 Port, bool& ListenFail);
+
+	/** c++ connections without a UObject each, see FWebSocketPool. null without a context */
+	TSharedPtr<FWebSocketPool, ESPMode::ThreadSafe> CreatePool(IWebSocketPoolListener* Listener);
+
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	UWebSocketBase* ProbeEndpoints(const TArray<FString>& Urls, bool& ProbeFail);
+
+	/**
+	 * Manual mode, run queued commands and due timers, then block in lws_service for up to TimeoutMs
+	 * until a socket is ready or another thread sends. the calling thread becomes the service thread,
+	 * a dedicated server calls it from its own loop. false when the context is not usable.
+	 */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	bool Service(int32 TimeoutMs = 0);
+
+	/** close every connection within Timeout seconds and destroy the context, in Manual mode from the servicing thread */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	void Shutdown(float Timeout = 2.0f);
+
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	FWebSocketContextStats GetContextStats() const;
+
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	FWebSocketTlsStats GetTlsStats() const;
+
+	UFUNCTION(BlueprintPure, Category = WebSocket)
+	TArray<FWebSocketEndpointStatus> GetEndpointLatencies() const;
+
+	UWebSocketContext* GetContext() const { return mContext; }
+
+private:
+
+	UPROPERTY()
+	UWebSocketContext* mContext;
+};
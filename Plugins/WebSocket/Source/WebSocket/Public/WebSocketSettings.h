@@ -0,0 +1,299 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include "Engine/DeveloperSettings.h"
+#include "WebSocketSettings.generated.h"
+
+UENUM(BlueprintType)
+enum class EWebSocketTlsVersion : uint8
+{
+	Default,
+	TLS1_0,
+	TLS1_1,
+	TLS1_2,
+	TLS1_3,
+};
+
+UENUM(BlueprintType)
+enum class EWebSocketPayloadCodec : uint8
+{
+	/** utf-8 text frames for OnReceiveData, the dictionary codec applies when it is enabled */
+	Text,
+	/** binary frames are handed to OnReceiveBinary as they arrived */
+	Binary,
+};
+
+/** who calls lws_service for a context */
+UENUM(BlueprintType)
+enum class EWebSocketServiceMode : uint8
+{
+	/** the service thread when bUseServiceThread is set, the game tick otherwise */
+	Default,
+	Thread,
+	Tick,
+	/** only UWebSocketService::Service, for a dedicated server's own loop */
+	Manual,
+};
+
+/** a subprotocol offered through Sec-WebSocket-Protocol, picked per connection with ConnectWithProtocol */
+USTRUCT(BlueprintType)
+struct FWebSocketProtocolConfig
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(Category = WebSocket, EditAnywhere, BlueprintReadWrite)
+	FString Name;
+
+	/** bytes lws allocates per connection and reads per callback, longer messages arrive in fragments */
+	UPROPERTY(Category = WebSocket, EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "128"))
+	int32 RxBufferSize;
+
+	UPROPERTY(Category = WebSocket, EditAnywhere, BlueprintReadWrite)
+	EWebSocketPayloadCodec Codec;
+
+	/**
+	 * the server of this protocol speaks the plugin's binary frames: channels, durable acks, transfers, command
+	 * frames and clock sync. off, their magic bytes are not looked at and every binary message is delivered
+	 */
+	UPROPERTY(Category = WebSocket, EditAnywhere, BlueprintReadWrite)
+	bool bPluginFrames;
+
+	FWebSocketProtocolConfig()
+		:RxBufferSize(64 * 1024), Codec(EWebSocketPayloadCodec::Text), bPluginFrames(false)
+	{
+	}
+};
+
+/**
+ * client handshake tuning, empty strings keep the openssl defaults.
+ * ECDHE with X25519/P-256 and ECDSA certificates cost the client a fraction of the RSA operations.
+ */
+USTRUCT(BlueprintType)
+struct FWebSocketTlsOptions
+{
+	GENERATED_USTRUCT_BODY()
+
+	/** openssl cipher list for TLS 1.2 and below, eg "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-AES128-GCM-SHA256" */
+	UPROPERTY(Category = WebSocket, EditAnywhere, BlueprintReadWrite)
+	FString CipherList;
+
+	/** TLS 1.3 cipher suites, eg "TLS_AES_128_GCM_SHA256:TLS_CHACHA20_POLY1305_SHA256" */
+	UPROPERTY(Category = WebSocket, EditAnywhere, BlueprintReadWrite)
+	FString CipherSuites;
+
+	/** key exchange groups in preference order, eg "X25519:P-256" */
+	UPROPERTY(Category = WebSocket, EditAnywhere, BlueprintReadWrite)
+	FString Curves;
+
+	/** signature algorithms in preference order, eg "ECDSA+SHA256:RSA-PSS+SHA256:RSA+SHA256" */
+	UPROPERTY(Category = WebSocket, EditAnywhere, BlueprintReadWrite)
+	FString SignatureAlgorithms;
+
+	UPROPERTY(Category = WebSocket, EditAnywhere, BlueprintReadWrite)
+	EWebSocketTlsVersion MinVersion;
+
+	FWebSocketTlsOptions()
+		:MinVersion(EWebSocketTlsVersion::Default)
+	{
+	}
+};
+
+/**
+ * project wide websocket settings, stored in DefaultGame.ini under [/Script/WebSocket.WebSocketSettings]
+ */
+UCLASS(config = Game, defaultconfig, meta = (DisplayName = "WebSocket"))
+class WEBSOCKET_API UWebSocketSettings : public UDeveloperSettings
+{
+	GENERATED_BODY()
+public:
+
+	UWebSocketSettings();
+
+	/** create the context on a task graph worker, connects made meanwhile are queued instead of stalling the game thread */
+	UPROPERTY(config, EditAnywhere, Category = Context)
+	bool bCreateContextAsync;
+
+	/** start creating the context when the engine finished loading instead of on the first connect */
+	UPROPERTY(config, EditAnywhere, Category = Context)
+	bool bWarmUpOnStartup;
+
+	/**
+	 * service lws on a dedicated thread that sleeps until a socket is ready or a message is sent, instead of polling every frame.
+	 * off by default: delegates then still fire from the game tick as they did before, with the thread they arrive a frame later
+	 */
+	UPROPERTY(config, EditAnywhere, Category = Context)
+	bool bUseServiceThread;
+
+	/**
+	 * without the service thread, sockets that neither received nor wrote for this long are polled every IdleTickPollMs
+	 * instead of every frame. a send or a due timer still polls at once, the first message after a pause can arrive this late.
+	 * 0 polls every frame
+	 */
+	UPROPERTY(config, EditAnywhere, Category = Context, meta = (EditCondition = "!bUseServiceThread", ClampMin = "0"))
+	int32 IdleTickPollMs;
+
+	/** longest sleep of the service thread without socket activity, only lws timeouts depend on it */
+	UPROPERTY(config, EditAnywhere, Category = Context, meta = (EditCondition = "bUseServiceThread", ClampMin = "10"))
+	int32 IdleServiceTimeoutMs;
+
+	/** seconds the context gets on exit to close its connections before they are dropped */
+	UPROPERTY(config, EditAnywhere, Category = Context, meta = (ClampMin = "0"))
+	float ShutdownTimeout;
+
+	/** stop reading a socket once this many received bytes wait for OnReceiveData, 0 disables the limit */
+	UPROPERTY(config, EditAnywhere, Category = FlowControl, meta = (ClampMin = "0"))
+	int32 RxPauseBytes;
+
+	/** read again once the pending bytes dropped to this */
+	UPROPERTY(config, EditAnywhere, Category = FlowControl, meta = (ClampMin = "0"))
+	int32 RxResumeBytes;
+
+	/** bytes handed to OnReceiveData per socket and frame, the rest waits for the next frame. 0 delivers everything at once */
+	UPROPERTY(config, EditAnywhere, Category = FlowControl, meta = (ClampMin = "0"))
+	int32 MaxDeliverBytesPerFrame;
+
+	/**
+	 * pace sends with a token bucket that follows the estimated bandwidth of each connection, so messages
+	 * wait in our queue instead of piling up in the socket buffer where nothing can reorder or drop them
+	 */
+	UPROPERTY(config, EditAnywhere, Category = Pacing)
+	bool bEnablePacing;
+
+	/** bytes per second until the first estimate, the startup phase doubles it from there */
+	UPROPERTY(config, EditAnywhere, Category = Pacing, meta = (EditCondition = "bEnablePacing", ClampMin = "1024"))
+	int32 InitialPacingRate;
+
+	UPROPERTY(config, EditAnywhere, Category = Pacing, meta = (EditCondition = "bEnablePacing", ClampMin = "1024"))
+	int32 MinPacingRate;
+
+	/** 0 leaves the rate to the estimate */
+	UPROPERTY(config, EditAnywhere, Category = Pacing, meta = (EditCondition = "bEnablePacing", ClampMin = "0"))
+	int32 MaxPacingRate;
+
+	/** bytes that may go out back to back after an idle period */
+	UPROPERTY(config, EditAnywhere, Category = Pacing, meta = (EditCondition = "bEnablePacing", ClampMin = "0"))
+	int32 PacingBurstBytes;
+
+	/** shortest time between the pings that measure rtt and delivered bytes while sending */
+	UPROPERTY(config, EditAnywhere, Category = Pacing, meta = (EditCondition = "bEnablePacing", ClampMin = "10"))
+	int32 PacingProbeIntervalMs;
+
+	/** seconds ConnectEndpoints waits for the probes before it picks from the endpoints that answered */
+	UPROPERTY(config, EditAnywhere, Category = Failover, meta = (ClampMin = "0.1"))
+	float EndpointProbeTimeout;
+
+	/** probe results younger than this are reused instead of probing again */
+	UPROPERTY(config, EditAnywhere, Category = Failover, meta = (ClampMin = "0"))
+	float EndpointCacheTtl;
+
+	/** keep the second fastest endpoint connected, a dropped connection then fails over without a handshake */
+	UPROPERTY(config, EditAnywhere, Category = Failover)
+	bool bKeepWarmStandby;
+
+	/** first size of a durable lane's journal file, it doubles while the unacknowledged messages do not fit */
+	UPROPERTY(config, EditAnywhere, Category = Durable, meta = (ClampMin = "4096"))
+	int32 DurableJournalBytes;
+
+	/** durable sends fail once the unacknowledged messages would need a bigger journal */
+	UPROPERTY(config, EditAnywhere, Category = Durable, meta = (ClampMin = "4096"))
+	int32 MaxDurableJournalBytes;
+
+	/** appended bytes that start a write to disk right away instead of waiting for DurableSyncIntervalMs */
+	UPROPERTY(config, EditAnywhere, Category = Durable, meta = (ClampMin = "0"))
+	int32 DurableSyncBytes;
+
+	/** longest time an appended message waits for its write to disk, what a crash may lose */
+	UPROPERTY(config, EditAnywhere, Category = Durable, meta = (ClampMin = "0"))
+	int32 DurableSyncIntervalMs;
+
+	/** bytes of a file read and written per websocket frame, what a transfer holds in memory on either side */
+	UPROPERTY(config, EditAnywhere, Category = Transfer, meta = (ClampMin = "1024"))
+	int32 TransferChunkBytes;
+
+	/** file bytes per fragmented message, other messages wait at most for one of them */
+	UPROPERTY(config, EditAnywhere, Category = Transfer, meta = (ClampMin = "1024"))
+	int32 TransferMessageBytes;
+
+	/** json field UWebSocketBase::Request stamps the correlation id into, the server copies it into the response */
+	UPROPERTY(config, EditAnywhere, Category = Requests)
+	FString RequestIdField;
+
+	/** seconds a request waits for its response when Request is called without a timeout */
+	UPROPERTY(config, EditAnywhere, Category = Requests, meta = (ClampMin = "0.01"))
+	float RequestTimeout;
+
+	/** exchanges StartClockSync makes right after a connect, 50 ms apart, before it slows down to ClockSyncInterval */
+	UPROPERTY(config, EditAnywhere, Category = ClockSync, meta = (ClampMin = "1"))
+	int32 ClockSyncBurst;
+
+	/** seconds between clock exchanges after the burst, drift is measured over the span of the kept ones */
+	UPROPERTY(config, EditAnywhere, Category = ClockSync, meta = (ClampMin = "0.1"))
+	float ClockSyncInterval;
+
+	/** sockets a UWebSocketServer accepted answer clock requests, see WEBSOCKET_CLOCK_MAGIC */
+	UPROPERTY(config, EditAnywhere, Category = ClockSync)
+	bool bServeClockSync;
+
+	/** subprotocols registered with the context, connections without a protocol keep the unnamed 64 KB text protocol */
+	UPROPERTY(config, EditAnywhere, Category = Protocols)
+	TArray<FWebSocketProtocolConfig> Protocols;
+
+	/** enable the dictionary codec, messages are compressed with a preset dictionary on task graph workers */
+	UPROPERTY(config, EditAnywhere, Category = Compression)
+	bool bEnableDictionaryCodec;
+
+	/** dictionary file trained by TestServer/dicttool.js, relative to the project directory */
+	UPROPERTY(config, EditAnywhere, Category = Compression, meta = (EditCondition = "bEnableDictionaryCodec"))
+	FString DictionaryFile;
+
+	/** version announced to the server, must match the dictionary the server loaded */
+	UPROPERTY(config, EditAnywhere, Category = Compression, meta = (EditCondition = "bEnableDictionaryCodec", ClampMin = "1", ClampMax = "65535"))
+	int32 DictionaryVersion;
+
+	/** zlib compression level used by the dictionary codec */
+	UPROPERTY(config, EditAnywhere, Category = Compression, meta = (EditCondition = "bEnableDictionaryCodec", ClampMin = "1", ClampMax = "9"))
+	int32 CompressionLevel;
+
+	/** messages shorter than this are sent as plain text frames */
+	UPROPERTY(config, EditAnywhere, Category = Compression, meta = (EditCondition = "bEnableDictionaryCodec", ClampMin = "0"))
+	int32 MinCompressSize;
+
+	/** offer the last tls session of a host and port again so wss reconnects use an abbreviated handshake */
+	UPROPERTY(config, EditAnywhere, Category = TLS)
+	bool bEnableTlsSessionCache;
+
+	/** keep cached tls sessions in Saved/WebSocket/tls-sessions.bin across runs, the file holds session secrets */
+	UPROPERTY(config, EditAnywhere, Category = TLS, meta = (EditCondition = "bEnableTlsSessionCache"))
+	bool bPersistTlsSessions;
+
+	UPROPERTY(config, EditAnywhere, Category = TLS)
+	FWebSocketTlsOptions TlsOptions;
+
+	/** trust the ca bundle compiled into WebSocketCA.cpp */
+	UPROPERTY(config, EditAnywhere, Category = TLS)
+	bool bUseBundledCA;
+
+	/** trust the platform certificate store too, mostly useful on linux servers */
+	UPROPERTY(config, EditAnywhere, Category = TLS)
+	bool bUseSystemTrustStore;
+};
@@ -0,0 +1,493 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include "UObject/NoExportTypes.h"
+#include "WebSocketStats.generated.h"
+
+USTRUCT(BlueprintType)
+struct FWebSocketTlsStats
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 FullHandshakes;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 ResumedHandshakes;
+
+	/** resumed / (full + resumed) */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float ResumeRate;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float AverageFullHandshakeMs;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float AverageResumedHandshakeMs;
+
+	/** number of hosts with a cached session */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 CachedSessions;
+
+	FWebSocketTlsStats()
+		:FullHandshakes(0), ResumedHandshakes(0), ResumeRate(0.0f), AverageFullHandshakeMs(0.0f), AverageResumedHandshakeMs(0.0f), CachedSessions(0)
+	{
+	}
+};
+
+USTRUCT(BlueprintType)
+struct FWebSocketContextStats
+{
+	GENERATED_USTRUCT_BODY()
+
+	/** the lws context is created and serviced */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	bool bReady;
+
+	/** time spent in context creation, openssl init, ca loading and lws_create_context */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float CreateMs;
+
+	/** connects waiting for the context */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 PendingConnects;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 OpenConnections;
+
+	/** lws is serviced on its own thread instead of the game tick */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	bool bServiceThread;
+
+	/** lws is only serviced by UWebSocketService::Service */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	bool bManualService;
+
+	/** lws_service calls so far, stays flat while the connections are idle */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 ServiceRounds;
+
+	/** messages registered with RegisterFrame and the bytes their encoded frames hold */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 CachedFrames;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 CachedFrameBytes;
+
+	/** sends by frame handle, each one skipped json, utf-8 conversion and compression */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 CachedFrameSends;
+
+	FWebSocketContextStats()
+		:bReady(false), CreateMs(0.0f), PendingConnects(0), OpenConnections(0), bServiceThread(false), bManualService(false), ServiceRounds(0),
+		CachedFrames(0), CachedFrameBytes(0), CachedFrameSends(0)
+	{
+	}
+};
+
+/** message registered once with RegisterFrameText or RegisterFrameBinary, see UWebSocketBase::SendFrame */
+USTRUCT(BlueprintType)
+struct FWebSocketFrameHandle
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Id;
+
+	FWebSocketFrameHandle() :Id(0) {}
+
+	bool IsValid() const { return Id != 0; }
+};
+
+USTRUCT(BlueprintType)
+struct FWebSocketRxStats
+{
+	GENERATED_USTRUCT_BODY()
+
+	/** received bytes not yet handed to OnReceiveData, including messages still decoding */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 PendingBytes;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 PendingMessages;
+
+	/** socket reads are currently paused */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	bool bPaused;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 PauseCount;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 ResumeCount;
+
+	FWebSocketRxStats()
+		:PendingBytes(0), PendingMessages(0), bPaused(false), PauseCount(0), ResumeCount(0)
+	{
+	}
+};
+
+USTRUCT(BlueprintType)
+struct FWebSocketChannelStats
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Channel;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 SentMessages;
+
+	/** payload bytes, the 4 byte channel header not included */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 SentBytes;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 ReceivedMessages;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 ReceivedBytes;
+
+	/** bytes waiting for the socket */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 QueuedBytes;
+
+	/** received bytes not yet handed to the channel's OnReceiveData */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 PendingBytes;
+
+	/** sends refused because MaxQueuedBytes was reached */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 DroppedSends;
+
+	/** the server asked us to hold the channel's messages */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	bool bPausedByPeer;
+
+	/** we asked the server to hold the channel's messages */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	bool bPausedPeer;
+
+	FWebSocketChannelStats()
+		:Channel(0), SentMessages(0), SentBytes(0), ReceivedMessages(0), ReceivedBytes(0), QueuedBytes(0), PendingBytes(0), DroppedSends(0), bPausedByPeer(false), bPausedPeer(false)
+	{
+	}
+};
+
+USTRUCT(BlueprintType)
+struct FWebSocketPacingStats
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	bool bEnabled;
+
+	/** delivered bytes per second, the best recent sample of the data the server acknowledged with a pong */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float EstimatedBandwidth;
+
+	/** bytes per second the token bucket currently allows */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float PacingRate;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float RttMs;
+
+	/** lowest rtt of the last 10 seconds, rtt above it is time spent in queues */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float MinRttMs;
+
+	/** written to the socket but not yet acknowledged */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 BytesInFlight;
+
+	/** the rate is still being doubled to find the bandwidth */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	bool bStartup;
+
+	/** times sending stopped to wait for tokens or acknowledgements */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 PacedWaits;
+
+	FWebSocketPacingStats()
+		:bEnabled(false), EstimatedBandwidth(0.0f), PacingRate(0.0f), RttMs(0.0f), MinRttMs(0.0f), BytesInFlight(0), bStartup(false), PacedWaits(0)
+	{
+	}
+};
+
+/** result of the last probe of an endpoint, kept by the context for EndpointCacheTtl seconds */
+USTRUCT(BlueprintType)
+struct FWebSocketEndpointStatus
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	FString Url;
+
+	/** the websocket handshake completed and a ping was answered */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	bool bHealthy;
+
+	/** websocket ping round trip */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float RttMs;
+
+	/** tcp, tls and upgrade handshake */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float ConnectMs;
+
+	/** seconds since the probe */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float AgeSeconds;
+
+	FWebSocketEndpointStatus()
+		:bHealthy(false), RttMs(0.0f), ConnectMs(0.0f), AgeSeconds(0.0f)
+	{
+	}
+};
+
+/** journal of a durable lane, see UWebSocketBase::OpenDurableLane */
+USTRUCT(BlueprintType)
+struct FWebSocketDurableStats
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	bool bOpen;
+
+	/** messages the server did not acknowledge yet, they are sent again after the next connect */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 PendingMessages;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 PendingBytes;
+
+	/** messages appended since the journal was opened */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 AppendedMessages;
+
+	/** size of the mapped journal file */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 JournalBytes;
+
+	/** batches written to disk, appends per sync is how well the fsync cost is spread */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Syncs;
+
+	FWebSocketDurableStats()
+		:bOpen(false), PendingMessages(0), PendingBytes(0), AppendedMessages(0), JournalBytes(0), Syncs(0)
+	{
+	}
+};
+
+/** file sent with SendFile or received by a socket that AcceptTransfers */
+USTRUCT(BlueprintType)
+struct FWebSocketTransfer
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 TransferId;
+
+	/** file name the sender announced */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	FString Name;
+
+	/** where a received file was written, empty for uploads */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	FString Path;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	bool bUpload;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int64 TransferredBytes;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int64 TotalBytes;
+
+	FWebSocketTransfer()
+		:TransferId(0), bUpload(false), TransferredBytes(0), TotalBytes(0)
+	{
+	}
+};
+
+/** slots of an FWebSocketPool and what a connection costs with and without a UObject */
+USTRUCT(BlueprintType)
+struct FWebSocketPoolStats
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 OpenConnections;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Slots;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 FreeSlots;
+
+	/** connects that took a slot from the free list instead of growing the pool */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 ReusedSlots;
+
+	/**
+	 * average bytes of a pooled connection: slot, connection and inbox, the lws rx buffer of its protocol and
+	 * the received bytes waiting for delivery. send queues, tls state and what a connection allocates for the
+	 * features it uses (channels, clock, transfers, pacing, decoder, ws+unix) are not counted
+	 */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 BytesPerConnection;
+
+	/** the same for a UWebSocketBase: the object and its gc entry on top of connection and inbox */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 BytesPerObjectConnection;
+
+	FWebSocketPoolStats()
+		:OpenConnections(0), Slots(0), FreeSlots(0), ReusedSlots(0), BytesPerConnection(0), BytesPerObjectConnection(0)
+	{
+	}
+};
+
+/** listen socket and broadcast fan-out of a UWebSocketServer */
+USTRUCT(BlueprintType)
+struct FWebSocketServerStats
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	bool bListening;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Port;
+
+	/** accepted connections that are still open */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Clients;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 AcceptedConnections;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Broadcasts;
+
+	/** frames queued by broadcasts, one per recipient */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 BroadcastRecipients;
+
+	/** bytes the broadcast frames took to build, once per broadcast */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int64 BroadcastBytesBuilt;
+
+	/** bytes the broadcasts put on the wire, once per recipient */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int64 BroadcastBytesQueued;
+
+	FWebSocketServerStats()
+		:bListening(false), Port(0), Clients(0), AcceptedConnections(0), Broadcasts(0), BroadcastRecipients(0), BroadcastBytesBuilt(0), BroadcastBytesQueued(0)
+	{
+	}
+};
+
+/** requests of one type on a socket, see UWebSocketBase::Request. latencies are accurate to 10% */
+USTRUCT(BlueprintType)
+struct FWebSocketRequestStats
+{
+	GENERATED_USTRUCT_BODY()
+
+	/** cmd of the requests */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Type;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Requests;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Responses;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Timeouts;
+
+	/** requests the closed socket failed */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Failed;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Pending;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float P50Ms;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float P90Ms;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float P99Ms;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float MaxMs;
+
+	FWebSocketRequestStats()
+		:Type(0), Requests(0), Responses(0), Timeouts(0), Failed(0), Pending(0), P50Ms(0.0f), P90Ms(0.0f), P99Ms(0.0f), MaxMs(0.0f)
+	{
+	}
+};
+
+/** estimate of the server's clock, see UWebSocketBase::StartClockSync */
+USTRUCT(BlueprintType)
+struct FWebSocketClockStats
+{
+	GENERATED_USTRUCT_BODY()
+
+	/** at least one exchange completed, GetServerTime follows the server from then on */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	bool bSynchronized;
+
+	/** server clock minus utc now on this machine */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float OffsetMs;
+
+	/** how much faster the server's clock runs, millionths */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float DriftPpm;
+
+	/** bound of the current estimate, it grows with the time since the last exchange */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float ErrorMs;
+
+	/** lowest round trip of the kept exchanges, without the server's time between receive and send */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	float RttMs;
+
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 Samples;
+
+	/** exchanges of the window the estimate is fitted to, the slow and the spiking ones are left out */
+	UPROPERTY(Category = WebSocket, VisibleAnywhere, BlueprintReadOnly)
+	int32 UsedSamples;
+
+	FWebSocketClockStats()
+		:bSynchronized(false), OffsetMs(0.0f), DriftPpm(0.0f), ErrorMs(0.0f), RttMs(0.0f), Samples(0), UsedSamples(0)
+	{
+	}
+};
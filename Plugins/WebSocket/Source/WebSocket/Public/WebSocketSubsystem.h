@@ -0,0 +1,64 @@
+/*
+* uewebsocket - unreal engine 4 websocket plugin
+*
+* Copyright (C) 2017 feiwu <feixuwu@outlook.com>
+*
+*  This library is free software; you can redistribute it and/or
+*  modify it under the terms of the GNU Lesser General Public
+*  License as published by the Free Software Foundation:
+*  version 2.1 of the License.
+*
+*  This library is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*  Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public
+*  License along with this library; if not, write to the Free Software
+*  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+*  MA  02110-1301  USA
+*/
+
+
+
+#pragma once
+
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "WebSocketService.h"
+#include "WebSocketSubsystem.generated.h"
+
+/**
+ * one websocket context per game instance, so PIE clients and match instances hosted in one process
+ * do not share an lws loop. shut down with its game instance.
+ */
+UCLASS()
+class WEBSOCKET_API UWebSocketSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+public:
+
+	UWebSocketSubsystem();
+
+	virtual void Deinitialize() override;
+
+	/** created on the first call with the settings and mode given to Configure */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	UWebSocketService* GetService();
+
+	/** before the first GetService, eg a dedicated server picking EWebSocketServiceMode::Manual */
+	UFUNCTION(BlueprintCallable, Category = WebSocket)
+	void Configure(UWebSocketSettings* Settings, EWebSocketServiceMode Mode);
+
+	/** the subsystem of the game instance WorldContextObject belongs to, null outside a game instance */
+	static UWebSocketSubsystem* Get(const UObject* WorldContextObject);
+
+private:
+
+	UPROPERTY()
+	UWebSocketService* mService;
+
+	UPROPERTY()
+	UWebSocketSettings* mSettings;
+
+	EWebSocketServiceMode mMode;
+};
@@ -38,6 +38,12 @@ public class WebSocket : ModuleRules
 
         System.Console.WriteLine("version:" + strEngineVersion);
 
+        // UWebSocketSubsystem is a UGameInstanceSubsystem, those came with 4.22
+        if (int.Parse(EngineMinorVersion) < 22)
+        {
+            throw new BuildException("WebSocket needs engine 4.22 or later, found " + strEngineVersion);
+        }
+
         PrivateIncludePaths.AddRange(
 			new string[] {
 				"WebSocket/Private",
@@ -87,42 +93,26 @@ public class WebSocket : ModuleRules
         if (Target.Platform == UnrealTargetPlatform.Win64)
         {
             PublicDefinitions.Add("PLATFORM_UWP=0");
+            PublicDefinitions.Add("WITH_WEBSOCKET_OPENSSL=1");
             PrivateDependencyModuleNames.Add("zlib");
-            if (EngineMinorVersion == "21" || EngineMinorVersion == "20")
-            {
-                PrivateDependencyModuleNames.Add("OpenSSL");
-            }
 
             PrivateIncludePaths.Add("WebSocket/ThirdParty/include/Win64");
             string strStaticPath = Path.GetFullPath(Path.Combine(ModulePath, "ThirdParty/lib/Win64/"));
             PublicLibraryPaths.Add(strStaticPath);
 
-            // for 4.21
-            if(EngineMinorVersion == "21" || EngineMinorVersion == "20")
+            if (Target.Type == TargetType.Editor)
             {
-                string[] StaticLibrariesX64 = new string[] {
-                "websockets_static.lib",
-                };
-
-                foreach (string Lib in StaticLibrariesX64)
-                {
-                    PublicAdditionalLibraries.Add(Lib);
-                }
+                // the editor links openssl from the prebuilt libs, we only need the headers
+                PrivateIncludePathModuleNames.Add("OpenSSL");
+                PublicAdditionalLibraries.Add("websockets_static422.lib");
+                PublicAdditionalLibraries.Add("libeay32.lib");
+                PublicAdditionalLibraries.Add("ssleay32.lib");
             }
-            /*else if(EngineMinorVersion == "22" || EngineMinorVersion == "23")*/
             else
             {
-                // for 4.22 and 4.23
-                if (Target.Type == TargetType.Editor)
-                {
-                    PublicAdditionalLibraries.Add("websockets_static422.lib");
-                    PublicAdditionalLibraries.Add("libeay32.lib");
-                    PublicAdditionalLibraries.Add("ssleay32.lib");
-                }
-                else
-                {
-                    PublicAdditionalLibraries.Add("websockets_game_static422.lib");
-                }
+                // WebSocketSSL.cpp calls libssl and libcrypto itself, link them instead of relying on another module
+                PrivateDependencyModuleNames.Add("OpenSSL");
+                PublicAdditionalLibraries.Add("websockets_game_static422.lib");
             }
 
             
@@ -130,6 +120,7 @@ public class WebSocket : ModuleRules
         if (Target.Platform == UnrealTargetPlatform.Win32)
         {
             PublicDefinitions.Add("PLATFORM_UWP=0");
+            PublicDefinitions.Add("WITH_WEBSOCKET_OPENSSL=1");
             PrivateDependencyModuleNames.Add("zlib");
             PrivateDependencyModuleNames.Add("OpenSSL");
             PrivateIncludePaths.Add("WebSocket/ThirdParty/include/Win32");
@@ -137,38 +128,21 @@ public class WebSocket : ModuleRules
             string strStaticPath = Path.GetFullPath(Path.Combine(ModulePath, "ThirdParty/lib/Win32/"));
             PublicLibraryPaths.Add(strStaticPath);
 
-            // 4.22 and 4.21
-            if (EngineMinorVersion == "21" || EngineMinorVersion == "20")
-            {
-                string[] StaticLibrariesX32 = new string[] {
-                    "websockets_static.lib",
-                    //"libcrypto.lib",
-                    //"libssl.lib",
-                };
-
-                foreach (string Lib in StaticLibrariesX32)
-                {
-                    PublicAdditionalLibraries.Add(Lib);
-                }
-            }
-            /*else if(EngineMinorVersion == "22"|| EngineMinorVersion == "23")*/
-            else
+            string[] StaticLibrariesX32 = new string[] {
+                "websockets_static422.lib",
+                //"libcrypto.lib",
+                //"libssl.lib",
+            };
+
+            foreach (string Lib in StaticLibrariesX32)
             {
-                string[] StaticLibrariesX32 = new string[] {
-                    "websockets_static422.lib",
-                    //"libcrypto.lib",
-                    //"libssl.lib",
-                };
-
-                foreach (string Lib in StaticLibrariesX32)
-                {
-                    PublicAdditionalLibraries.Add(Lib);
-                }
+                PublicAdditionalLibraries.Add(Lib);
             }
         }
         /*else if(Target.Platform == UnrealTargetPlatform.HTML5)
         {
             PublicDefinitions.Add("PLATFORM_UWP=0");
+            PublicDefinitions.Add("WITH_WEBSOCKET_OPENSSL=1");
             string strStaticPath = Path.GetFullPath(Path.Combine(ModulePath, "ThirdParty/lib/HTML5/"));
             PublicLibraryPaths.Add(strStaticPath);
 
@@ -184,6 +158,9 @@ public class WebSocket : ModuleRules
         else if(Target.Platform == UnrealTargetPlatform.Mac)
         {
             PublicDefinitions.Add("PLATFORM_UWP=0");
+            PublicDefinitions.Add("WITH_WEBSOCKET_OPENSSL=1");
+            PublicDefinitions.Add("WITH_WEBSOCKET_UNIX_SOCKET=1");
+            PrivateDependencyModuleNames.Add("zlib");
             PrivateIncludePaths.Add("WebSocket/ThirdParty/include/Mac");
             string strStaticPath = Path.GetFullPath(Path.Combine(ModulePath, "ThirdParty/lib/Mac/"));
             //PublicLibraryPaths.Add(strStaticPath);
@@ -202,7 +179,10 @@ public class WebSocket : ModuleRules
         else if (Target.Platform == UnrealTargetPlatform.Linux)
         {
             PublicDefinitions.Add("PLATFORM_UWP=0");
+            PublicDefinitions.Add("WITH_WEBSOCKET_OPENSSL=1");
+            PublicDefinitions.Add("WITH_WEBSOCKET_UNIX_SOCKET=1");
             PrivateDependencyModuleNames.Add("OpenSSL");
+            PrivateDependencyModuleNames.Add("zlib");
             PrivateIncludePaths.Add("WebSocket/ThirdParty/include/Linux");
             string strStaticPath = Path.GetFullPath(Path.Combine(ModulePath, "ThirdParty/lib/Linux/"));
             PublicLibraryPaths.Add(strStaticPath);
@@ -221,8 +201,10 @@ public class WebSocket : ModuleRules
         else if(Target.Platform == UnrealTargetPlatform.IOS)
         {
             PublicDefinitions.Add("PLATFORM_UWP=0");
+            PublicDefinitions.Add("WITH_WEBSOCKET_OPENSSL=1");
             PrivateIncludePaths.Add("WebSocket/ThirdParty/include/IOS");
             PrivateDependencyModuleNames.Add("OpenSSL");
+            PrivateDependencyModuleNames.Add("zlib");
 
             string PluginPath = Utils.MakePathRelativeTo(ModuleDirectory, Target.RelativeEnginePath + "/Source/");
             PluginPath = PluginPath.Replace("\\", "/");
@@ -245,6 +227,8 @@ public class WebSocket : ModuleRules
         else if(Target.Platform == UnrealTargetPlatform.Android)
         {
             PublicDefinitions.Add("PLATFORM_UWP=0");
+            PublicDefinitions.Add("WITH_WEBSOCKET_OPENSSL=1");
+            PrivateDependencyModuleNames.Add("zlib");
             PrivateIncludePaths.Add("WebSocket/ThirdParty/include/Android");
             string strStaticPath = Path.GetFullPath(Path.Combine(ModulePath, "ThirdParty/lib/Android/armeabi-v7a"));
             PublicLibraryPaths.Add(strStaticPath);
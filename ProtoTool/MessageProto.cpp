@@ -1,12 +1,17 @@
 #include "MessageProto.h"
 #include "Engine.h"
 #include "Kismet/BlueprintFunctionLibrary.h"
+#include "WebSocketBlueprintLibrary.h"
 
 
 int UMessageProtocommandBlueprintLibrary::CMD_TEST(){
 	return 1;
 }
 
+void UMessageProtocommandBlueprintLibrary::RegisterCommands(){
+	UWebSocketBlueprintLibrary::RegisterCommand(1, UCS_CMD_TEST::StaticClass());
+}
+
 UTestInfo::UTestInfo(){
 }
 
@@ -8,6 +8,8 @@ class  UMessageProtocommandBlueprintLibrary : public UBlueprintFunctionLibrary{
 public:
 	UFUNCTION(BlueprintPure, Category = "MessageProto")
 	static int CMD_TEST();
+	UFUNCTION(BlueprintCallable, Category = "MessageProto")
+	static void RegisterCommands();
 };
 
 UCLASS(BlueprintType, Blueprintable)
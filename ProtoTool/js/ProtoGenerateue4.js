@@ -23,7 +23,8 @@ var Ue4Generate = /** @class */ (function () {
         fs.writeFileSync(moduleName + ".h", fileheader + body + end);
         var cppContent = "#include \"" + moduleName + ".h\"\n";
         cppContent += "#include \"Engine.h\"\n";
-        cppContent += "#include \"Kismet/BlueprintFunctionLibrary.h\"\n\n\n";
+        cppContent += "#include \"Kismet/BlueprintFunctionLibrary.h\"\n";
+        cppContent += "#include \"WebSocketBlueprintLibrary.h\"\n\n\n";
         cppContent += this.cppDepend;
         var keys = Object.keys(this.cppString);
         for (var i = 0; i < keys.length; i++) {
@@ -36,11 +37,11 @@ var Ue4Generate = /** @class */ (function () {
         var ret = "";
         for (var i = 0; i < keys.length; i++) {
             var defObj = protoObj[keys[i]];
-            ret += this.exportCommand(keys[i], defObj, tabCount);
+            ret += this.exportCommand(keys[i], defObj, tabCount, protoObj);
         }
         return ret;
     };
-    Ue4Generate.prototype.exportCommand = function (key, defObj, tabCount) {
+    Ue4Generate.prototype.exportCommand = function (key, defObj, tabCount, protoObj) {
         if (defObj.enum != 1) {
             return "";
         }
@@ -59,9 +60,31 @@ var Ue4Generate = /** @class */ (function () {
             this.cppDepend += this.tab(1) + "return " + defObj[keys[i]] + ";\n";
             this.cppDepend += "}\n\n";
         }
+        // cmd to class table for UWebSocketBase::RouteCommand
+        ret += this.tab(tabCount + 1) + "UFUNCTION(BlueprintCallable, Category = \"" + this.moduleName + "\")\n";
+        ret += this.tab(tabCount + 1) + "static void RegisterCommands();\n";
+        this.cppDepend += "void U" + this.moduleName + key + "BlueprintLibrary::RegisterCommands(){\n";
+        for (var i = 0; i < keys.length; i++) {
+            var typeName = this.commandType(keys[i], protoObj);
+            if (keys[i] == "enum" || typeName == "") {
+                continue;
+            }
+            this.cppDepend += this.tab(1) + "UWebSocketBlueprintLibrary::RegisterCommand(" + defObj[keys[i]] + ", U" + typeName + "::StaticClass());\n";
+        }
+        this.cppDepend += "}\n\n";
         ret += this.tab(tabCount) + "};\n\n";
         return ret;
     };
+    // what the server sends for a command is SC_<command>, CS_<command> when it only echoes the client's message
+    Ue4Generate.prototype.commandType = function (command, protoObj) {
+        if (protoObj["SC_" + command] != undefined) {
+            return "SC_" + command;
+        }
+        if (protoObj["CS_" + command] != undefined) {
+            return "CS_" + command;
+        }
+        return "";
+    };
     Ue4Generate.prototype.exportTypes = function (protoObj, tabCount) {
         var keys = Object.keys(protoObj);
         var ret = "";
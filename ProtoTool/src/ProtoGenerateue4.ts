@@ -31,7 +31,8 @@ export class Ue4Generate implements ProtoGenerate.IProtoGenerate{
 
         var cppContent = "#include \"" + moduleName + ".h\"\n"
         cppContent += "#include \"Engine.h\"\n"
-        cppContent += "#include \"Kismet/BlueprintFunctionLibrary.h\"\n\n\n"
+        cppContent += "#include \"Kismet/BlueprintFunctionLibrary.h\"\n"
+        cppContent += "#include \"WebSocketBlueprintLibrary.h\"\n\n\n"
         
 
         cppContent += this.cppDepend;
@@ -52,13 +53,13 @@ export class Ue4Generate implements ProtoGenerate.IProtoGenerate{
         
         for(var i = 0; i < keys.length; i++){
             var defObj = protoObj[keys[i]]
-            ret += this.exportCommand(keys[i], defObj, tabCount)
+            ret += this.exportCommand(keys[i], defObj, tabCount, protoObj)
         }
 
         return ret;
     }
 
-    exportCommand(key:string, defObj:any, tabCount:number):string{
+    exportCommand(key:string, defObj:any, tabCount:number, protoObj:any):string{
         if(defObj.enum != 1){
             return "";
         }
@@ -82,11 +83,38 @@ export class Ue4Generate implements ProtoGenerate.IProtoGenerate{
             this.cppDepend += "}\n\n"
         }
 
+        // cmd to class table for UWebSocketBase::RouteCommand
+        ret += this.tab(tabCount + 1) + "UFUNCTION(BlueprintCallable, Category = \""+ this.moduleName+ "\")\n";
+        ret += this.tab(tabCount+1) + "static void RegisterCommands();\n"
+
+        this.cppDepend += "void U" + this.moduleName + key + "BlueprintLibrary::RegisterCommands(){\n"
+        for (var i = 0; i < keys.length; i++){
+            var typeName = this.commandType(keys[i], protoObj)
+            if(keys[i] == "enum" || typeName == ""){
+                continue;
+            }
+
+            this.cppDepend += this.tab(1) + "UWebSocketBlueprintLibrary::RegisterCommand(" + defObj[keys[i]] + ", U" + typeName + "::StaticClass());\n"
+        }
+        this.cppDepend += "}\n\n"
+
         ret += this.tab(tabCount) + "};\n\n"
 
         return ret;
     }
 
+    // what the server sends for a command is SC_<command>, CS_<command> when it only echoes the client's message
+    commandType(command:string, protoObj:any):string{
+        if(protoObj["SC_" + command] != undefined){
+            return "SC_" + command;
+        }
+        if(protoObj["CS_" + command] != undefined){
+            return "CS_" + command;
+        }
+
+        return "";
+    }
+
     exportTypes(protoObj:any, tabCount:number):string{
         var keys = Object.keys(protoObj)
 
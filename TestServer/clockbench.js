@@ -0,0 +1,82 @@
+// clock sync server with a simulated link and a wrong clock
+//
+//   node clockbench.js [port] [jitter ms] [offset ms] [drift ppm]
+//
+// answers the clock frames of StartClockSync (see WEBSOCKET_CLOCK_MAGIC in
+// WebSocketCodec.h) from a clock that is offset ms ahead of the real one and
+// runs drift ppm fast (defaults 1234.5 ms, 50 ppm). every request waits an
+// exponential jitter (default 5 ms, one in twenty ten times as long) before it
+// is stamped and again after, like queues on both ways of a mobile link. the
+// true offset is printed every second, compare it with GetClockStats. the game
+// only reads the answers on a protocol with bPluginFrames.
+const WebSocket = require('ws');
+
+var CLOCK_MAGIC = 0x54
+var CLOCK_REQUEST_SIZE = 10
+var CLOCK_REQUEST = 0
+var CLOCK_RESPONSE = 1
+
+var port = process.argv.length > 2 ? parseInt(process.argv[2]) : 8080
+var jitterMs = process.argv.length > 3 ? parseFloat(process.argv[3]) : 5
+var offsetMs = process.argv.length > 4 ? parseFloat(process.argv[4]) : 1234.5
+var driftPpm = process.argv.length > 5 ? parseFloat(process.argv[5]) : 50
+
+var startUs = Date.now() * 1000
+var startHr = process.hrtime.bigint()
+
+function RealUs()
+{
+    return startUs + Number(process.hrtime.bigint() - startHr) / 1000
+}
+
+// microseconds since the unix epoch on the simulated server's clock
+function ServerUs()
+{
+    var realUs = RealUs()
+    return Math.round(realUs + offsetMs * 1000 + (realUs - startUs) * driftPpm * 1e-6)
+}
+
+function Jitter()
+{
+    var ms = -jitterMs * Math.log(1 - Math.random())
+    return Math.random() < 0.05 ? ms * 10 : ms
+}
+
+var server = new WebSocket.Server({ port: port, perMessageDeflate: false })
+server.on('connection', function connection(client, req) {
+    console.log("connected " + req.socket.remoteAddress)
+
+    client.on('message', function incoming(data) {
+        if (!Buffer.isBuffer(data) || data.length != CLOCK_REQUEST_SIZE || data[0] != CLOCK_MAGIC || data[1] != CLOCK_REQUEST) {
+            return
+        }
+
+        setTimeout(function () {
+            var response = Buffer.alloc(26)
+            response[0] = CLOCK_MAGIC
+            response[1] = CLOCK_RESPONSE
+            data.copy(response, 2, 2, 10)
+            response.writeBigInt64LE(BigInt(ServerUs()), 10)
+            response.writeBigInt64LE(BigInt(ServerUs()), 18)
+            setTimeout(function () {
+                if (client.readyState == WebSocket.OPEN) {
+                    client.send(response)
+                }
+            }, Jitter())
+        }, Jitter())
+    })
+
+    client.on('close', function () {
+        console.log("closed")
+    })
+
+    client.on('error', function (err) {
+        console.log("error " + err)
+    })
+})
+
+setInterval(function () {
+    console.log("true offset " + ((ServerUs() - RealUs()) / 1000).toFixed(3) + " ms")
+}, 1000)
+
+console.log("listening on " + port + ", jitter " + jitterMs + " ms, offset " + offsetMs + " ms, drift " + driftPpm + " ppm")
@@ -0,0 +1,112 @@
+// dictionary tool for the websocket dictionary codec
+//
+//   node dicttool.js train <capture> <out.dict> [maxsize]
+//   node dicttool.js bench <capture> <dict>
+//
+// <capture> holds one captured message per line. the dictionary is a plain
+// zlib preset dictionary, the most valuable strings are packed at the end
+// because deflate encodes short distances cheaper.
+var fs = require('fs')
+var zlib = require('zlib')
+
+var SEGMENT_LENGTHS = [48, 32, 24, 16, 12, 8, 6]
+var MAX_DICT_SIZE = 32 * 1024
+
+function LoadCapture(file)
+{
+    return fs.readFileSync(file, 'utf8').split(/\r?\n/).filter(function (line) {
+        return line.length > 0
+    })
+}
+
+function Train(messages, maxSize)
+{
+    // count every segment once per message, strings repeated inside one message deflate handles anyway
+    var counts = new Map()
+    messages.forEach(function (msg) {
+        var seen = new Set()
+        SEGMENT_LENGTHS.forEach(function (len) {
+            for (var i = 0; i + len <= msg.length; i++) {
+                seen.add(msg.substr(i, len))
+            }
+        })
+        seen.forEach(function (seg) {
+            counts.set(seg, (counts.get(seg) || 0) + 1)
+        })
+    })
+
+    var candidates = []
+    counts.forEach(function (count, seg) {
+        if (count > 1) {
+            candidates.push({ seg: seg, score: (count - 1) * Buffer.byteLength(seg) })
+        }
+    })
+    candidates.sort(function (a, b) { return b.score - a.score })
+
+    var picked = []
+    var size = 0
+    for (var i = 0; i < candidates.length && size < maxSize; i++) {
+        var seg = candidates[i].seg
+        var covered = picked.some(function (p) { return p.indexOf(seg) >= 0 })
+        if (covered) {
+            continue
+        }
+
+        var bytes = Buffer.byteLength(seg)
+        if (size + bytes > maxSize) {
+            continue
+        }
+
+        picked.push(seg)
+        size += bytes
+    }
+
+    // best segment last
+    return Buffer.from(picked.reverse().join(''), 'utf8')
+}
+
+function Bench(messages, dict)
+{
+    var inputs = messages.map(function (msg) { return Buffer.from(msg, 'utf8') })
+    var rawBytes = inputs.reduce(function (sum, b) { return sum + b.length }, 0)
+
+    function Run(name, options)
+    {
+        var start = process.hrtime.bigint()
+        var outBytes = 0
+        var outputs = inputs.map(function (b) {
+            var out = zlib.deflateRawSync(b, options)
+            outBytes += out.length
+            return out
+        })
+        var encodeNs = Number(process.hrtime.bigint() - start)
+
+        start = process.hrtime.bigint()
+        outputs.forEach(function (b) { zlib.inflateRawSync(b, options) })
+        var decodeNs = Number(process.hrtime.bigint() - start)
+
+        console.log(name + ": ratio " + (rawBytes / outBytes).toFixed(2)
+            + ", encode " + (rawBytes / encodeNs * 1000).toFixed(1) + " MB/s"
+            + ", decode " + (rawBytes / decodeNs * 1000).toFixed(1) + " MB/s")
+    }
+
+    console.log(inputs.length + " messages, " + rawBytes + " bytes")
+    // permessage-deflate with client_no_context_takeover compresses every message on its own
+    Run("permessage-deflate", {})
+    Run("dictionary", { dictionary: dict })
+}
+
+var command = process.argv[2]
+if (command == "train" && process.argv.length >= 5) {
+    var maxSize = process.argv.length > 5 ? parseInt(process.argv[5]) : MAX_DICT_SIZE
+    var dict = Train(LoadCapture(process.argv[3]), Math.min(maxSize, MAX_DICT_SIZE))
+    fs.writeFileSync(process.argv[4], dict)
+    console.log("dictionary written:" + process.argv[4] + " " + dict.length + " bytes")
+}
+else if (command == "bench" && process.argv.length >= 5) {
+    Bench(LoadCapture(process.argv[3]), fs.readFileSync(process.argv[4]))
+}
+else {
+    console.log("useage: train [capture] [out.dict] [maxsize] | bench [capture] [dict]")
+    process.exit(1)
+}
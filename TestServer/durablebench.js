@@ -0,0 +1,126 @@
+// durable lane server and journal append benchmark
+//
+//   node durablebench.js server [port] [ack every n]
+//   node durablebench.js bench [messages] [size] [file]
+//
+// server speaks the durable framing (see WEBSOCKET_DURABLE_MAGIC in
+// WebSocketCodec.h): it stores every sequence above the last one it stored,
+// drops the replayed ones it already has and acknowledges every n messages
+// (default 16) and on a 100 ms timer. restart the game or kill the connection
+// to watch the journal being replayed. the game needs a protocol with
+// bPluginFrames for the acks, see Protocols in DefaultGame.ini.
+//
+// bench appends messages of size bytes in the journal's entry layout to file
+// (default /tmp/uewebsocket.journal) and syncs to disk after every batch, for
+// batch sizes from 1 to 1024. this is the cost DurableSyncBytes and
+// DurableSyncIntervalMs spread: one fdatasync per batch instead of per message.
+var fs = require('fs')
+const WebSocket = require('ws');
+
+var DURABLE_MAGIC = 0x4A
+var DURABLE_HEADER_SIZE = 10
+var DURABLE_ACK = 2
+var JOURNAL_HEADER_SIZE = 64
+var ENTRY_HEADER_SIZE = 16
+
+function MakeAck(sequence)
+{
+    var frame = Buffer.alloc(DURABLE_HEADER_SIZE)
+    frame[0] = DURABLE_MAGIC
+    frame[1] = DURABLE_ACK
+    frame.writeBigUInt64LE(sequence, 2)
+    return frame
+}
+
+function Server(port, ackEvery)
+{
+    var lastStored = 0n
+    var stored = 0
+    var duplicates = 0
+
+    var server = new WebSocket.Server({ port: port, perMessageDeflate: false })
+    server.on('connection', function connection(client, req) {
+        var unacked = 0
+
+        function Ack()
+        {
+            if (unacked > 0 && client.readyState == WebSocket.OPEN) {
+                client.send(MakeAck(lastStored))
+                unacked = 0
+            }
+        }
+
+        var timer = setInterval(Ack, 100)
+        client.on('message', function incoming(data) {
+            if (!Buffer.isBuffer(data) || data.length < DURABLE_HEADER_SIZE || data[0] != DURABLE_MAGIC || data[1] >= DURABLE_ACK) {
+                return
+            }
+
+            var sequence = data.readBigUInt64LE(2)
+            if (sequence <= lastStored) {
+                duplicates++
+            }
+            else {
+                lastStored = sequence
+                stored++
+            }
+
+            if (++unacked >= ackEvery) {
+                Ack()
+            }
+        })
+        client.on('close', function () {
+            clearInterval(timer)
+        })
+        client.on('error', function (err) {
+            console.log("error:" + err)
+        })
+    })
+
+    setInterval(function () {
+        console.log("stored " + stored + ", replayed duplicates dropped " + duplicates + ", last sequence 0x" + lastStored.toString(16))
+    }, 1000)
+    console.log("durable server on " + port + ", ack every " + ackEvery + " messages")
+}
+
+function Bench(messages, size, file)
+{
+    var payload = Buffer.alloc(size, 0x61)
+    var span = Math.ceil((ENTRY_HEADER_SIZE + size) / 8) * 8
+    var entry = Buffer.alloc(span)
+    payload.copy(entry, ENTRY_HEADER_SIZE)
+    entry.writeUInt32LE(size, 0)
+
+    var batches = [1, 4, 16, 64, 256, 1024]
+    batches.forEach(function (batch) {
+        var fd = fs.openSync(file, 'w')
+        var offset = JOURNAL_HEADER_SIZE
+        var start = process.hrtime()
+        for (var i = 0; i < messages; i++) {
+            entry.writeBigUInt64LE(BigInt(i + 1), 8)
+            fs.writeSync(fd, entry, 0, span, offset)
+            offset += span
+            if ((i + 1) % batch == 0) {
+                fs.fdatasyncSync(fd)
+            }
+        }
+        fs.fdatasyncSync(fd)
+        var d = process.hrtime(start)
+        var seconds = d[0] + d[1] / 1e9
+        fs.closeSync(fd)
+
+        console.log("sync every " + batch + " messages: " + (messages / seconds).toFixed(0) + " msg/s, "
+            + (seconds * 1e6 / Math.ceil(messages / batch)).toFixed(0) + " us per sync")
+    })
+    fs.unlinkSync(file)
+}
+
+var mode = process.argv.length > 2 ? process.argv[2] : "server"
+if (mode == "server") {
+    Server(process.argv.length > 3 ? parseInt(process.argv[3]) : 8080, process.argv.length > 4 ? parseInt(process.argv[4]) : 16)
+}
+else {
+    Bench(process.argv.length > 3 ? parseInt(process.argv[3]) : 20000,
+        process.argv.length > 4 ? parseInt(process.argv[4]) : 256,
+        process.argv.length > 5 ? process.argv[5] : "/tmp/uewebsocket.journal")
+}
@@ -0,0 +1,60 @@
+// idle connection cpu benchmark (linux)
+//
+//   node idlebench.js <pid> [port] [seconds]
+//
+// accepts websocket connections and never sends anything. connect a number of
+// sockets from the game (or a dedicated server) with the pid given, wait for
+// them to show up, and the cpu the process spends while all of them sit idle is
+// reported per connection. run it once with bUseServiceThread=True and once with
+// False to compare the service thread against polling every frame.
+var fs = require('fs')
+const WebSocket = require('ws');
+
+if (process.argv.length < 3) {
+    console.log("usage: node idlebench.js <pid> [port] [seconds]")
+    process.exit(1)
+}
+
+var pid = parseInt(process.argv[2])
+var port = process.argv.length > 3 ? parseInt(process.argv[3]) : 8080
+var seconds = process.argv.length > 4 ? parseFloat(process.argv[4]) : 10
+var ticksPerSecond = 100
+
+// utime + stime of the process in clock ticks
+function ReadCpuTicks()
+{
+    var stat = fs.readFileSync("/proc/" + pid + "/stat", "utf8")
+    var fields = stat.substring(stat.lastIndexOf(")") + 2).split(" ")
+    return parseInt(fields[11]) + parseInt(fields[12])
+}
+
+var connections = 0
+var server = new WebSocket.Server({ port: port })
+server.on('connection', function connection(client, req) {
+    connections++
+    client.on('close', function () {
+        connections--
+    })
+    client.on('error', function (err) {
+        console.log("error:" + err)
+    })
+})
+
+function Measure()
+{
+    var startTicks = ReadCpuTicks()
+    var start = Date.now()
+    var startConnections = connections
+
+    setTimeout(function () {
+        var elapsed = (Date.now() - start) / 1000
+        var cpuMs = (ReadCpuTicks() - startTicks) * 1000 / ticksPerSecond
+        var perSecond = cpuMs / elapsed
+        console.log(startConnections + " idle connections: " + perSecond.toFixed(2) + " ms cpu/s, "
+            + (startConnections > 0 ? (perSecond / startConnections).toFixed(4) : "-") + " ms cpu/s per connection")
+        Measure()
+    }, seconds * 1000)
+}
+
+console.log("listening on " + port + ", measuring pid " + pid + " every " + seconds + "s")
+Measure()
@@ -0,0 +1,179 @@
+// channel multiplexing echo server and benchmark
+//
+//   node muxbench.js server [port]
+//   node muxbench.js bench [channels] [messages] [port]
+//
+// server echoes every message back, channel frames (see WEBSOCKET_CHANNEL_MAGIC
+// in WebSocketCodec.h) on the channel they came from. a channel the client
+// paused is held until it is resumed, the others keep flowing. the game reads
+// channel frames only on a protocol with bPluginFrames, connect it with
+// ConnectWithProtocol and eg "plugin.v1", ws accepts the first one offered.
+//
+// bench runs the same echo traffic once over N separate sockets and once over
+// N channels of one socket, and prints time and memory for both.
+const WebSocket = require('ws');
+
+var CHANNEL_MAGIC = 0x4D
+var CHANNEL_HEADER_SIZE = 4
+var CHANNEL_TEXT = 0
+var CHANNEL_BINARY = 1
+var CHANNEL_PAUSE = 2
+var CHANNEL_RESUME = 3
+
+function MakeChannelFrame(channel, type, payload)
+{
+    var frame = Buffer.alloc(CHANNEL_HEADER_SIZE + (payload ? payload.length : 0))
+    frame[0] = CHANNEL_MAGIC
+    frame[1] = type
+    frame.writeUInt16LE(channel, 2)
+    if (payload) {
+        payload.copy(frame, CHANNEL_HEADER_SIZE)
+    }
+    return frame
+}
+
+function IsChannelFrame(data)
+{
+    return Buffer.isBuffer(data) && data.length >= CHANNEL_HEADER_SIZE && data[0] == CHANNEL_MAGIC && data[1] <= CHANNEL_RESUME
+}
+
+function CreateMuxServer(port)
+{
+    var server = new WebSocket.Server({ port: port, perMessageDeflate: false })
+    server.on('connection', function connection(client, req) {
+        var paused = {}
+        var held = {}
+
+        client.on('message', function incoming(data) {
+            if (!IsChannelFrame(data)) {
+                client.send(data)
+                return
+            }
+
+            var type = data[1]
+            var channel = data.readUInt16LE(2)
+            if (type == CHANNEL_PAUSE) {
+                paused[channel] = true
+                return
+            }
+
+            if (type == CHANNEL_RESUME) {
+                paused[channel] = false
+                var frames = held[channel] || []
+                held[channel] = []
+                frames.forEach(function (frame) { client.send(frame) })
+                return
+            }
+
+            if (paused[channel]) {
+                held[channel] = held[channel] || []
+                held[channel].push(data)
+                return
+            }
+
+            client.send(data)
+        })
+
+        client.on('error', function (err) {
+            console.log("error:" + err)
+        })
+    })
+    return server
+}
+
+function Rss()
+{
+    global.gc && global.gc()
+    return process.memoryUsage().rss
+}
+
+function OpenSockets(port, count, cb)
+{
+    var sockets = []
+    var open = 0
+    for (var i = 0; i < count; i++) {
+        var socket = new WebSocket("ws://localhost:" + port, { perMessageDeflate: false })
+        socket.on('open', function () {
+            if (++open == count) {
+                cb(sockets)
+            }
+        })
+        sockets.push(socket)
+    }
+}
+
+function RunSockets(port, count, messages, cb)
+{
+    var rssStart = Rss()
+    OpenSockets(port, count, function (sockets) {
+        var rssOpen = Rss()
+        var start = Date.now()
+        var remaining = count * messages
+        var payload = JSON.stringify({ cmd: 1, data: "x".repeat(64) })
+
+        sockets.forEach(function (socket) {
+            socket.on('message', function () {
+                if (--remaining == 0) {
+                    var ms = Date.now() - start
+                    sockets.forEach(function (s) { s.close() })
+                    cb({ name: count + " sockets", ms: ms, bytesPerStream: (rssOpen - rssStart) / count })
+                }
+            })
+            for (var i = 0; i < messages; i++) {
+                socket.send(payload)
+            }
+        })
+    })
+}
+
+function RunChannels(port, count, messages, cb)
+{
+    var rssStart = Rss()
+    OpenSockets(port, 1, function (sockets) {
+        var rssOpen = Rss()
+        var socket = sockets[0]
+        var start = Date.now()
+        var remaining = count * messages
+        var payload = Buffer.from(JSON.stringify({ cmd: 1, data: "x".repeat(64) }))
+
+        socket.on('message', function () {
+            if (--remaining == 0) {
+                var ms = Date.now() - start
+                socket.close()
+                cb({ name: count + " channels", ms: ms, bytesPerStream: (rssOpen - rssStart) / count })
+            }
+        })
+        for (var i = 0; i < messages; i++) {
+            for (var channel = 0; channel < count; channel++) {
+                socket.send(MakeChannelFrame(channel, CHANNEL_TEXT, payload))
+            }
+        }
+    })
+}
+
+function Report(result, messages, count)
+{
+    console.log(result.name + ": " + result.ms + " ms for " + (messages * count) + " round trips, "
+        + (result.bytesPerStream / 1024).toFixed(1) + " KB rss per stream")
+}
+
+var mode = process.argv.length > 2 ? process.argv[2] : "server"
+if (mode == "server") {
+    var port = process.argv.length > 3 ? parseInt(process.argv[3]) : 8080
+    CreateMuxServer(port)
+    console.log("mux echo server on " + port)
+}
+else {
+    var count = process.argv.length > 3 ? parseInt(process.argv[3]) : 3
+    var messages = process.argv.length > 4 ? parseInt(process.argv[4]) : 10000
+    var port = process.argv.length > 5 ? parseInt(process.argv[5]) : 8081
+    var server = CreateMuxServer(port)
+
+    RunSockets(port, count, messages, function (sockets) {
+        Report(sockets, messages, count)
+        RunChannels(port, count, messages, function (channels) {
+            Report(channels, messages, count)
+            server.close()
+        })
+    })
+}
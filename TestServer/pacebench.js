@@ -0,0 +1,144 @@
+// send latency over a bandwidth limited link
+//
+//   node pacebench.js [kbytes per second] [delay ms] [port]
+//
+// listens on port (default 8080) and forwards to a websocket server on port + 1
+// through a link that carries kbytes per second (default 64) with delay ms
+// (default 20) of propagation delay each way. the server measures how long
+// every message took since the game sent it.
+//
+// messages are text, or channel frames (see WEBSOCKET_CHANNEL_MAGIC in
+// WebSocketCodec.h) carrying text, holding json with t set to the unix time in
+// milliseconds at SendText, eg FDateTime::UtcNow().ToUnixTimestamp() * 1000 +
+// FDateTime::UtcNow().GetMillisecond(). both ends run on this host, so the
+// clocks agree. latency percentiles are printed per channel every second.
+//
+// send more than the link carries, once with bEnablePacing=False and once with
+// True. without pacing the socket buffer fills up and every message waits
+// behind it, with pacing the backlog stays in the plugin's queues where higher
+// priority channels overtake it, and GetEstimatedBandwidth tells the game how
+// far to lower its update rate.
+var net = require('net')
+const WebSocket = require('ws');
+
+var CHANNEL_MAGIC = 0x4D
+var CHANNEL_HEADER_SIZE = 4
+var CHANNEL_RESUME = 3
+
+var rate = (process.argv.length > 2 ? parseFloat(process.argv[2]) : 64) * 1024
+var delay = process.argv.length > 3 ? parseInt(process.argv[3]) : 20
+var port = process.argv.length > 4 ? parseInt(process.argv[4]) : 8080
+var linkBuffer = 16 * 1024
+var tickMs = 5
+
+// one direction of the link, at most linkBuffer bytes wait in it, the rest stays in the sender's socket buffer
+function Link(from, to, limited)
+{
+    var queue = []
+    var queued = 0
+    var budget = 0
+
+    from.on('data', function (data) {
+        if (!limited) {
+            setTimeout(function () { to.write(data) }, delay)
+            return
+        }
+
+        queue.push(data)
+        queued += data.length
+        if (queued > linkBuffer) {
+            from.pause()
+        }
+    })
+
+    if (!limited) {
+        return
+    }
+
+    var timer = setInterval(function () {
+        budget = Math.min(budget + rate * tickMs / 1000, linkBuffer)
+        while (queue.length > 0 && budget > 0) {
+            var chunk = queue[0]
+            var len = Math.min(chunk.length, Math.floor(budget))
+            if (len <= 0) {
+                break
+            }
+
+            var out = chunk.slice(0, len)
+            if (len == chunk.length) {
+                queue.shift()
+            }
+            else {
+                queue[0] = chunk.slice(len)
+            }
+            queued -= len
+            budget -= len
+            setTimeout(function (out) { to.write(out) }, delay, out)
+        }
+
+        if (queued <= linkBuffer / 2) {
+            from.resume()
+        }
+    }, tickMs)
+
+    from.on('close', function () {
+        clearInterval(timer)
+        to.end()
+    })
+}
+
+var proxy = net.createServer(function (client) {
+    var server = net.connect(port + 1, "127.0.0.1")
+    Link(client, server, true)
+    Link(server, client, false)
+    client.on('error', function () { server.destroy() })
+    server.on('error', function () { client.destroy() })
+})
+proxy.listen(port)
+
+var latencies = {}
+
+function Record(channel, text)
+{
+    try {
+        var sent = JSON.parse(text).t
+        if (typeof sent == "number") {
+            latencies[channel] = latencies[channel] || []
+            latencies[channel].push(Date.now() - sent)
+        }
+    }
+    catch (err) {
+    }
+}
+
+var server = new WebSocket.Server({ port: port + 1, perMessageDeflate: false })
+server.on('connection', function connection(client, req) {
+    client.on('message', function incoming(data) {
+        if (Buffer.isBuffer(data) && data.length >= CHANNEL_HEADER_SIZE && data[0] == CHANNEL_MAGIC && data[1] <= CHANNEL_RESUME) {
+            Record("channel " + data.readUInt16LE(2), data.slice(CHANNEL_HEADER_SIZE).toString())
+            return
+        }
+        Record("socket", data.toString())
+    })
+    client.on('error', function (err) {
+        console.log("error:" + err)
+    })
+})
+
+function Percentile(sorted, p)
+{
+    return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))]
+}
+
+setInterval(function () {
+    for (var channel in latencies) {
+        var samples = latencies[channel].sort(function (a, b) { return a - b })
+        if (samples.length > 0) {
+            console.log(channel + ": " + samples.length + " msgs, latency p50 " + Percentile(samples, 0.5) + " ms, p99 "
+                + Percentile(samples, 0.99) + " ms, max " + samples[samples.length - 1] + " ms")
+        }
+        latencies[channel] = []
+    }
+}, 1000)
+
+console.log("link of " + (rate / 1024) + " KB/s and " + delay + " ms on " + port + ", websocket server on " + (port + 1))
@@ -0,0 +1,95 @@
+// fake regional gateways for ConnectEndpoints
+//
+//   node regions.js [count] [port] [delay ms,...]
+//
+// starts count (default 3) echo servers on port, port + 1, ... (default 8080)
+// behind links that add the given one way delay (default 10,40,80 ms), so the
+// probes see a different rtt per region. type a region number and enter to
+// kill every connection of that region and stop it accepting new ones, type it
+// again to bring it back. with a game sending continuously the time from the
+// kill to the first message arriving at another region is printed, which is
+// how long the failover took.
+var net = require('net')
+var readline = require('readline')
+const WebSocket = require('ws');
+
+var count = process.argv.length > 2 ? parseInt(process.argv[2]) : 3
+var port = process.argv.length > 3 ? parseInt(process.argv[3]) : 8080
+var delays = (process.argv.length > 4 ? process.argv[4] : "10,40,80").split(",").map(function (it) { return parseInt(it) })
+
+var regions = []
+var killTime = 0
+var killedRegion = -1
+
+function Delay(from, to, ms)
+{
+    from.on('data', function (data) {
+        setTimeout(function () { to.write(data) }, ms)
+    })
+    from.on('close', function () {
+        setTimeout(function () { to.destroy() }, ms)
+    })
+    from.on('error', function () {
+        to.destroy()
+    })
+}
+
+function CreateRegion(index)
+{
+    var region = { index: index, port: port + index, delay: delays[index % delays.length], down: false, sockets: [] }
+    var backendPort = region.port + 1000
+
+    var server = new WebSocket.Server({ port: backendPort, perMessageDeflate: false })
+    server.on('connection', function connection(client, req) {
+        client.on('message', function incoming(data) {
+            if (killTime > 0 && index != killedRegion) {
+                console.log("region " + index + " got the first message " + (Date.now() - killTime) + " ms after region " + killedRegion + " went down")
+                killTime = 0
+            }
+            client.send(data)
+        })
+        client.on('error', function (err) {
+        })
+    })
+
+    region.proxy = net.createServer(function (client) {
+        if (region.down) {
+            client.destroy()
+            return
+        }
+
+        var backend = net.connect(backendPort, "127.0.0.1")
+        Delay(client, backend, region.delay)
+        Delay(backend, client, region.delay)
+        region.sockets.push(client)
+        client.on('close', function () {
+            region.sockets.splice(region.sockets.indexOf(client), 1)
+        })
+    })
+    region.proxy.listen(region.port)
+
+    console.log("region " + index + ": ws://127.0.0.1:" + region.port + ", " + (2 * region.delay) + " ms rtt")
+    return region
+}
+
+for (var i = 0; i < count; i++) {
+    regions.push(CreateRegion(i))
+}
+
+readline.createInterface({ input: process.stdin }).on('line', function (line) {
+    var region = regions[parseInt(line)]
+    if (!region) {
+        return
+    }
+
+    region.down = !region.down
+    if (!region.down) {
+        console.log("region " + region.index + " is back")
+        return
+    }
+
+    console.log("region " + region.index + " down, dropping " + region.sockets.length + " connections")
+    killTime = Date.now()
+    killedRegion = region.index
+    region.sockets.slice().forEach(function (socket) { socket.destroy() })
+})
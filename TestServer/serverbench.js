@@ -0,0 +1,109 @@
+// clients for a UWebSocketServer and a node reference server
+//
+//   node serverbench.js clients [url] [count]
+//   node serverbench.js reference [port] [count] [size] [broadcasts]
+//
+// clients opens count connections (default 1000) to a game that called Listen
+// and reports how fast they were accepted, then the messages and bytes per
+// second the game's BroadcastText and BroadcastBinary deliver to all of them.
+//
+// reference does the same against a ws server in this process that sends
+// broadcasts messages of size bytes (default 1000 of 256) to every client,
+// one send per client like a relay process would. the numbers are the baseline
+// for the game's encode once fan-out.
+const WebSocket = require('ws');
+
+function OpenClients(url, count, done)
+{
+    var clients = []
+    var open = 0
+    var received = 0
+    var receivedBytes = 0
+    var start = process.hrtime()
+
+    for (var i = 0; i < count; i++) {
+        var client = new WebSocket(url, { perMessageDeflate: false })
+        client.on('open', function () {
+            if (++open == count) {
+                var d = process.hrtime(start)
+                var seconds = d[0] + d[1] / 1e9
+                console.log(count + " connections accepted in " + (seconds * 1000).toFixed(0) + " ms, " + (count / seconds).toFixed(0) + " accepts/s")
+                done(clients, function () { return { received: received, bytes: receivedBytes } })
+            }
+        })
+        client.on('message', function incoming(data) {
+            received++
+            receivedBytes += data.length
+        })
+        client.on('error', function (err) {
+            console.log("error:" + err)
+        })
+        clients.push(client)
+    }
+}
+
+function Clients(url, count)
+{
+    OpenClients(url, count, function (clients, counters) {
+        var last = counters()
+        setInterval(function () {
+            var now = counters()
+            console.log("received " + (now.received - last.received) + " msg/s, " + ((now.bytes - last.bytes) / 1048576).toFixed(1) + " MB/s over " + count + " clients")
+            last = now
+        }, 1000)
+    })
+}
+
+function Reference(port, count, size, broadcasts)
+{
+    var server = new WebSocket.Server({ port: port, perMessageDeflate: false })
+    var payload = Buffer.alloc(size, 0x61)
+
+    OpenClients("ws://127.0.0.1:" + port, count, function (clients, counters) {
+        var expected = count * broadcasts
+        var start = process.hrtime()
+        var sent = 0
+
+        // one broadcast per turn of the event loop so the receivers keep up
+        function Next()
+        {
+            if (sent == broadcasts) {
+                return
+            }
+
+            server.clients.forEach(function (client) {
+                client.send(payload)
+            })
+            sent++
+            setImmediate(Next)
+        }
+        Next()
+
+        var timer = setInterval(function () {
+            if (counters().received < expected) {
+                return
+            }
+
+            clearInterval(timer)
+            var d = process.hrtime(start)
+            var seconds = d[0] + d[1] / 1e9
+            console.log(broadcasts + " broadcasts of " + size + " bytes to " + count + " clients: " + (broadcasts / seconds).toFixed(0) + " broadcasts/s, "
+                + (expected / seconds).toFixed(0) + " msg/s")
+            clients.forEach(function (client) {
+                client.close()
+            })
+            server.close()
+        }, 10)
+    })
+}
+
+var mode = process.argv.length > 2 ? process.argv[2] : "clients"
+if (mode == "clients") {
+    Clients(process.argv.length > 3 ? process.argv[3] : "ws://127.0.0.1:8080", process.argv.length > 4 ? parseInt(process.argv[4]) : 1000)
+}
+else {
+    Reference(process.argv.length > 3 ? parseInt(process.argv[3]) : 8081,
+        process.argv.length > 4 ? parseInt(process.argv[4]) : 1000,
+        process.argv.length > 5 ? parseInt(process.argv[5]) : 256,
+        process.argv.length > 6 ? parseInt(process.argv[6]) : 1000)
+}
@@ -0,0 +1,77 @@
+// server side cost of tls option choices, measured with node's own client
+//
+//   node tlsserver.js 8443 key.pem cert.pem
+//   node tlsbench.js [port] [seconds]
+//
+// this does not run the plugin: it shows what a cipher, curve or signature
+// choice costs the server before you put the same strings into TlsOptions.
+// run it once with an rsa certificate and once with an ecdsa one
+// (openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:P-256 ...) to compare.
+// sessions are never reused so every connect is a full handshake.
+//
+// the plugin's own handshake, with TlsOptions applied to its SSL_CTX, is
+// measured in game with the console command
+//
+//   websocket.TlsBench wss://localhost:8443 [connects]
+//
+// against the same tlsserver.js, with bEnableTlsSessionCache off for full handshakes.
+var tls = require('tls')
+
+var port = process.argv.length > 2 ? parseInt(process.argv[2]) : 8443
+var seconds = process.argv.length > 3 ? parseFloat(process.argv[3]) : 5
+
+var settings = [
+    { name: "openssl defaults" },
+    { name: "tls1.2 ecdhe-ecdsa aes128-gcm", maxVersion: "TLSv1.2", ciphers: "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256" },
+    { name: "tls1.2 curve P-256", maxVersion: "TLSv1.2", ecdhCurve: "P-256" },
+    { name: "tls1.2 curve X25519", maxVersion: "TLSv1.2", ecdhCurve: "X25519" },
+    { name: "tls1.3 X25519 ecdsa first", minVersion: "TLSv1.3", ecdhCurve: "X25519", sigalgs: "ECDSA+SHA256:RSA-PSS+SHA256" },
+]
+
+function Connect(options, cb)
+{
+    var socket = tls.connect(Object.assign({ port: port, host: "localhost", rejectUnauthorized: false }, options), function () {
+        socket.destroy()
+        cb(null)
+    })
+    socket.on('error', function (err) {
+        cb(err)
+    })
+}
+
+function Run(index)
+{
+    if (index >= settings.length) {
+        return
+    }
+
+    var setting = settings[index]
+    var count = 0
+    var start = Date.now()
+    var cpuStart = process.cpuUsage()
+
+    function Next(err)
+    {
+        if (err) {
+            console.log(setting.name + ": " + err.message)
+            Run(index + 1)
+            return
+        }
+
+        if (Date.now() - start >= seconds * 1000) {
+            var cpu = process.cpuUsage(cpuStart)
+            var cpuSeconds = (cpu.user + cpu.system) / 1e6
+            console.log(setting.name + ": " + (count / cpuSeconds).toFixed(0) + " connects/s per core, "
+                + (count * 1000 / (Date.now() - start)).toFixed(0) + " connects/s wall")
+            Run(index + 1)
+            return
+        }
+
+        count++
+        Connect(setting, Next)
+    }
+
+    Connect(setting, Next)
+}
+
+Run(0)
@@ -0,0 +1,55 @@
+// wss echo server that reports tls session resumption
+//
+//   openssl req -x509 -newkey rsa:2048 -nodes -keyout key.pem -out cert.pem -days 365 -subj "/CN=localhost"
+//   node tlsserver.js [port] [key.pem] [cert.pem]
+//
+// every accepted connection prints whether its handshake was resumed, connect
+// to wss://localhost:<port> twice from the plugin and the second one should say so.
+var fs = require('fs')
+var https = require('https')
+const WebSocket = require('ws');
+
+var port = process.argv.length > 2 ? parseInt(process.argv[2]) : 8443
+var keyFile = process.argv.length > 3 ? process.argv[3] : "key.pem"
+var certFile = process.argv.length > 4 ? process.argv[4] : "cert.pem"
+
+// session id resumption for clients that do not send tickets
+var sessionStore = {}
+var full = 0
+var resumed = 0
+
+function CreateTlsWebSocketServer(port)
+{
+    var httpsServer = https.createServer({ key: fs.readFileSync(keyFile), cert: fs.readFileSync(certFile) })
+    httpsServer.on('newSession', function (id, data, cb) {
+        sessionStore[id.toString('hex')] = data
+        cb()
+    })
+    httpsServer.on('resumeSession', function (id, cb) {
+        cb(null, sessionStore[id.toString('hex')] || null)
+    })
+
+    var server = new WebSocket.Server({ server: httpsServer })
+    server.on('connection', function connection(client, req) {
+        var isResumed = req.socket.isSessionReused()
+        if (isResumed) {
+            resumed++
+        }
+        else {
+            full++
+        }
+        console.log((isResumed ? "resumed" : "full") + " handshake, resume rate:" + (resumed / (full + resumed)).toFixed(2))
+
+        client.on('message', function incoming(message) {
+            client.send(message)
+        });
+
+        client.on('error', function (err) {
+            console.log("error:" + err);
+        })
+    });
+
+    httpsServer.listen(port)
+}
+
+CreateTlsWebSocketServer(port)
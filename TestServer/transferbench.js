@@ -0,0 +1,203 @@
+// file transfer server for SendFile and AcceptTransfers
+//
+//   node transferbench.js [port] [directory] [chunk bytes] [message bytes]
+//
+// speaks the transfer framing (see WEBSOCKET_TRANSFER_MAGIC in WebSocketCodec.h).
+// files the game sends with SendFile are written to directory (default
+// /tmp/transfers), checked against the crc of the END frame and reported with
+// their throughput. type a file path and enter to stream that file to every
+// connected game, in fragments of chunk bytes (default 64 KB) and messages of
+// message bytes (default 1 MB), the game needs AcceptTransfers for it and a
+// protocol with bPluginFrames to tell transfer frames from its own messages.
+var fs = require('fs')
+var path = require('path')
+var readline = require('readline')
+const WebSocket = require('ws');
+
+var TRANSFER_MAGIC = 0x46
+var TRANSFER_HEADER_SIZE = 4
+var TRANSFER_BEGIN = 0
+var TRANSFER_DATA = 1
+var TRANSFER_END = 2
+var TRANSFER_ABORT = 3
+
+var port = process.argv.length > 2 ? parseInt(process.argv[2]) : 8080
+var directory = process.argv.length > 3 ? process.argv[3] : "/tmp/transfers"
+var chunkBytes = process.argv.length > 4 ? parseInt(process.argv[4]) : 64 * 1024
+var messageBytes = process.argv.length > 5 ? parseInt(process.argv[5]) : 1024 * 1024
+
+var crcTable = []
+for (var n = 0; n < 256; n++) {
+    var c = n
+    for (var k = 0; k < 8; k++) {
+        c = (c & 1) ? (0xEDB88320 ^ (c >>> 1)) : (c >>> 1)
+    }
+    crcTable.push(c >>> 0)
+}
+
+function Crc32(crc, data)
+{
+    crc = ~crc >>> 0
+    for (var i = 0; i < data.length; i++) {
+        crc = (crcTable[(crc ^ data[i]) & 0xff] ^ (crc >>> 8)) >>> 0
+    }
+    return ~crc >>> 0
+}
+
+function MakeHeader(type, id, len)
+{
+    var frame = Buffer.alloc(TRANSFER_HEADER_SIZE + len)
+    frame[0] = TRANSFER_MAGIC
+    frame[1] = type
+    frame.writeUInt16LE(id, 2)
+    return frame
+}
+
+var partSerial = 0
+
+function Drop(transfers, id)
+{
+    fs.closeSync(transfers[id].fd)
+    fs.unlinkSync(transfers[id].part)
+    delete transfers[id]
+}
+
+function Receive(client, data, transfers)
+{
+    var type = data[1]
+    var id = data.readUInt16LE(2)
+
+    if (type == TRANSFER_BEGIN) {
+        var name = path.basename(data.slice(12).toString('utf8'))
+        var file = path.join(directory, name)
+        if (transfers[id]) {
+            console.log("transfer " + id + " began twice, dropped")
+            Drop(transfers, id)
+            return
+        }
+        var part = file + "." + id + "-" + (++partSerial) + ".part"
+        transfers[id] = { name: name, file: file, part: part, size: Number(data.readBigUInt64LE(4)), received: 0, crc: 0, fd: fs.openSync(part, 'w'), start: Date.now() }
+        console.log("receiving " + name + ", " + transfers[id].size + " bytes")
+        return
+    }
+
+    var transfer = transfers[id]
+    if (!transfer) {
+        console.log("frame for unknown transfer " + id)
+        return
+    }
+
+    if (type == TRANSFER_DATA) {
+        var payload = data.slice(TRANSFER_HEADER_SIZE)
+        fs.writeSync(transfer.fd, payload)
+        transfer.crc = Crc32(transfer.crc, payload)
+        transfer.received += payload.length
+        return
+    }
+
+    fs.closeSync(transfer.fd)
+    delete transfers[id]
+    var bOk = type == TRANSFER_END && transfer.received == transfer.size && data.readUInt32LE(4) == transfer.crc
+    if (!bOk) {
+        fs.unlinkSync(transfer.part)
+        console.log(transfer.name + (type == TRANSFER_ABORT ? " aborted by the game" : " corrupt") + " after " + transfer.received + " bytes")
+        return
+    }
+
+    fs.renameSync(transfer.part, transfer.file)
+    var seconds = Math.max(Date.now() - transfer.start, 1) / 1000
+    console.log(transfer.name + " done, " + (transfer.size / seconds / 1048576).toFixed(1) + " MB/s, crc " + transfer.crc.toString(16))
+}
+
+function SendFile(client, id, file)
+{
+    var size = fs.statSync(file).size
+    var name = Buffer.from(path.basename(file), 'utf8')
+    var begin = MakeHeader(TRANSFER_BEGIN, id, 8 + name.length)
+    begin.writeBigUInt64LE(BigInt(size), 4)
+    name.copy(begin, 12)
+    client.send(begin)
+
+    var fd = fs.openSync(file, 'r')
+    var chunk = Buffer.alloc(chunkBytes)
+    var crc = 0
+    var sent = 0
+    var start = Date.now()
+
+    // one fragment per turn of the event loop, the socket's buffer drains in between
+    function Next()
+    {
+        if (client.readyState != WebSocket.OPEN) {
+            fs.closeSync(fd)
+            return
+        }
+
+        if (sent == size) {
+            fs.closeSync(fd)
+            var end = MakeHeader(TRANSFER_END, id, 4)
+            end.writeUInt32LE(crc, 4)
+            client.send(end)
+            var seconds = Math.max(Date.now() - start, 1) / 1000
+            console.log("sent " + file + ", " + (size / seconds / 1048576).toFixed(1) + " MB/s")
+            return
+        }
+
+        var messageLeft = Math.min(messageBytes, size - sent)
+        var first = true
+        function Fragment()
+        {
+            var len = Math.min(chunkBytes, messageLeft)
+            fs.readSync(fd, chunk, 0, len, sent)
+            var data = chunk.slice(0, len)
+            crc = Crc32(crc, data)
+            sent += len
+            messageLeft -= len
+
+            var frame = first ? Buffer.concat([MakeHeader(TRANSFER_DATA, id, 0), data]) : Buffer.from(data)
+            first = false
+            client.send(frame, { binary: true, fin: messageLeft == 0 }, function () {
+                setImmediate(messageLeft == 0 ? Next : Fragment)
+            })
+        }
+        Fragment()
+    }
+    Next()
+}
+
+fs.mkdirSync(directory, { recursive: true })
+
+var clients = []
+var nextId = 1
+var server = new WebSocket.Server({ port: port, perMessageDeflate: false })
+server.on('connection', function connection(client, req) {
+    var transfers = {}
+    clients.push(client)
+
+    client.on('message', function incoming(data) {
+        if (Buffer.isBuffer(data) && data.length >= TRANSFER_HEADER_SIZE && data[0] == TRANSFER_MAGIC) {
+            Receive(client, data, transfers)
+        }
+    })
+    client.on('close', function () {
+        clients.splice(clients.indexOf(client), 1)
+        for (var id in transfers) {
+            Drop(transfers, id)
+        }
+    })
+    client.on('error', function (err) {
+        console.log("error:" + err)
+    })
+})
+
+readline.createInterface({ input: process.stdin }).on('line', function (line) {
+    var file = line.trim()
+    if (file.length == 0 || !fs.existsSync(file)) {
+        return
+    }
+
+    clients.forEach(function (client) {
+        SendFile(client, nextId++ & 0xffff, file)
+    })
+})
+
+console.log("transfer server on " + port + ", writing to " + directory)
@@ -0,0 +1,128 @@
+// unix domain socket vs tcp loopback benchmark
+//
+//   node unixbench.js server [socket] [port]
+//   node unixbench.js bench [messages] [size]
+//
+// server is an echo server listening on both the unix socket (default
+// /tmp/uewebsocket.sock) and the tcp port (default 8080), so the plugin can
+// connect to ws+unix:///tmp/uewebsocket.sock and ws://127.0.0.1:8080 in turn.
+//
+// bench measures round trip latency (one message in flight) and echo
+// throughput (all messages in flight) over both transports.
+var fs = require('fs')
+var http = require('http')
+const WebSocket = require('ws');
+
+function CreateEchoServer(listen, cb)
+{
+    var httpServer = http.createServer()
+    var server = new WebSocket.Server({ server: httpServer, perMessageDeflate: false })
+    server.on('connection', function connection(client, req) {
+        client.on('message', function incoming(data) {
+            client.send(data)
+        })
+        client.on('error', function (err) {
+            console.log("error:" + err)
+        })
+    })
+
+    if (typeof listen == "string" && fs.existsSync(listen)) {
+        fs.unlinkSync(listen)
+    }
+    httpServer.listen(listen, cb)
+    return httpServer
+}
+
+function Percentile(sorted, p)
+{
+    return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))]
+}
+
+function Latency(url, messages, payload, cb)
+{
+    var socket = new WebSocket(url, { perMessageDeflate: false })
+    var samples = []
+    var sent = 0
+    var start
+
+    function Send()
+    {
+        start = process.hrtime()
+        socket.send(payload)
+    }
+
+    socket.on('open', Send)
+    socket.on('message', function () {
+        var d = process.hrtime(start)
+        samples.push(d[0] * 1e6 + d[1] / 1e3)
+        if (++sent < messages) {
+            Send()
+            return
+        }
+
+        socket.close()
+        samples.sort(function (a, b) { return a - b })
+        cb(Percentile(samples, 0.5), Percentile(samples, 0.99))
+    })
+}
+
+function Throughput(url, messages, payload, cb)
+{
+    var socket = new WebSocket(url, { perMessageDeflate: false })
+    var received = 0
+    var start
+
+    socket.on('open', function () {
+        start = Date.now()
+        for (var i = 0; i < messages; i++) {
+            socket.send(payload)
+        }
+    })
+    socket.on('message', function () {
+        if (++received < messages) {
+            return
+        }
+
+        var seconds = (Date.now() - start) / 1000
+        socket.close()
+        cb(messages / seconds, messages * payload.length / seconds / 1024 / 1024)
+    })
+}
+
+function Bench(name, url, messages, payload, cb)
+{
+    Latency(url, messages, payload, function (p50, p99) {
+        Throughput(url, messages, payload, function (rate, mb) {
+            console.log(name + ": rtt p50 " + p50.toFixed(1) + " us, p99 " + p99.toFixed(1) + " us, "
+                + rate.toFixed(0) + " msg/s, " + mb.toFixed(1) + " MB/s")
+            cb()
+        })
+    })
+}
+
+var mode = process.argv.length > 2 ? process.argv[2] : "server"
+if (mode == "server") {
+    var socketPath = process.argv.length > 3 ? process.argv[3] : "/tmp/uewebsocket.sock"
+    var port = process.argv.length > 4 ? parseInt(process.argv[4]) : 8080
+    CreateEchoServer(socketPath)
+    CreateEchoServer(port)
+    console.log("echo server on " + socketPath + " and " + port)
+}
+else {
+    var messages = process.argv.length > 3 ? parseInt(process.argv[3]) : 20000
+    var size = process.argv.length > 4 ? parseInt(process.argv[4]) : 256
+    var payload = Buffer.alloc(size, 0x61)
+    var socketPath = "/tmp/uewebsocket-bench.sock"
+    var port = 8082
+
+    var unixServer = CreateEchoServer(socketPath, function () {
+        var tcpServer = CreateEchoServer(port, function () {
+            Bench("tcp loopback", "ws://127.0.0.1:" + port, messages, payload, function () {
+                Bench("unix socket ", "ws+unix://" + socketPath, messages, payload, function () {
+                    unixServer.close()
+                    tcpServer.close()
+                })
+            })
+        })
+    })
+}